@@ -0,0 +1,372 @@
+//=========================================================================
+// capture.c
+//
+// Pre-trigger capture of full-rate readings for the runMag utility.
+// See capture.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include "capture.h"
+#include "cmdmgr.h"
+
+#define CAPTURE_CHUNK           256         // entries copied out of the ring at a time
+#define CAPTURE_NICE            10
+
+//------------------------------------------
+// utcString()
+//------------------------------------------
+static void utcString(int64_t ns, char *buf, int len)
+{
+    time_t secs = ns / 1000000000LL;
+    struct tm utc;
+    int n;
+
+    gmtime_r(&secs, &utc);
+    n = strftime(buf, len, "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(buf + n, len - n, ".%06iZ", (int)(ns % 1000000000LL / 1000));
+}
+
+//------------------------------------------
+// openEventFile()
+//------------------------------------------
+static FILE *openEventFile(captureBuf *c, int64_t trigNs, const char *reason)
+{
+    char path[MAXPATHBUFLEN];
+    char suffix[64];
+    char utcStr[40];
+    time_t secs = trigNs / 1000000000LL;
+    struct tm utc;
+    FILE *fp;
+
+    gmtime_r(&secs, &utc);
+    strftime(suffix, sizeof(suffix), "%H%M%S-", &utc);
+    strcat(suffix, CAPTURE_SUFFIX);
+    buildLogFilePathFor(c->p, secs, suffix, path);
+    if((fp = fopen(path, "w")) == NULL)
+    {
+        perror("Capture event file");
+        return NULL;
+    }
+    utcString(trigNs, utcStr, sizeof(utcStr));
+    fprintf(fp, "# runMag event capture, site %s\n", c->p->sitePrefix);
+    fprintf(fp, "# trigger: %s at %s\n", reason, utcStr);
+    fprintf(fp, "# rate: %i Hz, %i s before and after\n", c->rate, c->seconds);
+    fprintf(fp, "# time, rawX, rawY, rawZ, X (nT), Y (nT), Z (nT), spikes\n");
+    return fp;
+}
+
+//------------------------------------------
+// writeEntries()
+// Writes ring entries [*pos, end); returns FALSE if the sampling loop
+// overwrote some of them first.
+//------------------------------------------
+static int writeEntries(captureBuf *c, FILE *fp, uint64_t *pos, uint64_t end, uint64_t trig)
+{
+    captureEntry chunk[CAPTURE_CHUNK];
+    char utcStr[40];
+    double xyz[3];
+    uint64_t n;
+    uint64_t i;
+
+    while(*pos < end)
+    {
+        n = end - *pos;
+        if(n > CAPTURE_CHUNK)
+        {
+            n = CAPTURE_CHUNK;
+        }
+        for(i = 0; i < n; i++)
+        {
+            chunk[i] = c->ring[(*pos + i) & (c->ringLen - 1)];
+        }
+        if(__atomic_load_n(&c->written, __ATOMIC_ACQUIRE) >= *pos + c->ringLen)
+        {
+            return FALSE;
+        }
+        for(i = 0; i < n; i++)
+        {
+            if(*pos + i == trig)
+            {
+                fprintf(fp, "# trigger\n");
+            }
+            magCalApply(&c->cal, chunk[i].rXYZ, xyz, 1);
+            utcString(chunk[i].ns, utcStr, sizeof(utcStr));
+            fprintf(fp, "%s, %i, %i, %i, %.3f, %.3f, %.3f, %u\n", utcStr,
+                    chunk[i].rXYZ[0], chunk[i].rXYZ[1], chunk[i].rXYZ[2], xyz[0], xyz[1], xyz[2], chunk[i].spikeMask);
+        }
+        *pos += n;
+    }
+    return TRUE;
+}
+
+//------------------------------------------
+// captureWorker()
+//------------------------------------------
+static void *captureWorker(void *arg)
+{
+    captureBuf *c = (captureBuf *)arg;
+    FILE *fp = NULL;
+    uint64_t pos = 0;
+    uint64_t end;
+    uint64_t written;
+    int inDump = FALSE;
+
+#ifdef SYS_gettid
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), CAPTURE_NICE);
+#endif
+    pthread_mutex_lock(&c->lock);
+    while(1)
+    {
+        if(!inDump && __atomic_load_n(&c->dumping, __ATOMIC_ACQUIRE))
+        {
+            uint64_t trig = c->dumpTrig;
+            char reason[CAPTURE_REASONLEN];
+
+            strcpy(reason, c->reason);
+            pos = c->dumpStart;
+            pthread_mutex_unlock(&c->lock);
+            fp = openEventFile(c, c->ring[trig & (c->ringLen - 1)].ns, reason);
+            pthread_mutex_lock(&c->lock);
+            inDump = TRUE;
+        }
+        if(inDump)
+        {
+            written = __atomic_load_n(&c->written, __ATOMIC_ACQUIRE);
+            end = (written < c->dumpEnd) ? written : c->dumpEnd;
+            if(pos < end && fp != NULL)
+            {
+                pthread_mutex_unlock(&c->lock);
+                if(!writeEntries(c, fp, &pos, end, c->dumpTrig))
+                {
+                    // Lapped by the sampling loop: skip to what is still there.
+                    fprintf(fp, "# truncated\n");
+                    pos = __atomic_load_n(&c->written, __ATOMIC_ACQUIRE);
+                    __atomic_fetch_add(&c->truncated, 1, __ATOMIC_RELAXED);
+                }
+                fflush(fp);
+                pthread_mutex_lock(&c->lock);
+                continue;
+            }
+            if(pos >= c->dumpEnd || fp == NULL || c->stop)
+            {
+                if(fp != NULL)
+                {
+                    if(pos < c->dumpEnd)
+                    {
+                        fprintf(fp, "# truncated\n");
+                        __atomic_fetch_add(&c->truncated, 1, __ATOMIC_RELAXED);
+                    }
+                    fclose(fp);
+                    fp = NULL;
+                    __atomic_fetch_add(&c->dumps, 1, __ATOMIC_RELAXED);
+                }
+                inDump = FALSE;
+                __atomic_store_n(&c->dumping, FALSE, __ATOMIC_RELEASE);
+                continue;
+            }
+        }
+        if(c->stop)
+        {
+            break;
+        }
+        pthread_cond_wait(&c->wake, &c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+//------------------------------------------
+// openControl()
+//------------------------------------------
+static int openControl(captureBuf *c)
+{
+    struct sockaddr_un sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if(strlen(c->ctlPath) >= sizeof(sa.sun_path))
+    {
+        fprintf(stderr, "Capture control socket path too long: %s\n", c->ctlPath);
+        return -1;
+    }
+    strcpy(sa.sun_path, c->ctlPath);
+    unlink(c->ctlPath);
+    if((c->ctlFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0 ||
+       bind(c->ctlFd, (struct sockaddr *)&sa, sizeof(sa)) != 0)
+    {
+        perror("Capture control socket");
+        return -1;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// captureOpen()
+//------------------------------------------
+int captureOpen(captureBuf *c, pList *p, const magCal *cal)
+{
+    uint64_t need;
+
+    memset(c, 0, sizeof(captureBuf));
+    c->p = p;
+    c->cal = *cal;
+    c->rate = p->decimRatio;
+    c->seconds = p->captureSeconds;
+    c->level = p->captureLevel;
+    c->ctlFd = -1;
+    c->ctlPath = p->captureCtl;
+    need = (uint64_t)CAPTURE_SPAN * c->seconds * c->rate;
+    for(c->ringLen = 1; c->ringLen < need; c->ringLen <<= 1)
+    {
+    }
+    c->bytes = c->ringLen * sizeof(captureEntry);
+    if((c->ring = malloc(c->bytes)) == NULL)
+    {
+        perror("Capture buffer");
+        return -1;
+    }
+    if(c->ctlPath != NULL && openControl(c) != 0)
+    {
+        captureClose(c);
+        return -1;
+    }
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->wake, NULL);
+    if(pthread_create(&c->worker, NULL, captureWorker, c) != 0)
+    {
+        perror("Capture: pthread_create()");
+        captureClose(c);
+        return -1;
+    }
+    c->running = TRUE;
+    return 0;
+}
+
+//------------------------------------------
+// captureTrigger()
+// From the sampling loop; the dump is centred on the last reading pushed.
+//------------------------------------------
+void captureTrigger(captureBuf *c, const char *reason)
+{
+    uint64_t pre = (uint64_t)c->seconds * c->rate;
+
+    if(c->written == 0)
+    {
+        return;
+    }
+    if(__atomic_load_n(&c->dumping, __ATOMIC_ACQUIRE))
+    {
+        c->ignored++;
+        return;
+    }
+    pthread_mutex_lock(&c->lock);
+    c->dumpTrig = c->written - 1;
+    c->dumpStart = (c->dumpTrig > pre) ? c->dumpTrig - pre : 0;
+    c->dumpEnd = c->dumpTrig + pre + 1;
+    strncpy(c->reason, reason, CAPTURE_REASONLEN - 1);
+    __atomic_store_n(&c->dumping, TRUE, __ATOMIC_RELEASE);
+    pthread_cond_signal(&c->wake);
+    pthread_mutex_unlock(&c->lock);
+}
+
+//------------------------------------------
+// capturePush()
+// Stores one calibrated raw reading; checks the level trigger.
+//------------------------------------------
+void capturePush(captureBuf *c, const magSample *raw)
+{
+    captureEntry *e = &c->ring[c->written & (c->ringLen - 1)];
+    int fire = FALSE;
+    int i;
+
+    e->ns = (int64_t)raw->ts.tv_sec * 1000000000LL + raw->ts.tv_nsec;
+    memcpy(e->rXYZ, raw->spikeMask ? raw->origXYZ : raw->rXYZ, sizeof(e->rXYZ));
+    e->spikeMask = raw->spikeMask;
+    __atomic_store_n(&c->written, c->written + 1, __ATOMIC_RELEASE);
+    if(c->level > 0.0)
+    {
+        for(i = 0; i < 3; i++)
+        {
+            if(c->meanValid >= c->rate && fabs(raw->xyz[i] - c->mean[i]) > c->level)
+            {
+                fire = TRUE;
+            }
+            c->mean[i] = c->meanValid ? c->mean[i] + (raw->xyz[i] - c->mean[i]) / c->rate : raw->xyz[i];
+        }
+        if(c->meanValid < c->rate)
+        {
+            c->meanValid++;
+        }
+        if(fire)
+        {
+            captureTrigger(c, "level");
+        }
+    }
+    // Keep the writer moving once a second while a dump is in progress.
+    if(__atomic_load_n(&c->dumping, __ATOMIC_ACQUIRE) && (c->written % c->rate == 0 || c->written == c->dumpEnd))
+    {
+        pthread_mutex_lock(&c->lock);
+        pthread_cond_signal(&c->wake);
+        pthread_mutex_unlock(&c->lock);
+    }
+}
+
+//------------------------------------------
+// capturePoll()
+// Reads commands from the control socket when it is readable.
+//------------------------------------------
+void capturePoll(captureBuf *c)
+{
+    char cmd[64];
+    ssize_t n;
+
+    if(c->ctlFd < 0)
+    {
+        return;
+    }
+    while((n = recv(c->ctlFd, cmd, sizeof(cmd) - 1, 0)) > 0)
+    {
+        cmd[n] = '\0';
+        if(!strncmp(cmd, CAPTURE_CTLCMD, strlen(CAPTURE_CTLCMD)))
+        {
+            captureTrigger(c, "control");
+        }
+    }
+}
+
+//------------------------------------------
+// captureClose()
+// Finishes what is buffered of a dump in progress.
+//------------------------------------------
+void captureClose(captureBuf *c)
+{
+    if(c->running)
+    {
+        pthread_mutex_lock(&c->lock);
+        c->stop = TRUE;
+        pthread_cond_signal(&c->wake);
+        pthread_mutex_unlock(&c->lock);
+        pthread_join(c->worker, NULL);
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->wake);
+        c->running = FALSE;
+    }
+    if(c->ctlFd >= 0)
+    {
+        close(c->ctlFd);
+        unlink(c->ctlPath);
+        c->ctlFd = -1;
+    }
+    free(c->ring);
+    c->ring = NULL;
+}
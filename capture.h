@@ -0,0 +1,100 @@
+//=========================================================================
+// capture.h
+//
+// Pre-trigger capture of full-rate readings for the runMag utility.
+//
+// While decimating, every raw reading also goes into a circular buffer
+// sized for 3 * N seconds.  A trigger marks the reading it arrived with;
+// a worker thread then writes the N seconds before it and, as they come
+// in, the N seconds after it to an event file
+//
+//      <site>-<date>-<HHMMSS>-runmag-event.csv
+//
+// in the log directory.  The sampling loop only stores readings and sets
+// flags, so a slow disk never stalls it; if the writer falls more than N
+// seconds behind, the dump is marked truncated.  Triggers:
+//
+//      level       a reading more than <nT> from its 1 second running mean
+//      dbdt        a dB/dt onset (--dbdt)
+//      signal      SIGUSR1, taken by the event loop (evloop.h)
+//      control     a "trigger" datagram on a Unix socket
+//
+// Triggers during a dump are counted but do not start another.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100CAPTURE_h
+#define SWX3100CAPTURE_h
+
+#include <pthread.h>
+#include "main.h"
+#include "magcal.h"
+
+#define CAPTURE_MAXSECONDS      600
+#define CAPTURE_SPAN            3           // buffer covers N before, N after and N of slack
+#define CAPTURE_SUFFIX          "runmag-event.csv"
+#define CAPTURE_CTLCMD          "trigger"
+#define CAPTURE_REASONLEN       16
+
+//------------------------------------------
+// One buffered reading
+//------------------------------------------
+typedef struct tag_captureEntry
+{
+    int64_t     ns;
+    int32_t     rXYZ[3];
+    uint32_t    spikeMask;
+} captureEntry;
+
+//------------------------------------------
+// Capture state
+//------------------------------------------
+typedef struct tag_captureBuf
+{
+    pList          *p;
+    magCal          cal;
+    int             rate;
+    int             seconds;
+    double          level;                  // nT; 0: off
+    double          mean[3];                // running mean for the level trigger
+    int             meanValid;
+
+    // Ring, written by the sampling loop.
+    captureEntry   *ring;
+    uint64_t        ringLen;                // power of 2
+    uint64_t        written;                // atomic
+
+    // Current dump: set by the sampling loop, consumed by the worker.
+    int             dumping;                // atomic
+    uint64_t        dumpStart;
+    uint64_t        dumpTrig;
+    uint64_t        dumpEnd;
+    char            reason[CAPTURE_REASONLEN];
+
+    int             ctlFd;
+    const char     *ctlPath;
+
+    unsigned long   dumps;                  // atomic, counted by the worker
+    unsigned long   truncated;              // atomic, counted by the worker
+    unsigned long   ignored;
+    size_t          bytes;                  // memory held
+
+    int             stop;
+    int             running;
+    pthread_t       worker;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+} captureBuf;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int captureOpen(captureBuf *c, pList *p, const magCal *cal);
+void capturePush(captureBuf *c, const magSample *raw);
+void captureTrigger(captureBuf *c, const char *reason);
+void capturePoll(captureBuf *c);
+void captureClose(captureBuf *c);
+
+#endif // SWX3100CAPTURE_h
@@ -7,16 +7,35 @@
 // Date:        June 19, 2020
 // License:     GPL 3.0
 //=========================================================================
+#include <getopt.h>
 #include "main.h"
 //#include "jsmn/jsmn.h"
 //#include "uthash/uthash.h"
 #include "cmdmgr.h"
+#include "logroll.h"
+#include "mseed.h"
+#include "pipeout.h"
+#include "shmring.h"
+#include "netserve.h"
+#include "decimate.h"
+#include "hampel.h"
+#include "psd.h"
+#include "dbdt.h"
+#include "capture.h"
+#include "resample.h"
+#include "tempcomp.h"
+#include "kindex.h"
+#include "sweep.h"
+#include "logidx.h"
+#include "history.h"
+#include "journal.h"
 
 extern char version[];
 extern char outFilePath[MAXPATHBUFLEN];
 extern char workFilePath[MAXPATHBUFLEN];
 extern char rollOverTime[UTCBUFLEN];
 extern char sitePrefixString[SITEPREFIXLEN];
+extern char outputPipeName[MAXPATHBUFLEN];
 
 //-------------------------------------------
 //  Informative list of known SBC defaults,
@@ -43,6 +62,121 @@ static struct busDev busDevs[] =
     {0,                 0,                  -1,                 -1}
 };
 
+//-------------------------------------------
+//  Long-only options (we have run out of letters).
+//-------------------------------------------
+enum
+{
+    OPT_MSEED = 256,
+    OPT_MSEED_NET,
+    OPT_MSEED_LOC,
+    OPT_PIPE_POLICY,
+    OPT_PIPE_QUEUE,
+    OPT_SHM,
+    OPT_SHM_SLOTS,
+    OPT_TCP,
+    OPT_TCP_QUEUE,
+    OPT_UDP,
+    OPT_UDP_TTL,
+    OPT_NET_BATCH,
+    OPT_NET_LINGER,
+    OPT_DECIMATE,
+    OPT_DECIM_FILTER,
+    OPT_RAW_LOG,
+    OPT_CAL,
+    OPT_DESPIKE,
+    OPT_DESPIKE_K,
+    OPT_DESPIKE_MARK,
+    OPT_PSD,
+    OPT_PSD_AVG,
+    OPT_PSD_OUT,
+    OPT_PSD_BIN,
+    OPT_DBDT,
+    OPT_DBDT_ON,
+    OPT_DBDT_OFF,
+    OPT_DBDT_OUT,
+    OPT_CAPTURE,
+    OPT_CAPTURE_LEVEL,
+    OPT_CAPTURE_CTL,
+    OPT_RESAMPLE,
+    OPT_RESAMPLE_MODE,
+    OPT_TEMPCOMP,
+    OPT_TEMPCOMP_LAMBDA,
+    OPT_TEMPCOMP_FREEZE,
+    OPT_TEMPCOMP_FIT,
+    OPT_KINDEX,
+    OPT_KINDEX_K9,
+    OPT_SWEEP,
+    OPT_SWEEP_NOS,
+    OPT_SWEEP_SECS,
+    OPT_SWEEP_RATE,
+    OPT_ROLLUP,
+    OPT_LOG_INDEX,
+    OPT_HISTORY,
+    OPT_HISTORY_HOURS,
+    OPT_JOURNAL,
+    OPT_JOURNAL_SLOTS,
+    OPT_JOURNAL_SYNC,
+    OPT_METRICS,
+};
+
+static struct option longOptions[] =
+{
+    /* name,            has_arg,            flag,   val */
+    {"mseed",           required_argument,  NULL,   OPT_MSEED},
+    {"mseed-net",       required_argument,  NULL,   OPT_MSEED_NET},
+    {"mseed-loc",       required_argument,  NULL,   OPT_MSEED_LOC},
+    {"pipe-policy",     required_argument,  NULL,   OPT_PIPE_POLICY},
+    {"pipe-queue",      required_argument,  NULL,   OPT_PIPE_QUEUE},
+    {"shm",             required_argument,  NULL,   OPT_SHM},
+    {"shm-slots",       required_argument,  NULL,   OPT_SHM_SLOTS},
+    {"tcp",             required_argument,  NULL,   OPT_TCP},
+    {"tcp-queue",       required_argument,  NULL,   OPT_TCP_QUEUE},
+    {"udp",             required_argument,  NULL,   OPT_UDP},
+    {"udp-ttl",         required_argument,  NULL,   OPT_UDP_TTL},
+    {"net-batch",       required_argument,  NULL,   OPT_NET_BATCH},
+    {"net-linger",      required_argument,  NULL,   OPT_NET_LINGER},
+    {"decimate",        required_argument,  NULL,   OPT_DECIMATE},
+    {"decim-filter",    required_argument,  NULL,   OPT_DECIM_FILTER},
+    {"raw-log",         no_argument,        NULL,   OPT_RAW_LOG},
+    {"cal",             required_argument,  NULL,   OPT_CAL},
+    {"despike",         required_argument,  NULL,   OPT_DESPIKE},
+    {"despike-k",       required_argument,  NULL,   OPT_DESPIKE_K},
+    {"despike-mark",    no_argument,        NULL,   OPT_DESPIKE_MARK},
+    {"psd",             required_argument,  NULL,   OPT_PSD},
+    {"psd-avg",         required_argument,  NULL,   OPT_PSD_AVG},
+    {"psd-out",         required_argument,  NULL,   OPT_PSD_OUT},
+    {"psd-bin",         no_argument,        NULL,   OPT_PSD_BIN},
+    {"dbdt",            required_argument,  NULL,   OPT_DBDT},
+    {"dbdt-on",         required_argument,  NULL,   OPT_DBDT_ON},
+    {"dbdt-off",        required_argument,  NULL,   OPT_DBDT_OFF},
+    {"dbdt-out",        required_argument,  NULL,   OPT_DBDT_OUT},
+    {"capture",         required_argument,  NULL,   OPT_CAPTURE},
+    {"capture-level",   required_argument,  NULL,   OPT_CAPTURE_LEVEL},
+    {"capture-ctl",     required_argument,  NULL,   OPT_CAPTURE_CTL},
+    {"resample",        required_argument,  NULL,   OPT_RESAMPLE},
+    {"resample-mode",   required_argument,  NULL,   OPT_RESAMPLE_MODE},
+    {"tempcomp",        required_argument,  NULL,   OPT_TEMPCOMP},
+    {"tempcomp-lambda", required_argument,  NULL,   OPT_TEMPCOMP_LAMBDA},
+    {"tempcomp-freeze", no_argument,        NULL,   OPT_TEMPCOMP_FREEZE},
+    {"tempcomp-fit",    required_argument,  NULL,   OPT_TEMPCOMP_FIT},
+    {"kindex",          required_argument,  NULL,   OPT_KINDEX},
+    {"kindex-k9",       required_argument,  NULL,   OPT_KINDEX_K9},
+    {"sweep",           required_argument,  NULL,   OPT_SWEEP},
+    {"sweep-nos",       required_argument,  NULL,   OPT_SWEEP_NOS},
+    {"sweep-secs",      required_argument,  NULL,   OPT_SWEEP_SECS},
+    {"sweep-rate",      required_argument,  NULL,   OPT_SWEEP_RATE},
+    {"rollup",          no_argument,        NULL,   OPT_ROLLUP},
+    {"log-index",       required_argument,  NULL,   OPT_LOG_INDEX},
+    {"history",         required_argument,  NULL,   OPT_HISTORY},
+    {"history-hours",   required_argument,  NULL,   OPT_HISTORY_HOURS},
+    {"journal",         required_argument,  NULL,   OPT_JOURNAL},
+    {"journal-slots",   required_argument,  NULL,   OPT_JOURNAL_SLOTS},
+    {"journal-sync",    no_argument,        NULL,   OPT_JOURNAL_SYNC},
+    {"metrics",         required_argument,  NULL,   OPT_METRICS},
+    {NULL,              0,                  NULL,   0}
+};
+
 //------------------------------------------
 // currentTimeMillis()
 //------------------------------------------
@@ -114,31 +248,65 @@ void listSBCs()
 //  buildLogFilePath()
 //------------------------------------------
 int buildLogFilePath(pList *p)
+{
+    p->outputFilePath = workFilePath;
+    return buildLogFilePathFor(p, time(NULL), LOGROLL_TEXTSUFFIX, p->outputFilePath);
+}
+
+//------------------------------------------
+//  buildLogFilePathFor()
+//  Builds the path of a log (or side file ending in 'suffix') for the
+//  rollover period containing 'when'.  'path' must hold MAXPATHBUFLEN chars.  Safe to call from the
+//  log rollover worker thread.
+//------------------------------------------
+int buildLogFilePathFor(pList *p, time_t when, const char *suffix, char *path)
 {
     int rv = 0;
     char utcStr[UTCBUFLEN] = "";
-    struct tm *utcTime = getUTC();
+    struct tm utcTime;
 
-    p->outputFilePath = workFilePath;
-    strcpy(p->outputFilePath, outFilePath);
+    gmtime_r(&when, &utcTime);
+    strcpy(path, outFilePath);
 
     const char ch = '/';
 
-    if(p->outputFilePath[strlen(p->outputFilePath) - 1] != ch)
+    if(path[strlen(path) - 1] != ch)
+    {
+        strcat(path, "/");
+    }
+    strcat(path, (p->sitePrefix != NULL) ? p->sitePrefix : sitePrefixString);
+    strcat(path, "-");
+    if(p->logRollSeconds > 0 && p->logRollSeconds < 86400)
+    {
+        strftime(utcStr, UTCBUFLEN, "%Y%m%d-%H%M-", &utcTime);
+    }
+    else
     {
-        printf("Adding '/' to: %s\n", p->outputFilePath);
-        strcat(p->outputFilePath, "/");
+        strftime(utcStr, UTCBUFLEN, "%Y%m%d-", &utcTime);        // RFC 2822: "%a, %d %b %Y %T %z"      RFC 822: "%a, %d %b %y %T %z"
     }
-    strcat(p->outputFilePath, p->sitePrefix);
-    strcat(p->outputFilePath, utcStr);
-    strcat(p->outputFilePath, "-");
-    utcTime = getUTC();
-    strftime(utcStr, UTCBUFLEN, "%Y%m%d-runmag.log", utcTime);        // RFC 2822: "%a, %d %b %Y %T %z"      RFC 822: "%a, %d %b %y %T %z"
-    //strftime(utcStr, UTCBUFLEN, "%Y%m%d-%H%M-runmag.log", utcTime);        // RFC 2822: "%a, %d %b %Y %T %z"      RFC 822: "%a, %d %b %y %T %z"
-    strcat(p->outputFilePath, utcStr);
+    strcat(path, utcStr);
+    strcat(path, suffix);
     return rv;
 }
 
+//------------------------------------------
+//  buildSiteFilePath()
+//  As buildLogFilePathFor() without the date, for files that span
+//  rollovers.  'path' must hold MAXPATHBUFLEN chars.
+//------------------------------------------
+int buildSiteFilePath(pList *p, const char *suffix, char *path)
+{
+    strcpy(path, outFilePath);
+    if(path[strlen(path) - 1] != '/')
+    {
+        strcat(path, "/");
+    }
+    strcat(path, (p->sitePrefix != NULL) ? p->sitePrefix : sitePrefixString);
+    strcat(path, "-");
+    strcat(path, suffix);
+    return 0;
+}
+
 ////------------------------------------------
 //// readConfigFromFile()
 ////------------------------------------------
@@ -377,14 +545,24 @@ int buildLogFilePath(pList *p)
 
 
 //------------------------------------------
-// setOutputFilePath()
+// setLogRollOver()
 //------------------------------------------
 int setLogRollOver(pList *p, char *rollTime)
 {
     int rv = 0;
+    int period = parseLogRollPeriod(rollTime);
 
-    strncpy(rollOverTime, rollTime, strlen(rollTime));
-    p->logOutputTime = rollOverTime;
+    if(period <= 0)
+    {
+        fprintf(stderr, "\nInvalid log rollover period: %s  [ daily, hourly, <N>m, <N>h ]\n", rollTime);
+        rv = 1;
+    }
+    else
+    {
+        strncpy(rollOverTime, rollTime, UTCBUFLEN - 1);
+        p->logOutputTime = rollOverTime;
+        p->logRollSeconds = period;
+    }
     return rv;
 }
 
@@ -420,14 +598,32 @@ void showSettings(pList *p)
     fprintf(stdout, "\nCurrent Parameters:\n\n");
     fprintf(stdout, "   Log output path:                            %s\n",          p->buildLogPath ? "TRUE" : "FALSE");
     fprintf(stdout, "   Log output:                                 %s\n",          p->logOutput ? "TRUE" : "FALSE");
-    //fprintf(stdout, "   Log Rollover time:                          %s\n",          p->logOutputTime);
+    fprintf(stdout, "   Log Rollover period:                        %s (%i sec)\n", p->logOutputTime, p->logRollSeconds);
+    fprintf(stdout, "   Compress closed logs:                       %s\n",          p->compressLogs ? "TRUE" : "FALSE");
     fprintf(stdout, "   Log site prefix string:                     %s\n",          p->sitePrefix);
     fprintf(stdout, "   Output file path:                           %s\n",          p->outputFilePath);
-#if (USE_PIPES)
-    fprintf(stdout, "   Log output to pipes:                        %s\n",          p->useOutputPipe ? "TRUE" : "FALSE");
-    fprintf(stdout, "   Input file path:                            %s\n",          p->pipeInPath);
-    fprintf(stdout, "   Output file path:                           %s\n",          p->pipeOutPath);
-#endif
+    fprintf(stdout, "   Log output to pipe:                         %s\n",          p->useOutputPipe ? "TRUE" : "FALSE");
+    fprintf(stdout, "   Output pipe path:                           %s\n",          p->pipeOutPath);
+    fprintf(stdout, "   Output pipe queue / policy:                 %i records, %s\n", p->pipeQueueLen, pipePolicyName(p->pipePolicy));
+    fprintf(stdout, "   Shared memory ring:                         %s (%i slots)\n", p->shmName ? p->shmName : "off", p->shmSlots);
+    fprintf(stdout, "   TCP stream listener:                        %s (%i KB per client)\n", p->tcpListen ? p->tcpListen : "off", p->tcpQueueKB);
+    fprintf(stdout, "   UDP stream destination:                     %s (ttl %i)\n", p->udpDest ? p->udpDest : "off", p->udpTtl);
+    fprintf(stdout, "   Network batch / linger:                     %i records, %i ms\n", p->netBatch, p->netLingerMs);
+    fprintf(stdout, "   Oversample and decimate:                    %i:1, %s filter%s\n", p->decimRatio, decimFilterName(p->decimFilter), p->rawLog ? ", raw log" : "");
+    fprintf(stdout, "   Calibration file:                           %s\n",          p->calFilePath ? p->calFilePath : "none");
+    fprintf(stdout, "   Despike window / k / action:                %i, %.1f, %s\n", p->despikeWindow, p->despikeK, p->despikeMark ? "mark" : "replace");
+    fprintf(stdout, "   Welch PSD length / average / output:        %i, %i segments, %s%s\n", p->psdLen, p->psdAvg, p->psdOut ? p->psdOut : "side file", p->psdBinary ? " (binary)" : "");
+    fprintf(stdout, "   dB/dt windows / onset / release:            %s s, %.1f, %.1f nT/min, %s\n", p->dbdtWindows ? p->dbdtWindows : "off", p->dbdtOnset, (p->dbdtRelease > 0.0) ? p->dbdtRelease : p->dbdtOnset / 2.0, p->dbdtOut ? p->dbdtOut : "side file");
+    fprintf(stdout, "   Event capture +/- / level / control:        %i s, %.1f nT, %s\n", p->captureSeconds, p->captureLevel, p->captureCtl ? p->captureCtl : "none");
+    fprintf(stdout, "   Resample period / method:                   %g s, %s\n", p->resamplePeriod, resampleModeName(p->resampleMode));
+    fprintf(stdout, "   Temperature model / lambda:                 %s, %g%s\n", p->tempCompPath ? p->tempCompPath : "off", p->tempCompLambda, p->tempCompFreeze ? ", frozen" : "");
+    fprintf(stdout, "   K index file / K9 limit:                    %s, %.0f nT\n", p->kIndexPath ? p->kIndexPath : "off", p->kIndexK9);
+    fprintf(stdout, "   Sweep counts / NOS / secs / rate:           %s, %s, %i s, %g Hz\n", p->sweepCounts ? p->sweepCounts : "off", p->sweepNos ? p->sweepNos : "-A", p->sweepSecs, p->sweepRate);
+    fprintf(stdout, "   Rollups (1 m, 1 h, 1 d):                    %s\n",          p->rollup ? "TRUE" : "FALSE");
+    fprintf(stdout, "   Log index stride:                           %i s%s\n",     p->logIndexStride, p->logIndexStride ? "" : " (off)");
+    fprintf(stdout, "   History socket / hours:                     %s, %i h\n",   p->historySock ? p->historySock : "off", p->historyHours);
+    fprintf(stdout, "   Journal / slots:                            %s, %i%s\n",  p->journalPath ? p->journalPath : "off", p->journalSlots, p->journalSync ? ", synced" : "");
+    fprintf(stdout, "   Metrics endpoint:                           %s\n",          p->metricsAddr ? p->metricsAddr : "off");
     fprintf(stdout, "   I2C bus number as integer:                  %i (dec)\n",    p->i2cBusNumber);
     fprintf(stdout, "   I2C bus path as string:                     %s\n",          pathStr);
     fprintf(stdout, "   Built in self test (BIST) value:            %02X (hex)\n",  p->doBistMask);
@@ -455,6 +651,7 @@ void showSettings(pList *p)
     fprintf(stdout, "   Timestamp format:                           %s\n",          p->tsMilliseconds   ? "RAW"  : "UTCSTRING");
     fprintf(stdout, "   Verbose output:                             %s\n",          p->verboseFlag      ? "TRUE" : "FALSE");
     fprintf(stdout, "   Show total field:                           %s\n",          p->showTotal        ? "TRUE" : "FALSE");
+    fprintf(stdout, "   miniSEED record length:                     %i%s\n",         p->mseedRecLen, p->mseedRecLen ? "" : " (off)");
     fprintf(stdout, "\n\n");
 }
 
@@ -465,6 +662,7 @@ int getCommandLine(int argc, char** argv, pList *p)
 {
     int c;
     int NOSval = 0;
+    int vals[SWEEP_MAXVALUES];
     int magAddr = 0;
     int lTmpAddr = 0;
     int rTmpAddr = 0;
@@ -513,20 +711,64 @@ int getCommandLine(int argc, char** argv, pList *p)
     p->verboseFlag      = FALSE;
     p->showTotal        = FALSE;
     p->outputFilePath   = outFilePath;
-#if(USE_PIPES)
+    p->sitePrefix       = sitePrefixString;
     p->useOutputPipe    = FALSE;
-    p->pipeInPath       = inputPipeName;
     p->pipeOutPath      = outputPipeName;
-#endif
-    //p->logOutputTime    = rollOverTime;
+    p->pipePolicy       = ePIPE_DROP_OLDEST;
+    p->pipeQueueLen     = PIPEOUT_DEFQUEUE;
+    p->shmName          = NULL;
+    p->shmSlots         = SHMRING_DEFSLOTS;
+    p->tcpListen        = NULL;
+    p->udpDest          = NULL;
+    p->udpTtl           = NETSERVE_DEFTTL;
+    p->netBatch         = NETSERVE_DEFBATCH;
+    p->netLingerMs      = NETSERVE_DEFLINGER;
+    p->tcpQueueKB       = NETSERVE_DEFQUEUE;
+    p->decimRatio       = 1;
+    p->decimFilter      = eDECIM_GAUSS;
+    p->rawLog           = FALSE;
+    p->calFilePath      = NULL;
+    p->despikeWindow    = 0;
+    p->despikeK         = HAMPEL_DEFK;
+    p->despikeMark      = FALSE;
+    p->psdLen           = 0;
+    p->psdAvg           = PSD_DEFAVG;
+    p->psdOut           = NULL;
+    p->psdBinary        = FALSE;
+    p->dbdtWindows      = NULL;
+    p->dbdtOnset        = DBDT_DEFONSET;
+    p->dbdtRelease      = 0.0;
+    p->dbdtOut          = NULL;
+    p->captureSeconds   = 0;
+    p->captureLevel     = 0.0;
+    p->captureCtl       = NULL;
+    p->resamplePeriod   = 0.0;
+    p->resampleMode     = eRESAMPLE_CUBIC;
+    p->tempCompPath     = NULL;
+    p->tempCompLambda   = TEMPCOMP_DEFLAMBDA;
+    p->tempCompFreeze   = FALSE;
+    p->tempCompFit      = NULL;
+    p->kIndexPath       = NULL;
+    p->kIndexK9         = KINDEX_DEFK9;
+    p->sweepCounts      = NULL;
+    p->sweepNos         = NULL;
+    p->sweepSecs        = SWEEP_DEFSECS;
+    p->sweepRate        = 1.0;
+    p->rollup           = FALSE;
+    p->logIndexStride   = 0;
+    p->historySock      = NULL;
+    p->historyHours     = HISTORY_DEFHOURS;
+    p->journalPath      = NULL;
+    p->journalSlots     = JOURNAL_DEFSLOTS;
+    p->journalSync      = FALSE;
+    p->metricsAddr      = NULL;
+    p->logOutputTime    = rollOverTime;
+    p->logRollSeconds   = LOGROLL_DAILY;
+    p->compressLogs     = FALSE;
     p->logOutput        = FALSE;
     p->Version          = version;
 
-#if (USE_PIPES)
-    while((c = getopt(argc, argv, "?aA:b:B:c:CD:Ef:F:g:HhjklL:mM:O:PqrR:sS:Tt:YvVZ")) != -1)
-#else
-    while((c = getopt(argc, argv, "?aA:b:B:c:CD:Ef:F:g:HhjklL:mM:O:PqrR:sS:Tt:vVZ")) != -1)
-#endif
+    while((c = getopt_long(argc, argv, "?aA:b:B:c:CD:Ef:F:g:HhjkK:lL:mM:O:PqrR:sS:Tt:Y:vVzZ", longOptions, NULL)) != -1)
     {
         //int this_option_optind = optind ? optind : 1;
         switch(c)
@@ -602,10 +844,14 @@ int getCommandLine(int argc, char** argv, pList *p)
                 p->logOutput = TRUE;
                 p->buildLogPath = TRUE;
                 break;
-            //case 'K':
-            //    setLogRollOver(p, optarg);
-            //    p->buildLogPath = TRUE;
-            //    break;
+            case 'K':
+                if(setLogRollOver(p, optarg))
+                {
+                    exit(1);
+                }
+                p->logOutput = TRUE;
+                p->buildLogPath = TRUE;
+                break;
             case 'l':
                 p->localTempOnly = TRUE;
                 break;
@@ -681,14 +927,325 @@ int getCommandLine(int argc, char** argv, pList *p)
                 p->verboseFlag = TRUE;
                 p->quietFlag = FALSE;
                 break;
-#if (USE_PIPES)
             case 'Y':
+                if(strlen(optarg) >= MAXPATHBUFLEN)
+                {
+                    fprintf(stderr, "\nPipe path must be less than %i characters.\n", MAXPATHBUFLEN);
+                    exit(1);
+                }
+                strcpy(outputPipeName, optarg);
                 p->useOutputPipe = TRUE;
                 break;
-#endif
+            case 'z':
+                p->compressLogs = TRUE;
+                break;
             case 'Z':
                 p->showTotal = TRUE;
                 break;
+            case OPT_MSEED:
+                p->mseedRecLen = atoi(optarg);
+                if((p->mseedRecLen != MSEED_MINRECLEN) && (p->mseedRecLen != MSEED_MAXRECLEN))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: miniSEED record length must be %i or %i.\n\n", MSEED_MINRECLEN, MSEED_MAXRECLEN);
+                    exit(1);
+                }
+                break;
+            case OPT_MSEED_NET:
+                p->mseedNetwork = optarg;
+                break;
+            case OPT_MSEED_LOC:
+                p->mseedLocation = optarg;
+                break;
+            case OPT_PIPE_POLICY:
+                if((p->pipePolicy = parsePipePolicy(optarg)) < 0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: pipe policy must be oldest, newest or decimate.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_PIPE_QUEUE:
+                p->pipeQueueLen = atoi(optarg);
+                if((p->pipeQueueLen < PIPEOUT_MINQUEUE) || (p->pipeQueueLen > PIPEOUT_MAXQUEUE))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: pipe queue must be %i to %i records.\n\n", PIPEOUT_MINQUEUE, PIPEOUT_MAXQUEUE);
+                    exit(1);
+                }
+                break;
+            case OPT_SHM:
+                p->shmName = optarg;
+                break;
+            case OPT_SHM_SLOTS:
+                p->shmSlots = atoi(optarg);
+                if((p->shmSlots <= 0) || (p->shmSlots & (p->shmSlots - 1)) || (p->shmSlots > SHMRING_MAXSLOTS))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: shm slots must be a power of two <= %i.\n\n", SHMRING_MAXSLOTS);
+                    exit(1);
+                }
+                break;
+            case OPT_TCP:
+                p->tcpListen = optarg;
+                break;
+            case OPT_TCP_QUEUE:
+                p->tcpQueueKB = atoi(optarg);
+                if((p->tcpQueueKB < 4) || (p->tcpQueueKB > NETSERVE_MAXQUEUE))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: TCP queue must be 4 to %i KB.\n\n", NETSERVE_MAXQUEUE);
+                    exit(1);
+                }
+                break;
+            case OPT_UDP:
+                p->udpDest = optarg;
+                break;
+            case OPT_UDP_TTL:
+                p->udpTtl = atoi(optarg);
+                if((p->udpTtl < 1) || (p->udpTtl > 255))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: UDP multicast TTL must be 1 to 255.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_NET_BATCH:
+                p->netBatch = atoi(optarg);
+                if((p->netBatch < 1) || (p->netBatch > NETSERVE_MAXBATCH))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: network batch must be 1 to %i records.\n\n", NETSERVE_MAXBATCH);
+                    exit(1);
+                }
+                break;
+            case OPT_NET_LINGER:
+                p->netLingerMs = atoi(optarg);
+                if(p->netLingerMs < 0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: network linger must be >= 0 ms.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_DECIMATE:
+                p->decimRatio = atoi(optarg);
+                if((p->decimRatio < 1) || (p->decimRatio > DECIM_MAXRATIO))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: decimation ratio must be 1 to %i.\n\n", DECIM_MAXRATIO);
+                    exit(1);
+                }
+                break;
+            case OPT_DECIM_FILTER:
+                if((p->decimFilter = parseDecimFilter(optarg)) < 0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: decimation filter must be gauss, cic or boxcar.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_RAW_LOG:
+                p->rawLog = TRUE;
+                break;
+            case OPT_CAL:
+                p->calFilePath = optarg;
+                break;
+            case OPT_DESPIKE:
+                p->despikeWindow = atoi(optarg);
+                if((p->despikeWindow < HAMPEL_MINWINDOW) || (p->despikeWindow > HAMPEL_MAXWINDOW) || !(p->despikeWindow & 1))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: despike window must be odd, %i to %i samples.\n\n", HAMPEL_MINWINDOW, HAMPEL_MAXWINDOW);
+                    exit(1);
+                }
+                break;
+            case OPT_DESPIKE_K:
+                p->despikeK = atof(optarg);
+                if(p->despikeK <= 0.0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: despike threshold must be > 0.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_DESPIKE_MARK:
+                p->despikeMark = TRUE;
+                break;
+            case OPT_PSD:
+                p->psdLen = atoi(optarg);
+                if((p->psdLen < PSD_MINLEN) || (p->psdLen > PSD_MAXLEN) || (p->psdLen & (p->psdLen - 1)))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: PSD length must be a power of 2, %i to %i.\n\n", PSD_MINLEN, PSD_MAXLEN);
+                    exit(1);
+                }
+                break;
+            case OPT_PSD_AVG:
+                p->psdAvg = atoi(optarg);
+                if((p->psdAvg < 1) || (p->psdAvg > PSD_MAXAVG))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: PSD average must be 1 to %i segments.\n\n", PSD_MAXAVG);
+                    exit(1);
+                }
+                break;
+            case OPT_PSD_OUT:
+                p->psdOut = optarg;
+                break;
+            case OPT_PSD_BIN:
+                p->psdBinary = TRUE;
+                break;
+            case OPT_DBDT:
+                {
+                    int win[DBDT_MAXWINDOWS];
+
+                    if(parseDbdtWindows(optarg, win) < 0)
+                    {
+                        fprintf(stderr, "\n ERROR Invalid: dB/dt windows must be up to %i comma separated seconds, 1 to %i.\n\n", DBDT_MAXWINDOWS, DBDT_MAXWINDOW);
+                        exit(1);
+                    }
+                    p->dbdtWindows = optarg;
+                }
+                break;
+            case OPT_DBDT_ON:
+                p->dbdtOnset = atof(optarg);
+                if(p->dbdtOnset <= 0.0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: dB/dt onset threshold must be > 0.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_DBDT_OFF:
+                p->dbdtRelease = atof(optarg);
+                if(p->dbdtRelease <= 0.0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: dB/dt release threshold must be > 0.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_DBDT_OUT:
+                p->dbdtOut = optarg;
+                break;
+            case OPT_CAPTURE:
+                p->captureSeconds = atoi(optarg);
+                if((p->captureSeconds < 1) || (p->captureSeconds > CAPTURE_MAXSECONDS))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: capture span must be 1 to %i seconds.\n\n", CAPTURE_MAXSECONDS);
+                    exit(1);
+                }
+                break;
+            case OPT_CAPTURE_LEVEL:
+                p->captureLevel = atof(optarg);
+                if(p->captureLevel <= 0.0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: capture level must be > 0 nT.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_CAPTURE_CTL:
+                p->captureCtl = optarg;
+                break;
+            case OPT_RESAMPLE:
+                p->resamplePeriod = atof(optarg);
+                if((p->resamplePeriod < RESAMPLE_MINPERIOD) || (p->resamplePeriod > RESAMPLE_MAXPERIOD))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: resample period must be %g to %g seconds.\n\n", RESAMPLE_MINPERIOD, RESAMPLE_MAXPERIOD);
+                    exit(1);
+                }
+                break;
+            case OPT_RESAMPLE_MODE:
+                if((p->resampleMode = parseResampleMode(optarg)) < 0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: resample method must be linear, cubic or sinc.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_TEMPCOMP:
+                p->tempCompPath = optarg;
+                break;
+            case OPT_TEMPCOMP_LAMBDA:
+                p->tempCompLambda = atof(optarg);
+                if((p->tempCompLambda <= 0.0) || (p->tempCompLambda > 1.0))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: tempcomp lambda must be > 0 and <= 1.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_TEMPCOMP_FREEZE:
+                p->tempCompFreeze = TRUE;
+                break;
+            case OPT_TEMPCOMP_FIT:
+                p->tempCompFit = optarg;
+                break;
+            case OPT_KINDEX:
+                p->kIndexPath = optarg;
+                break;
+            case OPT_KINDEX_K9:
+                p->kIndexK9 = atof(optarg);
+                if((p->kIndexK9 < 50.0) || (p->kIndexK9 > 5000.0))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: K9 limit must be 50 to 5000 nT.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_SWEEP:
+                if(parseSweepList(optarg, vals, 1, CC_800) < 0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: sweep cycle counts must be up to %i values of 1 to %i, comma separated.\n\n", SWEEP_MAXVALUES, CC_800);
+                    exit(1);
+                }
+                p->sweepCounts = optarg;
+                break;
+            case OPT_SWEEP_NOS:
+                if(parseSweepList(optarg, vals, 1, 255) < 0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: sweep NOS values must be up to %i values of 1 to 255, comma separated.\n\n", SWEEP_MAXVALUES);
+                    exit(1);
+                }
+                p->sweepNos = optarg;
+                break;
+            case OPT_SWEEP_SECS:
+                p->sweepSecs = atoi(optarg);
+                if((p->sweepSecs < SWEEP_MINSECS) || (p->sweepSecs > SWEEP_MAXSECS))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: sweep time must be %i to %i seconds per setting.\n\n", SWEEP_MINSECS, SWEEP_MAXSECS);
+                    exit(1);
+                }
+                break;
+            case OPT_SWEEP_RATE:
+                p->sweepRate = atof(optarg);
+                if(p->sweepRate <= 0.0)
+                {
+                    fprintf(stderr, "\n ERROR Invalid: sweep target rate must be > 0 Hz.\n\n");
+                    exit(1);
+                }
+                break;
+            case OPT_ROLLUP:
+                p->rollup = TRUE;
+                break;
+            case OPT_LOG_INDEX:
+                p->logIndexStride = atoi(optarg);
+                if((p->logIndexStride < 1) || (p->logIndexStride > LOGIDX_MAXSTRIDE))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: log index stride must be 1 to %i seconds.\n\n", LOGIDX_MAXSTRIDE);
+                    exit(1);
+                }
+                break;
+            case OPT_HISTORY:
+                p->historySock = optarg;
+                break;
+            case OPT_HISTORY_HOURS:
+                p->historyHours = atoi(optarg);
+                if((p->historyHours < 1) || (p->historyHours > HISTORY_MAXHOURS))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: history must be 1 to %i hours.\n\n", HISTORY_MAXHOURS);
+                    exit(1);
+                }
+                break;
+            case OPT_JOURNAL:
+                p->journalPath = optarg;
+                break;
+            case OPT_JOURNAL_SLOTS:
+                p->journalSlots = atoi(optarg);
+                if((p->journalSlots < JOURNAL_MINSLOTS) || (p->journalSlots > JOURNAL_MAXSLOTS))
+                {
+                    fprintf(stderr, "\n ERROR Invalid: journal slots must be %i to %i.\n\n", JOURNAL_MINSLOTS, JOURNAL_MAXSLOTS);
+                    exit(1);
+                }
+                break;
+            case OPT_JOURNAL_SYNC:
+                p->journalSync = TRUE;
+                break;
+            case OPT_METRICS:
+                p->metricsAddr = optarg;
+                break;
             case 'h':
             case '?':
                 fprintf(stdout, "\n%s Version = %s\n", argv[0], version);
@@ -708,7 +1265,7 @@ int getCommandLine(int argc, char** argv, pList *p)
                 fprintf(stdout, "   -H                     :  Hide raw measurments.\n");
                 fprintf(stdout, "   -j                     :  Format output as JSON.\n");
                 fprintf(stdout, "   -k                     :  Create and roll log files.            [ 00:00 UTC default ]\n");
-                //fprintf(stdout, "   -K <time string>       :  Rotate log time.                      [ if non-default - UTC ]\n");
+                fprintf(stdout, "   -K <period>            :  Log rollover period.                  [ daily (default), hourly, <N>m, <N>h ]\n");
                 fprintf(stdout, "   -L <addr as integer>   :  Local temperature address.            [ default 19 hex ]\n");
                 fprintf(stdout, "   -l                     :  Read local temperature only.\n");
                 fprintf(stdout, "   -M <addr as integer>   :  Magnetometer address.                 [ default 20 hex ]\n");
@@ -725,11 +1282,62 @@ int getCommandLine(int argc, char** argv, pList *p)
                 fprintf(stdout, "   -T                     :  Raw timestamp in milliseconds.        [ default: UTC string ]\n");
 //                fprintf(stdout, "   -U <delay as ms>       :  Delay in mSec before DRDY.            [ default: 0 ]\n");
                 fprintf(stdout, "   -V                     :  Display software version and exit.\n");
-#if(USE_PIPES)
-                fprintf(stdout, "   -Y                     :  Use WebSockets.                       [ default False].\n");
-#endif
+                fprintf(stdout, "   -Y <fifo path>         :  Also publish records to a FIFO.       [ non-blocking, e.g. /home/web/wsroot/pipein.fifo ]\n");
+                fprintf(stdout, "   -z                     :  Compress closed log files.            [ gzip, run at low priority ]\n");
                 fprintf(stdout, "   -Z                     :  Show total field.                     [ sqrt((x*x) + (y*y) + (z*z)) ]\n");
-                fprintf(stdout, "   -h or -?               :  Display this help.\n\n");
+                fprintf(stdout, "   -h or -?               :  Display this help.\n");
+                fprintf(stdout, "   --mseed <512|4096>     :  Also write miniSEED, Steim2 raw counts. [ <site>-<date>-runmag.mseed ]\n");
+                fprintf(stdout, "   --mseed-net <NN>       :  miniSEED network code.                [ default XX ]\n");
+                fprintf(stdout, "   --mseed-loc <LL>       :  miniSEED location code.               [ default blank ]\n");
+                fprintf(stdout, "   --pipe-policy <p>      :  When the pipe queue is full.          [ oldest (default), newest, decimate ]\n");
+                fprintf(stdout, "   --pipe-queue <n>       :  Records queued for a slow reader.     [ default 64 ]\n");
+                fprintf(stdout, "   --shm <name>           :  Publish samples to shared memory.     [ e.g. /runmag; read with magtail ]\n");
+                fprintf(stdout, "   --shm-slots <n>        :  Shared memory ring size, power of 2.  [ default 4096 ]\n");
+                fprintf(stdout, "   --tcp <[addr:]port>    :  Serve binary batches over TCP.        [ e.g. 5150 or 127.0.0.1:5150 ]\n");
+                fprintf(stdout, "   --tcp-queue <KB>       :  Queue per TCP client before eviction. [ default 64 ]\n");
+                fprintf(stdout, "   --udp <addr:port>      :  Send binary batches over UDP.         [ unicast or multicast ]\n");
+                fprintf(stdout, "   --udp-ttl <n>          :  Multicast TTL.                        [ default 1 ]\n");
+                fprintf(stdout, "   --net-batch <n>        :  Samples per TCP/UDP batch.            [ 1 (default) to 22 ]\n");
+                fprintf(stdout, "   --net-linger <ms>      :  Longest a partial batch may wait.     [ default 1000 ]\n");
+                fprintf(stdout, "   --decimate <n>         :  Sample at n Hz, filter down to 1 Hz.  [ e.g. 50; default 1 (off) ]\n");
+                fprintf(stdout, "   --decim-filter <f>     :  Decimation filter.                    [ gauss (default), cic, boxcar ]\n");
+                fprintf(stdout, "   --raw-log              :  Also log every oversampled reading.   [ <site>-<date>-runmag-raw.log, needs -k ]\n");
+                fprintf(stdout, "   --cal <file>           :  Hard/soft iron calibration.           [ 'offset' and 'matrix' lines, see magcal.h ]\n");
+                fprintf(stdout, "   --despike <n>          :  Hampel despike, window of n readings. [ odd, 3 to 255; adds a spike mask column ]\n");
+                fprintf(stdout, "   --despike-k <k>        :  Spike threshold in robust sigmas.     [ default 3.0 ]\n");
+                fprintf(stdout, "   --despike-mark         :  Flag spikes but keep the values.\n");
+                fprintf(stdout, "   --psd <n>              :  Welch PSD, n point Hann segments.     [ power of 2, 16 to 65536; 50%% overlap ]\n");
+                fprintf(stdout, "   --psd-avg <n>          :  Segments averaged per PSD frame.      [ default 8 ]\n");
+                fprintf(stdout, "   --psd-out <dest>       :  PSD frames to a file or udp:host:port. [ default <site>-<date>-runmag-psd.json, needs -k ]\n");
+                fprintf(stdout, "   --psd-bin              :  Binary PSD frames (see psd.h).        [ always for UDP ]\n");
+                fprintf(stdout, "   --dbdt <s[,s..]>       :  dB/dt alerts over windows of s sec.   [ e.g. 10,60; X, Y, Z and total field ]\n");
+                fprintf(stdout, "   --dbdt-on <nT/min>     :  dB/dt onset threshold.                [ default 10 ]\n");
+                fprintf(stdout, "   --dbdt-off <nT/min>    :  dB/dt release threshold.              [ default half the onset ]\n");
+                fprintf(stdout, "   --dbdt-out <dest>      :  Alerts to a file, FIFO or udp:host:port. [ default <site>-<date>-runmag-alert.log, needs -k ]\n");
+                fprintf(stdout, "   --capture <N>          :  Keep N s of full-rate readings.       [ dump +/-N s on a trigger; needs --decimate and -k ]\n");
+                fprintf(stdout, "   --capture-level <nT>   :  Trigger at nT from the 1 s mean.      [ dB/dt onsets and SIGUSR1 also trigger ]\n");
+                fprintf(stdout, "   --capture-ctl <path>   :  Capture control socket (Unix dgram).  [ send \"trigger\" ]\n");
+                fprintf(stdout, "   --resample <s>         :  Also log on an exact UTC grid.        [ period in s; <site>-<date>-runmag-grid.log, needs -k ]\n");
+                fprintf(stdout, "   --resample-mode <m>    :  Grid interpolation.                   [ linear, cubic (default), sinc; adds a gap flags column ]\n");
+                fprintf(stdout, "   --tempcomp <file>      :  Temperature compensation model.       [ adds cx, cy, cz columns; learns online, saved to file ]\n");
+                fprintf(stdout, "   --tempcomp-lambda <l>  :  Model forgetting factor.              [ default 0.99999, about a day at 1 Hz ]\n");
+                fprintf(stdout, "   --tempcomp-freeze      :  Apply the model without updating it.  [ needs an existing model file ]\n");
+                fprintf(stdout, "   --tempcomp-fit <log>   :  Fit the model from a runMag log.      [ writes --tempcomp file and exits; same -r as the log ]\n");
+                fprintf(stdout, "   --kindex <file>        :  Keep K and hourly range indices.      [ JSON rewritten each minute; FMI method on X, Y ]\n");
+                fprintf(stdout, "   --kindex-k9 <nT>       :  Station K9 lower limit.               [ default 500 ]\n");
+                fprintf(stdout, "   --sweep <cc,cc,..>     :  Sweep cycle counts, then exit.        [ rate, timing, noise per setting; recommends -c / -A ]\n");
+                fprintf(stdout, "   --sweep-nos <n,n,..>   :  NOS values to sweep.                  [ default the -A value ]\n");
+                fprintf(stdout, "   --sweep-secs <s>       :  Time per sweep setting.               [ default 10 ]\n");
+                fprintf(stdout, "   --sweep-rate <Hz>      :  Target rate for the recommendation.   [ default 1 ]\n");
+                fprintf(stdout, "   --rollup               :  Keep minute, hour and day rollups.    [ binary rollRecord files; needs -k ]\n");
+                fprintf(stdout, "   --log-index <s>        :  Keep a time index beside each log.    [ entry per s s, e.g. 60; needs -k; magseek ]\n");
+                fprintf(stdout, "   --history <path>       :  Serve recent samples (Unix socket).   [ info, last <s> [<points>], range <from> <to> [<points>] ]\n");
+                fprintf(stdout, "   --history-hours <h>    :  Hours of samples kept in memory.      [ default %i, at most %i ]\n", HISTORY_DEFHOURS, HISTORY_MAXHOURS);
+                fprintf(stdout, "   --journal <path>       :  Journal samples to a mapped file.     [ e.g. /dev/shm/runmag.jnl; recovered at start; needs -k ]\n");
+                fprintf(stdout, "   --journal-slots <n>    :  Samples kept in the journal.          [ default %i, %i to %i ]\n", JOURNAL_DEFSLOTS, JOURNAL_MINSLOTS, JOURNAL_MAXSLOTS);
+                fprintf(stdout, "   --journal-sync         :  msync() the journal every sample.     [ survives power loss if <path> is on disk ]\n");
+                fprintf(stdout, "   --metrics <addr|path>  :  Prometheus metrics over HTTP.         [ [addr:]port, or a Unix socket path ]\n");
+                fprintf(stdout, "\n");
                 return 1;
                 break;
             default:
@@ -21,6 +21,9 @@ long currentTimeMillis();
 struct tm *getUTC();
 void listSBCs();
 int buildLogFilePath(pList *p);
+int buildLogFilePathFor(pList *p, time_t when, const char *suffix, char *path);
+int buildSiteFilePath(pList *p, const char *suffix, char *path);
+int setLogRollOver(pList *p, char *rollTime);
 void showCountGainRelationship();
 //int readConfigFromFile(pList *p, char *cfgFile);
 //int saveConfigToFile(pList *p, char *cfgFile);
@@ -0,0 +1,282 @@
+//=========================================================================
+// dbdt.c
+//
+// dB/dt event detector for the runMag utility.  See dbdt.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dbdt.h"
+#include "netserve.h"
+
+static const char chanName[DBDT_CHANNELS] = { 'X', 'Y', 'Z', 'F' };
+
+//------------------------------------------
+// parseDbdtWindows()
+// "w1[,w2...]" in seconds; returns the count or -1.
+//------------------------------------------
+int parseDbdtWindows(const char *spec, int *win)
+{
+    const char *s = spec;
+    char *end;
+    long w;
+    int n = 0;
+
+    while(*s)
+    {
+        w = strtol(s, &end, 10);
+        if(end == s || w < 1 || w > DBDT_MAXWINDOW || n == DBDT_MAXWINDOWS || (*end != ',' && *end != '\0'))
+        {
+            return -1;
+        }
+        win[n++] = (int)w;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return (n > 0) ? n : -1;
+}
+
+//------------------------------------------
+// openSink()
+// (Re)opens a file or FIFO without blocking.
+//------------------------------------------
+static void openSink(dbdtDetector *d)
+{
+    d->fd = open(d->outPath, O_WRONLY | O_APPEND | O_CREAT | O_NONBLOCK | O_CLOEXEC, 0644);
+}
+
+//------------------------------------------
+// emitAlert()
+//------------------------------------------
+static void emitAlert(dbdtDetector *d, const magSample *smp, const char *event, int w, int ch, double rate, const dbdtState *st)
+{
+    char buf[DBDT_ALERTLEN];
+    char utcStr[32];
+    struct tm utc;
+    struct timespec now;
+    double latMs;
+    int len;
+
+    gmtime_r(&smp->ts.tv_sec, &utc);
+    strftime(utcStr, sizeof(utcStr), "%Y-%m-%dT%H:%M:%S", &utc);
+    clock_gettime(CLOCK_REALTIME, &now);
+    latMs = (now.tv_sec - smp->ts.tv_sec) * 1e3 + (now.tv_nsec - smp->ts.tv_nsec) / 1e6;
+    len = snprintf(buf, sizeof(buf),
+                   "{\"ts\":\"%s.%03liZ\",\"event\":\"%s\",\"ch\":\"%c\",\"win\":%i,\"dbdt\":%.2f,\"peak\":%.2f,\"dur\":%.1f,\"lat_ms\":%.3f}\n",
+                   utcStr, smp->ts.tv_nsec / 1000000, event, chanName[ch], w, rate, st->peak,
+                   ((int64_t)smp->ts.tv_sec * 1000000000LL + smp->ts.tv_nsec - st->startNs) / 1e9, latMs);
+    if(d->udpFd >= 0)
+    {
+        if(sendto(d->udpFd, buf, len, MSG_DONTWAIT, (struct sockaddr *)&d->dest, d->destLen) != len)
+        {
+            d->dropped++;
+            return;
+        }
+    }
+    else if(d->useRoll)
+    {
+        d->fp = logRollCheck(&d->roll, time(NULL));
+        fwrite(buf, 1, len, d->fp);
+        fflush(d->fp);
+    }
+    else
+    {
+        if(d->fd < 0)
+        {
+            openSink(d);
+        }
+        if(d->fd < 0 || write(d->fd, buf, len) != len)
+        {
+            if(d->fd >= 0 && errno == EPIPE)
+            {
+                close(d->fd);
+                d->fd = -1;
+            }
+            d->dropped++;
+            return;
+        }
+    }
+    d->alerts++;
+    if(latMs > d->maxLatencyMs)
+    {
+        d->maxLatencyMs = latMs;
+    }
+}
+
+//------------------------------------------
+// dbdtOpen()
+// rate is the output sample rate in Hz; the windows are in seconds.
+//------------------------------------------
+int dbdtOpen(dbdtDetector *d, pList *p, double rate)
+{
+    int i;
+
+    memset(d, 0, sizeof(dbdtDetector));
+    d->fd = -1;
+    d->udpFd = -1;
+    if((d->nWin = parseDbdtWindows(p->dbdtWindows, d->win)) < 0)
+    {
+        return -1;
+    }
+    d->onset = p->dbdtOnset;
+    d->release = (p->dbdtRelease > 0.0) ? p->dbdtRelease : p->dbdtOnset / 2.0;
+    for(i = 0; i < d->nWin; i++)
+    {
+        d->lag[i] = (int)lround(d->win[i] * rate);
+        if(d->lag[i] < 1)
+        {
+            d->lag[i] = 1;
+        }
+        if(d->lag[i] + 1 > d->histLen)
+        {
+            d->histLen = d->lag[i] + 1;
+        }
+    }
+    if((d->hist = malloc(d->histLen * sizeof(dbdtPoint))) == NULL)
+    {
+        perror("dB/dt detector");
+        return -1;
+    }
+    d->outPath = p->dbdtOut;
+    if(d->outPath != NULL && !strncmp(d->outPath, "udp:", 4))
+    {
+        if(netParseAddr(d->outPath + 4, 0, SOCK_DGRAM, &d->dest, &d->destLen) != 0)
+        {
+            dbdtClose(d);
+            return -1;
+        }
+        if((d->udpFd = socket(d->dest.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+        {
+            perror("dB/dt alerts: socket()");
+            dbdtClose(d);
+            return -1;
+        }
+    }
+    else if(d->outPath != NULL)
+    {
+        // A FIFO without a reader fails here with ENXIO; retried per alert.
+        signal(SIGPIPE, SIG_IGN);
+        openSink(d);
+        if(d->fd < 0 && errno != ENXIO)
+        {
+            perror("dB/dt alert file");
+            dbdtClose(d);
+            return -1;
+        }
+    }
+    else if(!p->buildLogPath)
+    {
+        fprintf(stderr, "\n --dbdt needs log files (-k) or --dbdt-out.\n\n");
+        dbdtClose(d);
+        return -1;
+    }
+    else if((d->fp = logRollOpenFile(&d->roll, p, DBDT_SUFFIX)) == NULL)
+    {
+        perror("dB/dt alert side file");
+        dbdtClose(d);
+        return -1;
+    }
+    else
+    {
+        d->useRoll = TRUE;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// dbdtPush()
+// Called once per output sample, after it has been logged.  Returns the
+// number of onsets.
+//------------------------------------------
+int dbdtPush(dbdtDetector *d, const magSample *smp)
+{
+    const dbdtPoint *then;
+    dbdtPoint *cur = &d->hist[d->count % d->histLen];
+    dbdtState *st;
+    double dt;
+    double rate;
+    int onsets = 0;
+    int ch;
+    int i;
+    int n;
+    int w;
+
+    cur->b[0] = smp->xyz[0];
+    cur->b[1] = smp->xyz[1];
+    cur->b[2] = smp->xyz[2];
+    cur->b[3] = sqrt(smp->xyz[0] * smp->xyz[0] + smp->xyz[1] * smp->xyz[1] + smp->xyz[2] * smp->xyz[2]);
+    cur->ns = (int64_t)smp->ts.tv_sec * 1000000000LL + smp->ts.tv_nsec;
+    d->count++;
+    for(i = 0; i < d->nWin; i++)
+    {
+        w = d->win[i];
+        n = d->lag[i];
+        if(d->count <= (uint64_t)n)
+        {
+            continue;
+        }
+        then = &d->hist[(d->count - 1 - n) % d->histLen];
+        dt = (cur->ns - then->ns) / 1e9;
+        if(dt < 0.5 * w || dt > 1.5 * w)
+        {
+            // Gap or clock step inside the window; hold the current state.
+            continue;
+        }
+        for(ch = 0; ch < DBDT_CHANNELS; ch++)
+        {
+            st = &d->state[i][ch];
+            rate = (cur->b[ch] - then->b[ch]) * 60.0 / dt;
+            if(!st->active && fabs(rate) >= d->onset)
+            {
+                st->active = TRUE;
+                st->peak = rate;
+                st->startNs = cur->ns;
+                emitAlert(d, smp, "onset", w, ch, rate, st);
+                onsets++;
+            }
+            else if(st->active)
+            {
+                if(fabs(rate) > fabs(st->peak))
+                {
+                    st->peak = rate;
+                }
+                if(fabs(rate) < d->release)
+                {
+                    st->active = FALSE;
+                    emitAlert(d, smp, "end", w, ch, rate, st);
+                }
+            }
+        }
+    }
+    return onsets;
+}
+
+//------------------------------------------
+// dbdtClose()
+//------------------------------------------
+void dbdtClose(dbdtDetector *d)
+{
+    if(d->useRoll)
+    {
+        logRollClose(&d->roll);
+        d->useRoll = FALSE;
+    }
+    if(d->fd >= 0)
+    {
+        close(d->fd);
+        d->fd = -1;
+    }
+    if(d->udpFd >= 0)
+    {
+        close(d->udpFd);
+        d->udpFd = -1;
+    }
+    free(d->hist);
+    d->hist = NULL;
+}
@@ -0,0 +1,98 @@
+//=========================================================================
+// dbdt.h
+//
+// dB/dt event detector for the runMag utility.
+//
+// For each window w (seconds) the rate of change of X, Y, Z and the total
+// field F is
+//
+//      dB/dt = (B(t) - B(t - w)) / w                   nT/min
+//
+// using the sample times, so jitter and short gaps do not skew it.  A
+// channel goes active when |dB/dt| reaches the onset threshold and
+// clears when it falls below the (lower) release threshold.  Each change
+// is one JSON line:
+//
+//      {"ts":"<sample UTC>","event":"onset"|"end","ch":"X"|"Y"|"Z"|"F",
+//       "win":<s>,"dbdt":<nT/min>,"peak":<nT/min>,"dur":<s>,"lat_ms":<ms>}
+//
+// lat_ms runs from the acquisition time stamp of the sample to the write
+// of the alert.  Alerts go to a rolled side file, a file, a FIFO (opened
+// non-blocking; alerts are dropped while nobody reads) or UDP.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100DBDT_h
+#define SWX3100DBDT_h
+
+#include <sys/socket.h>
+#include "main.h"
+#include "logroll.h"
+
+#define DBDT_MAXWINDOWS         4
+#define DBDT_MAXWINDOW          3600        // seconds
+#define DBDT_CHANNELS           4           // X, Y, Z, F
+#define DBDT_DEFWINDOWS         "60"
+#define DBDT_DEFONSET           10.0        // nT/min
+#define DBDT_ALERTLEN           256
+#define DBDT_SUFFIX             "runmag-alert.log"
+
+//------------------------------------------
+// One sample of history
+//------------------------------------------
+typedef struct tag_dbdtPoint
+{
+    double      b[DBDT_CHANNELS];
+    int64_t     ns;
+} dbdtPoint;
+
+//------------------------------------------
+// One channel in one window
+//------------------------------------------
+typedef struct tag_dbdtState
+{
+    int         active;
+    double      peak;
+    int64_t     startNs;
+} dbdtState;
+
+//------------------------------------------
+// Detector
+//------------------------------------------
+typedef struct tag_dbdtDetector
+{
+    int             nWin;
+    int             win[DBDT_MAXWINDOWS];   // seconds
+    int             lag[DBDT_MAXWINDOWS];   // the same in output samples
+    double          onset;
+    double          release;
+    dbdtPoint      *hist;
+    int             histLen;                // longest lag + 1
+    uint64_t        count;
+    dbdtState       state[DBDT_MAXWINDOWS][DBDT_CHANNELS];
+
+    const char     *outPath;
+    int             fd;
+    FILE           *fp;
+    logRoll         roll;
+    int             useRoll;
+    int             udpFd;
+    struct sockaddr_storage dest;
+    socklen_t       destLen;
+
+    unsigned long   alerts;
+    unsigned long   dropped;
+    double          maxLatencyMs;
+} dbdtDetector;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int parseDbdtWindows(const char *spec, int *win);
+int dbdtOpen(dbdtDetector *d, pList *p, double rate);
+int dbdtPush(dbdtDetector *d, const magSample *smp);
+void dbdtClose(dbdtDetector *d);
+
+#endif // SWX3100DBDT_h
@@ -0,0 +1,243 @@
+//=========================================================================
+// decimate.c
+//
+// Oversample-and-decimate filtering for the runMag utility.
+// See decimate.h for the filter designs.
+//
+// The FIR is evaluated only once per output (polyphase), and each tap
+// is applied to X, Y and Z at once as one 4 lane vector.  The history is
+// stored twice over so the window is always one contiguous run.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "decimate.h"
+
+//------------------------------------------
+// parseDecimFilter()
+//------------------------------------------
+int parseDecimFilter(const char *spec)
+{
+    if(!strcasecmp(spec, "gauss"))
+    {
+        return eDECIM_GAUSS;
+    }
+    if(!strcasecmp(spec, "cic"))
+    {
+        return eDECIM_CIC;
+    }
+    if(!strcasecmp(spec, "boxcar"))
+    {
+        return eDECIM_BOXCAR;
+    }
+    return -1;
+}
+
+//------------------------------------------
+// decimFilterName()
+//------------------------------------------
+const char *decimFilterName(int filter)
+{
+    switch(filter)
+    {
+        case eDECIM_CIC:
+            return "cic";
+        case eDECIM_BOXCAR:
+            return "boxcar";
+        default:
+            return "gauss";
+    }
+}
+
+//------------------------------------------
+// designGauss()
+// Gaussian low pass whose response exp(-2 pi^2 sigma^2 f^2) is down
+// DECIM_STOPBAND_DB at half the output rate.
+//------------------------------------------
+static int designGauss(decimator *d)
+{
+    double sigmaOut = sqrt(DECIM_STOPBAND_DB / (20.0 * log10(M_E) * 2.0 * M_PI * M_PI * 0.25));
+    double sigma = sigmaOut * d->firRatio;
+    int half = (int)ceil(DECIM_GAUSS_SIGMAS * sigma);
+    double sum = 0.0;
+    double t;
+    int i;
+
+    d->firLen = 2 * half + 1;
+    if(posix_memalign((void **)&d->taps, 64, d->firLen * sizeof(v4df)) != 0 ||
+       posix_memalign((void **)&d->hist, 64, 2 * d->firLen * sizeof(v4df)) != 0)
+    {
+        return -1;
+    }
+    memset(d->hist, 0, 2 * d->firLen * sizeof(v4df));
+    for(i = 0; i < d->firLen; i++)
+    {
+        t = (i - half) / sigma;
+        d->taps[i][0] = exp(-0.5 * t * t);
+        sum += d->taps[i][0];
+    }
+    for(i = 0; i < d->firLen; i++)
+    {
+        t = d->taps[i][0] / sum;
+        d->taps[i] = (v4df){ t, t, t, 0.0 };
+    }
+    return half;
+}
+
+//------------------------------------------
+// decimatorInit()
+// ratio is input samples per output sample, periodNs the time between
+// input samples.
+//------------------------------------------
+int decimatorInit(decimator *d, int ratio, int filter, int64_t periodNs)
+{
+    double delay = 0.0;
+    int half;
+    int r;
+
+    memset(d, 0, sizeof(decimator));
+    d->filter = filter;
+    d->ratio = ratio;
+    switch(filter)
+    {
+        case eDECIM_BOXCAR:
+            d->cicOrder = 1;
+            d->cicRatio = ratio;
+            break;
+        case eDECIM_CIC:
+            d->cicOrder = DECIM_CICORDER;
+            d->cicRatio = ratio;
+            break;
+        default:
+            // Let the CIC take the largest factor that still leaves the
+            // FIR enough samples per output to shape the response.
+            d->cicRatio = 1;
+            for(r = 2; r <= ratio / DECIM_FIRMINRATE; r++)
+            {
+                if(ratio % r == 0)
+                {
+                    d->cicRatio = r;
+                }
+            }
+            d->cicOrder = (d->cicRatio > 1) ? DECIM_CICORDER : 0;
+            d->firRatio = ratio / d->cicRatio;
+            if((half = designGauss(d)) < 0)
+            {
+                perror("decimator");
+                decimatorFree(d);
+                return -1;
+            }
+            delay = (double)half * d->cicRatio;
+            break;
+    }
+    if(d->cicOrder > 0)
+    {
+        d->cicScale = 1.0 / pow(d->cicRatio, d->cicOrder);
+        delay += d->cicOrder * (d->cicRatio - 1) / 2.0;
+    }
+    d->delay = delay;
+    d->delayNs = (int64_t)(delay * periodNs);
+    return 0;
+}
+
+//------------------------------------------
+// decimatorPush()
+// Adds one raw sample.  Returns 1 and fills out[] (counts) when an
+// output sample is ready, otherwise 0.
+//------------------------------------------
+int decimatorPush(decimator *d, const int32_t raw[3], double out[3])
+{
+    v4df x = { raw[0], raw[1], raw[2], 0.0 };
+    v4df acc = { 0.0, 0.0, 0.0, 0.0 };
+    const v4df *w;
+    uint64_t y;
+    uint64_t t;
+    int i;
+    int k;
+
+    if(d->cicOrder > 0)
+    {
+        for(i = 0; i < 3; i++)
+        {
+            d->integ[0][i] += (uint64_t)(int64_t)raw[i];
+            for(k = 1; k < d->cicOrder; k++)
+            {
+                d->integ[k][i] += d->integ[k - 1][i];
+            }
+        }
+        if(++d->cicPhase < d->cicRatio)
+        {
+            return 0;
+        }
+        d->cicPhase = 0;
+        for(i = 0; i < 3; i++)
+        {
+            y = d->integ[d->cicOrder - 1][i];
+            for(k = 0; k < d->cicOrder; k++)
+            {
+                t = y;
+                y -= d->comb[k][i];
+                d->comb[k][i] = t;
+            }
+            x[i] = (double)(int64_t)y * d->cicScale;
+        }
+    }
+    if(d->firLen == 0)
+    {
+        // The combs need cicOrder outputs before they are settled.
+        if(d->firFill < d->cicOrder)
+        {
+            d->firFill++;
+            return 0;
+        }
+        out[0] = x[0];
+        out[1] = x[1];
+        out[2] = x[2];
+        return 1;
+    }
+    d->hist[d->firPos] = x;
+    d->hist[d->firPos + d->firLen] = x;
+    if(++d->firPos == d->firLen)
+    {
+        d->firPos = 0;
+    }
+    if(d->firFill < d->firLen + d->cicOrder)
+    {
+        d->firFill++;
+    }
+    if(++d->firPhase < d->firRatio)
+    {
+        return 0;
+    }
+    d->firPhase = 0;
+    if(d->firFill < d->firLen + d->cicOrder)
+    {
+        return 0;
+    }
+    w = d->hist + d->firPos;
+    for(k = 0; k < d->firLen; k++)
+    {
+        acc += d->taps[k] * w[k];
+    }
+    out[0] = acc[0];
+    out[1] = acc[1];
+    out[2] = acc[2];
+    return 1;
+}
+
+//------------------------------------------
+// decimatorFree()
+//------------------------------------------
+void decimatorFree(decimator *d)
+{
+    free(d->taps);
+    free(d->hist);
+    d->taps = NULL;
+    d->hist = NULL;
+}
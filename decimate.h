@@ -0,0 +1,80 @@
+//=========================================================================
+// decimate.h
+//
+// Oversample-and-decimate filtering for the runMag utility.
+//
+// Raw counts taken at <ratio> samples per second are filtered per axis
+// and reduced to one value per second:
+//
+//      gauss   CIC (order 3) pre-decimation, then a Gaussian FIR in the
+//              style of the INTERMAGNET 1-second filter (>= 50 dB at the
+//              output Nyquist frequency).  Default.
+//      cic     Order 3 CIC over the whole ratio.  Cheapest, softer.
+//      boxcar  Plain mean of the <ratio> samples.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100DECIMATE_h
+#define SWX3100DECIMATE_h
+
+#include <stdint.h>
+
+#define DECIM_MAXRATIO          200
+#define DECIM_CICORDER          3
+#define DECIM_FIRMINRATE        8           // FIR input samples per output, at least
+#define DECIM_STOPBAND_DB       50.0        // attenuation at the output Nyquist frequency
+#define DECIM_GAUSS_SIGMAS      4.0         // FIR half length in standard deviations
+#define DECIM_RAWSUFFIX         "runmag-raw.log"
+
+//-------------------------------------------
+// Filter designs
+//-------------------------------------------
+typedef enum
+{
+    eDECIM_GAUSS = 0,
+    eDECIM_CIC,
+    eDECIM_BOXCAR,
+} decimFilter;
+
+// Three axes plus a pad lane; GCC maps this to NEON/SSE/AVX.
+#ifndef SWX3100_V4DF
+#define SWX3100_V4DF
+typedef double v4df __attribute__((vector_size(32)));
+#endif
+
+//------------------------------------------
+// Decimator state
+//------------------------------------------
+typedef struct tag_decimator
+{
+    int         filter;
+    int         ratio;                      // input samples per output
+    int         cicOrder;                   // 0: no CIC stage
+    int         cicRatio;
+    int         cicPhase;
+    double      cicScale;                   // 1 / cicRatio^cicOrder
+    uint64_t    integ[DECIM_CICORDER][3];   // wrap-around arithmetic is exact for CIC
+    uint64_t    comb[DECIM_CICORDER][3];
+    int         firRatio;
+    int         firLen;                     // 0: no FIR stage
+    int         firPhase;
+    int         firPos;
+    int         firFill;
+    v4df       *taps;                       // firLen, each tap in all lanes
+    v4df       *hist;                       // 2 * firLen, so the window is contiguous
+    double      delay;                      // group delay of the whole chain, input samples
+    int64_t     delayNs;                    // the same at the input period given to decimatorInit()
+} decimator;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int parseDecimFilter(const char *spec);
+const char *decimFilterName(int filter);
+int decimatorInit(decimator *d, int ratio, int filter, int64_t periodNs);
+int decimatorPush(decimator *d, const int32_t raw[3], double out[3]);
+void decimatorFree(decimator *d);
+
+#endif // SWX3100DECIMATE_h
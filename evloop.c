@@ -0,0 +1,216 @@
+//=========================================================================
+// evloop.c
+//
+// Event loop for the runMag utility.
+// See evloop.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include "evloop.h"
+
+//------------------------------------------
+// evLoopOpen()
+// Creates the epoll set and takes the 0 terminated list of signals away
+// from their handlers; they arrive as EVLOOP_SIGNAL instead.
+//------------------------------------------
+int evLoopOpen(evLoop *ev, const int *signals)
+{
+    int i;
+
+    memset(ev, 0, sizeof(evLoop));
+    ev->sigFd = -1;
+    for(i = 0; i < EVLOOP_MAXSOURCES; i++)
+    {
+        ev->fd[i] = -1;
+    }
+    if((ev->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        perror("Event loop: epoll_create1()");
+        return -1;
+    }
+    sigemptyset(&ev->sigs);
+    for(i = 0; signals[i] != 0; i++)
+    {
+        sigaddset(&ev->sigs, signals[i]);
+    }
+    pthread_sigmask(SIG_BLOCK, &ev->sigs, &ev->oldMask);
+    if((ev->sigFd = signalfd(-1, &ev->sigs, SFD_NONBLOCK | SFD_CLOEXEC)) < 0 ||
+       evLoopWatch(ev, EVLOOP_SIGNAL, ev->sigFd, EPOLLIN) != 0)
+    {
+        perror("Event loop: signalfd()");
+        evLoopClose(ev);
+        return -1;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// evLoopWatch()
+// Watches fd for events under id, replacing whatever id watched before.
+// An fd < 0 or no events stops watching.
+//------------------------------------------
+int evLoopWatch(evLoop *ev, int id, int fd, uint32_t events)
+{
+    struct epoll_event e;
+    int i;
+
+    if(fd < 0 || events == 0)
+    {
+        fd = -1;
+        events = 0;
+    }
+    if(ev->fd[id] >= 0 && fd != ev->fd[id])
+    {
+        // The old descriptor may have been closed, which removed it, and
+        // its number taken by another id; leave that one alone.
+        for(i = 0; i < EVLOOP_MAXSOURCES && (i == id || ev->fd[i] != ev->fd[id]); i++)
+        {
+        }
+        if(i == EVLOOP_MAXSOURCES)
+        {
+            epoll_ctl(ev->epfd, EPOLL_CTL_DEL, ev->fd[id], NULL);
+        }
+    }
+    ev->fd[id] = -1;
+    ev->want[id] = 0;
+    if(fd < 0)
+    {
+        return 0;
+    }
+    e.events = events;
+    e.data.u32 = (uint32_t)id;
+    // The same number may be a new descriptor, which only ADD takes.
+    if(epoll_ctl(ev->epfd, EPOLL_CTL_MOD, fd, &e) != 0 && (errno != ENOENT || epoll_ctl(ev->epfd, EPOLL_CTL_ADD, fd, &e) != 0))
+    {
+        return -1;
+    }
+    ev->fd[id] = fd;
+    ev->want[id] = events;
+    return 0;
+}
+
+//------------------------------------------
+// evLoopWait()
+// Sleeps until something is ready or timeoutMs (-1 forever) passes and
+// returns the ready ids.
+//------------------------------------------
+uint64_t evLoopWait(evLoop *ev, int timeoutMs)
+{
+    struct epoll_event e[EVLOOP_MAXSOURCES];
+    uint64_t ready = 0;
+    int n;
+    int i;
+
+    if((n = epoll_wait(ev->epfd, e, EVLOOP_MAXSOURCES, timeoutMs)) < 0)
+    {
+        if(errno != EINTR)
+        {
+            perror("Event loop: epoll_wait()");
+        }
+        return 0;
+    }
+    ev->wakeups++;
+    for(i = 0; i < n; i++)
+    {
+        ev->got[e[i].data.u32] = e[i].events;
+        ready |= EVLOOP_BIT(e[i].data.u32);
+    }
+    return ready;
+}
+
+//------------------------------------------
+// evLoopSignal()
+// The next pending signal, 0 if none.
+//------------------------------------------
+int evLoopSignal(evLoop *ev)
+{
+    struct signalfd_siginfo si;
+
+    if(ev->sigFd < 0 || read(ev->sigFd, &si, sizeof(si)) != sizeof(si))
+    {
+        return 0;
+    }
+    return (int)si.ssi_signo;
+}
+
+//------------------------------------------
+// evLoopClose()
+// Closes the set and gives the signals back.  Watched descriptors belong
+// to their owners and stay open.
+//------------------------------------------
+void evLoopClose(evLoop *ev)
+{
+    if(ev->sigFd >= 0)
+    {
+        close(ev->sigFd);
+        ev->sigFd = -1;
+    }
+    if(ev->epfd >= 0)
+    {
+        close(ev->epfd);
+        ev->epfd = -1;
+    }
+    pthread_sigmask(SIG_SETMASK, &ev->oldMask, NULL);
+}
+
+//------------------------------------------
+// evTimerOpen()
+//------------------------------------------
+int evTimerOpen(int clockId)
+{
+    int fd;
+
+    if((fd = timerfd_create(clockId, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+    {
+        perror("Event loop: timerfd_create()");
+    }
+    return fd;
+}
+
+//------------------------------------------
+// evTimerSet()
+// Arms the timer at atNs on its own clock, repeating every periodNs if
+// that is not 0.  atNs 0 disarms it.
+//------------------------------------------
+int evTimerSet(int fd, int64_t atNs, int64_t periodNs)
+{
+    struct itimerspec its;
+
+    its.it_value.tv_sec = atNs / 1000000000LL;
+    its.it_value.tv_nsec = atNs % 1000000000LL;
+    its.it_interval.tv_sec = periodNs / 1000000000LL;
+    its.it_interval.tv_nsec = periodNs % 1000000000LL;
+    return timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+//------------------------------------------
+// evTimerRead()
+// Expirations since the last read; 0 if it has not fired.
+//------------------------------------------
+uint64_t evTimerRead(int fd)
+{
+    uint64_t n;
+
+    return (read(fd, &n, sizeof(n)) == sizeof(n)) ? n : 0;
+}
+
+//------------------------------------------
+// evClockNs()
+//------------------------------------------
+int64_t evClockNs(int clockId)
+{
+    struct timespec ts;
+
+    clock_gettime(clockId, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
@@ -0,0 +1,60 @@
+//=========================================================================
+// evloop.h
+//
+// Event loop for the runMag utility.
+//
+// The sampling thread waits in one place, an epoll set holding the sample
+// cadence and sensor deadline (timerfd), the signals (signalfd) and the
+// descriptors of the outputs that can back up: TCP clients, the FIFO and
+// the capture control socket.  Each descriptor is watched under a small
+// fixed id.  evLoopWait() returns the ready ids as a bit mask and leaves
+// their events in got[], so main() handles them in a fixed order, each
+// once per wakeup, without callbacks.
+//
+// evLoopOpen() blocks the signals it takes over, so it must run before
+// any thread is started; threads inherit the mask and never see them.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100EVLOOP_h
+#define SWX3100EVLOOP_h
+
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+
+#define EVLOOP_MAXSOURCES       64
+#define EVLOOP_SIGNAL           0           // id of the signalfd
+#define EVLOOP_BIT(id)          (1ULL << (id))
+
+//------------------------------------------
+// Loop state
+//------------------------------------------
+typedef struct tag_evLoop
+{
+    int             epfd;
+    int             sigFd;
+    sigset_t        sigs;                   // taken over from the default handling
+    sigset_t        oldMask;
+    int             fd[EVLOOP_MAXSOURCES];  // watched descriptor per id, -1 none
+    uint32_t        want[EVLOOP_MAXSOURCES];
+    uint32_t        got[EVLOOP_MAXSOURCES]; // events of the last evLoopWait()
+    unsigned long   wakeups;
+} evLoop;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int evLoopOpen(evLoop *ev, const int *signals);
+int evLoopWatch(evLoop *ev, int id, int fd, uint32_t events);
+uint64_t evLoopWait(evLoop *ev, int timeoutMs);
+int evLoopSignal(evLoop *ev);
+void evLoopClose(evLoop *ev);
+int evTimerOpen(int clockId);
+int evTimerSet(int fd, int64_t atNs, int64_t periodNs);
+uint64_t evTimerRead(int fd);
+int64_t evClockNs(int clockId);
+
+#endif // SWX3100EVLOOP_h
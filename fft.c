@@ -0,0 +1,135 @@
+//=========================================================================
+// fft.c
+//
+// Small self-contained FFT for the runMag utility.  See fft.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fft.h"
+
+//------------------------------------------
+// fftInit()
+//------------------------------------------
+int fftInit(fftPlan *f, int n)
+{
+    uint32_t i;
+    uint32_t j;
+    int bits = 0;
+    int m;
+
+    memset(f, 0, sizeof(fftPlan));
+    if(n < FFT_MINLEN || n > FFT_MAXLEN || (n & (n - 1)) != 0)
+    {
+        fprintf(stderr, "FFT: length %i is not a power of two from %i to %i.\n", n, FFT_MINLEN, FFT_MAXLEN);
+        return -1;
+    }
+    while((1 << bits) < n)
+    {
+        bits++;
+    }
+    f->n = n;
+    f->swap = malloc(n * sizeof(uint32_t));
+    f->twRe = malloc((n - 1) * sizeof(double));
+    f->twIm = malloc((n - 1) * sizeof(double));
+    if(f->swap == NULL || f->twRe == NULL || f->twIm == NULL)
+    {
+        perror("FFT");
+        fftFree(f);
+        return -1;
+    }
+    for(i = 0; i < (uint32_t)n; i++)
+    {
+        j = 0;
+        for(m = 0; m < bits; m++)
+        {
+            j |= ((i >> m) & 1) << (bits - 1 - m);
+        }
+        if(i < j)
+        {
+            f->swap[f->nSwap++] = i;
+            f->swap[f->nSwap++] = j;
+        }
+    }
+    for(m = 1; m < n; m <<= 1)
+    {
+        for(j = 0; j < (uint32_t)m; j++)
+        {
+            f->twRe[m - 1 + j] = cos(M_PI * j / m);
+            f->twIm[m - 1 + j] = -sin(M_PI * j / m);
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// fftRun()
+// Forward transform of n elements, in place.
+//------------------------------------------
+void fftRun(const fftPlan *f, v4df *re, v4df *im)
+{
+    const double *wr;
+    const double *wi;
+    v4df t;
+    v4df tr;
+    v4df ti;
+    int n = f->n;
+    int m;
+    int i;
+    int j;
+    int k;
+
+    for(i = 0; i < f->nSwap; i += 2)
+    {
+        j = f->swap[i];
+        k = f->swap[i + 1];
+        t = re[j]; re[j] = re[k]; re[k] = t;
+        t = im[j]; im[j] = im[k]; im[k] = t;
+    }
+    // First stage: all twiddles are 1.
+    for(i = 0; i < n; i += 2)
+    {
+        tr = re[i + 1];
+        ti = im[i + 1];
+        re[i + 1] = re[i] - tr;
+        im[i + 1] = im[i] - ti;
+        re[i] += tr;
+        im[i] += ti;
+    }
+    for(m = 2; m < n; m <<= 1)
+    {
+        wr = f->twRe + m - 1;
+        wi = f->twIm + m - 1;
+        for(i = 0; i < n; i += 2 * m)
+        {
+            for(j = 0; j < m; j++)
+            {
+                k = i + j + m;
+                tr = re[k] * wr[j] - im[k] * wi[j];
+                ti = re[k] * wi[j] + im[k] * wr[j];
+                re[k] = re[i + j] - tr;
+                im[k] = im[i + j] - ti;
+                re[i + j] += tr;
+                im[i + j] += ti;
+            }
+        }
+    }
+}
+
+//------------------------------------------
+// fftFree()
+//------------------------------------------
+void fftFree(fftPlan *f)
+{
+    free(f->swap);
+    free(f->twRe);
+    free(f->twIm);
+    f->swap = NULL;
+    f->twRe = NULL;
+    f->twIm = NULL;
+}
@@ -0,0 +1,48 @@
+//=========================================================================
+// fft.h
+//
+// Small self-contained FFT for the runMag utility.
+//
+// Radix-2, decimation in time, in place.  Each element holds X, Y and Z
+// in the lanes of a v4df, so one pass transforms all three axes and every
+// butterfly is a handful of vector instructions.  Twiddles for each stage
+// are stored contiguously, so a stage walks its table front to back.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100FFT_h
+#define SWX3100FFT_h
+
+#include <stdint.h>
+
+#define FFT_MINLEN              4
+#define FFT_MAXLEN              65536
+
+// Three axes plus a pad lane; GCC maps this to NEON/SSE/AVX.
+#ifndef SWX3100_V4DF
+#define SWX3100_V4DF
+typedef double v4df __attribute__((vector_size(32)));
+#endif
+
+//------------------------------------------
+// Transform plan
+//------------------------------------------
+typedef struct tag_fftPlan
+{
+    int         n;                          // power of two
+    uint32_t   *swap;                       // index pairs for the bit reversal
+    int         nSwap;
+    double     *twRe;                       // n - 1: stage with half size m at [m - 1]
+    double     *twIm;
+} fftPlan;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int fftInit(fftPlan *f, int n);
+void fftRun(const fftPlan *f, v4df *re, v4df *im);
+void fftFree(fftPlan *f);
+
+#endif // SWX3100FFT_h
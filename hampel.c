@@ -0,0 +1,291 @@
+//=========================================================================
+// hampel.c
+//
+// Streaming Hampel despiking filter for the runMag utility.
+// See hampel.h.
+//
+// The skip list follows R. Hettinger's indexable skip list: every link
+// records how many ranks it jumps, so the i-th smallest value is found
+// by walking down the levels.  Nodes live in a fixed pool per axis; the
+// value leaving the window frees the node the new one takes.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <stdlib.h>
+#include <string.h>
+#include "hampel.h"
+
+//------------------------------------------
+// randomLevel()
+// 1 + number of heads in a row, from a xorshift generator.
+//------------------------------------------
+static int randomLevel(hampelFilter *h)
+{
+    uint32_t x = h->rng;
+    int level = 1;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    h->rng = x;
+    while((x & 1) && level < HAMPEL_LEVELS)
+    {
+        level++;
+        x >>= 1;
+    }
+    return level;
+}
+
+//------------------------------------------
+// windowInit()
+//------------------------------------------
+static void windowInit(hampelWindow *w)
+{
+    int i;
+
+    memset(w, 0, sizeof(hampelWindow));
+    for(i = 0; i < HAMPEL_LEVELS; i++)
+    {
+        w->node[0].next[i] = HAMPEL_NIL;
+        w->node[0].width[i] = 1;
+    }
+    w->node[0].level = HAMPEL_LEVELS;
+    for(i = 0; i < HAMPEL_MAXWINDOW + 1; i++)
+    {
+        w->freeList[i] = (int16_t)(HAMPEL_MAXWINDOW + 1 - i);
+    }
+    w->nFree = HAMPEL_MAXWINDOW + 1;
+}
+
+//------------------------------------------
+// listInsert()
+//------------------------------------------
+static void listInsert(hampelFilter *h, hampelWindow *w, int32_t val)
+{
+    int16_t chain[HAMPEL_LEVELS];
+    int steps[HAMPEL_LEVELS];
+    hampelNode *n;
+    int16_t x = 0;
+    int16_t nx;
+    int stepsTotal = 0;
+    int lvl;
+    int id;
+
+    for(lvl = HAMPEL_LEVELS - 1; lvl >= 0; lvl--)
+    {
+        steps[lvl] = 0;
+        while((nx = w->node[x].next[lvl]) != HAMPEL_NIL && w->node[nx].val <= val)
+        {
+            steps[lvl] += w->node[x].width[lvl];
+            x = nx;
+        }
+        chain[lvl] = x;
+    }
+    id = w->freeList[--w->nFree];
+    n = &w->node[id];
+    n->val = val;
+    n->level = (int16_t)randomLevel(h);
+    for(lvl = 0; lvl < n->level; lvl++)
+    {
+        hampelNode *prev = &w->node[chain[lvl]];
+
+        n->next[lvl] = prev->next[lvl];
+        prev->next[lvl] = (int16_t)id;
+        n->width[lvl] = prev->width[lvl] - stepsTotal;
+        prev->width[lvl] = stepsTotal + 1;
+        stepsTotal += steps[lvl];
+    }
+    for(; lvl < HAMPEL_LEVELS; lvl++)
+    {
+        w->node[chain[lvl]].width[lvl]++;
+    }
+}
+
+//------------------------------------------
+// listRemove()
+// Removes one node holding val (it is known to be present).
+//------------------------------------------
+static void listRemove(hampelWindow *w, int32_t val)
+{
+    int16_t chain[HAMPEL_LEVELS];
+    int16_t x = 0;
+    int16_t nx;
+    int16_t id;
+    int lvl;
+
+    for(lvl = HAMPEL_LEVELS - 1; lvl >= 0; lvl--)
+    {
+        while((nx = w->node[x].next[lvl]) != HAMPEL_NIL && w->node[nx].val < val)
+        {
+            x = nx;
+        }
+        chain[lvl] = x;
+    }
+    id = w->node[chain[0]].next[0];
+    for(lvl = 0; lvl < w->node[id].level; lvl++)
+    {
+        hampelNode *prev = &w->node[chain[lvl]];
+
+        prev->width[lvl] += w->node[id].width[lvl] - 1;
+        prev->next[lvl] = w->node[id].next[lvl];
+    }
+    for(; lvl < HAMPEL_LEVELS; lvl++)
+    {
+        w->node[chain[lvl]].width[lvl]--;
+    }
+    w->freeList[w->nFree++] = id;
+}
+
+//------------------------------------------
+// listAt()
+// i-th smallest value, 0 based.
+//------------------------------------------
+static int32_t listAt(const hampelWindow *w, int i)
+{
+    int16_t x = 0;
+    int lvl;
+
+    i++;
+    for(lvl = HAMPEL_LEVELS - 1; lvl >= 0; lvl--)
+    {
+        while(w->node[x].next[lvl] != HAMPEL_NIL && w->node[x].width[lvl] <= i)
+        {
+            i -= w->node[x].width[lvl];
+            x = w->node[x].next[lvl];
+        }
+    }
+    return w->node[x].val;
+}
+
+//------------------------------------------
+// lowerDev() / upperDev()
+// The deviations below and above the median, each in increasing order.
+//------------------------------------------
+static inline int64_t lowerDev(const hampelWindow *w, int c, int64_t med, int i)
+{
+    return med - listAt(w, c - 1 - i);
+}
+
+static inline int64_t upperDev(const hampelWindow *w, int c, int64_t med, int j)
+{
+    return listAt(w, c + 1 + j) - med;
+}
+
+//------------------------------------------
+// windowMad()
+// Median absolute deviation of a full, odd sized window.  The n
+// deviations are 0 (the median itself) plus two sorted runs of c each;
+// the median deviation is the (c-1)th smallest of the two runs merged,
+// found by binary search on how many come from the lower run.
+//------------------------------------------
+static int64_t windowMad(const hampelWindow *w, int c, int64_t med)
+{
+    int k = c - 1;
+    int lo = 0;
+    int hi = (k + 1 < c) ? k + 1 : c;
+    int i;
+    int j;
+    int64_t a;
+    int64_t b;
+
+    while(lo <= hi)
+    {
+        i = (lo + hi) / 2;
+        j = k + 1 - i;
+        if(i < c && j > 0 && upperDev(w, c, med, j - 1) > lowerDev(w, c, med, i))
+        {
+            lo = i + 1;
+        }
+        else if(i > 0 && j < c && lowerDev(w, c, med, i - 1) > upperDev(w, c, med, j))
+        {
+            hi = i - 1;
+        }
+        else
+        {
+            a = (i > 0) ? lowerDev(w, c, med, i - 1) : 0;
+            b = (j > 0) ? upperDev(w, c, med, j - 1) : 0;
+            return (a > b) ? a : b;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// hampelInit()
+//------------------------------------------
+void hampelInit(hampelFilter *h, int window, double k, int replace)
+{
+    int i;
+
+    memset(h, 0, sizeof(hampelFilter));
+    h->window = window | 1;
+    h->k = k;
+    h->replace = replace;
+    h->rng = 0x9E3779B9;
+    for(i = 0; i < 3; i++)
+    {
+        windowInit(&h->axis[i]);
+    }
+}
+
+//------------------------------------------
+// hampelPush()
+// Adds one sample of raw counts.  Returns a mask of spiking axes
+// (1 = X, 2 = Y, 4 = Z); replaced axes are overwritten in xyz[].
+//------------------------------------------
+int hampelPush(hampelFilter *h, int32_t xyz[3])
+{
+    hampelWindow *w;
+    int c = (h->window - 1) / 2;
+    int64_t med;
+    int64_t mad;
+    int64_t dev;
+    int mask = 0;
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        w = &h->axis[i];
+        if(w->count == h->window)
+        {
+            listRemove(w, w->fifo[w->fifoPos]);
+        }
+        else
+        {
+            w->count++;
+        }
+        listInsert(h, w, xyz[i]);
+        w->fifo[w->fifoPos] = xyz[i];
+        if(++w->fifoPos == h->window)
+        {
+            w->fifoPos = 0;
+        }
+        if(w->count < h->window)
+        {
+            continue;
+        }
+        med = listAt(w, c);
+        mad = windowMad(w, c, med);
+        if(mad < 1)
+        {
+            mad = 1;
+        }
+        dev = xyz[i] - med;
+        if(dev < 0)
+        {
+            dev = -dev;
+        }
+        if(dev > h->k * HAMPEL_MADSCALE * mad)
+        {
+            mask |= 1 << i;
+            h->spikes[i]++;
+            if(h->replace)
+            {
+                xyz[i] = (int32_t)med;
+            }
+        }
+    }
+    return mask;
+}
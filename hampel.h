@@ -0,0 +1,76 @@
+//=========================================================================
+// hampel.h
+//
+// Streaming Hampel despiking filter for the runMag utility.
+//
+// Each axis keeps the last <window> raw counts in an indexable skip list,
+// so the median and the median absolute deviation (MAD) of the window
+// are found in O(log n) per sample without re-sorting.  A sample is a
+// spike when
+//
+//      |x - median| > k * 1.4826 * max(MAD, 1 count)
+//
+// The window is causal (it ends at the sample under test), so the filter
+// adds no delay.  Spikes are replaced by the window median, or only
+// flagged when marking.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100HAMPEL_h
+#define SWX3100HAMPEL_h
+
+#include <stdint.h>
+
+#define HAMPEL_MINWINDOW        3
+#define HAMPEL_MAXWINDOW        255
+#define HAMPEL_LEVELS           8           // log2(HAMPEL_MAXWINDOW + 1)
+#define HAMPEL_DEFK             3.0
+#define HAMPEL_MADSCALE         1.4826      // MAD to standard deviation, normal data
+#define HAMPEL_NIL              (-1)
+
+//------------------------------------------
+// Skip list node; node 0 is the head.
+//------------------------------------------
+typedef struct tag_hampelNode
+{
+    int32_t     val;
+    int16_t     level;
+    int16_t     next[HAMPEL_LEVELS];
+    uint16_t    width[HAMPEL_LEVELS];       // ranks skipped by next[]
+} hampelNode;
+
+//------------------------------------------
+// One axis
+//------------------------------------------
+typedef struct tag_hampelWindow
+{
+    hampelNode  node[HAMPEL_MAXWINDOW + 2];
+    int16_t     freeList[HAMPEL_MAXWINDOW + 1];
+    int         nFree;
+    int32_t     fifo[HAMPEL_MAXWINDOW];     // arrival order, to know what leaves
+    int         fifoPos;
+    int         count;
+} hampelWindow;
+
+//------------------------------------------
+// Three axes
+//------------------------------------------
+typedef struct tag_hampelFilter
+{
+    hampelWindow axis[3];
+    int         window;
+    double      k;
+    int         replace;
+    uint32_t    rng;
+    unsigned long spikes[3];
+} hampelFilter;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+void hampelInit(hampelFilter *h, int window, double k, int replace);
+int hampelPush(hampelFilter *h, int32_t xyz[3]);
+
+#endif // SWX3100HAMPEL_h
@@ -0,0 +1,408 @@
+//=========================================================================
+// history.c
+//
+// In-memory sample history for the runMag utility.
+// See history.h.
+//
+// The sampling loop only copies each sample into the ring under the lock.
+// The worker holds the lock just long enough to copy out the range asked
+// for (two memcpy()s at most), and buckets, formats and sends the reply
+// after letting go.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <stdarg.h>
+#include <string.h>
+#include <sys/socket.h>
+#include "history.h"
+
+#define HISTORY_CHUNK           65536       // reply bytes per send()
+
+//------------------------------------------
+// One downsampled point
+//------------------------------------------
+typedef struct tag_histBucket
+{
+    int64_t     ts;                         // first and last sample
+    int64_t     te;
+    uint32_t    n;
+    float       min[3];
+    float       max[3];
+    double      sum[3];
+    double      tSum[2];
+    uint32_t    tN[2];
+} histBucket;
+
+//------------------------------------------
+// Reply buffer
+//------------------------------------------
+typedef struct tag_histReply
+{
+    int         fd;
+    int         len;
+    int         failed;
+    char        buf[HISTORY_CHUNK];
+} histReply;
+
+//------------------------------------------
+// replyFlush()
+//------------------------------------------
+static void replyFlush(histReply *r)
+{
+    if(!r->failed && reqSendAll(r->fd, r->buf, r->len) != 0)
+    {
+        r->failed = TRUE;
+    }
+    r->len = 0;
+}
+
+//------------------------------------------
+// reply()
+//------------------------------------------
+static void reply(histReply *r, const char *fmt, ...)
+{
+    va_list ap;
+
+    if(r->len > HISTORY_CHUNK - 512)
+    {
+        replyFlush(r);
+    }
+    va_start(ap, fmt);
+    r->len += vsnprintf(r->buf + r->len, HISTORY_CHUNK - r->len, fmt, ap);
+    va_end(ap);
+}
+
+//------------------------------------------
+// replyTemps()
+//------------------------------------------
+static void replyTemps(histReply *r, const int16_t temp[2])
+{
+    if(temp[0] != HISTORY_NOTEMP)
+    {
+        reply(r, ", \"rt\":%.2f", temp[0] / 100.0);
+    }
+    if(temp[1] != HISTORY_NOTEMP)
+    {
+        reply(r, ", \"lt\":%.2f", temp[1] / 100.0);
+    }
+}
+
+//------------------------------------------
+// findFirst()
+// First sample number in [lo, hi) at or after tsMs.  Caller holds the lock.
+//------------------------------------------
+static uint64_t findFirst(const history *h, uint64_t lo, uint64_t hi, int64_t tsMs)
+{
+    uint64_t mid;
+
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(h->ring[mid % h->capacity].tsMs < tsMs)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+//------------------------------------------
+// addToBucket()
+//------------------------------------------
+static void addToBucket(histBucket *b, const histSample *s)
+{
+    int i;
+
+    if(b->n == 0)
+    {
+        b->ts = s->tsMs;
+        for(i = 0; i < 3; i++)
+        {
+            b->min[i] = b->max[i] = s->xyz[i];
+        }
+    }
+    b->te = s->tsMs;
+    b->n++;
+    for(i = 0; i < 3; i++)
+    {
+        b->min[i] = (s->xyz[i] < b->min[i]) ? s->xyz[i] : b->min[i];
+        b->max[i] = (s->xyz[i] > b->max[i]) ? s->xyz[i] : b->max[i];
+        b->sum[i] += s->xyz[i];
+    }
+    for(i = 0; i < 2; i++)
+    {
+        if(s->temp[i] != HISTORY_NOTEMP)
+        {
+            b->tSum[i] += s->temp[i];
+            b->tN[i]++;
+        }
+    }
+}
+
+//------------------------------------------
+// answer()
+// Selects [from, to) and replies with every sample, or with at most
+// points buckets.
+//------------------------------------------
+static void answer(history *h, histReply *r, int64_t from, int64_t to, int points)
+{
+    static const char axis[3] = { 'x', 'y', 'z' };
+    histSample *raw = NULL;
+    histBucket *bkt = NULL;
+    histBucket *b;
+    uint64_t first;
+    uint64_t lo;
+    uint64_t hi;
+    uint64_t n;
+    uint64_t i;
+    uint64_t k;
+    int64_t width = 0;
+    int16_t temp[2];
+    int j;
+
+    pthread_mutex_lock(&h->lock);
+    first = (h->head > h->capacity) ? h->head - h->capacity : 0;
+    lo = findFirst(h, first, h->head, from);
+    hi = findFirst(h, lo, h->head, to);
+    n = hi - lo;
+    if(n > 0 && (raw = malloc(n * sizeof(histSample))) != NULL)
+    {
+        // The range may wrap around the end of the ring.
+        i = lo % h->capacity;
+        k = (h->capacity - i < n) ? h->capacity - i : n;
+        memcpy(raw, &h->ring[i], k * sizeof(histSample));
+        memcpy(raw + k, h->ring, (n - k) * sizeof(histSample));
+    }
+    pthread_mutex_unlock(&h->lock);
+
+    if(points > 0 && n > (uint64_t)points && raw != NULL)
+    {
+        width = (to - from + points - 1) / points;
+        if((bkt = calloc(points, sizeof(histBucket))) != NULL)
+        {
+            for(i = 0; i < n; i++)
+            {
+                addToBucket(&bkt[(raw[i].tsMs - from) / width], &raw[i]);
+            }
+        }
+    }
+    if((n > 0 && raw == NULL) || (width > 0 && bkt == NULL))
+    {
+        reply(r, "{ \"error\":\"out of memory\" }\n");
+        h->errors++;
+        free(raw);
+        return;
+    }
+    reply(r, "{ \"from\":%lld, \"to\":%lld, \"samples\":%llu, \"points\":%i, \"bucket\":%lld }\n",
+          (long long)from, (long long)to, (unsigned long long)n, width ? points : (int)n, (long long)width);
+    for(i = 0; width == 0 && i < n; i++)
+    {
+        reply(r, "{ \"ts\":%lld, \"x\":%.2f, \"y\":%.2f, \"z\":%.2f", (long long)raw[i].tsMs, raw[i].xyz[0], raw[i].xyz[1], raw[i].xyz[2]);
+        replyTemps(r, raw[i].temp);
+        reply(r, " }\n");
+    }
+    for(j = 0; width > 0 && j < points; j++)
+    {
+        b = &bkt[j];
+        if(b->n == 0)
+        {
+            continue;
+        }
+        reply(r, "{ \"ts\":%lld, \"te\":%lld, \"n\":%u", (long long)b->ts, (long long)b->te, b->n);
+        for(i = 0; i < 3; i++)
+        {
+            reply(r, ", \"%c\":[%.2f,%.2f,%.2f]", axis[i], b->min[i], b->sum[i] / b->n, b->max[i]);
+        }
+        for(i = 0; i < 2; i++)
+        {
+            temp[i] = b->tN[i] ? (int16_t)lround(b->tSum[i] / b->tN[i]) : HISTORY_NOTEMP;
+        }
+        replyTemps(r, temp);
+        reply(r, " }\n");
+    }
+    free(raw);
+    free(bkt);
+}
+
+//------------------------------------------
+// handleRequest()
+//------------------------------------------
+static void handleRequest(history *h, histReply *r, const char *req)
+{
+    char cmd[16];
+    long long a = 0;
+    long long b = 0;
+    int points = 0;
+    int fields;
+    int64_t oldest = 0;
+    int64_t newest = 0;
+    uint64_t count;
+
+    fields = sscanf(req, "%15s %lld %lld %i", cmd, &a, &b, &points);
+    pthread_mutex_lock(&h->lock);
+    count = (h->head > h->capacity) ? h->capacity : h->head;
+    if(count > 0)
+    {
+        oldest = h->ring[(h->head - count) % h->capacity].tsMs;
+        newest = h->ring[(h->head - 1) % h->capacity].tsMs;
+    }
+    pthread_mutex_unlock(&h->lock);
+
+    if(fields >= 1 && !strcmp(cmd, "info"))
+    {
+        reply(r, "{ \"samples\":%llu, \"capacity\":%llu, \"from\":%lld, \"to\":%lld, \"dropped\":%lu, \"queries\":%lu }\n",
+              (unsigned long long)count, (unsigned long long)h->capacity, (long long)oldest, (long long)newest, h->dropped, h->queries);
+        return;
+    }
+    if(fields >= 2 && !strcmp(cmd, "last") && a > 0)
+    {
+        // Relative to the newest sample, not the clock, and no further
+        // back than the oldest.
+        points = (fields >= 3) ? (int)b : 0;
+        if(a > (newest - oldest) / 1000 + 1)
+        {
+            a = (newest - oldest) / 1000 + 1;
+        }
+        b = newest + 1;
+        a = b - a * 1000;
+        fields = 4;
+    }
+    else if(fields >= 3 && !strcmp(cmd, "range") && b > a)
+    {
+        // Trimmed to what is held, so the bucket arithmetic cannot overflow.
+        if(count > 0 && a < newest + 1 && b > oldest)
+        {
+            a = (a < oldest) ? oldest : a;
+            b = (b > newest + 1) ? newest + 1 : b;
+        }
+    }
+    else
+    {
+        reply(r, "{ \"error\":\"expected info, last <s> [<points>] or range <from ms> <to ms> [<points>]\" }\n");
+        h->errors++;
+        return;
+    }
+    if(points < 0 || points > HISTORY_MAXPOINTS)
+    {
+        reply(r, "{ \"error\":\"points must be 0 to %i\" }\n", HISTORY_MAXPOINTS);
+        h->errors++;
+        return;
+    }
+    answer(h, r, a, b, points);
+}
+
+//------------------------------------------
+// historyServe()
+// One request per connection, from the request server's worker.
+//------------------------------------------
+static void historyServe(void *ctx, int fd)
+{
+    history *h = (history *)ctx;
+    histReply *r = h->reply;
+    char req[HISTORY_REQLEN];
+    ssize_t n;
+    int len;
+
+    for(len = 0; len < HISTORY_REQLEN - 1 && memchr(req, '\n', len) == NULL; len += n)
+    {
+        if((n = recv(fd, req + len, HISTORY_REQLEN - 1 - len, 0)) <= 0)
+        {
+            break;
+        }
+    }
+    req[len] = '\0';
+    r->fd = fd;
+    r->len = 0;
+    r->failed = FALSE;
+    handleRequest(h, r, req);
+    replyFlush(r);
+    h->queries++;
+}
+
+//------------------------------------------
+// historyOpen()
+//------------------------------------------
+int historyOpen(history *h, pList *p, double rate)
+{
+    memset(h, 0, sizeof(history));
+    h->p = p;
+    h->srv.listenFd = -1;
+    pthread_mutex_init(&h->lock, NULL);
+    h->capacity = (uint64_t)ceil(p->historyHours * 3600.0 * rate);
+    if((h->ring = malloc(h->capacity * sizeof(histSample))) == NULL ||
+       (h->reply = malloc(sizeof(histReply))) == NULL)
+    {
+        perror("History");
+        historyClose(h);
+        return -1;
+    }
+    if(reqServeOpen(&h->srv, "History", p->historySock, TRUE, historyServe, h) != 0)
+    {
+        historyClose(h);
+        return -1;
+    }
+    if(p->verboseFlag)
+    {
+        fprintf(stdout, "History: %llu samples (%.1f MB) on %s\n", (unsigned long long)h->capacity,
+                h->capacity * sizeof(histSample) / 1048576.0, p->historySock);
+    }
+    return 0;
+}
+
+//------------------------------------------
+// historyPush()
+// Once per output sample.  Samples older than the last are dropped so
+// the ring stays sorted.
+//------------------------------------------
+void historyPush(history *h, const magSample *smp)
+{
+    histSample s;
+    int i;
+
+    s.tsMs = (int64_t)smp->ts.tv_sec * 1000 + smp->ts.tv_nsec / 1000000;
+    if(h->head > 0 && s.tsMs < h->lastMs)
+    {
+        h->dropped++;
+        return;
+    }
+    for(i = 0; i < 3; i++)
+    {
+        s.xyz[i] = (float)smp->xyz[i];
+    }
+    s.temp[0] = s.temp[1] = HISTORY_NOTEMP;
+    if(!h->p->magnetometerOnly)
+    {
+        if(!h->p->localTempOnly && smp->rcTemp >= -100.0)
+        {
+            s.temp[0] = (int16_t)lroundf(smp->rcTemp * 100.0f);
+        }
+        if(!h->p->remoteTempOnly && smp->lcTemp >= -100.0)
+        {
+            s.temp[1] = (int16_t)lroundf(smp->lcTemp * 100.0f);
+        }
+    }
+    h->lastMs = s.tsMs;
+    pthread_mutex_lock(&h->lock);
+    h->ring[h->head % h->capacity] = s;
+    h->head++;
+    pthread_mutex_unlock(&h->lock);
+}
+
+//------------------------------------------
+// historyClose()
+//------------------------------------------
+void historyClose(history *h)
+{
+    reqServeClose(&h->srv);
+    pthread_mutex_destroy(&h->lock);
+    free(h->reply);
+    h->reply = NULL;
+    free(h->ring);
+    h->ring = NULL;
+}
@@ -0,0 +1,78 @@
+//=========================================================================
+// history.h
+//
+// In-memory sample history for the runMag utility, queried over a local
+// Unix stream socket.
+//
+// The last --history-hours of output samples are kept in a ring of 24
+// byte entries, sized from the output rate (24 hours at 1 Hz is about
+// 2 MB).  Entries are in time
+// order, so the ring is its own time index: a query binary searches it.
+// A request server thread (reqserve.c) takes one request per
+// connection, a single line:
+//
+//      info                                size and time span
+//      last <s> [<points>]                 the last s seconds
+//      range <from> <to> [<points>]        from <= t < to, epoch ms
+//
+// The reply is JSON lines: a header with what was selected, then either
+// every sample or, when points is given and smaller, one line per time
+// bucket with the count and min, mean and max of each axis, so peaks
+// survive the reduction:
+//
+//      { "from":..., "to":..., "samples":86400, "points":720, "bucket":120000 }
+//      { "ts":..., "te":..., "n":120, "x":[min,mean,max], "y":[..], "z":[..] }
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100HISTORY_h
+#define SWX3100HISTORY_h
+
+#include <pthread.h>
+#include "main.h"
+#include "reqserve.h"
+
+#define HISTORY_DEFHOURS        24
+#define HISTORY_MAXHOURS        168
+#define HISTORY_MAXPOINTS       100000
+#define HISTORY_REQLEN          128
+#define HISTORY_NOTEMP          INT16_MIN
+
+//------------------------------------------
+// One sample, 24 bytes
+//------------------------------------------
+typedef struct tag_histSample
+{
+    int64_t     tsMs;
+    float       xyz[3];                     // nT
+    int16_t     temp[2];                    // 0.01 C, remote and local
+} histSample;
+
+//------------------------------------------
+// History state
+//------------------------------------------
+typedef struct tag_history
+{
+    pList          *p;
+    histSample     *ring;
+    uint64_t        capacity;
+    uint64_t        head;                   // samples ever pushed
+    int64_t         lastMs;
+    pthread_mutex_t lock;                   // ring and head
+    reqServer       srv;
+    struct tag_histReply *reply;            // the server thread's reply buffer
+    unsigned long   dropped;                // went back in time
+    unsigned long   queries;
+    unsigned long   errors;
+} history;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int historyOpen(history *h, pList *p, double rate);
+void historyPush(history *h, const magSample *smp);
+void historyClose(history *h);
+
+#endif // SWX3100HISTORY_h
@@ -19,6 +19,24 @@
 #include "i2c.h"
 #include "main.h"
 
+static i2cStats stats[I2C_MAXADDR];
+static int curAddr = 0;
+
+//------------------------------------------
+// countXfer()
+// One writer, so a relaxed load and store is enough.
+//------------------------------------------
+static void countXfer(int ok)
+{
+    i2cStats *s = &stats[curAddr];
+
+    __atomic_store_n(&s->xfers, __atomic_load_n(&s->xfers, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    if(!ok)
+    {
+        __atomic_store_n(&s->errors, __atomic_load_n(&s->errors, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    }
+}
+
 //------------------------------------------
 // i2c_setAddress()
 //
@@ -32,6 +50,7 @@ void i2c_setAddress(int fd, int devAddr)
         perror("i2c_SetAddress");
         exit(1);
     }
+    curAddr = devAddr & (I2C_MAXADDR - 1);
 }
 
 //
@@ -60,11 +79,13 @@ int i2c_write(int fd, uint8_t reg, uint8_t value)
     data[0] = reg;
     data[1] = value & 0xff;
     int rv = 0;
+    int ok = (write(fd, data, 2) == 2);
 
-    if(write(fd, data, 2) != 2)
+    if(!ok)
     {
         perror("i2c_write()");
     }
+    countXfer(ok);
     return rv;
 }
 
@@ -87,6 +108,7 @@ int i2c_writebuf(int fd, uint8_t reg, char *buffer, short int length)
         perror("i2c_writebuf(): write(data)");
         exit(1);
     }
+    countXfer(TRUE);
     return rv;
 }
 
@@ -106,7 +128,9 @@ uint8_t i2c_read(int fd, uint8_t reg)
     if(read(fd, data + 1, 1) != 1)
     {
         perror("i2c_read read value.");
+        rv = -1;
     }
+    countXfer(rv == 1);
     return data[1];
 }
 
@@ -129,9 +153,19 @@ int i2c_readbuf(int fd, uint8_t reg, uint8_t* buf, short int length)
     {
         perror("i2c transaction i2c_readbuf() failed.\n");
     }
+    countXfer(rv == 1 && bytes_read == length);
     return bytes_read;
 }
 
+//------------------------------------------
+// i2c_getStats()
+// I2C_MAXADDR entries, indexed by device address.
+//------------------------------------------
+const i2cStats *i2c_getStats(void)
+{
+    return stats;
+}
+
 ///**
 // * @fn SensorStatus mag_enable_interrupts();
 // *
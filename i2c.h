@@ -12,6 +12,18 @@
 
 #include "main.h"
 
+#define I2C_MAXADDR             128
+
+//------------------------------------------
+// Transfers per 7 bit device address.  Only the sampling thread uses the
+// bus; readers elsewhere load the counts atomically.
+//------------------------------------------
+typedef struct tag_i2cStats
+{
+    uint64_t    xfers;
+    uint64_t    errors;
+} i2cStats;
+
 //------------------------------------------
 // Prototypes
 //------------------------------------------
@@ -23,5 +35,6 @@ int i2c_write(int fd, uint8_t reg, uint8_t value);
 uint8_t i2c_read(int fd, uint8_t reg);
 int i2c_writebuf(int fd, uint8_t reg, char* buffer, short int length);
 int i2c_readbuf(int fd, uint8_t reg, uint8_t* buf, short int length);
+const i2cStats *i2c_getStats(void);
 
 #endif //PNIRM3100_I2C_H
\ No newline at end of file
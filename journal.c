@@ -0,0 +1,219 @@
+//=========================================================================
+// journal.c
+//
+// Crash-safe sample journal for the runMag utility.
+// See journal.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#define _GNU_SOURCE                 // memrchr()
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "journal.h"
+#include "logidx.h"
+
+#define JOURNAL_TAILLEN         4096        // bytes read from the end of a log
+
+//------------------------------------------
+// validHeader()
+//------------------------------------------
+static int validHeader(const journalHdr *h, off_t size)
+{
+    return !memcmp(h->magic, JOURNAL_MAGIC, sizeof(h->magic)) && h->format == JOURNAL_FORMAT &&
+           h->recSize == sizeof(magRecord) && h->slots >= JOURNAL_MINSLOTS && h->slots <= JOURNAL_MAXSLOTS &&
+           size >= (off_t)(sizeof(journalHdr) + (size_t)h->slots * sizeof(journalSlot));
+}
+
+//------------------------------------------
+// recoverRecords()
+// Copies out the complete records of the journal left by the last run.
+// The slot for record 'head' is looked at too: it may have been finished
+// without head being moved on.
+//------------------------------------------
+static void recoverRecords(journal *j, int fd, const journalHdr *old)
+{
+    size_t len = sizeof(journalHdr) + (size_t)old->slots * sizeof(journalSlot);
+    const journalSlot *slot;
+    const journalSlot *s;
+    uint64_t n;
+    void *map;
+
+    if((map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        perror("Journal: mmap()");
+        return;
+    }
+    if((j->recovered = malloc(old->slots * sizeof(magRecord))) == NULL)
+    {
+        munmap(map, len);
+        return;
+    }
+    slot = (const journalSlot *)((const char *)map + sizeof(journalHdr));
+    for(n = (old->head >= old->slots) ? old->head - old->slots + 1 : 0; n <= old->head; n++)
+    {
+        s = &slot[n % old->slots];
+        if(s->lock == 2 * n + 2)
+        {
+            j->recovered[j->nRecovered++] = s->rec;
+        }
+    }
+    if(j->nRecovered > 0)
+    {
+        j->lastSeq = j->recovered[j->nRecovered - 1].seq;
+        j->lastNs = j->recovered[j->nRecovered - 1].tsNs;
+    }
+    munmap(map, len);
+}
+
+//------------------------------------------
+// journalOpen()
+// Maps the journal, creating or resizing it as needed, after taking out
+// what the last run left in it.
+//------------------------------------------
+int journalOpen(journal *j, pList *p)
+{
+    journalHdr old;
+    struct stat st;
+    int keep = FALSE;
+    int fd;
+
+    memset(j, 0, sizeof(journal));
+    j->sync = p->journalSync;
+    j->mapLen = sizeof(journalHdr) + (size_t)p->journalSlots * sizeof(journalSlot);
+    if((fd = open(p->journalPath, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+    {
+        perror("Journal");
+        return -1;
+    }
+    if(fstat(fd, &st) == 0 && pread(fd, &old, sizeof(old), 0) == sizeof(old) && validHeader(&old, st.st_size))
+    {
+        recoverRecords(j, fd, &old);
+        keep = (old.slots == (uint32_t)p->journalSlots);
+    }
+    // A new or resized journal starts empty; record numbers restart with it.
+    if(!keep && (ftruncate(fd, 0) != 0 || ftruncate(fd, j->mapLen) != 0))
+    {
+        perror("Journal: ftruncate()");
+        close(fd);
+        return -1;
+    }
+    j->hdr = mmap(NULL, j->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(j->hdr == MAP_FAILED)
+    {
+        perror("Journal: mmap()");
+        j->hdr = NULL;
+        return -1;
+    }
+    j->slot = (journalSlot *)((char *)j->hdr + sizeof(journalHdr));
+    if(!keep)
+    {
+        memcpy(j->hdr->magic, JOURNAL_MAGIC, sizeof(j->hdr->magic));
+        j->hdr->format = JOURNAL_FORMAT;
+        j->hdr->slots = p->journalSlots;
+        j->hdr->recSize = sizeof(magRecord);
+        j->hdr->head = 0;
+        if(j->sync)
+        {
+            msync(j->hdr, j->mapLen, MS_SYNC);
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// journalWrite()
+// Once per output sample, before it is logged.
+//------------------------------------------
+void journalWrite(journal *j, const magRecord *rec)
+{
+    uint64_t n = j->hdr->head;
+    journalSlot *s = &j->slot[n % j->hdr->slots];
+    uintptr_t pageMask = ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1);
+    uintptr_t from;
+    uintptr_t to;
+
+    __atomic_store_n(&s->lock, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&s->rec, rec, sizeof(magRecord));
+    __atomic_store_n(&s->lock, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&j->hdr->head, n + 1, __ATOMIC_RELEASE);
+    if(j->sync)
+    {
+        // The slot's pages, then the header's; a torn slot is ignored.
+        from = (uintptr_t)s & pageMask;
+        to = (uintptr_t)(s + 1);
+        if(msync((void *)from, to - from, MS_SYNC) != 0 || msync(j->hdr, sizeof(journalHdr), MS_SYNC) != 0)
+        {
+            j->errors++;
+        }
+    }
+    j->written++;
+}
+
+//------------------------------------------
+// journalClose()
+//------------------------------------------
+void journalClose(journal *j)
+{
+    if(j->hdr != NULL)
+    {
+        munmap(j->hdr, j->mapLen);
+        j->hdr = NULL;
+    }
+    free(j->recovered);
+    j->recovered = NULL;
+    j->nRecovered = 0;
+}
+
+//------------------------------------------
+// journalLogTailMs()
+// Time of the last sample line of a log, INT64_MIN if it has none (or
+// does not exist).
+//------------------------------------------
+int64_t journalLogTailMs(const char *logPath)
+{
+    char buf[JOURNAL_TAILLEN + 1];
+    struct stat st;
+    int64_t ts = INT64_MIN;
+    ssize_t len;
+    off_t from;
+    char *end;
+    char *line;
+    int fd;
+
+    if((fd = open(logPath, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        return INT64_MIN;
+    }
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        from = (st.st_size > JOURNAL_TAILLEN) ? st.st_size - JOURNAL_TAILLEN : 0;
+        if((len = pread(fd, buf, st.st_size - from, from)) > 0)
+        {
+            // Whole lines only, newest first; a line cut by a crash is skipped.
+            buf[len] = '\0';
+            end = memrchr(buf, '\n', len);
+            while(end != NULL && ts == INT64_MIN)
+            {
+                *end = '\0';
+                line = memrchr(buf, '\n', end - buf);
+                if(line == NULL && from > 0)
+                {
+                    break;
+                }
+                line = (line != NULL) ? line + 1 : buf;
+                if((ts = logIndexParseTime(line)) < 0)
+                {
+                    ts = INT64_MIN;
+                }
+                end = (line > buf) ? line - 1 : NULL;
+            }
+        }
+    }
+    close(fd);
+    return ts;
+}
@@ -0,0 +1,86 @@
+//=========================================================================
+// journal.h
+//
+// Crash-safe sample journal for the runMag utility.
+//
+// Each output sample is stored as a magRecord in a small memory-mapped
+// ring before it is formatted and written to the log.  The map is a file
+// (/dev/shm to survive the process, a disk file with --journal-sync to
+// survive the board), so whatever runMag was doing when it died, the last
+// --journal-slots samples are still there at the next start.
+//
+// There is one writer and no reader while it runs, so the protocol is the
+// shmring one without the readers: slot lock 2n+1 while record n is being
+// stored, 2n+2 once it is whole, then head = n+1.  A slot whose lock is
+// not 2n+2 was torn and is ignored.
+//
+// At start-up the complete records are handed back in order.  runMag
+// appends those newer than the last line of their log, carries on the
+// sequence numbers, and marks a gap in the log only if its first new
+// sample comes more than JOURNAL_GAPNS after the newest journal record.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100JOURNAL_h
+#define SWX3100JOURNAL_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "main.h"
+#include "magrec.h"
+
+#define JOURNAL_MAGIC           "RMJNL01"
+#define JOURNAL_FORMAT          1
+#define JOURNAL_DEFSLOTS        256
+#define JOURNAL_MINSLOTS        16
+#define JOURNAL_MAXSLOTS        65536
+#define JOURNAL_GAPNS           2000000000LL    // 1 Hz output: more than one missed sample
+
+//------------------------------------------
+// Mapped layout, host byte order
+//------------------------------------------
+typedef struct tag_journalHdr
+{
+    char        magic[8];
+    uint32_t    format;
+    uint32_t    slots;
+    uint32_t    recSize;
+    uint32_t    pad0;
+    uint64_t    head;                       // records stored so far
+    uint64_t    pad[4];
+} journalHdr;
+
+typedef struct tag_journalSlot
+{
+    uint64_t    lock;                       // 2n+1 storing record n, 2n+2 record n complete
+    magRecord   rec;
+} journalSlot;
+
+//------------------------------------------
+// Writer state
+//------------------------------------------
+typedef struct tag_journal
+{
+    journalHdr     *hdr;
+    journalSlot    *slot;
+    size_t          mapLen;
+    int             sync;                   // msync() each record
+    magRecord      *recovered;              // complete records found at open, oldest first
+    uint32_t        nRecovered;
+    uint64_t        lastSeq;                // of the newest recovered record, else 0
+    int64_t         lastNs;                 // its time, else 0
+    unsigned long   written;
+    unsigned long   errors;
+} journal;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int journalOpen(journal *j, pList *p);
+void journalWrite(journal *j, const magRecord *rec);
+void journalClose(journal *j);
+int64_t journalLogTailMs(const char *logPath);
+
+#endif // SWX3100JOURNAL_h
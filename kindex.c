@@ -0,0 +1,364 @@
+//=========================================================================
+// kindex.c
+//
+// Incremental K and hourly range indices for the runMag utility.
+// See kindex.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <string.h>
+#include "kindex.h"
+
+// Standard K scale for K9 = 500 nT.
+static const double kScale[10] = { 0.0, 5.0, 10.0, 20.0, 40.0, 70.0, 120.0, 200.0, 330.0, 500.0 };
+
+//------------------------------------------
+// kIndexInit()
+//------------------------------------------
+void kIndexInit(kIndex *ki, pList *p)
+{
+    int i;
+
+    memset(ki, 0, sizeof(kIndex));
+    ki->path = p->kIndexPath;
+    ki->k9 = p->kIndexK9;
+    for(i = 0; i < 10; i++)
+    {
+        ki->limits[i] = kScale[i] * ki->k9 / 500.0;
+    }
+    for(i = 0; i < KINDEX_MINUTES; i++)
+    {
+        ki->minutes[i].min = KINDEX_NOMIN;
+    }
+    for(i = 0; i < KINDEX_INTERVALS; i++)
+    {
+        ki->iv[i].start = KINDEX_NOMIN;
+    }
+    for(i = 0; i < KINDEX_HOURS; i++)
+    {
+        ki->hr[i].hour = KINDEX_NOMIN;
+    }
+    ki->curMin = KINDEX_NOMIN;
+}
+
+//------------------------------------------
+// getMinute()
+//------------------------------------------
+static const kIndexMinute *getMinute(const kIndex *ki, int64_t t)
+{
+    const kIndexMinute *m = &ki->minutes[t & (KINDEX_MINUTES - 1)];
+
+    return (m->min == t) ? m : NULL;
+}
+
+//------------------------------------------
+// kFromRange()
+//------------------------------------------
+static int kFromRange(const kIndex *ki, double range)
+{
+    int k = 9;
+
+    while(k > 0 && range < ki->limits[k])
+    {
+        k--;
+    }
+    return k;
+}
+
+//------------------------------------------
+// computeK()
+// FMI method over the interval starting at minute start, with whatever
+// data has arrived so far.
+//------------------------------------------
+static int computeK(const kIndex *ki, int64_t start, double *range)
+{
+    const kIndexMinute *m;
+    double lo[2];
+    double hi[2];
+    double mean[5][2];
+    double sr[2];
+    double r[2];
+    double f;
+    double w;
+    int have[5];
+    int64_t ext;
+    int64_t h0;
+    int64_t t;
+    long n = 0;
+    int iter;
+    int k;
+    int c;
+    int j;
+
+    // K0 from the plain ranges.
+    for(t = start; t < start + KINDEX_INTERVAL; t++)
+    {
+        if((m = getMinute(ki, t)) == NULL)
+        {
+            continue;
+        }
+        if(n++ == 0)
+        {
+            lo[0] = hi[0] = m->x;
+            lo[1] = hi[1] = m->y;
+        }
+        lo[0] = fmin(lo[0], m->x);
+        hi[0] = fmax(hi[0], m->x);
+        lo[1] = fmin(lo[1], m->y);
+        hi[1] = fmax(hi[1], m->y);
+    }
+    if(n < KINDEX_INTERVAL / 2)
+    {
+        *range = 0.0;
+        return -1;
+    }
+    *range = fmax(hi[0] - lo[0], hi[1] - lo[1]);
+    k = kFromRange(ki, *range);
+    for(iter = 0; iter < 2; iter++)
+    {
+        // Extended hourly means, hour before to hour after the interval.
+        ext = 30 + (int64_t)pow(k, 3.3);
+        if(ext > KINDEX_MAXEXT)
+        {
+            ext = KINDEX_MAXEXT;
+        }
+        for(j = 0; j < 5; j++)
+        {
+            h0 = start - 60 + 60 * j;
+            mean[j][0] = mean[j][1] = 0.0;
+            n = 0;
+            for(t = h0 - ext; t < h0 + 60 + ext; t++)
+            {
+                if((m = getMinute(ki, t)) != NULL)
+                {
+                    mean[j][0] += m->x;
+                    mean[j][1] += m->y;
+                    n++;
+                }
+            }
+            have[j] = (n > 0);
+            if(n > 0)
+            {
+                mean[j][0] /= n;
+                mean[j][1] /= n;
+            }
+        }
+        // Range about the curve through the hour centres.
+        n = 0;
+        for(t = start; t < start + KINDEX_INTERVAL; t++)
+        {
+            if((m = getMinute(ki, t)) == NULL)
+            {
+                continue;
+            }
+            f = (t + 0.5 - (start - 30)) / 60.0;
+            j = (int)f;
+            w = f - j;
+            for(c = 0; c < 2; c++)
+            {
+                if(have[j] && have[j + 1])
+                {
+                    sr[c] = (1.0 - w) * mean[j][c] + w * mean[j + 1][c];
+                }
+                else
+                {
+                    sr[c] = have[j] ? mean[j][c] : mean[j + 1][c];
+                }
+            }
+            r[0] = m->x - sr[0];
+            r[1] = m->y - sr[1];
+            for(c = 0; c < 2; c++)
+            {
+                if(n == 0)
+                {
+                    lo[c] = hi[c] = r[c];
+                }
+                lo[c] = fmin(lo[c], r[c]);
+                hi[c] = fmax(hi[c], r[c]);
+            }
+            n++;
+        }
+        *range = fmax(hi[0] - lo[0], hi[1] - lo[1]);
+        k = kFromRange(ki, *range);
+    }
+    return k;
+}
+
+//------------------------------------------
+// updateIntervals()
+// Recomputes every interval later data could still change.
+//------------------------------------------
+static void updateIntervals(kIndex *ki, int64_t now)
+{
+    kIndexInterval *iv;
+    int64_t cur = now - now % KINDEX_INTERVAL;
+    int64_t start;
+    int j;
+
+    for(j = KINDEX_INTERVALS - 1; j >= 0; j--)
+    {
+        start = cur - (int64_t)KINDEX_INTERVAL * j;
+        iv = &ki->iv[(start / KINDEX_INTERVAL) % KINDEX_INTERVALS];
+        if(iv->start != start)
+        {
+            iv->start = start;
+            iv->final = FALSE;
+        }
+        if(!iv->final)
+        {
+            iv->k = computeK(ki, start, &iv->range);
+            iv->final = (now >= start + KINDEX_INTERVAL + 60 + KINDEX_MAXEXT);
+        }
+    }
+}
+
+//------------------------------------------
+// fmtMinute()
+//------------------------------------------
+static void fmtMinute(int64_t min, char *buf, int len)
+{
+    time_t t = (time_t)(min * 60);
+    struct tm utc;
+
+    gmtime_r(&t, &utc);
+    strftime(buf, len, "%Y-%m-%dT%H:%M:%SZ", &utc);
+}
+
+//------------------------------------------
+// writeFile()
+// Written to a temporary file and renamed, so readers never see half of it.
+//------------------------------------------
+static void writeFile(kIndex *ki, int64_t now)
+{
+    const kIndexInterval *iv;
+    const kIndexHour *hr;
+    char tmp[MAXPATHBUFLEN];
+    char ts[UTCBUFLEN];
+    int64_t cur = now - now % KINDEX_INTERVAL;
+    int64_t start;
+    int64_t hour;
+    int j;
+    FILE *fp;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", ki->path);
+    if((fp = fopen(tmp, "w")) == NULL)
+    {
+        ki->writeErrors++;
+        return;
+    }
+    fmtMinute(now + 1, ts, sizeof(ts));
+    fprintf(fp, "{\"updated\":\"%s\",\"k9\":%.0f,\n \"k\":[", ts, ki->k9);
+    for(j = KINDEX_INTERVALS - 1; j >= 0; j--)
+    {
+        start = cur - (int64_t)KINDEX_INTERVAL * j;
+        iv = &ki->iv[(start / KINDEX_INTERVAL) % KINDEX_INTERVALS];
+        fmtMinute(start, ts, sizeof(ts));
+        fprintf(fp, "\n  {\"start\":\"%s\",", ts);
+        if(iv->k < 0)
+        {
+            fprintf(fp, "\"k\":null,\"range\":null,");
+        }
+        else
+        {
+            fprintf(fp, "\"k\":%i,\"range\":%.1f,", iv->k, iv->range);
+        }
+        fprintf(fp, "\"final\":%s}%s", iv->final ? "true" : "false", j ? "," : "");
+    }
+    fprintf(fp, "],\n \"hr\":[");
+    for(j = KINDEX_HOURS - 1; j >= 0; j--)
+    {
+        hour = now / 60 - j;
+        hr = &ki->hr[hour % KINDEX_HOURS];
+        fmtMinute(hour * 60, ts, sizeof(ts));
+        fprintf(fp, "\n  {\"start\":\"%s\",", ts);
+        if(hr->hour != hour)
+        {
+            fprintf(fp, "\"range\":null}");
+        }
+        else
+        {
+            fprintf(fp, "\"range\":%.1f}", fmax(hr->max[0] - hr->min[0], hr->max[1] - hr->min[1]));
+        }
+        fprintf(fp, "%s", j ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+    if(fclose(fp) != 0 || rename(tmp, ki->path) != 0)
+    {
+        ki->writeErrors++;
+        return;
+    }
+    ki->writes++;
+}
+
+//------------------------------------------
+// closeMinute()
+//------------------------------------------
+static void closeMinute(kIndex *ki)
+{
+    kIndexMinute *m = &ki->minutes[ki->curMin & (KINDEX_MINUTES - 1)];
+    kIndexHour *hr;
+    int64_t hour = ki->curMin / 60;
+    double v[2];
+    int c;
+
+    v[0] = ki->sum[0] / ki->count;
+    v[1] = ki->sum[1] / ki->count;
+    m->min = ki->curMin;
+    m->x = v[0];
+    m->y = v[1];
+    hr = &ki->hr[hour % KINDEX_HOURS];
+    if(hr->hour != hour)
+    {
+        hr->hour = hour;
+        for(c = 0; c < 2; c++)
+        {
+            hr->min[c] = hr->max[c] = v[c];
+        }
+    }
+    for(c = 0; c < 2; c++)
+    {
+        hr->min[c] = fmin(hr->min[c], v[c]);
+        hr->max[c] = fmax(hr->max[c], v[c]);
+    }
+    updateIntervals(ki, ki->curMin);
+    writeFile(ki, ki->curMin);
+}
+
+//------------------------------------------
+// kIndexPush()
+// Uses the temperature compensated field when there is one.
+//------------------------------------------
+void kIndexPush(kIndex *ki, const magSample *smp)
+{
+    const double *b = smp->haveComp ? smp->compXYZ : smp->xyz;
+    int64_t min = smp->ts.tv_sec / 60;
+
+    if(min != ki->curMin)
+    {
+        if(ki->count > 0)
+        {
+            closeMinute(ki);
+        }
+        ki->curMin = min;
+        ki->sum[0] = ki->sum[1] = 0.0;
+        ki->count = 0;
+    }
+    ki->sum[0] += b[0];
+    ki->sum[1] += b[1];
+    ki->count++;
+}
+
+//------------------------------------------
+// kIndexClose()
+//------------------------------------------
+void kIndexClose(kIndex *ki)
+{
+    if(ki->count > 0)
+    {
+        closeMinute(ki);
+        ki->count = 0;
+    }
+}
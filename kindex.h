@@ -0,0 +1,107 @@
+//=========================================================================
+// kindex.h
+//
+// Incremental K and hourly range indices for the runMag utility.
+//
+// The horizontal components (X north, Y east as installed) are reduced
+// to one minute means; everything else works on those.  For each 3 hour
+// UT interval, following the FMI method:
+//
+//  1.  K0 from the range of X and Y in the interval.
+//  2.  Quiet day curve: means of each hour, extended by 30 + K^3.3
+//      minutes either side (at most KINDEX_MAXEXT), interpolated between
+//      hour centres.
+//  3.  K from the larger range of X and Y about that curve; steps 2 and
+//      3 run twice.
+//
+// K is converted from the range with the standard scale, multiplied by
+// the station's K9 lower limit / 500 nT.  The hourly range index is the
+// larger of the X and Y ranges within each UT hour.
+//
+// The current and previous intervals are recomputed once a minute from
+// the minute history (a few hundred operations) until no later data can
+// change them; the sample path only adds to the minute sums.  After each
+// minute the side file is rewritten (atomically) with the last
+// KINDEX_INTERVALS K values and KINDEX_HOURS hourly ranges:
+//
+//      {"updated":"<UTC>","k9":<nT>,
+//       "k":[{"start":"<UTC>","k":<0-9|null>,"range":<nT>,"final":<bool>},..],
+//       "hr":[{"start":"<UTC>","range":<nT|null>},..]}
+//
+// oldest first.  An interval with under half its minutes has k null.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100KINDEX_h
+#define SWX3100KINDEX_h
+
+#include <stdint.h>
+#include "main.h"
+
+#define KINDEX_MINUTES          2048        // minute history, power of 2
+#define KINDEX_INTERVALS        8
+#define KINDEX_HOURS            24
+#define KINDEX_INTERVAL         180         // minutes
+#define KINDEX_MAXEXT           360         // minutes
+#define KINDEX_DEFK9            500.0       // nT
+#define KINDEX_NOMIN            INT64_MIN
+
+//------------------------------------------
+// One minute mean
+//------------------------------------------
+typedef struct tag_kIndexMinute
+{
+    int64_t     min;                        // minutes since the epoch
+    double      x;
+    double      y;
+} kIndexMinute;
+
+//------------------------------------------
+// One 3 hour interval
+//------------------------------------------
+typedef struct tag_kIndexInterval
+{
+    int64_t     start;                      // minutes since the epoch
+    int         k;                          // -1 while too little data
+    double      range;                      // nT about the quiet day curve
+    int         final;
+} kIndexInterval;
+
+//------------------------------------------
+// One hour of ranges
+//------------------------------------------
+typedef struct tag_kIndexHour
+{
+    int64_t     hour;                       // hours since the epoch
+    double      min[2];
+    double      max[2];
+} kIndexHour;
+
+//------------------------------------------
+// Index state
+//------------------------------------------
+typedef struct tag_kIndex
+{
+    const char     *path;
+    double          limits[10];             // K lower limits, nT
+    double          k9;
+    kIndexMinute    minutes[KINDEX_MINUTES];
+    kIndexInterval  iv[KINDEX_INTERVALS];
+    kIndexHour      hr[KINDEX_HOURS];
+    int64_t         curMin;
+    double          sum[2];
+    long            count;
+    unsigned long   writes;
+    unsigned long   writeErrors;
+} kIndex;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+void kIndexInit(kIndex *ki, pList *p);
+void kIndexPush(kIndex *ki, const magSample *smp);
+void kIndexClose(kIndex *ki);
+
+#endif // SWX3100KINDEX_h
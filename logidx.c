@@ -0,0 +1,282 @@
+//=========================================================================
+// logidx.c
+//
+// Sidecar time index for runMag text logs.
+// See logidx.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#define _GNU_SOURCE                 // strptime(), timegm()
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "logidx.h"
+
+//------------------------------------------
+// logIndexParseTime()
+// Time of a CSV or JSON log line, "19 Oct 2026 03:59:00" or -M
+// milliseconds; -1 for the header or anything else.
+//------------------------------------------
+int64_t logIndexParseTime(const char *line)
+{
+    const char *s = line;
+    struct tm tm;
+    char *end;
+    long long ms;
+
+    if(*s == '{')
+    {
+        if((s = strstr(s, "\"ts\":")) == NULL)
+        {
+            return -1;
+        }
+        s += 5;
+    }
+    if(*s == '"')
+    {
+        s++;
+    }
+    if(*s < '0' || *s > '9')
+    {
+        return -1;
+    }
+    memset(&tm, 0, sizeof(tm));
+    if(strptime(s, "%d %b %Y %T", &tm) != NULL)
+    {
+        return (int64_t)timegm(&tm) * 1000;
+    }
+    ms = strtoll(s, &end, 10);
+    return (*end == ' ' || *end == '"' || *end == ',') ? ms : -1;
+}
+
+//------------------------------------------
+// appendEntry()
+//------------------------------------------
+static void appendEntry(logIndex *li, int64_t tsMs, uint64_t offset)
+{
+    logIndexEntry e;
+
+    e.ts = tsMs;
+    e.offset = offset;
+    if(fwrite(&e, sizeof(e), 1, li->fp) != 1 || fflush(li->fp) != 0)
+    {
+        li->errors++;
+        return;
+    }
+    li->entries++;
+}
+
+//------------------------------------------
+// catchUp()
+// Indexes the log from offset 'from' to its current end.
+//------------------------------------------
+static int catchUp(logIndex *li, uint64_t from)
+{
+    char line[LOGIDX_LINELEN];
+    uint64_t offset = from;
+    int64_t ts;
+    int64_t key;
+    int lineStart = 1;
+    size_t len;
+    FILE *log;
+
+    if(from >= li->logSize)
+    {
+        return 0;
+    }
+    if((log = fopen(li->logPath, "r")) == NULL || fseeko(log, (off_t)from, SEEK_SET) != 0)
+    {
+        return -1;
+    }
+    while(offset < li->logSize && fgets(line, sizeof(line), log) != NULL)
+    {
+        len = strlen(line);
+        // A long line comes in pieces; only the first has the time.
+        if(lineStart && (ts = logIndexParseTime(line)) >= 0 && (key = ts / 1000 / li->stride) > li->lastKey)
+        {
+            appendEntry(li, ts, offset);
+            li->lastKey = key;
+        }
+        lineStart = (len > 0 && line[len - 1] == '\n');
+        offset += len;
+    }
+    fclose(log);
+    return 0;
+}
+
+//------------------------------------------
+// logIndexOpen()
+// Opens or creates the index of a log and brings it up to date.  logfp
+// is the log being written, or NULL to only refresh the index.
+//------------------------------------------
+int logIndexOpen(logIndex *li, const char *logPath, FILE *logfp, int stride)
+{
+    char path[LOGIDX_PATHLEN + sizeof(LOGIDX_SUFFIX)];
+    logIndexHdr hdr;
+    logIndexEntry e;
+    struct stat st;
+    uint64_t from = 0;
+    long n = 0;
+
+    memset(li, 0, sizeof(logIndex));
+    snprintf(li->logPath, sizeof(li->logPath), "%s", logPath);
+    li->stride = stride;
+    li->lastKey = -1;
+    if(logfp != NULL)
+    {
+        fflush(logfp);
+    }
+    if((logfp != NULL) ? fstat(fileno(logfp), &st) : stat(logPath, &st))
+    {
+        return -1;
+    }
+    li->logSize = st.st_size;
+    snprintf(path, sizeof(path), "%s%s", logPath, LOGIDX_SUFFIX);
+    if((li->fp = fopen(path, "r+b")) == NULL && (li->fp = fopen(path, "w+b")) == NULL)
+    {
+        return -1;
+    }
+    if(fread(&hdr, sizeof(hdr), 1, li->fp) == 1 && !memcmp(hdr.magic, LOGIDX_MAGIC, sizeof(hdr.magic)) &&
+       hdr.format == LOGIDX_FORMAT && hdr.stride == (uint32_t)stride && fstat(fileno(li->fp), &st) == 0)
+    {
+        // Keep whole entries that point into the log.
+        n = (long)((st.st_size - sizeof(hdr)) / sizeof(e));
+        while(n > 0)
+        {
+            if(fseeko(li->fp, (off_t)(sizeof(hdr) + (n - 1) * sizeof(e)), SEEK_SET) != 0 ||
+               fread(&e, sizeof(e), 1, li->fp) != 1)
+            {
+                n = 0;
+                break;
+            }
+            if(e.offset < li->logSize)
+            {
+                li->lastKey = e.ts / 1000 / stride;
+                from = e.offset;
+                break;
+            }
+            n--;
+        }
+    }
+    else
+    {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, LOGIDX_MAGIC, sizeof(hdr.magic));
+        hdr.format = LOGIDX_FORMAT;
+        hdr.stride = stride;
+        rewind(li->fp);
+        if(fwrite(&hdr, sizeof(hdr), 1, li->fp) != 1)
+        {
+            fclose(li->fp);
+            li->fp = NULL;
+            return -1;
+        }
+    }
+    fflush(li->fp);
+    if(ftruncate(fileno(li->fp), (off_t)(sizeof(hdr) + n * sizeof(e))) != 0 ||
+       fseeko(li->fp, 0, SEEK_END) != 0)
+    {
+        fclose(li->fp);
+        li->fp = NULL;
+        return -1;
+    }
+    li->entries = n;
+    return catchUp(li, from);
+}
+
+//------------------------------------------
+// logIndexAdd()
+// Called after each line is written to the log.
+//------------------------------------------
+void logIndexAdd(logIndex *li, int64_t tsMs, size_t lineLen)
+{
+    int64_t key = tsMs / 1000 / li->stride;
+
+    if(li->fp != NULL && key > li->lastKey)
+    {
+        appendEntry(li, tsMs, li->logSize);
+        li->lastKey = key;
+    }
+    li->logSize += lineLen;
+}
+
+//------------------------------------------
+// logIndexClose()
+//------------------------------------------
+void logIndexClose(logIndex *li)
+{
+    if(li->fp != NULL)
+    {
+        fclose(li->fp);
+        li->fp = NULL;
+    }
+}
+
+//------------------------------------------
+// logIndexSeek()
+// Positions log (opened from logPath) at or before the first line at or
+// after tsMs.  The lines skipped over before it all fall in one stride,
+// but across a gap in the data that stride may start well before tsMs,
+// so the caller still reads forward to tsMs.  Without a usable index it
+// rewinds and returns -1.
+//------------------------------------------
+int logIndexSeek(FILE *log, const char *logPath, int64_t tsMs)
+{
+    char path[LOGIDX_PATHLEN + sizeof(LOGIDX_SUFFIX)];
+    logIndexHdr hdr;
+    logIndexEntry *e = NULL;
+    struct stat st;
+    uint64_t offset = 0;
+    long n = 0;
+    long lo = 0;
+    long hi;
+    long mid;
+    FILE *fp;
+    int rv = -1;
+
+    snprintf(path, sizeof(path), "%s%s", logPath, LOGIDX_SUFFIX);
+    if((fp = fopen(path, "rb")) != NULL)
+    {
+        if(fread(&hdr, sizeof(hdr), 1, fp) == 1 && !memcmp(hdr.magic, LOGIDX_MAGIC, sizeof(hdr.magic)) &&
+           hdr.format == LOGIDX_FORMAT && fstat(fileno(fp), &st) == 0)
+        {
+            n = (long)((st.st_size - sizeof(hdr)) / sizeof(logIndexEntry));
+            if(n > 0 && (e = malloc(n * sizeof(logIndexEntry))) != NULL)
+            {
+                n = (long)fread(e, sizeof(logIndexEntry), n, fp);
+            }
+            rv = 0;
+        }
+        fclose(fp);
+    }
+    // Last entry at or before tsMs.
+    hi = (e != NULL) ? n : 0;
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(e[mid].ts <= tsMs)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    if(lo > 0)
+    {
+        offset = e[lo - 1].offset;
+    }
+    free(e);
+    if(fseeko(log, (off_t)offset, SEEK_SET) != 0)
+    {
+        rewind(log);
+        return -1;
+    }
+    return rv;
+}
@@ -0,0 +1,77 @@
+//=========================================================================
+// logidx.h
+//
+// Sidecar time index for runMag text logs.
+//
+// Next to <log> runMag keeps <log>.idx: a header, then one entry per
+// stride seconds that holds the time of the first line in that stride
+// and its byte offset.  Entries are appended after the line is written,
+// so at worst the index lags the log; opening it (a restart appending to
+// the same day file, or magseek -i) drops anything past the end of the
+// log and indexes the lines written since the last entry.
+//
+// Lines that go back in time are not indexed, so entries stay sorted.
+// The offsets are into the uncompressed log.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100LOGIDX_h
+#define SWX3100LOGIDX_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LOGIDX_MAGIC            "RMLIDX1"
+#define LOGIDX_FORMAT           1
+#define LOGIDX_SUFFIX           ".idx"
+#define LOGIDX_PATHLEN          1100
+#define LOGIDX_DEFSTRIDE        60
+#define LOGIDX_MAXSTRIDE        3600
+#define LOGIDX_LINELEN          1024
+
+//------------------------------------------
+// File header, 32 bytes, host byte order
+//------------------------------------------
+typedef struct tag_logIndexHdr
+{
+    char        magic[8];
+    uint32_t    format;
+    uint32_t    stride;                     // seconds
+    uint8_t     pad[16];
+} logIndexHdr;
+
+//------------------------------------------
+// One entry, 16 bytes
+//------------------------------------------
+typedef struct tag_logIndexEntry
+{
+    int64_t     ts;                         // ms since the epoch (UTC)
+    uint64_t    offset;                     // of the line in the log
+} logIndexEntry;
+
+//------------------------------------------
+// Writer state
+//------------------------------------------
+typedef struct tag_logIndex
+{
+    FILE           *fp;
+    int             stride;
+    int64_t         lastKey;                // stride number of the last entry
+    uint64_t        logSize;                // offset of the next line
+    char            logPath[LOGIDX_PATHLEN];
+    unsigned long   entries;
+    unsigned long   errors;
+} logIndex;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int64_t logIndexParseTime(const char *line);
+int logIndexOpen(logIndex *li, const char *logPath, FILE *logfp, int stride);
+void logIndexAdd(logIndex *li, int64_t tsMs, size_t lineLen);
+void logIndexClose(logIndex *li);
+int logIndexSeek(FILE *log, const char *logPath, int64_t tsMs);
+
+#endif // SWX3100LOGIDX_h
@@ -0,0 +1,419 @@
+//=========================================================================
+// logroll.c
+//
+// Log file rollover management for the runMag utility.
+//
+// The file for the next period is opened by a background worker shortly
+// before the boundary, so the sampling loop only swaps a pointer when the
+// boundary passes.  Closed files are handed back to the same worker which
+// closes them and, if asked to, compresses them at low priority.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "main.h"
+#include "cmdmgr.h"
+#include "logroll.h"
+
+//------------------------------------------
+// parseLogRollPeriod()
+// Accepts "daily", "hourly", "<N>m", "<N>h" or "<N>" (minutes).
+// Returns the period in seconds, or 0 if invalid.
+//------------------------------------------
+int parseLogRollPeriod(const char *spec)
+{
+    char *end = NULL;
+    long val = 0;
+
+    if(spec == NULL || *spec == '\0')
+    {
+        return 0;
+    }
+    if(!strcasecmp(spec, "daily") || !strcasecmp(spec, "d") || !strcmp(spec, "00:00"))
+    {
+        return LOGROLL_DAILY;
+    }
+    if(!strcasecmp(spec, "hourly"))
+    {
+        return LOGROLL_HOURLY;
+    }
+    val = strtol(spec, &end, 10);
+    if(val <= 0)
+    {
+        return 0;
+    }
+    if(*end == '\0' || !strcasecmp(end, "m"))
+    {
+        val *= 60;
+    }
+    else if(!strcasecmp(end, "h"))
+    {
+        val *= 3600;
+    }
+    else
+    {
+        return 0;
+    }
+    if(val > LOGROLL_DAILY)
+    {
+        return 0;
+    }
+    return (int)val;
+}
+
+//------------------------------------------
+// writeLogHeader()
+//------------------------------------------
+void writeLogHeader(pList *p, FILE *fp)
+{
+    if(p->jsonFlag)
+    {
+        return;
+    }
+    // DRL put meta data here
+    // DRL should be printed only at the top of the log file
+    // DMW respect -H switch (but not other rtemp, ltemp, etc. options yet.)
+    if(p->hideRaw)
+    {
+        fprintf(fp, "\"time\", \"rtemp\", \"ltemp\", \"x\", \"y\", \"z\", \"total\"\n");
+    }
+    else
+    {
+        fprintf(fp, "\"time\", \"rtemp\", \"ltemp\", \"x\", \"y\", \"z\", \"rx\", \"ry\", \"rz\", \"total\"\n");
+    }
+}
+
+//------------------------------------------
+// openPeriodFile()
+// Opens the log file for the period starting at 'start'.
+//------------------------------------------
+static FILE *openPeriodFile(logRoll *lr, time_t start, char *path, int *empty, int *created)
+{
+    FILE *fp = NULL;
+    struct stat st;
+
+    buildLogFilePathFor(lr->p, start, lr->suffix, path);
+    *created = (stat(path, &st) != 0);
+    if((fp = fopen(path, "a+")) != NULL)
+    {
+        *empty = (fstat(fileno(fp), &st) == 0) ? (st.st_size == 0) : FALSE;
+    }
+    return fp;
+}
+
+//------------------------------------------
+// compressLog()
+// Runs the compressor on a closed log at idle priority.
+//------------------------------------------
+static void compressLog(const char *path)
+{
+    pid_t pid;
+    int status = 0;
+
+    if((pid = fork()) == 0)
+    {
+        setpriority(PRIO_PROCESS, 0, LOGROLL_NICE);
+#ifdef SYS_ioprio_set
+        // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+        syscall(SYS_ioprio_set, 1, 0, (3 << 13));
+#endif
+        execlp(LOGROLL_COMPRESSCMD, LOGROLL_COMPRESSCMD, "-f", path, (char *)NULL);
+        _exit(127);
+    }
+    else if(pid < 0)
+    {
+        perror("logroll: fork()");
+        return;
+    }
+    while(waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "logroll: %s failed on %s\n", LOGROLL_COMPRESSCMD, path);
+    }
+}
+
+//------------------------------------------
+// retireLog()
+// Closes a file handed back by the sampling loop.
+//------------------------------------------
+static void retireLog(closedLog *cl)
+{
+    struct stat st;
+    int empty = FALSE;
+
+    if(cl->fp == NULL)
+    {
+        return;
+    }
+    fclose(cl->fp);
+    cl->fp = NULL;
+    empty = (stat(cl->path, &st) == 0) && (st.st_size == 0);
+    if(empty)
+    {
+        unlink(cl->path);
+    }
+    else if(cl->compress)
+    {
+        compressLog(cl->path);
+    }
+}
+
+//------------------------------------------
+// logRollWorker()
+//------------------------------------------
+static void *logRollWorker(void *arg)
+{
+    logRoll *lr = (logRoll *)arg;
+    closedLog cl;
+    struct timespec until;
+
+#ifdef SYS_gettid
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), LOGROLL_NICE);
+#endif
+    pthread_mutex_lock(&lr->lock);
+    while(1)
+    {
+        if(lr->qCount > 0)
+        {
+            cl = lr->closed[lr->qHead];
+            lr->closed[lr->qHead].fp = NULL;
+            lr->qHead = (lr->qHead + 1) % LOGROLL_QUEUELEN;
+            lr->qCount--;
+            pthread_mutex_unlock(&lr->lock);
+            retireLog(&cl);
+            pthread_mutex_lock(&lr->lock);
+            continue;
+        }
+        if(lr->stop)
+        {
+            break;
+        }
+        if(lr->nextfp == NULL && time(NULL) >= lr->boundary - LOGROLL_PREOPEN_LEAD)
+        {
+            time_t start = lr->boundary;
+            char path[MAXPATHBUFLEN] = "";
+            int empty = FALSE;
+            int created = FALSE;
+            FILE *fp = NULL;
+
+            pthread_mutex_unlock(&lr->lock);
+            fp = openPeriodFile(lr, start, path, &empty, &created);
+            if(fp == NULL)
+            {
+                perror("logroll: pre-open next log");
+            }
+            pthread_mutex_lock(&lr->lock);
+            if(fp != NULL && lr->nextfp == NULL && start == lr->boundary)
+            {
+                lr->nextfp = fp;
+                lr->nextStart = start;
+                lr->nextEmpty = empty;
+                lr->nextCreated = created;
+                strcpy(lr->nextPath, path);
+                continue;
+            }
+            if(fp != NULL)
+            {
+                // Boundary moved while we were opening; discard.
+                cl.fp = fp;
+                cl.compress = FALSE;
+                strcpy(cl.path, path);
+                pthread_mutex_unlock(&lr->lock);
+                retireLog(&cl);
+                pthread_mutex_lock(&lr->lock);
+                continue;
+            }
+            // Open failed: the sampling loop will retry synchronously at the boundary.
+            until.tv_sec = lr->boundary;
+            until.tv_nsec = 0;
+            pthread_cond_timedwait(&lr->wake, &lr->lock, &until);
+            continue;
+        }
+        if(lr->nextfp == NULL)
+        {
+            until.tv_sec = lr->boundary - LOGROLL_PREOPEN_LEAD;
+            until.tv_nsec = 0;
+            pthread_cond_timedwait(&lr->wake, &lr->lock, &until);
+        }
+        else
+        {
+            pthread_cond_wait(&lr->wake, &lr->lock);
+        }
+    }
+    // Shutting down: drop a pre-opened file nobody has written to yet.
+    if(lr->nextfp != NULL)
+    {
+        fclose(lr->nextfp);
+        if(lr->nextCreated)
+        {
+            unlink(lr->nextPath);
+        }
+        lr->nextfp = NULL;
+    }
+    pthread_mutex_unlock(&lr->lock);
+    return NULL;
+}
+
+//------------------------------------------
+// logRollOpen()
+// Opens the text log for the current period and starts the worker.
+//------------------------------------------
+FILE *logRollOpen(logRoll *lr, pList *p)
+{
+    FILE *fp = logRollOpenFile(lr, p, LOGROLL_TEXTSUFFIX);
+
+    if(fp != NULL)
+    {
+        lr->isText = TRUE;
+        if(lr->curEmpty)
+        {
+            writeLogHeader(p, fp);
+        }
+        p->outputFilePath = lr->curPath;
+    }
+    return fp;
+}
+
+//------------------------------------------
+// logRollOpenFile()
+// Opens a side file (same directory, site prefix and rollover period as
+// the text log) for the current period and starts its worker.
+//------------------------------------------
+FILE *logRollOpenFile(logRoll *lr, pList *p, const char *suffix)
+{
+    time_t now = time(NULL);
+    time_t start;
+    int empty = FALSE;
+    int created = FALSE;
+
+    memset(lr, 0, sizeof(logRoll));
+    lr->p = p;
+    lr->suffix = suffix;
+    lr->period = (p->logRollSeconds > 0) ? p->logRollSeconds : LOGROLL_DAILY;
+    start = now - (now % lr->period);
+    lr->boundary = start + lr->period;
+    if((lr->curfp = openPeriodFile(lr, start, lr->curPath, &empty, &created)) == NULL)
+    {
+        return NULL;
+    }
+    lr->curEmpty = empty;
+    pthread_mutex_init(&lr->lock, NULL);
+    pthread_cond_init(&lr->wake, NULL);
+    if(pthread_create(&lr->worker, NULL, logRollWorker, lr) != 0)
+    {
+        perror("logroll: pthread_create()");
+    }
+    else
+    {
+        lr->running = TRUE;
+    }
+    return lr->curfp;
+}
+
+//------------------------------------------
+// logRollSwap()
+// Switches to the pre-opened file once a boundary has passed.
+//------------------------------------------
+FILE *logRollSwap(logRoll *lr, time_t now)
+{
+    time_t start = now - (now % lr->period);
+    FILE *fp = NULL;
+    int empty = FALSE;
+    int created = FALSE;
+    int slot;
+
+    pthread_mutex_lock(&lr->lock);
+    if(lr->qCount < LOGROLL_QUEUELEN)
+    {
+        slot = (lr->qHead + lr->qCount) % LOGROLL_QUEUELEN;
+        lr->closed[slot].fp = lr->curfp;
+        lr->closed[slot].compress = lr->p->compressLogs;
+        strcpy(lr->closed[slot].path, lr->curPath);
+        lr->qCount++;
+    }
+    else
+    {
+        // Worker is hopelessly behind; close without compressing rather than leak.
+        fclose(lr->curfp);
+    }
+    lr->curfp = NULL;
+    if(lr->nextfp != NULL && lr->nextStart == start)
+    {
+        lr->curfp = lr->nextfp;
+        empty = lr->nextEmpty;
+        strcpy(lr->curPath, lr->nextPath);
+    }
+    else if(lr->nextfp != NULL && lr->qCount < LOGROLL_QUEUELEN)
+    {
+        // Clock jumped past the prepared period.
+        slot = (lr->qHead + lr->qCount) % LOGROLL_QUEUELEN;
+        lr->closed[slot].fp = lr->nextfp;
+        lr->closed[slot].compress = FALSE;
+        strcpy(lr->closed[slot].path, lr->nextPath);
+        lr->qCount++;
+    }
+    else if(lr->nextfp != NULL)
+    {
+        fclose(lr->nextfp);
+    }
+    lr->nextfp = NULL;
+    lr->boundary = start + lr->period;
+    pthread_cond_signal(&lr->wake);
+    pthread_mutex_unlock(&lr->lock);
+
+    if(lr->curfp == NULL)
+    {
+        // Fallback: the worker did not get the file ready in time.
+        if((fp = openPeriodFile(lr, start, lr->curPath, &empty, &created)) == NULL)
+        {
+            fprintf(stdout, "\nNew Log File: %s\n", lr->curPath);
+            perror("\nLog File: ");
+            exit(1);
+        }
+        lr->curfp = fp;
+    }
+    lr->curEmpty = empty;
+    if(lr->isText)
+    {
+        if(empty)
+        {
+            writeLogHeader(lr->p, lr->curfp);
+        }
+        lr->p->outputFilePath = lr->curPath;
+    }
+    if(lr->p->verboseFlag)
+    {
+        fprintf(stdout, "\nNew Log File: %s\n", lr->curPath);
+    }
+    return lr->curfp;
+}
+
+//------------------------------------------
+// logRollClose()
+// Stops the worker after it has drained its queue and closes the current log.
+//------------------------------------------
+void logRollClose(logRoll *lr)
+{
+    if(lr->running)
+    {
+        pthread_mutex_lock(&lr->lock);
+        lr->stop = TRUE;
+        pthread_cond_signal(&lr->wake);
+        pthread_mutex_unlock(&lr->lock);
+        pthread_join(lr->worker, NULL);
+        lr->running = FALSE;
+    }
+    if(lr->curfp != NULL)
+    {
+        fclose(lr->curfp);
+        lr->curfp = NULL;
+    }
+}
@@ -0,0 +1,89 @@
+//=========================================================================
+// logroll.h
+//
+// Log file rollover management for the runMag utility.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100LOGROLL_h
+#define SWX3100LOGROLL_h
+
+#include <pthread.h>
+#include "main.h"
+
+#define LOGROLL_DAILY           86400
+#define LOGROLL_HOURLY          3600
+#define LOGROLL_PREOPEN_LEAD    30          // seconds before a boundary to open the next file
+#define LOGROLL_QUEUELEN        8           // closed files waiting for the background worker
+#define LOGROLL_NICE            19          // scheduling priority of the worker and compressor
+#define LOGROLL_COMPRESSCMD     "gzip"
+#define LOGROLL_TEXTSUFFIX      "runmag.log"
+
+//------------------------------------------
+// Closed file waiting for the worker
+//------------------------------------------
+typedef struct tag_closedLog
+{
+    FILE   *fp;
+    int     compress;
+    char    path[MAXPATHBUFLEN];
+} closedLog;
+
+//------------------------------------------
+// Log rollover state
+//------------------------------------------
+typedef struct tag_logRoll
+{
+    pList          *p;
+    const char     *suffix;                 // file name suffix, e.g. "runmag.log"
+    int             isText;                 // the primary text log (header, p->outputFilePath)
+    FILE           *curfp;
+    time_t          period;                 // rollover period in seconds
+    time_t          boundary;               // UTC start of the next period
+    int             curEmpty;
+    char            curPath[MAXPATHBUFLEN];
+
+    // Pre-opened file for the period starting at nextStart (owned by worker until swapped)
+    FILE           *nextfp;
+    time_t          nextStart;
+    int             nextEmpty;
+    int             nextCreated;
+    char            nextPath[MAXPATHBUFLEN];
+
+    closedLog       closed[LOGROLL_QUEUELEN];
+    int             qHead;
+    int             qCount;
+
+    int             stop;
+    int             running;
+    pthread_t       worker;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+} logRoll;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int parseLogRollPeriod(const char *spec);
+void writeLogHeader(pList *p, FILE *fp);
+FILE *logRollOpen(logRoll *lr, pList *p);
+FILE *logRollOpenFile(logRoll *lr, pList *p, const char *suffix);
+FILE *logRollSwap(logRoll *lr, time_t now);
+void logRollClose(logRoll *lr);
+
+//------------------------------------------
+// logRollCheck()
+// Called once per sample; the common case is a single compare.
+//------------------------------------------
+static inline FILE *logRollCheck(logRoll *lr, time_t now)
+{
+    if(now < lr->boundary)
+    {
+        return lr->curfp;
+    }
+    return logRollSwap(lr, now);
+}
+
+#endif // SWX3100LOGROLL_h
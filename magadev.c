@@ -0,0 +1,776 @@
+//=========================================================================
+// magadev.c
+//
+// Overlapping Allan deviation of runMag data, for comparing cycle counts,
+// NOS settings and boards.
+//
+// Reads runMag logs (CSV or JSON, any number of files) or follows the
+// live shared memory ring (-s) or TCP stream (-t), and prints
+//
+//      tau (s)   ADEV X   ADEV Y   ADEV Z (nT)   terms
+//
+// at logarithmically spaced taus, one table per data set, ready for
+// gnuplot (tables are separated by two blank lines, so "index n").
+//
+// Everything is done in one pass.  With x the running sum of the
+// samples,
+//
+//      AVAR(m) = < (x[k] - 2 x[k - m] + x[k - 2m])^2 > / (2 m^2)
+//
+// so each tau needs only x at three points.  x is kept in rings of
+// ADEV_RING entries at strides 1, 2, 4, ..; a tau of m samples uses the
+// finest stride that holds 2m, with m rounded to a multiple of it, and
+// is evaluated at every stride'th sample (fully overlapping below
+// ADEV_RING / 2 samples).  Memory is fixed whatever the length of the
+// data.  The samples are treated as contiguous; gaps in a log are not
+// detected.
+//
+// Each data set runs its three axes on their own threads, fed in blocks
+// by the thread parsing it; up to -j data sets run at once.  By default
+// each file is a data set; -c joins them (e.g. daily logs of one run).
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "shmring.h"
+#include "netserve.h"
+
+#define MAGADEV_VERSION "0.1.2"
+
+#define ADEV_RING               4096        // entries per stride level, power of 2
+#define ADEV_LEVELS             24
+#define ADEV_MAXTAUS            256
+#define ADEV_BLOCK              8192        // samples per block to the axis threads
+#define ADEV_QUEUE              4           // blocks in flight per data set
+#define ADEV_LINELEN            1024
+
+//------------------------------------------
+// Tau list, shared by every axis
+//------------------------------------------
+typedef struct tag_adevTaus
+{
+    int         count;
+    uint64_t    m[ADEV_MAXTAUS];            // samples
+    int         level[ADEV_MAXTAUS];        // stride 2^level
+    int         first[ADEV_LEVELS + 1];     // taus of each level: first[l] .. first[l + 1] - 1
+} adevTaus;
+
+//------------------------------------------
+// One axis
+//------------------------------------------
+typedef struct tag_adevAxis
+{
+    const adevTaus *taus;
+    double    (*ring)[ADEV_RING];           // ADEV_LEVELS rings, while running
+    double      x;
+    double      y0;
+    uint64_t    k;
+    double      sum[ADEV_MAXTAUS];
+    uint64_t    terms[ADEV_MAXTAUS];
+} adevAxis;
+
+//------------------------------------------
+// A block of samples
+//------------------------------------------
+typedef struct tag_adevBlock
+{
+    int         n;
+    double      v[3][ADEV_BLOCK];
+} adevBlock;
+
+//------------------------------------------
+// One data set
+//------------------------------------------
+typedef struct tag_adevSet
+{
+    char          **files;
+    int             nFiles;
+    const char     *name;
+    adevAxis        axis[3];
+    adevBlock      *blocks;                 // ADEV_QUEUE, while running
+    uint64_t        produced;
+    uint64_t        consumed[3];
+    int             done;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    uint64_t        samples;
+    uint64_t        badLines;
+    int             failed;
+} adevSet;
+
+//------------------------------------------
+// Axis thread argument
+//------------------------------------------
+typedef struct tag_adevWorker
+{
+    adevSet    *set;
+    int         axis;
+} adevWorker;
+
+//------------------------------------------
+// Options
+//------------------------------------------
+static adevTaus taus;
+static double tau0 = 1.0;
+static int skipCols = 2;
+static adevSet *sets;
+static int nSets;
+static int nextSet;
+static volatile sig_atomic_t stopFlag = 0;
+
+//------------------------------------------
+// onSignal()
+//------------------------------------------
+static void onSignal(int sig)
+{
+    (void)sig;
+    stopFlag = 1;
+}
+
+//------------------------------------------
+// buildTaus()
+// perDecade points per decade up to maxM samples.
+//------------------------------------------
+static void buildTaus(adevTaus *t, int perDecade, uint64_t maxM)
+{
+    uint64_t m;
+    uint64_t s;
+    int level;
+    int i;
+    int l;
+
+    t->count = 0;
+    for(i = 0; t->count < ADEV_MAXTAUS; i++)
+    {
+        m = (uint64_t)llround(pow(10.0, (double)i / perDecade));
+        if(m > maxM)
+        {
+            break;
+        }
+        for(level = 0, s = 1; m / s > ADEV_RING / 2 - 1; level++, s <<= 1)
+        {
+        }
+        if(level >= ADEV_LEVELS)
+        {
+            break;
+        }
+        m = m / s * s;
+        if(t->count > 0 && m <= t->m[t->count - 1])
+        {
+            continue;
+        }
+        t->m[t->count] = m;
+        t->level[t->count] = level;
+        t->count++;
+    }
+    // Taus come out in level order, so each level is a run.
+    for(l = 0, i = 0; l <= ADEV_LEVELS; l++)
+    {
+        while(i < t->count && t->level[i] < l)
+        {
+            i++;
+        }
+        t->first[l] = i;
+    }
+}
+
+//------------------------------------------
+// axisPush()
+//------------------------------------------
+static void axisPush(adevAxis *a, double y)
+{
+    const adevTaus *t = a->taus;
+    uint64_t idx;
+    uint64_t mm;
+    double *ring;
+    double d;
+    int l;
+    int i;
+
+    if(a->k == 0)
+    {
+        // Offset removed so x stays small over long runs.
+        a->y0 = y;
+    }
+    for(l = 0; l < ADEV_LEVELS && (a->k & ((1ULL << l) - 1)) == 0; l++)
+    {
+        idx = a->k >> l;
+        ring = a->ring[l];
+        ring[idx & (ADEV_RING - 1)] = a->x;
+        for(i = t->first[l]; i < t->first[l + 1]; i++)
+        {
+            mm = t->m[i] >> l;
+            if(idx < 2 * mm)
+            {
+                break;
+            }
+            d = a->x - 2.0 * ring[(idx - mm) & (ADEV_RING - 1)] + ring[(idx - 2 * mm) & (ADEV_RING - 1)];
+            a->sum[i] += d * d;
+            a->terms[i]++;
+        }
+    }
+    a->x += y - a->y0;
+    a->k++;
+}
+
+//------------------------------------------
+// axisThread()
+//------------------------------------------
+static void *axisThread(void *arg)
+{
+    adevWorker *w = (adevWorker *)arg;
+    adevSet *s = w->set;
+    adevAxis *a = &s->axis[w->axis];
+    adevBlock *b;
+    int i;
+
+    while(1)
+    {
+        pthread_mutex_lock(&s->lock);
+        while(s->consumed[w->axis] == s->produced && !s->done)
+        {
+            pthread_cond_wait(&s->cond, &s->lock);
+        }
+        if(s->consumed[w->axis] == s->produced)
+        {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+        b = &s->blocks[s->consumed[w->axis] % ADEV_QUEUE];
+        pthread_mutex_unlock(&s->lock);
+        for(i = 0; i < b->n; i++)
+        {
+            axisPush(a, b->v[w->axis][i]);
+        }
+        pthread_mutex_lock(&s->lock);
+        s->consumed[w->axis]++;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+    }
+    return NULL;
+}
+
+//------------------------------------------
+// setBlock()
+// The block to fill next, once every axis is done with it.
+//------------------------------------------
+static adevBlock *setBlock(adevSet *s)
+{
+    uint64_t oldest;
+    int i;
+
+    pthread_mutex_lock(&s->lock);
+    while(1)
+    {
+        oldest = s->consumed[0];
+        for(i = 1; i < 3; i++)
+        {
+            oldest = (s->consumed[i] < oldest) ? s->consumed[i] : oldest;
+        }
+        if(s->produced - oldest < ADEV_QUEUE)
+        {
+            break;
+        }
+        pthread_cond_wait(&s->cond, &s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return &s->blocks[s->produced % ADEV_QUEUE];
+}
+
+//------------------------------------------
+// setPublish()
+//------------------------------------------
+static void setPublish(adevSet *s, adevBlock *b)
+{
+    if(b->n == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    s->samples += b->n;
+    s->produced++;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+//------------------------------------------
+// setAdd()
+// Adds one sample (nT), publishing full blocks.
+//------------------------------------------
+static adevBlock *setAdd(adevSet *s, adevBlock *b, const double xyz[3])
+{
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        b->v[i][b->n] = xyz[i];
+    }
+    if(++b->n == ADEV_BLOCK)
+    {
+        setPublish(s, b);
+        b = setBlock(s);
+        b->n = 0;
+    }
+    return b;
+}
+
+//------------------------------------------
+// parseLine()
+// X, Y, Z in nT from one runMag log line (uT in the log).
+//------------------------------------------
+static int parseLine(const char *line, double xyz[3])
+{
+    static const char *keys[3] = { "\"x\":", "\"y\":", "\"z\":" };
+    const char *s;
+    char *end;
+    int i;
+
+    if(line[0] == '{')
+    {
+        for(i = 0; i < 3; i++)
+        {
+            if((s = strstr(line, keys[i])) == NULL)
+            {
+                return -1;
+            }
+            xyz[i] = strtod(s + 4, &end) * 1000.0;
+            if(end == s + 4)
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    if(line[0] != '"' && (line[0] < '0' || line[0] > '9'))
+    {
+        return -1;
+    }
+    // Time stamp and skipCols columns before X.
+    s = line;
+    for(i = 0; i <= skipCols; i++)
+    {
+        if((s = strchr(s, ',')) == NULL)
+        {
+            return -1;
+        }
+        s++;
+    }
+    for(i = 0; i < 3; i++)
+    {
+        xyz[i] = strtod(s, &end) * 1000.0;
+        if(end == s)
+        {
+            return -1;
+        }
+        s = end;
+        while(*s == ' ' || *s == ',')
+        {
+            s++;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// readFiles()
+//------------------------------------------
+static void readFiles(adevSet *s, adevBlock *b)
+{
+    char line[ADEV_LINELEN];
+    double xyz[3];
+    FILE *fp;
+    int f;
+
+    for(f = 0; f < s->nFiles && !stopFlag; f++)
+    {
+        if(!strcmp(s->files[f], "-"))
+        {
+            fp = stdin;
+        }
+        else if((fp = fopen(s->files[f], "r")) == NULL)
+        {
+            fprintf(stderr, "magadev: %s: %s\n", s->files[f], strerror(errno));
+            s->failed = 1;
+            continue;
+        }
+        while(!stopFlag && fgets(line, sizeof(line), fp) != NULL)
+        {
+            if(parseLine(line, xyz) != 0)
+            {
+                s->badLines++;
+                continue;
+            }
+            b = setAdd(s, b, xyz);
+        }
+        if(fp != stdin)
+        {
+            fclose(fp);
+        }
+    }
+    setPublish(s, b);
+}
+
+//------------------------------------------
+// readShm()
+//------------------------------------------
+static void readShm(adevSet *s, adevBlock *b, const char *name, uint64_t limit)
+{
+    shmRingReader r;
+    magRecord rec;
+
+    if(shmRingAttach(&r, name) != 0)
+    {
+        fprintf(stderr, "magadev: cannot attach to ring %s: %s\n", name, strerror(errno));
+        s->failed = 1;
+        return;
+    }
+    shmRingSeekTail(&r, 0);
+    while(!stopFlag && (limit == 0 || s->samples + b->n < limit))
+    {
+        if(!shmRingRead(&r, &rec))
+        {
+            usleep(10000);
+            continue;
+        }
+        b = setAdd(s, b, rec.xyz);
+    }
+    if(r.lost)
+    {
+        fprintf(stderr, "magadev: overrun, %llu samples lost\n", (unsigned long long)r.lost);
+    }
+    shmRingDetach(&r);
+    setPublish(s, b);
+}
+
+//------------------------------------------
+// readFull()
+// A signal (EINTR) ends the read like end of stream.
+//------------------------------------------
+static int readFull(int fd, uint8_t *buf, size_t len)
+{
+    ssize_t n;
+
+    while(len > 0)
+    {
+        if((n = read(fd, buf, len)) <= 0)
+        {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// readTcp()
+//------------------------------------------
+static void readTcp(adevSet *s, adevBlock *b, const char *spec, uint64_t limit)
+{
+    struct sockaddr_storage ss;
+    socklen_t len;
+    uint8_t buf[NETSERVE_FRAMELEN];
+    magRecord recs[NETSERVE_MAXBATCH];
+    netBatchHdr hdr;
+    uint32_t frameLen;
+    int fd;
+    int n;
+    int i;
+
+    if(netParseAddr(spec, 0, SOCK_STREAM, &ss, &len) != 0)
+    {
+        s->failed = 1;
+        return;
+    }
+    if((fd = socket(ss.ss_family, SOCK_STREAM, 0)) < 0 || connect(fd, (struct sockaddr *)&ss, len) != 0)
+    {
+        fprintf(stderr, "magadev: cannot connect to %s: %s\n", spec, strerror(errno));
+        s->failed = 1;
+        return;
+    }
+    while(!stopFlag && (limit == 0 || s->samples + b->n < limit) && readFull(fd, buf, 4) == 0)
+    {
+        frameLen = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+        if(frameLen > sizeof(buf) || readFull(fd, buf, frameLen) != 0)
+        {
+            break;
+        }
+        if((n = netBatchDecode(buf, frameLen, &hdr, recs, NETSERVE_MAXBATCH)) < 0)
+        {
+            fprintf(stderr, "magadev: bad batch from %s\n", spec);
+            break;
+        }
+        for(i = 0; i < n; i++)
+        {
+            b = setAdd(s, b, recs[i].xyz);
+        }
+    }
+    close(fd);
+    setPublish(s, b);
+}
+
+//------------------------------------------
+// runSet()
+// Parses one data set here while its axes run on three threads.
+//------------------------------------------
+static void runSet(adevSet *s, const char *shmName, const char *tcpSpec, uint64_t limit)
+{
+    adevWorker w[3];
+    pthread_t tid[3];
+    adevBlock *b;
+    int i;
+
+    if((s->blocks = malloc(ADEV_QUEUE * sizeof(adevBlock))) == NULL)
+    {
+        perror("magadev");
+        s->failed = 1;
+        return;
+    }
+    for(i = 0; i < 3; i++)
+    {
+        if((s->axis[i].ring = malloc(ADEV_LEVELS * sizeof(*s->axis[i].ring))) == NULL)
+        {
+            perror("magadev");
+            exit(1);
+        }
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    for(i = 0; i < 3; i++)
+    {
+        s->axis[i].taus = &taus;
+        w[i].set = s;
+        w[i].axis = i;
+        pthread_create(&tid[i], NULL, axisThread, &w[i]);
+    }
+    b = setBlock(s);
+    b->n = 0;
+    if(shmName != NULL)
+    {
+        readShm(s, b, shmName, limit);
+    }
+    else if(tcpSpec != NULL)
+    {
+        readTcp(s, b, tcpSpec, limit);
+    }
+    else
+    {
+        readFiles(s, b);
+    }
+    pthread_mutex_lock(&s->lock);
+    s->done = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    for(i = 0; i < 3; i++)
+    {
+        pthread_join(tid[i], NULL);
+        free(s->axis[i].ring);
+        s->axis[i].ring = NULL;
+    }
+    free(s->blocks);
+    s->blocks = NULL;
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+}
+
+//------------------------------------------
+// setRunner()
+// Pool thread: takes data sets until none are left.
+//------------------------------------------
+static void *setRunner(void *arg)
+{
+    int i;
+
+    (void)arg;
+    while((i = __atomic_fetch_add(&nextSet, 1, __ATOMIC_RELAXED)) < nSets)
+    {
+        runSet(&sets[i], NULL, NULL, 0);
+    }
+    return NULL;
+}
+
+//------------------------------------------
+// printSet()
+//------------------------------------------
+static void printSet(const adevSet *s)
+{
+    const adevAxis *a = s->axis;
+    double m;
+    int i;
+    int c;
+
+    fprintf(stdout, "# magadev: %s\n", s->name);
+    fprintf(stdout, "# %llu samples, tau0 %g s, %llu lines skipped\n", (unsigned long long)s->samples, tau0, (unsigned long long)s->badLines);
+    fprintf(stdout, "# %-12s  %-12s  %-12s  %-12s  %s\n", "tau_s", "adev_x_nT", "adev_y_nT", "adev_z_nT", "terms");
+    for(i = 0; i < taus.count; i++)
+    {
+        if(a[0].terms[i] == 0)
+        {
+            continue;
+        }
+        m = (double)taus.m[i];
+        fprintf(stdout, "  %-12g", m * tau0);
+        for(c = 0; c < 3; c++)
+        {
+            fprintf(stdout, "  %-12.6g", sqrt(a[c].sum[i] / (2.0 * m * m * a[c].terms[i])));
+        }
+        fprintf(stdout, "  %llu\n", (unsigned long long)a[0].terms[i]);
+    }
+}
+
+//------------------------------------------
+// usage()
+//------------------------------------------
+static void usage(const char *prog)
+{
+    fprintf(stdout, "\n%s Version = %s\n", prog, MAGADEV_VERSION);
+    fprintf(stdout, "\nUsage: %s [options] <log> [<log> ..]     ('-' reads stdin)\n", prog);
+    fprintf(stdout, "\nParameters:\n\n");
+    fprintf(stdout, "   -c                     :  Join the files into one data set.     [ default one per file ]\n");
+    fprintf(stdout, "   -d <n>                 :  Taus per decade.                      [ default 10 ]\n");
+    fprintf(stdout, "   -j <n>                 :  Data sets in parallel.                [ default CPUs / 3; each uses 3 more threads ]\n");
+    fprintf(stdout, "   -k <n>                 :  CSV columns between time and X.       [ default 2; 1 for runMag -r/-l, 0 for -m ]\n");
+    fprintf(stdout, "   -n <count>             :  Stop a live run after count samples.  [ default: at Ctrl-C ]\n");
+    fprintf(stdout, "   -r <Hz>                :  Sample rate.                          [ default 1, or the ring's rate with -s ]\n");
+    fprintf(stdout, "   -s <name>              :  Follow the runMag --shm ring.\n");
+    fprintf(stdout, "   -t <host:port>         :  Follow runMag --tcp.\n");
+    fprintf(stdout, "   -T <s>                 :  Largest tau.                          [ default 1e6 ]\n");
+    fprintf(stdout, "   -h or -?               :  Display this help.\n\n");
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    const char *shmName = NULL;
+    const char *tcpSpec = NULL;
+    struct sigaction sa;
+    shmRingReader r;
+    pthread_t *tid;
+    uint64_t limit = 0;
+    double maxTau = 1e6;
+    double rate = 0.0;
+    int perDecade = 10;
+    int jobs = 0;
+    int join = 0;
+    int failed = 0;
+    int c;
+    int i;
+
+    while((c = getopt(argc, argv, "?cd:hj:k:n:r:s:t:T:")) != -1)
+    {
+        switch(c)
+        {
+            case 'c':
+                join = 1;
+                break;
+            case 'd':
+                perDecade = atoi(optarg);
+                break;
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 'k':
+                skipCols = atoi(optarg);
+                break;
+            case 'n':
+                limit = strtoull(optarg, NULL, 10);
+                break;
+            case 'r':
+                rate = atof(optarg);
+                break;
+            case 's':
+                shmName = optarg;
+                break;
+            case 't':
+                tcpSpec = optarg;
+                break;
+            case 'T':
+                maxTau = atof(optarg);
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(perDecade < 1 || perDecade > 50 || skipCols < 0 || rate < 0.0 || maxTau <= 0.0 ||
+       (shmName == NULL && tcpSpec == NULL && optind >= argc))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if(rate == 0.0 && shmName != NULL && shmRingAttach(&r, shmName) == 0)
+    {
+        rate = r.hdr->sampleRate;
+        shmRingDetach(&r);
+    }
+    tau0 = (rate > 0.0) ? 1.0 / rate : 1.0;
+    buildTaus(&taus, perDecade, (uint64_t)(maxTau / tau0));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    nSets = (shmName != NULL || tcpSpec != NULL || join) ? 1 : argc - optind;
+    if((sets = calloc(nSets, sizeof(adevSet))) == NULL)
+    {
+        perror("magadev");
+        return 1;
+    }
+    for(i = 0; i < nSets; i++)
+    {
+        sets[i].files = &argv[optind + i];
+        sets[i].nFiles = join ? argc - optind : 1;
+        sets[i].name = (shmName != NULL) ? shmName : (tcpSpec != NULL) ? tcpSpec : argv[optind + i];
+    }
+    if(shmName != NULL || tcpSpec != NULL)
+    {
+        runSet(&sets[0], shmName, tcpSpec, limit);
+    }
+    else
+    {
+        if(jobs < 1)
+        {
+            jobs = (int)(sysconf(_SC_NPROCESSORS_ONLN) / 3);
+        }
+        jobs = (jobs < 1) ? 1 : (jobs > nSets) ? nSets : jobs;
+        if((tid = calloc(jobs, sizeof(pthread_t))) == NULL)
+        {
+            perror("magadev");
+            return 1;
+        }
+        for(i = 0; i < jobs; i++)
+        {
+            pthread_create(&tid[i], NULL, setRunner, NULL);
+        }
+        for(i = 0; i < jobs; i++)
+        {
+            pthread_join(tid[i], NULL);
+        }
+        free(tid);
+    }
+    for(i = 0; i < nSets; i++)
+    {
+        if(i > 0)
+        {
+            fprintf(stdout, "\n\n");
+        }
+        printSet(&sets[i]);
+        failed |= sets[i].failed;
+    }
+    free(sets);
+    return failed;
+}
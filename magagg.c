@@ -0,0 +1,860 @@
+//=========================================================================
+// magagg.c
+//
+// Merges the live streams of many runMag stations into one archive.
+//
+//      magagg -o <dir> -u 5800                 stations run --udp <this host>:5800
+//      magagg -o <dir> -T stations.txt         connect to each station's --tcp
+//
+// One thread, one epoll set: the UDP socket (read recvmmsg() at a time)
+// and a non-blocking connection per TCP station, reconnected when it
+// drops.  Stations are known by the site name in each batch header.
+//
+// Samples are put on the nearest UTC second.  A second is written once
+// the clock is -L seconds past it; anything for it after that is late and
+// counted, not written.  The archive is a daily CSV with a line per
+// station per second (more for stations above 1 Hz), in time order so
+// magseek can read it:
+//
+//      <dir>/merged-YYYYMMDD.log
+//      "19 Oct 2026 03:59:00", KD0EAG, 12, 24.50, 21.00, 20.0226, 1.4997, 50.0006
+//                              site,  ms from the second, rt, lt, X, Y, Z (uT)
+//
+// Per station metrics go to the -m JSON file every -I seconds: samples,
+// lost (gaps in the sample sequence), late, duplicates, restarts, mean
+// and minimum delay from sample time to arrival (the minimum is the
+// station's clock offset plus the fixed path delay) and age of the last
+// sample.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#define _GNU_SOURCE                 // recvmmsg()
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "netserve.h"
+
+#define MAGAGG_VERSION "0.1.2"
+
+#define MAGAGG_MAXSTATIONS      4096
+#define MAGAGG_HASHLEN          8192        // power of two, > 2 * MAGAGG_MAXSTATIONS
+#define MAGAGG_MAXTCP           1024
+#define MAGAGG_DEFLATE          5           // s
+#define MAGAGG_MAXLATE          600
+#define MAGAGG_AHEAD            10          // s a station's clock may be ahead of ours
+#define MAGAGG_DEFINTERVAL      10          // s between metrics files
+#define MAGAGG_RETRY            5           // s between TCP connection attempts
+#define MAGAGG_UDPBATCH         64          // datagrams per recvmmsg()
+#define MAGAGG_EVENTS           256
+
+//------------------------------------------
+// One station
+//------------------------------------------
+typedef struct tag_aggStation
+{
+    char        site[NETSERVE_SITELEN + 1];
+    uint64_t    nextSeq;
+    int         started;
+    uint64_t    samples;
+    uint64_t    lost;
+    uint64_t    late;
+    uint64_t    dupes;
+    uint64_t    restarts;
+    int64_t     lastTsNs;
+    double      delaySum;                   // this metrics interval, ms
+    uint64_t    delayN;
+    double      delayMin;
+    double      lastDelayMean;              // the last complete interval
+    double      lastDelayMin;
+} aggStation;
+
+//------------------------------------------
+// One sample waiting for its second
+//------------------------------------------
+typedef struct tag_aggEntry
+{
+    uint16_t    station;
+    int16_t     dtMs;                       // sample time - the second
+    uint32_t    flags;
+    float       rcTemp;
+    float       lcTemp;
+    double      xyz[3];                     // nT
+} aggEntry;
+
+//------------------------------------------
+// One UTC second
+//------------------------------------------
+typedef struct tag_aggSlot
+{
+    int64_t     key;                        // seconds since the epoch
+    aggEntry   *e;
+    int         n;
+    int         cap;
+} aggSlot;
+
+//------------------------------------------
+// A TCP station
+//------------------------------------------
+typedef struct tag_aggConn
+{
+    char        spec[128];
+    int         fd;
+    int         connecting;
+    time_t      retryAt;
+    size_t      have;
+    uint8_t     buf[NETSERVE_FRAMELEN];
+} aggConn;
+
+//------------------------------------------
+// Everything
+//------------------------------------------
+static aggStation *stations;
+static int nStations;
+static int16_t hashTab[MAGAGG_HASHLEN];
+static aggSlot *slots;
+static int nSlots;
+static int64_t nextEmit;                    // oldest second not yet written
+static aggConn *conns;
+static int nConns;
+static int epfd = -1;
+static int udpFd = -1;
+static int lateness = MAGAGG_DEFLATE;
+static const char *outDir = NULL;
+static FILE *outfp = NULL;
+static char outPath[1100];
+static int64_t outDay = -1;
+static uint64_t rows;
+static uint64_t written;
+static uint64_t unknown;                    // batches from beyond MAGAGG_MAXSTATIONS
+static uint64_t badBatches;
+static int verbose = 0;
+static volatile sig_atomic_t stopping = 0;
+
+//------------------------------------------
+// onSignal()
+//------------------------------------------
+static void onSignal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+//------------------------------------------
+// nowNs()
+//------------------------------------------
+static int64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//------------------------------------------
+// findStation()
+// Station number of a site, added the first time it is seen; -1 when
+// the table is full.
+//------------------------------------------
+static int findStation(const char *site)
+{
+    uint32_t h = 2166136261u;
+    const char *s;
+    int i;
+
+    for(s = site; *s != '\0'; s++)
+    {
+        h = (h ^ (uint8_t)*s) * 16777619u;
+    }
+    for(i = h & (MAGAGG_HASHLEN - 1); hashTab[i] >= 0; i = (i + 1) & (MAGAGG_HASHLEN - 1))
+    {
+        if(!strcmp(stations[hashTab[i]].site, site))
+        {
+            return hashTab[i];
+        }
+    }
+    if(nStations >= MAGAGG_MAXSTATIONS)
+    {
+        return -1;
+    }
+    memset(&stations[nStations], 0, sizeof(aggStation));
+    strcpy(stations[nStations].site, site);
+    stations[nStations].delayMin = 1e300;
+    hashTab[i] = (int16_t)nStations;
+    if(verbose)
+    {
+        fprintf(stderr, "magagg: new station %s\n", site);
+    }
+    return nStations++;
+}
+
+//------------------------------------------
+// addSample()
+//------------------------------------------
+static void addSample(int st, const magRecord *rec, int64_t arrivalNs)
+{
+    aggStation *s = &stations[st];
+    aggSlot *slot;
+    aggEntry *e;
+    int64_t key = (rec->tsNs + 500000000LL) / 1000000000LL;
+    double delay = (arrivalNs - rec->tsNs) / 1e6;
+
+    // Loss and duplicates from the station's own sample numbers.  Without
+    // --journal they start again at 0 when runMag restarts; time going
+    // forward tells that from a repeat.
+    if(s->started && rec->seq < s->nextSeq)
+    {
+        if(rec->tsNs <= s->lastTsNs)
+        {
+            s->dupes++;
+            return;
+        }
+        s->restarts++;
+    }
+    else if(s->started && rec->seq > s->nextSeq)
+    {
+        s->lost += rec->seq - s->nextSeq;
+    }
+    s->started = 1;
+    s->nextSeq = rec->seq + 1;
+    s->samples++;
+    s->lastTsNs = rec->tsNs;
+    s->delaySum += delay;
+    s->delayN++;
+    s->delayMin = (delay < s->delayMin) ? delay : s->delayMin;
+
+    if(key < nextEmit || key >= nextEmit + nSlots)
+    {
+        // Too late, or too far ahead of our clock to hold.
+        s->late++;
+        return;
+    }
+    slot = &slots[key % nSlots];
+    if(slot->key != key)
+    {
+        slot->key = key;
+        slot->n = 0;
+    }
+    if(slot->n == slot->cap)
+    {
+        slot->cap = slot->cap ? slot->cap * 2 : 64;
+        if((e = realloc(slot->e, slot->cap * sizeof(aggEntry))) == NULL)
+        {
+            perror("magagg");
+            exit(1);
+        }
+        slot->e = e;
+    }
+    e = &slot->e[slot->n++];
+    e->station = (uint16_t)st;
+    e->dtMs = (int16_t)((rec->tsNs - key * 1000000000LL) / 1000000LL);
+    e->flags = rec->flags;
+    e->rcTemp = rec->rcTemp;
+    e->lcTemp = rec->lcTemp;
+    memcpy(e->xyz, rec->xyz, sizeof(e->xyz));
+}
+
+//------------------------------------------
+// addBatch()
+//------------------------------------------
+static void addBatch(const uint8_t *buf, size_t len, int64_t arrivalNs)
+{
+    magRecord recs[NETSERVE_MAXBATCH];
+    netBatchHdr hdr;
+    int st;
+    int n;
+    int i;
+
+    if((n = netBatchDecode(buf, len, &hdr, recs, NETSERVE_MAXBATCH)) < 0)
+    {
+        badBatches++;
+        return;
+    }
+    if((st = findStation(hdr.site)) < 0)
+    {
+        unknown++;
+        return;
+    }
+    for(i = 0; i < n; i++)
+    {
+        addSample(st, &recs[i], arrivalNs);
+    }
+}
+
+//------------------------------------------
+// bySiteTime()
+// A station above 1 Hz has several samples in a second; they stay in
+// time order.
+//------------------------------------------
+static int bySiteTime(const void *a, const void *b)
+{
+    const aggEntry *ea = (const aggEntry *)a;
+    const aggEntry *eb = (const aggEntry *)b;
+    int c = strcmp(stations[ea->station].site, stations[eb->station].site);
+
+    return c ? c : ea->dtMs - eb->dtMs;
+}
+
+//------------------------------------------
+// openDay()
+//------------------------------------------
+static int openDay(int64_t key)
+{
+    struct tm utcTime;
+    time_t t = (time_t)key;
+    long size;
+
+    if(outfp != NULL)
+    {
+        fclose(outfp);
+        outfp = NULL;
+    }
+    gmtime_r(&t, &utcTime);
+    snprintf(outPath, sizeof(outPath), "%s/merged-%04i%02i%02i.log", outDir, utcTime.tm_year + 1900, utcTime.tm_mon + 1, utcTime.tm_mday);
+    if((outfp = fopen(outPath, "a")) == NULL)
+    {
+        fprintf(stderr, "magagg: %s: %s\n", outPath, strerror(errno));
+        return -1;
+    }
+    if((size = ftell(outfp)) == 0)
+    {
+        fprintf(outfp, "\"time\", \"site\", \"dt_ms\", \"rtemp\", \"ltemp\", \"x\", \"y\", \"z\"\n");
+    }
+    outDay = key / 86400;
+    return 0;
+}
+
+//------------------------------------------
+// emitSecond()
+//------------------------------------------
+static void emitSecond(int64_t key)
+{
+    aggSlot *slot = &slots[key % nSlots];
+    char utcStr[32];
+    struct tm utcTime;
+    time_t t = (time_t)key;
+    aggEntry *e;
+    int i;
+
+    if(slot->key != key || slot->n == 0)
+    {
+        return;
+    }
+    if(key / 86400 != outDay && openDay(key) != 0)
+    {
+        slot->n = 0;
+        return;
+    }
+    gmtime_r(&t, &utcTime);
+    strftime(utcStr, sizeof(utcStr), "%d %b %Y %T", &utcTime);
+    qsort(slot->e, slot->n, sizeof(aggEntry), bySiteTime);
+    for(i = 0; i < slot->n; i++)
+    {
+        e = &slot->e[i];
+        fprintf(outfp, "\"%s\", %s, %i, ", utcStr, stations[e->station].site, e->dtMs);
+        if(e->flags & MAGREC_F_RTEMP)
+        {
+            fprintf(outfp, "%.2f, ", e->rcTemp);
+        }
+        else
+        {
+            fprintf(outfp, "\"ERROR\", ");
+        }
+        if(e->flags & MAGREC_F_LTEMP)
+        {
+            fprintf(outfp, "%.2f, ", e->lcTemp);
+        }
+        else
+        {
+            fprintf(outfp, "\"ERROR\", ");
+        }
+        fprintf(outfp, "%.4f, %.4f, %.4f\n", e->xyz[0] / 1000, e->xyz[1] / 1000, e->xyz[2] / 1000);
+    }
+    fflush(outfp);
+    rows++;
+    written += slot->n;
+    slot->n = 0;
+}
+
+//------------------------------------------
+// emitUpTo()
+// Writes every second before 'until'.
+//------------------------------------------
+static void emitUpTo(int64_t until)
+{
+    for(; nextEmit < until; nextEmit++)
+    {
+        emitSecond(nextEmit);
+    }
+}
+
+//------------------------------------------
+// writeMetrics()
+// Rewrites the metrics file and starts a new interval.
+//------------------------------------------
+static void writeMetrics(const char *path, int64_t now)
+{
+    char tmpPath[1100];
+    aggStation *s;
+    FILE *fp = NULL;
+    int i;
+
+    if(path != NULL)
+    {
+        snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+        if((fp = fopen(tmpPath, "w")) == NULL)
+        {
+            fprintf(stderr, "magagg: %s: %s\n", tmpPath, strerror(errno));
+        }
+    }
+    if(fp != NULL)
+    {
+        fprintf(fp, "{ \"time\":%lld, \"stations\":%i, \"rows\":%llu, \"written\":%llu, \"bad_batches\":%llu, \"unknown\":%llu, \"station\":[\n",
+                (long long)(now / 1000000), nStations, (unsigned long long)rows, (unsigned long long)written,
+                (unsigned long long)badBatches, (unsigned long long)unknown);
+    }
+    for(i = 0; i < nStations; i++)
+    {
+        s = &stations[i];
+        if(s->delayN > 0)
+        {
+            s->lastDelayMean = s->delaySum / s->delayN;
+            s->lastDelayMin = s->delayMin;
+        }
+        if(fp != NULL)
+        {
+            fprintf(fp, "  { \"site\":\"%s\", \"samples\":%llu, \"lost\":%llu, \"late\":%llu, \"dupes\":%llu, \"restarts\":%llu, "
+                    "\"delay_ms\":%.1f, \"offset_ms\":%.1f, \"age_s\":%.1f }%s\n",
+                    s->site, (unsigned long long)s->samples, (unsigned long long)s->lost, (unsigned long long)s->late,
+                    (unsigned long long)s->dupes, (unsigned long long)s->restarts, s->lastDelayMean, s->lastDelayMin,
+                    (now - s->lastTsNs) / 1e9, (i < nStations - 1) ? "," : "");
+        }
+        s->delaySum = 0.0;
+        s->delayN = 0;
+        s->delayMin = 1e300;
+    }
+    if(fp != NULL)
+    {
+        fprintf(fp, "] }\n");
+        if(fclose(fp) != 0 || rename(tmpPath, path) != 0)
+        {
+            fprintf(stderr, "magagg: %s not written\n", path);
+        }
+    }
+}
+
+//------------------------------------------
+// readUdp()
+//------------------------------------------
+static void readUdp(void)
+{
+    static uint8_t buf[MAGAGG_UDPBATCH][NETSERVE_FRAMELEN];
+    struct mmsghdr msg[MAGAGG_UDPBATCH];
+    struct iovec iov[MAGAGG_UDPBATCH];
+    int64_t arrival;
+    int n;
+    int i;
+
+    memset(msg, 0, sizeof(msg));
+    for(i = 0; i < MAGAGG_UDPBATCH; i++)
+    {
+        iov[i].iov_base = buf[i];
+        iov[i].iov_len = NETSERVE_FRAMELEN;
+        msg[i].msg_hdr.msg_iov = &iov[i];
+        msg[i].msg_hdr.msg_iovlen = 1;
+    }
+    while((n = recvmmsg(udpFd, msg, MAGAGG_UDPBATCH, MSG_DONTWAIT, NULL)) > 0)
+    {
+        arrival = nowNs();
+        for(i = 0; i < n; i++)
+        {
+            addBatch(buf[i], msg[i].msg_len, arrival);
+        }
+        if(n < MAGAGG_UDPBATCH)
+        {
+            break;
+        }
+    }
+}
+
+//------------------------------------------
+// closeConn()
+//------------------------------------------
+static void closeConn(aggConn *c, const char *why)
+{
+    if(c->fd >= 0)
+    {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        if(verbose)
+        {
+            fprintf(stderr, "magagg: %s: %s\n", c->spec, why);
+        }
+    }
+    c->fd = -1;
+    c->have = 0;
+    c->retryAt = time(NULL) + MAGAGG_RETRY;
+}
+
+//------------------------------------------
+// startConn()
+//------------------------------------------
+static void startConn(aggConn *c, int index)
+{
+    struct sockaddr_storage ss;
+    struct epoll_event ev;
+    socklen_t len;
+
+    c->retryAt = time(NULL) + MAGAGG_RETRY;
+    if(netParseAddr(c->spec, 0, SOCK_STREAM, &ss, &len) != 0 ||
+       (c->fd = socket(ss.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        c->fd = -1;
+        return;
+    }
+    if(connect(c->fd, (struct sockaddr *)&ss, len) != 0 && errno != EINPROGRESS)
+    {
+        closeConn(c, strerror(errno));
+        return;
+    }
+    c->connecting = TRUE;
+    c->have = 0;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u32 = (uint32_t)index + 1;
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev) != 0)
+    {
+        closeConn(c, strerror(errno));
+    }
+}
+
+//------------------------------------------
+// serviceConn()
+// Reads whole frames: a 32 bit length, then a batch.
+//------------------------------------------
+static void serviceConn(aggConn *c, uint32_t events)
+{
+    struct epoll_event ev;
+    socklen_t len = sizeof(int);
+    uint32_t frameLen;
+    int64_t arrival;
+    ssize_t n;
+    size_t used;
+    int err = 0;
+
+    if(c->connecting)
+    {
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if(err != 0 || (events & (EPOLLERR | EPOLLHUP)))
+        {
+            closeConn(c, strerror(err ? err : ECONNREFUSED));
+            return;
+        }
+        c->connecting = FALSE;
+        ev.events = EPOLLIN;
+        ev.data.u32 = (uint32_t)(c - conns) + 1;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        if(verbose)
+        {
+            fprintf(stderr, "magagg: %s: connected\n", c->spec);
+        }
+    }
+    while((n = read(c->fd, c->buf + c->have, sizeof(c->buf) - c->have)) > 0)
+    {
+        c->have += n;
+        arrival = nowNs();
+        for(used = 0; c->have - used >= 4; used += 4 + frameLen)
+        {
+            frameLen = c->buf[used] | (c->buf[used + 1] << 8) | (c->buf[used + 2] << 16) | ((uint32_t)c->buf[used + 3] << 24);
+            if(frameLen > sizeof(c->buf) - 4)
+            {
+                closeConn(c, "bad frame");
+                return;
+            }
+            if(c->have - used < 4 + frameLen)
+            {
+                break;
+            }
+            addBatch(c->buf + used + 4, frameLen, arrival);
+        }
+        memmove(c->buf, c->buf + used, c->have - used);
+        c->have -= used;
+    }
+    if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+        closeConn(c, (n == 0) ? "closed" : strerror(errno));
+    }
+}
+
+//------------------------------------------
+// openUdp()
+// As magtail: bind, and join the group if it is a multicast address.
+//------------------------------------------
+static int openUdp(const char *spec)
+{
+    struct sockaddr_storage ss;
+    struct epoll_event ev;
+    socklen_t len;
+    int rcvBuf = 4 << 20;
+    int on = 1;
+
+    if(netParseAddr(spec, 1, SOCK_DGRAM, &ss, &len) != 0 ||
+       (udpFd = socket(ss.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        return -1;
+    }
+    setsockopt(udpFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    // Hundreds of stations can land in one scheduling slice.
+    setsockopt(udpFd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+    if(bind(udpFd, (struct sockaddr *)&ss, len) != 0)
+    {
+        fprintf(stderr, "magagg: cannot bind %s: %s\n", spec, strerror(errno));
+        return -1;
+    }
+    if(ss.ss_family == AF_INET && IN_MULTICAST(ntohl(((struct sockaddr_in *)&ss)->sin_addr.s_addr)))
+    {
+        struct ip_mreq mreq;
+
+        mreq.imr_multiaddr = ((struct sockaddr_in *)&ss)->sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        setsockopt(udpFd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
+    else if(ss.ss_family == AF_INET6 && IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *)&ss)->sin6_addr))
+    {
+        struct ipv6_mreq mreq;
+
+        mreq.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&ss)->sin6_addr;
+        mreq.ipv6mr_interface = 0;
+        setsockopt(udpFd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq));
+    }
+    ev.events = EPOLLIN;
+    ev.data.u32 = 0;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, udpFd, &ev);
+}
+
+//------------------------------------------
+// addConn()
+//------------------------------------------
+static int addConn(const char *spec)
+{
+    if(nConns >= MAGAGG_MAXTCP || strlen(spec) >= sizeof(conns[0].spec))
+    {
+        fprintf(stderr, "magagg: too many stations or bad address: %s\n", spec);
+        return -1;
+    }
+    snprintf(conns[nConns].spec, sizeof(conns[nConns].spec), "%s", spec);
+    conns[nConns].fd = -1;
+    nConns++;
+    return 0;
+}
+
+//------------------------------------------
+// readStationList()
+// One host:port per line; blank lines and # comments are skipped.
+//------------------------------------------
+static int readStationList(const char *path)
+{
+    char line[256];
+    char spec[128];
+    FILE *fp;
+
+    if((fp = fopen(path, "r")) == NULL)
+    {
+        fprintf(stderr, "magagg: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        if(sscanf(line, "%127s", spec) == 1 && spec[0] != '#' && addConn(spec) != 0)
+        {
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+//------------------------------------------
+// usage()
+//------------------------------------------
+static void usage(const char *prog)
+{
+    fprintf(stdout, "\n%s Version = %s\n", prog, MAGAGG_VERSION);
+    fprintf(stdout, "\nUsage: %s -o <dir> [-u <[addr:]port>] [-t <host:port> ..] [-T <file>] [options]\n", prog);
+    fprintf(stdout, "\nParameters:\n\n");
+    fprintf(stdout, "   -o <dir>               :  Write <dir>/merged-YYYYMMDD.log.\n");
+    fprintf(stdout, "   -u <[addr:]port>       :  Receive runMag --udp batches.         [ addr may be a multicast group ]\n");
+    fprintf(stdout, "   -t <host:port>         :  Connect to a runMag --tcp station.    [ repeat for more ]\n");
+    fprintf(stdout, "   -T <file>              :  Connect to each host:port in file.\n");
+    fprintf(stdout, "   -L <s>                 :  Lateness window.                      [ default %i, at most %i ]\n", MAGAGG_DEFLATE, MAGAGG_MAXLATE);
+    fprintf(stdout, "   -m <file>              :  Per station metrics, JSON.\n");
+    fprintf(stdout, "   -I <s>                 :  Metrics interval.                     [ default %i ]\n", MAGAGG_DEFINTERVAL);
+    fprintf(stdout, "   -v                     :  Report stations and connections.\n");
+    fprintf(stdout, "   -h or -?               :  Display this help.\n\n");
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    struct epoll_event ev[MAGAGG_EVENTS];
+    struct sigaction sa;
+    const char *udpSpec = NULL;
+    const char *metricsPath = NULL;
+    int64_t now;
+    int64_t nextMetrics;
+    int64_t wakeNs;
+    time_t sec;
+    int interval = MAGAGG_DEFINTERVAL;
+    int timeout;
+    int n;
+    int c;
+    int i;
+
+    stations = calloc(MAGAGG_MAXSTATIONS, sizeof(aggStation));
+    conns = calloc(MAGAGG_MAXTCP, sizeof(aggConn));
+    if(stations == NULL || conns == NULL)
+    {
+        perror("magagg");
+        return 1;
+    }
+    while((c = getopt(argc, argv, "?hI:L:m:o:t:T:u:v")) != -1)
+    {
+        switch(c)
+        {
+            case 'I':
+                interval = atoi(optarg);
+                break;
+            case 'L':
+                lateness = atoi(optarg);
+                break;
+            case 'm':
+                metricsPath = optarg;
+                break;
+            case 'o':
+                outDir = optarg;
+                break;
+            case 't':
+                if(addConn(optarg) != 0)
+                {
+                    return 1;
+                }
+                break;
+            case 'T':
+                if(readStationList(optarg) != 0)
+                {
+                    return 1;
+                }
+                break;
+            case 'u':
+                udpSpec = optarg;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(outDir == NULL || (udpSpec == NULL && nConns == 0) || lateness < 0 || lateness > MAGAGG_MAXLATE || interval < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    memset(hashTab, 0xff, sizeof(hashTab));
+    nSlots = lateness + MAGAGG_AHEAD + 2;
+    if((slots = calloc(nSlots, sizeof(aggSlot))) == NULL || (epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        perror("magagg");
+        return 1;
+    }
+    for(i = 0; i < nSlots; i++)
+    {
+        slots[i].key = -1;
+    }
+    if(udpSpec != NULL && openUdp(udpSpec) != 0)
+    {
+        return 1;
+    }
+    for(i = 0; i < nConns; i++)
+    {
+        startConn(&conns[i], i);
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    now = nowNs();
+    nextEmit = now / 1000000000LL - lateness;
+    nextMetrics = now + (int64_t)interval * 1000000000LL;
+    while(!stopping)
+    {
+        // Wake for the next second to close, the metrics, or a retry.
+        now = nowNs();
+        wakeNs = (nextEmit + lateness + 1) * 1000000000LL;
+        wakeNs = (nextMetrics < wakeNs) ? nextMetrics : wakeNs;
+        timeout = (wakeNs > now) ? (int)((wakeNs - now) / 1000000LL) + 1 : 0;
+        timeout = (nConns > 0 && timeout > 1000) ? 1000 : timeout;
+        if((n = epoll_wait(epfd, ev, MAGAGG_EVENTS, timeout)) < 0 && errno != EINTR)
+        {
+            perror("magagg: epoll_wait()");
+            break;
+        }
+        for(i = 0; i < n; i++)
+        {
+            if(ev[i].data.u32 == 0)
+            {
+                readUdp();
+            }
+            else if(conns[ev[i].data.u32 - 1].fd >= 0)
+            {
+                serviceConn(&conns[ev[i].data.u32 - 1], ev[i].events);
+            }
+        }
+        now = nowNs();
+        emitUpTo(now / 1000000000LL - lateness);
+        if(now >= nextMetrics)
+        {
+            writeMetrics(metricsPath, now);
+            nextMetrics += (int64_t)interval * 1000000000LL;
+        }
+        for(i = 0, sec = time(NULL); i < nConns; i++)
+        {
+            if(conns[i].fd < 0 && sec >= conns[i].retryAt)
+            {
+                startConn(&conns[i], i);
+            }
+        }
+    }
+    // Everything received is written, however recent.
+    emitUpTo(nextEmit + nSlots);
+    writeMetrics(metricsPath, nowNs());
+    fprintf(stderr, "magagg: %i stations, %llu seconds, %llu samples written, %llu bad batches\n",
+            nStations, (unsigned long long)rows, (unsigned long long)written, (unsigned long long)badBatches);
+    for(i = 0; i < nConns; i++)
+    {
+        if(conns[i].fd >= 0)
+        {
+            close(conns[i].fd);
+        }
+    }
+    if(outfp != NULL)
+    {
+        fclose(outfp);
+    }
+    return 0;
+}
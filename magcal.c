@@ -0,0 +1,214 @@
+//=========================================================================
+// magcal.c
+//
+// Batch decode and calibration of RM3100 samples for the runMag utility.
+// See magcal.h for the calibration model and file format.
+//
+// Decoding works on a flat stream of 24 bit counts: each 16 byte load is
+// shuffled so four big-endian counts land in the top three bytes of four
+// 32 bit lanes, and an arithmetic shift right by 8 sign-extends them.
+// __builtin_shuffle becomes TBL on ARM and PSHUFB on x86 with SSSE3; on
+// x86 the kernel is cloned so the SSSE3 version is picked at run time.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <string.h>
+#include "magcal.h"
+#include "runMag.h"
+
+#if defined(__x86_64__) && !defined(__clang__)
+#define MAGCAL_CLONES   __attribute__((target_clones("default", "ssse3")))
+#else
+#define MAGCAL_CLONES
+#endif
+
+//------------------------------------------
+// decode24()
+//------------------------------------------
+static inline int32_t decode24(const uint8_t *b)
+{
+    return (int32_t)(((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8)) >> 8;
+}
+
+//------------------------------------------
+// magDecode()
+// Converts n raw 9 byte samples to 3 * n sign-extended counts.
+//------------------------------------------
+MAGCAL_CLONES
+void magDecode(const uint8_t *bytes, int32_t *raw, int n)
+{
+    int total = 3 * n;
+    int k = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Lane byte 0 is junk that the shift discards.
+    const v16qu mask = { 2, 2, 1, 0,  5, 5, 4, 3,  8, 8, 7, 6,  11, 11, 10, 9 };
+    v16qu in;
+    v4si out;
+
+    // Each step reads 16 bytes but uses 12; stop while a full load still fits.
+    for(; k + 4 <= total && 3 * k + 16 <= 3 * total; k += 4)
+    {
+        memcpy(&in, bytes + 3 * k, sizeof(in));
+        out = (v4si)__builtin_shuffle(in, mask) >> 8;
+        memcpy(raw + k, &out, sizeof(out));
+    }
+#endif
+    for(; k < total; k++)
+    {
+        raw[k] = decode24(bytes + 3 * k);
+    }
+}
+
+//------------------------------------------
+// setMatrix()
+//------------------------------------------
+static void setMatrix(magCal *c, double m[3][3], double off[3])
+{
+    int i;
+    int j;
+
+    for(j = 0; j < 3; j++)
+    {
+        c->col[j] = (v4sf){ (float)m[0][j], (float)m[1][j], (float)m[2][j], 0.0f };
+        c->offset[j] = (float)off[j];
+        c->dOffset[j] = off[j];
+        for(i = 0; i < 3; i++)
+        {
+            c->dMatrix[i][j] = m[i][j];
+        }
+    }
+}
+
+//------------------------------------------
+// magCalInitUnit()
+// Unit scale and no iron correction, for input already in nT.
+//------------------------------------------
+void magCalInitUnit(magCal *c)
+{
+    double unit[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+    double zero[3] = { 0.0, 0.0, 0.0 };
+    int i;
+
+    memset(c, 0, sizeof(magCal));
+    for(i = 0; i < 3; i++)
+    {
+        c->dScale[i] = 1.0;
+        c->scale[i] = 1.0f;
+    }
+    setMatrix(c, unit, zero);
+}
+
+//------------------------------------------
+// magCalInit()
+// Scale from the current cycle counts and NOS value; no iron correction.
+//------------------------------------------
+void magCalInit(magCal *c, pList *p)
+{
+    int cc[3] = { p->cc_x, p->cc_y, p->cc_z };
+    int nos = (p->NOSRegValue > 0) ? p->NOSRegValue : 1;
+    int i;
+
+    magCalInitUnit(c);
+    for(i = 0; i < 3; i++)
+    {
+        // counts / NOS / gain is uT; * 1000 for nT.
+        c->dScale[i] = 1000.0 / (nos * getCCGainExact(cc[i]));
+        c->scale[i] = (float)c->dScale[i];
+    }
+}
+
+//------------------------------------------
+// magCalLoad()
+//------------------------------------------
+int magCalLoad(magCal *c, const char *path)
+{
+    double m[3][3];
+    double off[3];
+    char line[256];
+    char key[16];
+    int lineNo = 0;
+    int i;
+    int j;
+    FILE *fp;
+
+    for(i = 0; i < 3; i++)
+    {
+        off[i] = c->dOffset[i];
+        for(j = 0; j < 3; j++)
+        {
+            m[i][j] = c->dMatrix[i][j];
+        }
+    }
+    if((fp = fopen(path, "r")) == NULL)
+    {
+        perror("Calibration file");
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        lineNo++;
+        if(sscanf(line, "%15s", key) != 1 || key[0] == '#')
+        {
+            continue;
+        }
+        if(!strcmp(key, "offset") &&
+           sscanf(line, "%*s %lf %lf %lf", &off[0], &off[1], &off[2]) == 3)
+        {
+            continue;
+        }
+        if(!strcmp(key, "matrix") &&
+           sscanf(line, "%*s %lf %lf %lf %lf %lf %lf %lf %lf %lf",
+                  &m[0][0], &m[0][1], &m[0][2], &m[1][0], &m[1][1], &m[1][2], &m[2][0], &m[2][1], &m[2][2]) == 9)
+        {
+            continue;
+        }
+        fprintf(stderr, "Calibration file %s line %i: expected 'offset' with 3 or 'matrix' with 9 values.\n", path, lineNo);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    setMatrix(c, m, off);
+    return 0;
+}
+
+//------------------------------------------
+// magCalApply()
+// Converts n samples of counts to calibrated nT.
+//------------------------------------------
+MAGCAL_CLONES
+void magCalApply(const magCal *c, const int32_t *raw, double *xyz, int n)
+{
+    v4sf v;
+    v4sf b;
+    int i;
+
+    for(i = 0; i < n; i++, raw += 3, xyz += 3)
+    {
+        v = (v4sf){ (float)raw[0], (float)raw[1], (float)raw[2], 0.0f } * c->scale - c->offset;
+        b = c->col[0] * v[0] + c->col[1] * v[1] + c->col[2] * v[2];
+        xyz[0] = b[0];
+        xyz[1] = b[1];
+        xyz[2] = b[2];
+    }
+}
+
+//------------------------------------------
+// magCalApplyCounts()
+// Same for one filtered (fractional) sample, in double precision.
+//------------------------------------------
+void magCalApplyCounts(const magCal *c, const double *counts, double *xyz)
+{
+    double v[3];
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        v[i] = counts[i] * c->dScale[i] - c->dOffset[i];
+    }
+    for(i = 0; i < 3; i++)
+    {
+        xyz[i] = c->dMatrix[i][0] * v[0] + c->dMatrix[i][1] * v[1] + c->dMatrix[i][2] * v[2];
+    }
+}
@@ -0,0 +1,59 @@
+//=========================================================================
+// magcal.h
+//
+// Batch decode and calibration of RM3100 samples for the runMag utility.
+//
+// A raw sample is the 9 bytes read from the XYZ result registers: three
+// big-endian 24 bit two's complement counts.  Calibrated field is
+//
+//      B = M * (scale * counts - offset)           nT
+//
+// where scale = 1000 / (NOS * gain) uses the exact PNI gain equation,
+// offset is the hard iron offset and M the soft iron matrix, both read
+// from an optional calibration file:
+//
+//      # comment
+//      offset  <bx> <by> <bz>                      nT
+//      matrix  <m00> <m01> <m02>  <m10> <m11> <m12>  <m20> <m21> <m22>
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100MAGCAL_h
+#define SWX3100MAGCAL_h
+
+#include <stdint.h>
+#include "main.h"
+
+#define MAGCAL_RAWLEN           9           // bytes per raw sample
+
+// X, Y, Z and a pad lane; GCC maps these to NEON/SSE.
+typedef float   v4sf __attribute__((vector_size(16)));
+typedef int32_t v4si __attribute__((vector_size(16)));
+typedef uint8_t v16qu __attribute__((vector_size(16)));
+
+//------------------------------------------
+// Calibration
+//------------------------------------------
+typedef struct tag_magCal
+{
+    v4sf        scale;                      // nT per count
+    v4sf        offset;                     // hard iron, nT
+    v4sf        col[3];                     // soft iron matrix, by column
+    double      dScale[3];                  // double copies for filtered counts
+    double      dOffset[3];
+    double      dMatrix[3][3];
+} magCal;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+void magDecode(const uint8_t *bytes, int32_t *raw, int n);
+void magCalInitUnit(magCal *c);
+void magCalInit(magCal *c, pList *p);
+int magCalLoad(magCal *c, const char *path);
+void magCalApply(const magCal *c, const int32_t *raw, double *xyz, int n);
+void magCalApplyCounts(const magCal *c, const double *counts, double *xyz);
+
+#endif // SWX3100MAGCAL_h
@@ -0,0 +1,1313 @@
+//=========================================================================
+// magcol.c
+//
+// Columnar archive of runMag logs, and range queries over it.
+//
+//      magcol -o <archive> [-B n] [-k n] <log> [<log> ..]         pack
+//      magcol [-b t] [-e t] [-g s] [-c cols] [-s f] [-w f] <archive>
+//
+// Packing splits the samples into blocks of -B samples (never across a
+// UTC hour) and stores each column of a block on its own: time in ms,
+// X, Y, Z in 0.1 nT (the log's resolution) and the two temperatures in
+// 0.01 C.  A column is delta coded (time delta of delta), zigzagged and
+// written as varints, so a quiet 1 Hz axis takes one or two bytes a
+// sample.  An index at the end of the file holds each block's time span
+// and, per column, its size, count, min, max and sum.
+//
+// A query maps the archive, finds the first block of the time range by
+// binary search, and per block:
+//
+//      - skips it when a sample filter (-s) can match none of it,
+//      - takes its statistics as they are when it lies inside the range
+//        and one group (-g) and every filter matches all of it,
+//      - otherwise decodes the columns it needs and filters and
+//        aggregates them in straight loops over the arrays.
+//
+// Groups print as rows of count and min, max, mean per column; group
+// filters (-w) keep rows by a group statistic.  All hours where Z moved
+// more than 50 nT, for example:
+//
+//      magcol -g 3600 -c z -w 'z.range>50' station.mcol
+//
+// Logs must be in time order; samples that go back in time are dropped.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#define _GNU_SOURCE                 // strptime(), timegm()
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAGCOL_VERSION "0.1.2"
+
+#define MAGCOL_MAGIC            "RMCOL01"
+#define MAGCOL_FORMAT           1
+#define MAGCOL_COLS             6
+#define MAGCOL_MISSING          INT32_MIN   // no value (temperature ERROR or absent)
+#define MAGCOL_DEFBLOCK         1024
+#define MAGCOL_MAXBLOCK         65536
+#define MAGCOL_LINELEN          1024
+#define MAGCOL_MAXFILTERS       16
+#define MAGCOL_HOURMS           3600000LL
+
+enum { COL_T, COL_X, COL_Y, COL_Z, COL_RT, COL_LT };
+enum { OP_LT, OP_LE, OP_GT, OP_GE };
+enum { ST_MIN, ST_MAX, ST_MEAN, ST_RANGE };
+
+static const char *colNames[MAGCOL_COLS] = { "t", "x", "y", "z", "rt", "lt" };
+static const double colScale[MAGCOL_COLS] = { 1.0, 10.0, 10.0, 10.0, 100.0, 100.0 };   // stored units per nT or C
+
+//------------------------------------------
+// File header, 64 bytes, host byte order
+//------------------------------------------
+typedef struct tag_colHeader
+{
+    char        magic[8];
+    uint32_t    format;
+    uint32_t    blockLen;                   // samples per block, at most
+    uint32_t    nCols;
+    uint32_t    nBlocks;
+    uint64_t    samples;
+    uint64_t    indexOffset;                // colBlock[nBlocks] from here to the end
+    int64_t     t0;                         // ms since the epoch (UTC)
+    int64_t     t1;
+    uint8_t     pad[8];
+} colHeader;
+
+typedef char colHeaderSizeCheck[(sizeof(colHeader) == 64) ? 1 : -1];
+
+//------------------------------------------
+// Statistics of one column of a block
+// min, max and sum cover the n values that are not missing; the time
+// column has only bytes and n.
+//------------------------------------------
+typedef struct tag_colStat
+{
+    uint32_t    bytes;
+    uint32_t    n;
+    int32_t     min;
+    int32_t     max;
+    double      sum;
+} colStat;
+
+//------------------------------------------
+// Index entry of one block, 176 bytes
+// Its columns follow each other from offset.
+//------------------------------------------
+typedef struct tag_colBlock
+{
+    int64_t     t0;
+    int64_t     t1;
+    uint64_t    offset;
+    uint32_t    n;
+    uint32_t    pad;
+    colStat     col[MAGCOL_COLS];
+} colBlock;
+
+typedef char colBlockSizeCheck[(sizeof(colBlock) == 176) ? 1 : -1];
+
+//------------------------------------------
+// Packer
+//------------------------------------------
+typedef struct tag_colPacker
+{
+    FILE           *fp;
+    colHeader       hdr;
+    int64_t        *v[MAGCOL_COLS];         // the open block
+    uint32_t        n;
+    uint8_t        *enc;
+    colBlock       *index;
+    uint32_t        indexCap;
+    int64_t         lastT;
+    uint64_t        badLines;
+    uint64_t        backwards;
+    int             failed;
+} colPacker;
+
+//------------------------------------------
+// Sample or group filter
+//------------------------------------------
+typedef struct tag_colFilter
+{
+    int         col;
+    int         stat;
+    int         op;
+    double      value;                      // stored units for sample filters
+} colFilter;
+
+//------------------------------------------
+// One group's aggregates
+//------------------------------------------
+typedef struct tag_colAgg
+{
+    int64_t     key;
+    int64_t     start;
+    uint64_t    n;
+    uint64_t    cn[MAGCOL_COLS];
+    int64_t     min[MAGCOL_COLS];
+    int64_t     max[MAGCOL_COLS];
+    double      sum[MAGCOL_COLS];
+} colAgg;
+
+//------------------------------------------
+// Query
+//------------------------------------------
+typedef struct tag_colQuery
+{
+    int64_t     begin;
+    int64_t     end;
+    int64_t     groupMs;                    // 0: one group
+    int         need[MAGCOL_COLS];
+    int         show[MAGCOL_COLS];
+    colFilter   sf[MAGCOL_MAXFILTERS];
+    int         nsf;
+    colFilter   gf[MAGCOL_MAXFILTERS];
+    int         ngf;
+    int64_t    *v[MAGCOL_COLS];
+    uint8_t    *mask;
+    colAgg      agg;
+    int         haveGroup;
+    uint64_t    rows;
+    uint64_t    blocks;
+    uint64_t    skipped;
+    uint64_t    fromStats;
+    uint64_t    decoded;
+} colQuery;
+
+static int skipCols = 2;
+
+//------------------------------------------
+// putVarint()
+//------------------------------------------
+static int putVarint(uint8_t *p, uint64_t v)
+{
+    int n = 0;
+
+    while(v >= 0x80)
+    {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+//------------------------------------------
+// encodeColumn()
+// Order 1 codes deltas, order 2 deltas of deltas; returns the bytes.
+//------------------------------------------
+static uint32_t encodeColumn(const int64_t *v, uint32_t n, int order, uint8_t *out)
+{
+    int64_t prev = 0;
+    int64_t prevDelta = 0;
+    int64_t d;
+    int64_t e;
+    uint32_t len = 0;
+    uint32_t i;
+
+    for(i = 0; i < n; i++)
+    {
+        d = v[i] - prev;
+        e = (order == 2) ? d - prevDelta : d;
+        prev = v[i];
+        prevDelta = d;
+        len += putVarint(out + len, ((uint64_t)e << 1) ^ (uint64_t)(e >> 63));
+    }
+    return len;
+}
+
+//------------------------------------------
+// decodeColumn()
+//------------------------------------------
+static int decodeColumn(const uint8_t *p, uint32_t len, uint32_t n, int order, int64_t *v)
+{
+    const uint8_t *end = p + len;
+    int64_t prev = 0;
+    int64_t prevDelta = 0;
+    int64_t e;
+    uint64_t u;
+    uint32_t i;
+    int shift;
+
+    for(i = 0; i < n; i++)
+    {
+        u = 0;
+        shift = 0;
+        do
+        {
+            if(p == end || shift > 63)
+            {
+                return -1;
+            }
+            u |= (uint64_t)(*p & 0x7F) << shift;
+            shift += 7;
+        } while(*p++ & 0x80);
+        e = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+        prevDelta = (order == 2) ? prevDelta + e : e;
+        prev += prevDelta;
+        v[i] = prev;
+    }
+    return (p == end) ? 0 : -1;
+}
+
+//------------------------------------------
+// parseLogTime()
+// "19 Oct 2026 03:59:00" or milliseconds; -1 if neither.
+//------------------------------------------
+static int64_t parseLogTime(const char *s)
+{
+    struct tm tm;
+    char *end;
+    long long ms;
+
+    if(*s == '"')
+    {
+        s++;
+    }
+    memset(&tm, 0, sizeof(tm));
+    if(strptime(s, "%d %b %Y %T", &tm) != NULL)
+    {
+        return (int64_t)timegm(&tm) * 1000;
+    }
+    ms = strtoll(s, &end, 10);
+    return (end > s && (*end == ' ' || *end == '"' || *end == ',')) ? ms : -1;
+}
+
+//------------------------------------------
+// parseValue()
+//------------------------------------------
+static int parseValue(const char *s, double scale, int64_t *v, const char **next)
+{
+    char *end;
+    double d = strtod(s, &end);
+
+    if(end == s)
+    {
+        return -1;
+    }
+    *v = (int64_t)llround(d * scale);
+    if(next != NULL)
+    {
+        *next = end;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// parseLine()
+// One runMag log line (CSV or JSON) to stored units.
+//------------------------------------------
+static int parseLine(const char *line, int64_t v[MAGCOL_COLS])
+{
+    static const char *keys[MAGCOL_COLS] = { "\"ts\":", "\"x\":", "\"y\":", "\"z\":", "\"rt\":", "\"lt\":" };
+    const char *s;
+    int i;
+
+    v[COL_RT] = v[COL_LT] = MAGCOL_MISSING;
+    if(line[0] == '{')
+    {
+        if((s = strstr(line, keys[COL_T])) == NULL || (v[COL_T] = parseLogTime(s + 5)) < 0)
+        {
+            return -1;
+        }
+        for(i = COL_X; i < MAGCOL_COLS; i++)
+        {
+            if((s = strstr(line, keys[i])) == NULL)
+            {
+                if(i <= COL_Z)
+                {
+                    return -1;
+                }
+                continue;
+            }
+            // x, y, z are uT in the log.
+            if(parseValue(s + strlen(keys[i]), (i <= COL_Z) ? 10000.0 : colScale[i], &v[i], NULL) != 0)
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    if(line[0] != '"' && (line[0] < '0' || line[0] > '9'))
+    {
+        return -1;
+    }
+    if((v[COL_T] = parseLogTime(line)) < 0 || (s = strchr(line, ',')) == NULL)
+    {
+        return -1;
+    }
+    // skipCols temperatures, remote first, then X, Y, Z.
+    for(i = 0; i < skipCols + 3; i++)
+    {
+        while(*s == ' ' || *s == ',')
+        {
+            s++;
+        }
+        if(i < skipCols)
+        {
+            if(i < 2 && *s != '"' && parseValue(s, 100.0, &v[COL_RT + i], NULL) != 0)
+            {
+                return -1;
+            }
+            if((s = strchr(s, ',')) == NULL)
+            {
+                return -1;
+            }
+        }
+        else if(parseValue(s, 10000.0, &v[COL_X + i - skipCols], &s) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// packFlush()
+// Writes the open block and adds it to the index.
+//------------------------------------------
+static void packFlush(colPacker *pk)
+{
+    colBlock *b;
+    colStat *st;
+    uint32_t i;
+    int c;
+
+    if(pk->n == 0)
+    {
+        return;
+    }
+    if(pk->hdr.nBlocks == pk->indexCap)
+    {
+        pk->indexCap = pk->indexCap ? pk->indexCap * 2 : 1024;
+        if((pk->index = realloc(pk->index, pk->indexCap * sizeof(colBlock))) == NULL)
+        {
+            perror("magcol");
+            exit(1);
+        }
+    }
+    b = &pk->index[pk->hdr.nBlocks++];
+    memset(b, 0, sizeof(colBlock));
+    b->t0 = pk->v[COL_T][0];
+    b->t1 = pk->v[COL_T][pk->n - 1];
+    b->offset = pk->hdr.indexOffset;
+    b->n = pk->n;
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        st = &b->col[c];
+        st->min = INT32_MAX;
+        st->max = INT32_MIN;
+        for(i = 0; i < pk->n && c != COL_T; i++)
+        {
+            if(pk->v[c][i] == MAGCOL_MISSING)
+            {
+                continue;
+            }
+            st->n++;
+            st->sum += pk->v[c][i];
+            st->min = (pk->v[c][i] < st->min) ? pk->v[c][i] : st->min;
+            st->max = (pk->v[c][i] > st->max) ? pk->v[c][i] : st->max;
+        }
+        if(c == COL_T)
+        {
+            st->n = pk->n;
+            st->min = st->max = 0;
+        }
+        st->bytes = encodeColumn(pk->v[c], pk->n, (c == COL_T) ? 2 : 1, pk->enc);
+        if(fwrite(pk->enc, 1, st->bytes, pk->fp) != st->bytes)
+        {
+            pk->failed = 1;
+        }
+        pk->hdr.indexOffset += st->bytes;
+    }
+    if(pk->hdr.nBlocks == 1)
+    {
+        pk->hdr.t0 = b->t0;
+    }
+    pk->hdr.t1 = b->t1;
+    pk->hdr.samples += pk->n;
+    pk->n = 0;
+}
+
+//------------------------------------------
+// packAdd()
+//------------------------------------------
+static void packAdd(colPacker *pk, const int64_t v[MAGCOL_COLS])
+{
+    int c;
+
+    if(v[COL_T] < pk->lastT)
+    {
+        pk->backwards++;
+        return;
+    }
+    // Out of range values would not fit the block statistics.
+    for(c = COL_X; c < MAGCOL_COLS; c++)
+    {
+        if(v[c] != MAGCOL_MISSING && (v[c] <= INT32_MIN || v[c] > INT32_MAX))
+        {
+            pk->badLines++;
+            return;
+        }
+    }
+    if(pk->n > 0 && (pk->n == pk->hdr.blockLen || v[COL_T] / MAGCOL_HOURMS != pk->v[COL_T][0] / MAGCOL_HOURMS))
+    {
+        packFlush(pk);
+    }
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        pk->v[c][pk->n] = v[c];
+    }
+    pk->n++;
+    pk->lastT = v[COL_T];
+}
+
+//------------------------------------------
+// runPack()
+// Written to <archive>.tmp and renamed, so a failed pack leaves nothing.
+//------------------------------------------
+static int runPack(const char *path, int blockLen, char **files, int nFiles)
+{
+    colPacker pk;
+    char tmpPath[4096];
+    char line[MAGCOL_LINELEN];
+    int64_t v[MAGCOL_COLS];
+    FILE *in;
+    int f;
+    int c;
+
+    memset(&pk, 0, sizeof(pk));
+    memcpy(pk.hdr.magic, MAGCOL_MAGIC, sizeof(pk.hdr.magic));
+    pk.hdr.format = MAGCOL_FORMAT;
+    pk.hdr.blockLen = blockLen;
+    pk.hdr.nCols = MAGCOL_COLS;
+    pk.hdr.indexOffset = sizeof(colHeader);
+    pk.lastT = INT64_MIN;
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        if((pk.v[c] = malloc(blockLen * sizeof(int64_t))) == NULL)
+        {
+            perror("magcol");
+            return 1;
+        }
+    }
+    if((pk.enc = malloc(blockLen * 10)) == NULL)
+    {
+        perror("magcol");
+        return 1;
+    }
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    if((pk.fp = fopen(tmpPath, "wb")) == NULL || fwrite(&pk.hdr, sizeof(colHeader), 1, pk.fp) != 1)
+    {
+        fprintf(stderr, "magcol: %s: %s\n", tmpPath, strerror(errno));
+        return 1;
+    }
+    for(f = 0; f < nFiles; f++)
+    {
+        if(!strcmp(files[f], "-"))
+        {
+            in = stdin;
+        }
+        else if((in = fopen(files[f], "r")) == NULL)
+        {
+            fprintf(stderr, "magcol: %s: %s\n", files[f], strerror(errno));
+            pk.failed = 1;
+            break;
+        }
+        while(fgets(line, sizeof(line), in) != NULL)
+        {
+            if(parseLine(line, v) != 0)
+            {
+                pk.badLines++;
+                continue;
+            }
+            packAdd(&pk, v);
+        }
+        if(in != stdin)
+        {
+            fclose(in);
+        }
+    }
+    packFlush(&pk);
+    if(pk.hdr.nBlocks > 0 && fwrite(pk.index, sizeof(colBlock), pk.hdr.nBlocks, pk.fp) != pk.hdr.nBlocks)
+    {
+        pk.failed = 1;
+    }
+    if(fseek(pk.fp, 0, SEEK_SET) != 0 || fwrite(&pk.hdr, sizeof(colHeader), 1, pk.fp) != 1)
+    {
+        pk.failed = 1;
+    }
+    if(fclose(pk.fp) != 0 || pk.failed || rename(tmpPath, path) != 0)
+    {
+        fprintf(stderr, "magcol: %s not written\n", path);
+        unlink(tmpPath);
+        return 1;
+    }
+    fprintf(stderr, "magcol: %llu samples in %u blocks, %.2f bytes per sample; %llu bad lines, %llu out of order\n",
+            (unsigned long long)pk.hdr.samples, pk.hdr.nBlocks,
+            pk.hdr.samples ? (double)(pk.hdr.indexOffset - sizeof(colHeader)) / pk.hdr.samples : 0.0,
+            (unsigned long long)pk.badLines, (unsigned long long)pk.backwards);
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        free(pk.v[c]);
+    }
+    free(pk.enc);
+    free(pk.index);
+    return 0;
+}
+
+//------------------------------------------
+// parseQueryTime()
+// 2026-10-19, 2026-10-19T03:00:00 (or a space) or epoch seconds; UTC.
+//------------------------------------------
+static int64_t parseQueryTime(const char *s)
+{
+    struct tm tm;
+    const char *end;
+    char *numEnd;
+    long long secs;
+
+    secs = strtoll(s, &numEnd, 10);
+    if(numEnd > s && *numEnd == '\0')
+    {
+        return secs * 1000;
+    }
+    memset(&tm, 0, sizeof(tm));
+    if((end = strptime(s, "%Y-%m-%d", &tm)) == NULL)
+    {
+        return -1;
+    }
+    if((*end == 'T' || *end == ' ') && (end = strptime(end + 1, "%H:%M:%S", &tm)) == NULL)
+    {
+        return -1;
+    }
+    if(*end != '\0' && strcmp(end, "Z") != 0)
+    {
+        return -1;
+    }
+    return (int64_t)timegm(&tm) * 1000;
+}
+
+//------------------------------------------
+// findColumn()
+//------------------------------------------
+static int findColumn(const char *s, int len)
+{
+    int c;
+
+    for(c = COL_X; c < MAGCOL_COLS; c++)
+    {
+        if((int)strlen(colNames[c]) == len && !strncmp(s, colNames[c], len))
+        {
+            return c;
+        }
+    }
+    return -1;
+}
+
+//------------------------------------------
+// parseFilter()
+// <col><op><value> or, for a group filter, <col>.<stat><op><value>.
+//------------------------------------------
+static int parseFilter(const char *spec, int group, colFilter *f)
+{
+    static const char *stats[] = { "min", "max", "mean", "range" };
+    const char *s = spec;
+    const char *dot;
+    char *end;
+    int len;
+
+    while(*s == ' ')
+    {
+        s++;
+    }
+    len = (int)strcspn(s, ".<> ");
+    if((f->col = findColumn(s, len)) < 0)
+    {
+        return -1;
+    }
+    s += len;
+    f->stat = ST_MIN;
+    if(group)
+    {
+        if(*s != '.')
+        {
+            return -1;
+        }
+        dot = ++s;
+        len = (int)strcspn(s, "<> ");
+        for(f->stat = ST_MIN; f->stat <= ST_RANGE; f->stat++)
+        {
+            if((int)strlen(stats[f->stat]) == len && !strncmp(dot, stats[f->stat], len))
+            {
+                break;
+            }
+        }
+        if(f->stat > ST_RANGE)
+        {
+            return -1;
+        }
+        s += len;
+    }
+    while(*s == ' ')
+    {
+        s++;
+    }
+    if(*s != '<' && *s != '>')
+    {
+        return -1;
+    }
+    f->op = (*s == '<') ? OP_LT : OP_GT;
+    if(*++s == '=')
+    {
+        f->op++;
+        s++;
+    }
+    f->value = strtod(s, &end);
+    if(end == s)
+    {
+        return -1;
+    }
+    while(*end == ' ')
+    {
+        end++;
+    }
+    if(*end != '\0')
+    {
+        return -1;
+    }
+    if(!group)
+    {
+        f->value *= colScale[f->col];
+    }
+    return 0;
+}
+
+//------------------------------------------
+// compare()
+//------------------------------------------
+static int compare(double a, int op, double b)
+{
+    switch(op)
+    {
+        case OP_LT:
+            return a < b;
+        case OP_LE:
+            return a <= b;
+        case OP_GT:
+            return a > b;
+        default:
+            return a >= b;
+    }
+}
+
+//------------------------------------------
+// blockVerdict()
+// 0 if no sample of the block can pass the filters, 1 if all pass,
+// 2 if the samples must be looked at.
+//------------------------------------------
+static int blockVerdict(const colQuery *q, const colBlock *b)
+{
+    const colStat *st;
+    const colFilter *f;
+    int verdict = 1;
+    int i;
+
+    for(i = 0; i < q->nsf; i++)
+    {
+        f = &q->sf[i];
+        st = &b->col[f->col];
+        if(st->n == 0)
+        {
+            return 0;
+        }
+        // The most and least favourable values of the block.
+        if(f->op == OP_LT || f->op == OP_LE)
+        {
+            if(!compare(st->min, f->op, f->value))
+            {
+                return 0;
+            }
+            if(!compare(st->max, f->op, f->value) || st->n < b->n)
+            {
+                verdict = 2;
+            }
+        }
+        else
+        {
+            if(!compare(st->max, f->op, f->value))
+            {
+                return 0;
+            }
+            if(!compare(st->min, f->op, f->value) || st->n < b->n)
+            {
+                verdict = 2;
+            }
+        }
+    }
+    return verdict;
+}
+
+//------------------------------------------
+// groupStat()
+//------------------------------------------
+static double groupStat(const colAgg *a, int col, int stat)
+{
+    double scale = colScale[col];
+
+    switch(stat)
+    {
+        case ST_MIN:
+            return a->min[col] / scale;
+        case ST_MAX:
+            return a->max[col] / scale;
+        case ST_MEAN:
+            return a->sum[col] / a->cn[col] / scale;
+        default:
+            return (a->max[col] - a->min[col]) / scale;
+    }
+}
+
+//------------------------------------------
+// emitGroup()
+//------------------------------------------
+static void emitGroup(colQuery *q)
+{
+    colAgg *a = &q->agg;
+    char utcStr[32];
+    time_t secs;
+    struct tm utcTime;
+    int i;
+    int c;
+
+    if(!q->haveGroup || a->n == 0)
+    {
+        return;
+    }
+    for(i = 0; i < q->ngf; i++)
+    {
+        if(a->cn[q->gf[i].col] == 0 || !compare(groupStat(a, q->gf[i].col, q->gf[i].stat), q->gf[i].op, q->gf[i].value))
+        {
+            return;
+        }
+    }
+    secs = (time_t)(a->start / 1000);
+    gmtime_r(&secs, &utcTime);
+    strftime(utcStr, sizeof(utcStr), "%Y-%m-%dT%H:%M:%SZ", &utcTime);
+    fprintf(stdout, "%s, %llu", utcStr, (unsigned long long)a->n);
+    for(c = COL_X; c < MAGCOL_COLS; c++)
+    {
+        if(!q->show[c])
+        {
+            continue;
+        }
+        if(a->cn[c] == 0)
+        {
+            fprintf(stdout, ", \"\", \"\", \"\"");
+            continue;
+        }
+        fprintf(stdout, (c <= COL_Z) ? ", %.1f, %.1f, %.2f" : ", %.2f, %.2f, %.3f",
+                groupStat(a, c, ST_MIN), groupStat(a, c, ST_MAX), groupStat(a, c, ST_MEAN));
+    }
+    fprintf(stdout, "\n");
+    q->rows++;
+}
+
+//------------------------------------------
+// startGroup()
+// Moves to the group of time t, printing the one before.
+//------------------------------------------
+static void startGroup(colQuery *q, int64_t t)
+{
+    int64_t key = q->groupMs ? t / q->groupMs : 0;
+    int c;
+
+    if(q->haveGroup && key == q->agg.key)
+    {
+        return;
+    }
+    emitGroup(q);
+    memset(&q->agg, 0, sizeof(colAgg));
+    q->agg.key = key;
+    q->agg.start = q->groupMs ? key * q->groupMs : t;
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        q->agg.min[c] = INT64_MAX;
+        q->agg.max[c] = INT64_MIN;
+    }
+    q->haveGroup = 1;
+}
+
+//------------------------------------------
+// mergeStats()
+// A whole block from its index entry.
+//------------------------------------------
+static void mergeStats(colQuery *q, const colBlock *b)
+{
+    colAgg *a = &q->agg;
+    const colStat *st;
+    int c;
+
+    startGroup(q, b->t0);
+    a->n += b->n;
+    for(c = COL_X; c < MAGCOL_COLS; c++)
+    {
+        st = &b->col[c];
+        if(!q->need[c] || st->n == 0)
+        {
+            continue;
+        }
+        a->cn[c] += st->n;
+        a->sum[c] += st->sum;
+        a->min[c] = (st->min < a->min[c]) ? st->min : a->min[c];
+        a->max[c] = (st->max > a->max[c]) ? st->max : a->max[c];
+    }
+}
+
+//------------------------------------------
+// scanBlock()
+// Decodes what the query needs, filters and aggregates.
+//------------------------------------------
+static int scanBlock(colQuery *q, const uint8_t *base, const colBlock *b)
+{
+    const uint8_t *p = base + b->offset;
+    uint8_t *mask = q->mask;
+    const int64_t *t = q->v[COL_T];
+    const int64_t *v;
+    const colFilter *f;
+    colAgg *a = &q->agg;
+    int64_t mn;
+    int64_t mx;
+    int64_t key;
+    double sum;
+    uint64_t cnt;
+    uint32_t n = b->n;
+    uint32_t i;
+    uint32_t j;
+    uint32_t k;
+    int c;
+
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        if((c == COL_T || q->need[c]) && decodeColumn(p, b->col[c].bytes, n, (c == COL_T) ? 2 : 1, q->v[c]) != 0)
+        {
+            return -1;
+        }
+        p += b->col[c].bytes;
+    }
+    for(i = 0; i < n; i++)
+    {
+        mask[i] = (t[i] >= q->begin) & (t[i] < q->end);
+    }
+    for(k = 0; k < (uint32_t)q->nsf; k++)
+    {
+        f = &q->sf[k];
+        v = q->v[f->col];
+        switch(f->op)
+        {
+            case OP_LT:
+                for(i = 0; i < n; i++)
+                {
+                    mask[i] &= (v[i] != MAGCOL_MISSING) & (v[i] < f->value);
+                }
+                break;
+            case OP_LE:
+                for(i = 0; i < n; i++)
+                {
+                    mask[i] &= (v[i] != MAGCOL_MISSING) & (v[i] <= f->value);
+                }
+                break;
+            case OP_GT:
+                for(i = 0; i < n; i++)
+                {
+                    mask[i] &= (v[i] > f->value);
+                }
+                break;
+            default:
+                for(i = 0; i < n; i++)
+                {
+                    mask[i] &= (v[i] >= f->value);
+                }
+                break;
+        }
+    }
+    // One pass per group the block touches.
+    for(i = 0; i < n; i = j)
+    {
+        key = q->groupMs ? t[i] / q->groupMs : 0;
+        for(j = i + 1; j < n && (q->groupMs ? t[j] / q->groupMs : 0) == key; j++)
+        {
+        }
+        for(cnt = 0, k = i; k < j; k++)
+        {
+            cnt += mask[k];
+        }
+        if(cnt == 0)
+        {
+            continue;
+        }
+        for(k = i; !mask[k]; k++)
+        {
+        }
+        startGroup(q, t[k]);
+        a->n += cnt;
+        for(c = COL_X; c < MAGCOL_COLS; c++)
+        {
+            if(!q->need[c])
+            {
+                continue;
+            }
+            v = q->v[c];
+            mn = INT64_MAX;
+            mx = INT64_MIN;
+            sum = 0.0;
+            cnt = 0;
+            for(k = i; k < j; k++)
+            {
+                if(mask[k] && v[k] != MAGCOL_MISSING)
+                {
+                    mn = (v[k] < mn) ? v[k] : mn;
+                    mx = (v[k] > mx) ? v[k] : mx;
+                    sum += v[k];
+                    cnt++;
+                }
+            }
+            a->cn[c] += cnt;
+            a->sum[c] += sum;
+            a->min[c] = (mn < a->min[c]) ? mn : a->min[c];
+            a->max[c] = (mx > a->max[c]) ? mx : a->max[c];
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// openArchive()
+//------------------------------------------
+static const uint8_t *openArchive(const char *path, size_t *size)
+{
+    const colHeader *hdr;
+    struct stat st;
+    uint8_t *map;
+    int fd;
+
+    if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+    {
+        fprintf(stderr, "magcol: %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if(st.st_size < (off_t)sizeof(colHeader) ||
+       (map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        fprintf(stderr, "magcol: %s: not an archive\n", path);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+    hdr = (const colHeader *)map;
+    if(memcmp(hdr->magic, MAGCOL_MAGIC, sizeof(hdr->magic)) != 0 || hdr->format != MAGCOL_FORMAT ||
+       hdr->nCols != MAGCOL_COLS || hdr->blockLen == 0 || hdr->blockLen > MAGCOL_MAXBLOCK ||
+       hdr->indexOffset > (uint64_t)st.st_size ||
+       (uint64_t)st.st_size - hdr->indexOffset != (uint64_t)hdr->nBlocks * sizeof(colBlock))
+    {
+        fprintf(stderr, "magcol: %s: not an archive, or a damaged one\n", path);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_WILLNEED);
+    *size = st.st_size;
+    return map;
+}
+
+//------------------------------------------
+// printInfo()
+//------------------------------------------
+static void printInfo(const uint8_t *base, size_t size)
+{
+    const colHeader *hdr = (const colHeader *)base;
+    const colBlock *idx = (const colBlock *)(base + hdr->indexOffset);
+    uint64_t bytes[MAGCOL_COLS] = { 0 };
+    char t0[32];
+    char t1[32];
+    time_t secs;
+    struct tm utcTime;
+    uint32_t b;
+    int c;
+
+    for(b = 0; b < hdr->nBlocks; b++)
+    {
+        for(c = 0; c < MAGCOL_COLS; c++)
+        {
+            bytes[c] += idx[b].col[c].bytes;
+        }
+    }
+    secs = (time_t)(hdr->t0 / 1000);
+    gmtime_r(&secs, &utcTime);
+    strftime(t0, sizeof(t0), "%Y-%m-%dT%H:%M:%SZ", &utcTime);
+    secs = (time_t)(hdr->t1 / 1000);
+    gmtime_r(&secs, &utcTime);
+    strftime(t1, sizeof(t1), "%Y-%m-%dT%H:%M:%SZ", &utcTime);
+    fprintf(stdout, "Samples:     %llu, %s to %s\n", (unsigned long long)hdr->samples, t0, t1);
+    fprintf(stdout, "Blocks:      %u of up to %u samples\n", hdr->nBlocks, hdr->blockLen);
+    fprintf(stdout, "Size:        %llu bytes\n", (unsigned long long)size);
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        fprintf(stdout, "Column %-4s  %llu bytes, %.2f per sample\n", colNames[c], (unsigned long long)bytes[c],
+                hdr->samples ? (double)bytes[c] / hdr->samples : 0.0);
+    }
+}
+
+//------------------------------------------
+// runQuery()
+//------------------------------------------
+static int runQuery(colQuery *q, const uint8_t *base, int verbose)
+{
+    const colHeader *hdr = (const colHeader *)base;
+    const colBlock *idx = (const colBlock *)(base + hdr->indexOffset);
+    const colBlock *b;
+    struct timespec t0;
+    struct timespec t1;
+    uint32_t lo = 0;
+    uint32_t hi = hdr->nBlocks;
+    uint32_t mid;
+    uint64_t bytes;
+    int inside;
+    int verdict;
+    int c;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        if((q->v[c] = malloc(hdr->blockLen * sizeof(int64_t))) == NULL)
+        {
+            perror("magcol");
+            return 1;
+        }
+    }
+    if((q->mask = malloc(hdr->blockLen)) == NULL)
+    {
+        perror("magcol");
+        return 1;
+    }
+    // First block ending at or after begin.
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(idx[mid].t1 < q->begin)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    fprintf(stdout, "# start, n");
+    for(c = COL_X; c < MAGCOL_COLS; c++)
+    {
+        if(q->show[c])
+        {
+            fprintf(stdout, ", %s min, %s max, %s mean", colNames[c], colNames[c], colNames[c]);
+        }
+    }
+    fprintf(stdout, "    (nT, C)\n");
+    for(b = &idx[lo]; b < &idx[hdr->nBlocks] && b->t0 < q->end; b++)
+    {
+        q->blocks++;
+        if((verdict = blockVerdict(q, b)) == 0)
+        {
+            q->skipped++;
+            continue;
+        }
+        inside = (b->t0 >= q->begin && b->t1 < q->end &&
+                  (q->groupMs == 0 || b->t0 / q->groupMs == b->t1 / q->groupMs));
+        if(inside && verdict == 1)
+        {
+            mergeStats(q, b);
+            q->fromStats++;
+            continue;
+        }
+        for(bytes = 0, c = 0; c < MAGCOL_COLS; c++)
+        {
+            bytes += b->col[c].bytes;
+        }
+        if(b->n > hdr->blockLen || b->offset + bytes > hdr->indexOffset || scanBlock(q, base, b) != 0)
+        {
+            fprintf(stderr, "magcol: damaged block at %llu\n", (unsigned long long)b->offset);
+            return 1;
+        }
+        q->decoded++;
+    }
+    emitGroup(q);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if(verbose)
+    {
+        fprintf(stderr, "magcol: %llu rows; %llu blocks: %llu skipped, %llu from statistics, %llu decoded; %.1f ms\n",
+                (unsigned long long)q->rows, (unsigned long long)q->blocks, (unsigned long long)q->skipped,
+                (unsigned long long)q->fromStats, (unsigned long long)q->decoded,
+                (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    }
+    for(c = 0; c < MAGCOL_COLS; c++)
+    {
+        free(q->v[c]);
+    }
+    free(q->mask);
+    return 0;
+}
+
+//------------------------------------------
+// usage()
+//------------------------------------------
+static void usage(const char *prog)
+{
+    fprintf(stdout, "\n%s Version = %s\n", prog, MAGCOL_VERSION);
+    fprintf(stdout, "\nUsage: %s -o <archive> [-B n] [-k n] <log> [<log> ..]     ('-' reads stdin)\n", prog);
+    fprintf(stdout, "       %s [query options] <archive>\n", prog);
+    fprintf(stdout, "\nPacking:\n\n");
+    fprintf(stdout, "   -o <archive>           :  Pack the logs, in time order.\n");
+    fprintf(stdout, "   -B <n>                 :  Samples per block.                    [ default 1024; 16 to 65536 ]\n");
+    fprintf(stdout, "   -k <n>                 :  CSV columns between time and X.       [ default 2; 1 for runMag -r/-l, 0 for -m ]\n");
+    fprintf(stdout, "\nQuerying:\n\n");
+    fprintf(stdout, "   -b <time>              :  From, UTC.                            [ 2026-10-19, 2026-10-19T03:00:00 or epoch s ]\n");
+    fprintf(stdout, "   -e <time>              :  Until, UTC, not included.\n");
+    fprintf(stdout, "   -g <s>                 :  One row per s seconds.                [ default one row ]\n");
+    fprintf(stdout, "   -c <cols>              :  Columns to show.                      [ default x,y,z; also rt, lt ]\n");
+    fprintf(stdout, "   -s <col><op><value>    :  Only samples passing, nT or C.        [ e.g. 'z>52000'; op <, <=, >, >= ]\n");
+    fprintf(stdout, "   -w <col>.<stat><op><v> :  Only rows passing.                    [ e.g. 'z.range>50'; min, max, mean, range ]\n");
+    fprintf(stdout, "   -i                     :  Describe the archive.\n");
+    fprintf(stdout, "   -v                     :  Query statistics to stderr.\n");
+    fprintf(stdout, "   -h or -?               :  Display this help.\n\n");
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    const char *outPath = NULL;
+    const char *s;
+    const uint8_t *base;
+    colQuery q;
+    size_t size;
+    int64_t t;
+    int blockLen = MAGCOL_DEFBLOCK;
+    int info = 0;
+    int verbose = 0;
+    int len;
+    int c;
+    int rc;
+
+    memset(&q, 0, sizeof(q));
+    q.begin = INT64_MIN;
+    q.end = INT64_MAX;
+    q.show[COL_X] = q.show[COL_Y] = q.show[COL_Z] = 1;
+    while((c = getopt(argc, argv, "?b:B:c:e:g:hik:o:s:vw:")) != -1)
+    {
+        switch(c)
+        {
+            case 'b':
+            case 'e':
+                if((t = parseQueryTime(optarg)) < 0)
+                {
+                    fprintf(stderr, "magcol: bad time %s\n", optarg);
+                    return 1;
+                }
+                *((c == 'b') ? &q.begin : &q.end) = t;
+                break;
+            case 'B':
+                blockLen = atoi(optarg);
+                break;
+            case 'c':
+                memset(q.show, 0, sizeof(q.show));
+                for(s = optarg; *s != '\0'; s += len + (s[len] == ','))
+                {
+                    len = (int)strcspn(s, ",");
+                    if(findColumn(s, len) < 0)
+                    {
+                        fprintf(stderr, "magcol: bad column list %s\n", optarg);
+                        return 1;
+                    }
+                    q.show[findColumn(s, len)] = 1;
+                }
+                break;
+            case 'g':
+                q.groupMs = (int64_t)(atof(optarg) * 1000.0);
+                if(q.groupMs <= 0)
+                {
+                    fprintf(stderr, "magcol: bad group length %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                info = 1;
+                break;
+            case 'k':
+                skipCols = atoi(optarg);
+                break;
+            case 'o':
+                outPath = optarg;
+                break;
+            case 's':
+            case 'w':
+                if((c == 's' ? q.nsf : q.ngf) == MAGCOL_MAXFILTERS ||
+                   parseFilter(optarg, c == 'w', (c == 's') ? &q.sf[q.nsf++] : &q.gf[q.ngf++]) != 0)
+                {
+                    fprintf(stderr, "magcol: bad filter %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(blockLen < 16 || blockLen > MAGCOL_MAXBLOCK || skipCols < 0 || optind >= argc ||
+       (outPath == NULL && optind != argc - 1))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if(outPath != NULL)
+    {
+        return runPack(outPath, blockLen, &argv[optind], argc - optind);
+    }
+    if((base = openArchive(argv[optind], &size)) == NULL)
+    {
+        return 1;
+    }
+    if(info)
+    {
+        printInfo(base, size);
+        return 0;
+    }
+    for(c = COL_X; c < MAGCOL_COLS; c++)
+    {
+        q.need[c] = q.show[c];
+    }
+    for(c = 0; c < q.nsf; c++)
+    {
+        q.need[q.sf[c].col] = 1;
+    }
+    for(c = 0; c < q.ngf; c++)
+    {
+        q.need[q.gf[c].col] = 1;
+    }
+    rc = runQuery(&q, base, verbose);
+    munmap((void *)base, size);
+    return rc;
+}
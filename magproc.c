@@ -0,0 +1,1047 @@
+//=========================================================================
+// magproc.c
+//
+// Batch reprocessing of runMag logs on all cores.
+//
+//      magproc -o <dir> [-f csv|json|bin] [-C cal] [-S window] [-D ratio] <log> ..
+//
+// Each log (CSV or JSON) is mapped and parsed by hand: the time stamp,
+// temperatures and X, Y, Z go straight to integers (0.1 nT, 0.01 C, the
+// log's own resolution), with no sscanf or strtod.  Every sample then
+// goes through the stages asked for, in this order:
+//
+//      despike     Hampel filter (hampel.c), spikes replaced by the median
+//      decimate    decimate.c, time stamped at the filter centre
+//      calibrate   offset and matrix of a magcal file on top of the logged nT
+//      format      runMag CSV or JSON, or 64 byte magRecords (magrec.h)
+//
+// and is written to <dir>/<log name> (".rec" appended for bin) by way of
+// a temporary file.  Files are the unit of work: they are dealt, largest
+// first, into one deque per thread; a thread takes from the front of its
+// own and, when that is empty, steals from the back of another's.
+// Records per second are reported per file (-v) and in total.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "magcal.h"
+#include "decimate.h"
+#include "hampel.h"
+
+#define MAGPROC_VERSION "0.1.2"
+
+#define MAGPROC_LINELEN         1024
+#define MAGPROC_OUTBUF          (1 << 20)
+#define MAGPROC_MAXTHREADS      256
+#define MAGPROC_MISSING         INT32_MIN
+
+enum { FMT_CSV, FMT_JSON, FMT_BIN };
+
+//------------------------------------------
+// One parsed sample
+//------------------------------------------
+typedef struct tag_procSample
+{
+    int64_t     tsNs;
+    int32_t     v[3];                       // 0.1 nT
+    int32_t     temp[2];                    // 0.01 C, remote and local
+    uint32_t    flags;
+} procSample;
+
+//------------------------------------------
+// One input file
+//------------------------------------------
+typedef struct tag_procFile
+{
+    const char *path;
+    off_t       size;
+    uint64_t    records;
+    uint64_t    written;
+    uint64_t    badLines;
+    uint64_t    spikes;
+    double      secs;
+    int         failed;
+} procFile;
+
+//------------------------------------------
+// A thread's deque of file numbers
+//------------------------------------------
+typedef struct tag_procDeque
+{
+    pthread_mutex_t lock;
+    int            *task;
+    int             head;
+    int             tail;
+} procDeque;
+
+//------------------------------------------
+// Per thread state
+//------------------------------------------
+typedef struct tag_procWorker
+{
+    int         id;
+    char       *out;                        // MAGPROC_OUTBUF
+    int         outLen;
+    FILE       *fp;
+    uint64_t    records;
+    uint64_t    steals;
+    int         failed;
+    time_t      lastSec;                    // cached time string
+    char        lastTime[32];
+    int         lastTimeLen;
+} procWorker;
+
+//------------------------------------------
+// Options and shared state
+//------------------------------------------
+static const char *outDir = NULL;
+static int outFormat = FMT_CSV;
+static int skipCols = 2;
+static int msTimes = 0;
+static int despikeWindow = 0;
+static double despikeK = HAMPEL_DEFK;
+static int decimRatio = 1;
+static int decimType = eDECIM_GAUSS;
+static int haveCal = 0;
+static magCal cal;
+static procFile *files;
+static int nFiles;
+static procDeque *deques;
+static int nThreads;
+static int verbose = 0;
+static pthread_mutex_t reportLock = PTHREAD_MUTEX_INITIALIZER;
+
+//------------------------------------------
+// nsNow()
+//------------------------------------------
+static double nsNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//------------------------------------------
+// parseFixed()
+// A decimal number as an integer in units of 10^-dec, rounded; moves *s
+// past it.
+//------------------------------------------
+static int parseFixed(const char **s, int dec, int32_t *v)
+{
+    const char *p = *s;
+    int64_t n = 0;
+    int neg = 0;
+    int digits = 0;
+    int frac = -1;
+
+    if(*p == '-' || *p == '+')
+    {
+        neg = (*p++ == '-');
+    }
+    for(;; p++)
+    {
+        if(*p >= '0' && *p <= '9')
+        {
+            if(frac < dec)
+            {
+                n = n * 10 + (*p - '0');
+                frac += (frac >= 0);
+            }
+            else if(frac == dec)
+            {
+                // First digit past the resolution rounds.
+                n += (*p >= '5');
+                frac++;
+            }
+            if(++digits > 15)
+            {
+                return -1;
+            }
+        }
+        else if(*p == '.' && frac < 0)
+        {
+            frac = 0;
+        }
+        else
+        {
+            break;
+        }
+    }
+    if(digits == 0)
+    {
+        return -1;
+    }
+    for(frac = (frac < 0) ? 0 : (frac > dec) ? dec : frac; frac < dec; frac++)
+    {
+        n *= 10;
+    }
+    if(n > INT32_MAX)
+    {
+        return -1;
+    }
+    *v = (int32_t)(neg ? -n : n);
+    *s = p;
+    return 0;
+}
+
+//------------------------------------------
+// parseDigits()
+//------------------------------------------
+static int parseDigits(const char **s, int count, int *v)
+{
+    const char *p = *s;
+    int i;
+
+    *v = 0;
+    for(i = 0; i < count; i++, p++)
+    {
+        if(*p < '0' || *p > '9')
+        {
+            return -1;
+        }
+        *v = *v * 10 + (*p - '0');
+    }
+    *s = p;
+    return 0;
+}
+
+//------------------------------------------
+// daysFromCivil()
+// Days since 1970-01-01 of a proleptic Gregorian date.
+//------------------------------------------
+static int64_t daysFromCivil(int y, int m, int d)
+{
+    int64_t era;
+    int yoe;
+    int doy;
+
+    y -= (m <= 2);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = (int)(y - era * 400);
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+//------------------------------------------
+// parseTime()
+// "19 Oct 2026 03:59:00" or milliseconds, optionally quoted.
+//------------------------------------------
+static int parseTime(const char **s, int64_t *tsNs)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    const char *p = *s;
+    const char *m;
+    int64_t ms = 0;
+    int day;
+    int mon;
+    int year;
+    int hh;
+    int mm;
+    int ss;
+
+    if(*p == '"')
+    {
+        p++;
+    }
+    if(p[1] == ' ' || p[2] == ' ')
+    {
+        if(parseDigits(&p, (p[1] == ' ') ? 1 : 2, &day) != 0 || *p++ != ' ')
+        {
+            return -1;
+        }
+        for(m = months; *m != '\0' && strncmp(m, p, 3) != 0; m += 3)
+        {
+        }
+        if(*m == '\0' || p[3] != ' ')
+        {
+            return -1;
+        }
+        mon = (int)(m - months) / 3 + 1;
+        p += 4;
+        if(parseDigits(&p, 4, &year) != 0 || *p++ != ' ' || parseDigits(&p, 2, &hh) != 0 || *p++ != ':' ||
+           parseDigits(&p, 2, &mm) != 0 || *p++ != ':' || parseDigits(&p, 2, &ss) != 0)
+        {
+            return -1;
+        }
+        *tsNs = ((daysFromCivil(year, mon, day) * 86400 + hh * 3600 + mm * 60 + ss)) * 1000000000LL;
+    }
+    else
+    {
+        if(*p < '0' || *p > '9')
+        {
+            return -1;
+        }
+        while(*p >= '0' && *p <= '9')
+        {
+            ms = ms * 10 + (*p++ - '0');
+        }
+        *tsNs = ms * 1000000LL;
+    }
+    if(*p == '"')
+    {
+        p++;
+    }
+    *s = p;
+    return 0;
+}
+
+//------------------------------------------
+// skipSeparators()
+//------------------------------------------
+static inline const char *skipSeparators(const char *p)
+{
+    while(*p == ' ' || *p == ',')
+    {
+        p++;
+    }
+    return p;
+}
+
+//------------------------------------------
+// parseCsv()
+// time, skipCols temperatures, X, Y, Z in uT; the rest is ignored.
+//------------------------------------------
+static int parseCsv(const char *p, procSample *s)
+{
+    int32_t extra;
+    int i;
+
+    if(parseTime(&p, &s->tsNs) != 0)
+    {
+        return -1;
+    }
+    for(i = 0; i < skipCols; i++)
+    {
+        p = skipSeparators(p);
+        if(*p == '"')
+        {
+            // "ERROR"
+            for(p++; *p != '"' && *p != '\0'; p++)
+            {
+            }
+            p += (*p == '"');
+        }
+        else if(parseFixed(&p, 2, (i < 2) ? &s->temp[i] : &extra) != 0)
+        {
+            return -1;
+        }
+    }
+    for(i = 0; i < 3; i++)
+    {
+        p = skipSeparators(p);
+        if(parseFixed(&p, 4, &s->v[i]) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// parseJson()
+// The keys runMag writes, in any order.
+//------------------------------------------
+static int parseJson(const char *p, procSample *s)
+{
+    const char *key;
+    int keyLen;
+    int have = 0;
+
+    while((p = strchr(p, '"')) != NULL)
+    {
+        key = ++p;
+        while(*p != '"' && *p != '\0')
+        {
+            p++;
+        }
+        keyLen = (int)(p - key);
+        if(*p != '"' || p[1] != ':')
+        {
+            return -1;
+        }
+        p += 2;
+        while(*p == ' ')
+        {
+            p++;
+        }
+        if(keyLen == 2 && key[0] == 't' && key[1] == 's')
+        {
+            if(parseTime(&p, &s->tsNs) != 0)
+            {
+                return -1;
+            }
+            have |= 1;
+        }
+        else if(keyLen == 1 && key[0] >= 'x' && key[0] <= 'z')
+        {
+            if(parseFixed(&p, 4, &s->v[key[0] - 'x']) != 0)
+            {
+                return -1;
+            }
+            have |= 2 << (key[0] - 'x');
+        }
+        else if(keyLen == 2 && (key[0] == 'r' || key[0] == 'l') && key[1] == 't')
+        {
+            if(parseFixed(&p, 2, &s->temp[key[0] == 'l']) != 0)
+            {
+                return -1;
+            }
+        }
+        // Past the value to the next key.
+        while(*p != ',' && *p != '}' && *p != '\0')
+        {
+            p++;
+        }
+    }
+    return (have == 15) ? 0 : -1;
+}
+
+//------------------------------------------
+// putFixed()
+// v in units of 10^-dec as a decimal.
+//------------------------------------------
+static int putFixed(char *out, int64_t v, int dec)
+{
+    char tmp[24];
+    int n = 0;
+    int len = 0;
+    uint64_t u = (v < 0) ? (uint64_t)-v : (uint64_t)v;
+
+    do
+    {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while(u > 0 || n <= dec);
+    if(v < 0)
+    {
+        out[len++] = '-';
+    }
+    while(n > 0)
+    {
+        if(n == dec)
+        {
+            out[len++] = '.';
+        }
+        out[len++] = tmp[--n];
+    }
+    return len;
+}
+
+//------------------------------------------
+// flushOut()
+//------------------------------------------
+static void flushOut(procWorker *w)
+{
+    if(w->fp != NULL && w->outLen > 0 && fwrite(w->out, 1, w->outLen, w->fp) != (size_t)w->outLen)
+    {
+        w->failed = 1;
+    }
+    w->outLen = 0;
+}
+
+//------------------------------------------
+// putTime()
+//------------------------------------------
+static int putTime(procWorker *w, char *out, int64_t tsNs)
+{
+    time_t sec = (time_t)(tsNs / 1000000000LL);
+    struct tm utcTime;
+
+    if(msTimes)
+    {
+        return putFixed(out, tsNs / 1000000LL, 0);
+    }
+    if(sec != w->lastSec || w->lastTimeLen == 0)
+    {
+        gmtime_r(&sec, &utcTime);
+        w->lastTimeLen = (int)strftime(w->lastTime, sizeof(w->lastTime), "%d %b %Y %T", &utcTime);
+        w->lastSec = sec;
+    }
+    memcpy(out, w->lastTime, w->lastTimeLen);
+    return w->lastTimeLen;
+}
+
+//------------------------------------------
+// emit()
+// Formats one output sample; xyz in nT.
+//------------------------------------------
+static void emit(procWorker *w, const procSample *s, const double xyz[3], uint64_t seq)
+{
+    static const char *jsonKeys[3] = { ", \"x\":", ", \"y\":", ", \"z\":" };
+    magRecord rec;
+    char *o;
+    int i;
+
+    if(w->outLen > MAGPROC_OUTBUF - MAGPROC_LINELEN)
+    {
+        flushOut(w);
+    }
+    o = w->out + w->outLen;
+    if(outFormat == FMT_BIN)
+    {
+        memset(&rec, 0, sizeof(rec));
+        rec.seq = seq;
+        rec.tsNs = s->tsNs;
+        rec.flags = s->flags;
+        for(i = 0; i < 3; i++)
+        {
+            rec.xyz[i] = xyz[i];
+        }
+        rec.rcTemp = (s->temp[0] == MAGPROC_MISSING) ? MAGREC_TEMP_INVALID : s->temp[0] / 100.0f;
+        rec.lcTemp = (s->temp[1] == MAGPROC_MISSING) ? MAGREC_TEMP_INVALID : s->temp[1] / 100.0f;
+        rec.flags |= (s->temp[0] != MAGPROC_MISSING) ? MAGREC_F_RTEMP : 0;
+        rec.flags |= (s->temp[1] != MAGPROC_MISSING) ? MAGREC_F_LTEMP : 0;
+        memcpy(o, &rec, sizeof(rec));
+        w->outLen += sizeof(rec);
+        return;
+    }
+    if(outFormat == FMT_JSON)
+    {
+        memcpy(o, "{ \"ts\":\"", 8);
+        o += 8;
+        o += putTime(w, o, s->tsNs);
+        *o++ = '"';
+        for(i = 0; i < 2; i++)
+        {
+            memcpy(o, i ? ", \"lt\":" : ", \"rt\":", 7);
+            o += 7;
+            o += putFixed(o, (s->temp[i] == MAGPROC_MISSING) ? 0 : s->temp[i], 2);
+        }
+        for(i = 0; i < 3; i++)
+        {
+            memcpy(o, jsonKeys[i], 6);
+            o += 6;
+            o += putFixed(o, llround(xyz[i] * 10.0), 4);
+        }
+        if(despikeWindow)
+        {
+            memcpy(o, ", \"spk\":", 8);
+            o += 8;
+            o += putFixed(o, (s->flags >> 4) & 7, 0);
+        }
+        memcpy(o, " }\n", 3);
+        o += 3;
+    }
+    else
+    {
+        if(!msTimes)
+        {
+            *o++ = '"';
+        }
+        o += putTime(w, o, s->tsNs);
+        if(!msTimes)
+        {
+            *o++ = '"';
+        }
+        else
+        {
+            *o++ = ' ';
+        }
+        for(i = 0; i < 2; i++)
+        {
+            memcpy(o, ", ", 2);
+            o += 2;
+            if(s->temp[i] == MAGPROC_MISSING)
+            {
+                memcpy(o, "\"ERROR\"", 7);
+                o += 7;
+            }
+            else
+            {
+                o += putFixed(o, s->temp[i], 2);
+            }
+        }
+        for(i = 0; i < 3; i++)
+        {
+            memcpy(o, ", ", 2);
+            o += 2;
+            o += putFixed(o, llround(xyz[i] * 10.0), 4);
+        }
+        if(despikeWindow)
+        {
+            memcpy(o, ", ", 2);
+            o += 2;
+            o += putFixed(o, (s->flags >> 4) & 7, 0);
+        }
+        *o++ = '\n';
+    }
+    w->outLen = (int)(o - w->out);
+}
+
+//------------------------------------------
+// openOutput()
+//------------------------------------------
+static int openOutput(procWorker *w, const char *in, char *path, size_t len, char *tmpPath, size_t tmpLen)
+{
+    const char *base = strrchr(in, '/');
+
+    base = (base != NULL) ? base + 1 : in;
+    snprintf(path, len, "%s/%s%s", outDir, base, (outFormat == FMT_BIN) ? ".rec" : "");
+    snprintf(tmpPath, tmpLen, "%s.tmp", path);
+    if((w->fp = fopen(tmpPath, "w")) == NULL)
+    {
+        fprintf(stderr, "magproc: %s: %s\n", tmpPath, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// delayedTime()
+// The time delay input samples before the newest in ring, interpolated
+// between the two around it, so the filter delay follows the log's own
+// sample spacing.  Before that much input has been seen it is taken at
+// the mean spacing so far.
+//------------------------------------------
+static int64_t delayedTime(const int64_t *ring, int len, uint64_t count, double delay)
+{
+    uint64_t k = (uint64_t)delay;
+    int64_t a = ring[(count - 1) % len];
+    int64_t b;
+
+    if(count < k + 2)
+    {
+        return (count > 1) ? a - (int64_t)(delay * (a - ring[0]) / (count - 1)) : a;
+    }
+    a = ring[(count - 1 - k) % len];
+    b = ring[(count - 2 - k) % len];
+    return a - (int64_t)((delay - k) * (a - b));
+}
+
+//------------------------------------------
+// processFile()
+//------------------------------------------
+static void processFile(procWorker *w, procFile *f)
+{
+    char path[MAXPATHBUFLEN + 16];
+    char tmpPath[MAXPATHBUFLEN + 32];
+    char line[MAGPROC_LINELEN];
+    hampelFilter *hf = NULL;
+    decimator dec;
+    procSample s;
+    procSample acc;
+    double counts[3];
+    double xyz[3];
+    double t0 = nsNow();
+    const char *map;
+    const char *p;
+    const char *end;
+    const char *nl;
+    int64_t tempSum[2] = { 0, 0 };
+    int64_t *tsRing = NULL;
+    uint64_t tsCount = 0;
+    int tsLen = 0;
+    int tempN[2] = { 0, 0 };
+    size_t len;
+    int fd;
+    int i;
+
+    memset(&dec, 0, sizeof(dec));
+    memset(&acc, 0, sizeof(acc));
+    if((fd = open(f->path, O_RDONLY)) < 0)
+    {
+        fprintf(stderr, "magproc: %s: %s\n", f->path, strerror(errno));
+        f->failed = 1;
+        return;
+    }
+    map = (f->size > 0) ? mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        fprintf(stderr, "magproc: %s: %s\n", f->path, strerror(errno));
+        f->failed = 1;
+        return;
+    }
+    if(map != NULL)
+    {
+        madvise((void *)map, f->size, MADV_SEQUENTIAL);
+    }
+    if(despikeWindow && (hf = malloc(sizeof(hampelFilter))) != NULL)
+    {
+        hampelInit(hf, despikeWindow, despikeK, TRUE);
+    }
+    if((despikeWindow && hf == NULL) || (decimRatio > 1 && decimatorInit(&dec, decimRatio, decimType, 0) != 0) ||
+       (outDir != NULL && openOutput(w, f->path, path, sizeof(path), tmpPath, sizeof(tmpPath)) != 0))
+    {
+        f->failed = 1;
+        goto done;
+    }
+    // Input times back to the filter's group delay.
+    if(decimRatio > 1)
+    {
+        tsLen = (int)dec.delay + 2;
+        if((tsRing = malloc(tsLen * sizeof(int64_t))) == NULL)
+        {
+            f->failed = 1;
+            goto done;
+        }
+    }
+    end = map + f->size;
+    for(p = map; p < end; p = nl + 1)
+    {
+        if((nl = memchr(p, '\n', end - p)) == NULL)
+        {
+            nl = end;
+        }
+        len = nl - p;
+        if(len == 0)
+        {
+            continue;
+        }
+        if(len >= sizeof(line))
+        {
+            f->badLines++;
+            continue;
+        }
+        memcpy(line, p, len);
+        line[len] = '\0';
+        s.temp[0] = s.temp[1] = MAGPROC_MISSING;
+        s.flags = 0;
+        if(((line[0] == '{') ? parseJson(line, &s) : parseCsv(line, &s)) != 0)
+        {
+            f->badLines++;
+            continue;
+        }
+        f->records++;
+        if(hf != NULL)
+        {
+            s.flags |= (uint32_t)hampelPush(hf, s.v) << 4;
+        }
+        if(decimRatio > 1)
+        {
+            // Temperatures and flags over the decimation interval.
+            for(i = 0; i < 2; i++)
+            {
+                if(s.temp[i] != MAGPROC_MISSING)
+                {
+                    tempSum[i] += s.temp[i];
+                    tempN[i]++;
+                }
+            }
+            acc.flags |= s.flags;
+            tsRing[tsCount % tsLen] = s.tsNs;
+            tsCount++;
+            if(!decimatorPush(&dec, s.v, counts))
+            {
+                continue;
+            }
+            acc.tsNs = delayedTime(tsRing, tsLen, tsCount, dec.delay);
+            for(i = 0; i < 2; i++)
+            {
+                acc.temp[i] = tempN[i] ? (int32_t)((tempSum[i] + tempN[i] / 2) / tempN[i]) : MAGPROC_MISSING;
+                tempSum[i] = 0;
+                tempN[i] = 0;
+            }
+            s.tsNs = acc.tsNs;
+            s.temp[0] = acc.temp[0];
+            s.temp[1] = acc.temp[1];
+            s.flags = acc.flags;
+            acc.flags = 0;
+        }
+        else
+        {
+            for(i = 0; i < 3; i++)
+            {
+                counts[i] = s.v[i];
+            }
+        }
+        for(i = 0; i < 3; i++)
+        {
+            counts[i] /= 10.0;
+        }
+        if(haveCal)
+        {
+            magCalApplyCounts(&cal, counts, xyz);
+        }
+        else
+        {
+            memcpy(xyz, counts, sizeof(xyz));
+        }
+        if(outDir != NULL)
+        {
+            emit(w, &s, xyz, f->written);
+        }
+        f->written++;
+    }
+    if(w->fp != NULL)
+    {
+        flushOut(w);
+        if(fclose(w->fp) != 0 || w->failed || rename(tmpPath, path) != 0)
+        {
+            fprintf(stderr, "magproc: %s not written\n", path);
+            unlink(tmpPath);
+            f->failed = 1;
+        }
+        w->fp = NULL;
+        w->failed = 0;
+    }
+done:
+    if(hf != NULL)
+    {
+        for(i = 0; i < 3; i++)
+        {
+            f->spikes += hf->spikes[i];
+        }
+        free(hf);
+    }
+    if(decimRatio > 1)
+    {
+        decimatorFree(&dec);
+    }
+    free(tsRing);
+    if(map != NULL)
+    {
+        munmap((void *)map, f->size);
+    }
+    f->secs = (nsNow() - t0) / 1e9;
+    w->records += f->records;
+    if(verbose)
+    {
+        pthread_mutex_lock(&reportLock);
+        fprintf(stderr, "magproc: %s: %llu records, %llu out, %llu bad lines, %llu spikes, %.0f records/s (thread %i)\n",
+                f->path, (unsigned long long)f->records, (unsigned long long)f->written, (unsigned long long)f->badLines,
+                (unsigned long long)f->spikes, f->secs > 0.0 ? f->records / f->secs : 0.0, w->id);
+        pthread_mutex_unlock(&reportLock);
+    }
+}
+
+//------------------------------------------
+// takeTask()
+// Front of our own deque, else the back of someone else's; -1 when all
+// are empty (no work is ever added, so that is the end).
+//------------------------------------------
+static int takeTask(procWorker *w)
+{
+    procDeque *q = &deques[w->id];
+    int task = -1;
+    int i;
+
+    pthread_mutex_lock(&q->lock);
+    if(q->head < q->tail)
+    {
+        task = q->task[q->head++];
+    }
+    pthread_mutex_unlock(&q->lock);
+    for(i = 1; task < 0 && i < nThreads; i++)
+    {
+        q = &deques[(w->id + i) % nThreads];
+        pthread_mutex_lock(&q->lock);
+        if(q->head < q->tail)
+        {
+            task = q->task[--q->tail];
+            w->steals++;
+        }
+        pthread_mutex_unlock(&q->lock);
+    }
+    return task;
+}
+
+//------------------------------------------
+// workerThread()
+//------------------------------------------
+static void *workerThread(void *arg)
+{
+    procWorker *w = (procWorker *)arg;
+    int task;
+
+    while((task = takeTask(w)) >= 0)
+    {
+        processFile(w, &files[task]);
+    }
+    return NULL;
+}
+
+//------------------------------------------
+// bySizeDesc()
+//------------------------------------------
+static int bySizeDesc(const void *a, const void *b)
+{
+    const procFile *fa = (const procFile *)a;
+    const procFile *fb = (const procFile *)b;
+
+    return (fa->size < fb->size) ? 1 : (fa->size > fb->size) ? -1 : 0;
+}
+
+//------------------------------------------
+// usage()
+//------------------------------------------
+static void usage(const char *prog)
+{
+    fprintf(stdout, "\n%s Version = %s\n", prog, MAGPROC_VERSION);
+    fprintf(stdout, "\nUsage: %s [options] <log> [<log> ..]\n", prog);
+    fprintf(stdout, "\nParameters:\n\n");
+    fprintf(stdout, "   -o <dir>               :  Write <dir>/<log name>.                [ required unless -n ]\n");
+    fprintf(stdout, "   -f <format>            :  csv, json or bin (magRecords).        [ default csv; bin appends .rec ]\n");
+    fprintf(stdout, "   -M                     :  Millisecond time stamps in csv/json.\n");
+    fprintf(stdout, "   -C <file>              :  Apply a calibration file.             [ offset and matrix, on the logged nT ]\n");
+    fprintf(stdout, "   -S <window>            :  Despike, Hampel window.               [ odd, %i to %i ]\n", HAMPEL_MINWINDOW, HAMPEL_MAXWINDOW);
+    fprintf(stdout, "   -K <k>                 :  Despike threshold, in sigmas.         [ default %.1f ]\n", HAMPEL_DEFK);
+    fprintf(stdout, "   -D <ratio>             :  Decimate by ratio.                    [ 2 to %i ]\n", DECIM_MAXRATIO);
+    fprintf(stdout, "   -F <filter>            :  Decimation filter.                    [ gauss (default), cic or boxcar ]\n");
+    fprintf(stdout, "   -k <n>                 :  CSV columns between time and X.       [ default 2; 1 for runMag -r/-l, 0 for -m ]\n");
+    fprintf(stdout, "   -j <n>                 :  Threads.                              [ default CPUs ]\n");
+    fprintf(stdout, "   -n                     :  Parse and process only, no output.\n");
+    fprintf(stdout, "   -v                     :  Report each file.\n");
+    fprintf(stdout, "   -h or -?               :  Display this help.\n\n");
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    procWorker *workers;
+    pthread_t *tid;
+    struct stat st;
+    const char *calPath = NULL;
+    uint64_t records = 0;
+    uint64_t written = 0;
+    uint64_t bad = 0;
+    uint64_t steals = 0;
+    double t0;
+    double secs;
+    int noOutput = 0;
+    int failed = 0;
+    int c;
+    int i;
+
+    while((c = getopt(argc, argv, "?C:D:f:F:hj:k:K:Mno:S:v")) != -1)
+    {
+        switch(c)
+        {
+            case 'C':
+                calPath = optarg;
+                break;
+            case 'D':
+                decimRatio = atoi(optarg);
+                break;
+            case 'f':
+                outFormat = !strcmp(optarg, "csv") ? FMT_CSV : !strcmp(optarg, "json") ? FMT_JSON : !strcmp(optarg, "bin") ? FMT_BIN : -1;
+                break;
+            case 'F':
+                decimType = parseDecimFilter(optarg);
+                break;
+            case 'j':
+                nThreads = atoi(optarg);
+                break;
+            case 'k':
+                skipCols = atoi(optarg);
+                break;
+            case 'K':
+                despikeK = atof(optarg);
+                break;
+            case 'M':
+                msTimes = 1;
+                break;
+            case 'n':
+                noOutput = 1;
+                break;
+            case 'o':
+                outDir = optarg;
+                break;
+            case 'S':
+                despikeWindow = atoi(optarg);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(outFormat < 0 || decimType < 0 || decimRatio < 1 || decimRatio > DECIM_MAXRATIO || skipCols < 0 ||
+       despikeK <= 0.0 || nThreads < 0 || nThreads > MAGPROC_MAXTHREADS ||
+       (despikeWindow && (despikeWindow < HAMPEL_MINWINDOW || despikeWindow > HAMPEL_MAXWINDOW || !(despikeWindow & 1))) ||
+       (outDir == NULL) != noOutput || optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if(calPath != NULL)
+    {
+        magCalInitUnit(&cal);
+        if(magCalLoad(&cal, calPath) != 0)
+        {
+            return 1;
+        }
+        haveCal = 1;
+    }
+    nFiles = argc - optind;
+    if((files = calloc(nFiles, sizeof(procFile))) == NULL)
+    {
+        perror("magproc");
+        return 1;
+    }
+    for(i = 0; i < nFiles; i++)
+    {
+        files[i].path = argv[optind + i];
+        files[i].size = (stat(files[i].path, &st) == 0) ? st.st_size : 0;
+    }
+    qsort(files, nFiles, sizeof(procFile), bySizeDesc);
+    if(nThreads == 0)
+    {
+        nThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    nThreads = (nThreads < 1) ? 1 : (nThreads > nFiles) ? nFiles : nThreads;
+    workers = calloc(nThreads, sizeof(procWorker));
+    deques = calloc(nThreads, sizeof(procDeque));
+    tid = calloc(nThreads, sizeof(pthread_t));
+    if(workers == NULL || deques == NULL || tid == NULL)
+    {
+        perror("magproc");
+        return 1;
+    }
+    // Largest first, dealt round robin.
+    for(i = 0; i < nThreads; i++)
+    {
+        pthread_mutex_init(&deques[i].lock, NULL);
+        if((deques[i].task = malloc(((nFiles + nThreads - 1) / nThreads) * sizeof(int))) == NULL ||
+           (workers[i].out = malloc(MAGPROC_OUTBUF)) == NULL)
+        {
+            perror("magproc");
+            return 1;
+        }
+        workers[i].id = i;
+    }
+    for(i = 0; i < nFiles; i++)
+    {
+        deques[i % nThreads].task[deques[i % nThreads].tail++] = i;
+    }
+    t0 = nsNow();
+    for(i = 0; i < nThreads; i++)
+    {
+        pthread_create(&tid[i], NULL, workerThread, &workers[i]);
+    }
+    for(i = 0; i < nThreads; i++)
+    {
+        pthread_join(tid[i], NULL);
+        steals += workers[i].steals;
+        free(workers[i].out);
+        free(deques[i].task);
+    }
+    secs = (nsNow() - t0) / 1e9;
+    for(i = 0; i < nFiles; i++)
+    {
+        records += files[i].records;
+        written += files[i].written;
+        bad += files[i].badLines;
+        failed |= files[i].failed;
+    }
+    fprintf(stderr, "magproc: %i files, %llu records in, %llu out, %llu bad lines in %.2f s on %i threads (%llu steals): %.0f records/s, %.0f per thread\n",
+            nFiles, (unsigned long long)records, (unsigned long long)written, (unsigned long long)bad, secs, nThreads,
+            (unsigned long long)steals, secs > 0.0 ? records / secs : 0.0, secs > 0.0 ? records / secs / nThreads : 0.0);
+    free(workers);
+    free(deques);
+    free(tid);
+    free(files);
+    return failed;
+}
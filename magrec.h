@@ -0,0 +1,60 @@
+//=========================================================================
+// magrec.h
+//
+// Fixed size binary sample record shared by runMag's binary outputs
+// and by the programs that read them.  Kept free of the I2C headers so
+// readers can include it on their own.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100MAGREC_h
+#define SWX3100MAGREC_h
+
+#include <stdint.h>
+
+#define MAGREC_TEMP_INVALID     (-9999.0f)
+
+// flags
+#define MAGREC_F_RTEMP          0x0001      // rcTemp valid
+#define MAGREC_F_LTEMP          0x0002      // lcTemp valid
+#define MAGREC_F_SPIKEX         0x0010      // despiked (or marked) X; Y and Z follow
+#define MAGREC_F_SPIKEY         0x0020
+#define MAGREC_F_SPIKEZ         0x0040
+
+//------------------------------------------
+// One sample, 64 bytes, host byte order.
+//------------------------------------------
+typedef struct tag_magRecord
+{
+    uint64_t    seq;                        // sample sequence number
+    int64_t     tsNs;                       // acquisition time, ns since the epoch (UTC)
+    int32_t     rXYZ[3];                    // raw counts
+    uint32_t    flags;
+    double      xyz[3];                     // field, nT
+    float       rcTemp;                     // remote temperature, C
+    float       lcTemp;                     // local temperature, C
+} magRecord;
+
+typedef char magRecordSizeCheck[(sizeof(magRecord) == 64) ? 1 : -1];
+
+//------------------------------------------
+// One rollup interval (runMag --rollup), 80 bytes, host byte order.
+// Channels are X, Y, Z and the total field F, all nT.  After a restart
+// an interval can appear twice; combine such rows by count.
+//------------------------------------------
+typedef struct tag_rollRecord
+{
+    int64_t     start;                      // interval start, s since the epoch (UTC)
+    uint32_t    seconds;                    // interval length: 60, 3600 or 86400
+    uint32_t    count;                      // samples
+    float       min[4];
+    float       max[4];
+    float       mean[4];
+    float       sd[4];                      // sample standard deviation
+} rollRecord;
+
+typedef char rollRecordSizeCheck[(sizeof(rollRecord) == 80) ? 1 : -1];
+
+#endif // SWX3100MAGREC_h
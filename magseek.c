@@ -0,0 +1,199 @@
+//=========================================================================
+// magseek.c
+//
+// Prints the lines of runMag logs in a time range, using the sidecar
+// index (runMag --log-index) to start reading no more than one stride
+// of lines before the range.
+//
+//      magseek -b 2026-10-19T13:05:00 -e 2026-10-19T13:20:00 <log> ..
+//      magseek -i [-s stride] <log> ..         build or refresh indexes
+//
+// Without an index a log is read from the start.  Lines are assumed to
+// be in time order: reading stops at the first line at or after -e.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#define _GNU_SOURCE                 // strptime(), timegm()
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "logidx.h"
+
+#define MAGSEEK_VERSION "0.1.2"
+
+//------------------------------------------
+// parseQueryTime()
+// 2026-10-19, 2026-10-19T13:05:00 (or a space) or epoch seconds; UTC.
+//------------------------------------------
+static int64_t parseQueryTime(const char *s)
+{
+    struct tm tm;
+    const char *end;
+    char *numEnd;
+    long long secs;
+
+    secs = strtoll(s, &numEnd, 10);
+    if(numEnd > s && *numEnd == '\0')
+    {
+        return secs * 1000;
+    }
+    memset(&tm, 0, sizeof(tm));
+    if((end = strptime(s, "%Y-%m-%d", &tm)) == NULL)
+    {
+        return -1;
+    }
+    if((*end == 'T' || *end == ' ') && (end = strptime(end + 1, "%H:%M:%S", &tm)) == NULL)
+    {
+        return -1;
+    }
+    if(*end != '\0' && strcmp(end, "Z") != 0)
+    {
+        return -1;
+    }
+    return (int64_t)timegm(&tm) * 1000;
+}
+
+//------------------------------------------
+// printRange()
+//------------------------------------------
+static int printRange(const char *path, int64_t begin, int64_t end, int verbose)
+{
+    char line[LOGIDX_LINELEN];
+    unsigned long read = 0;
+    unsigned long printed = 0;
+    int lineStart = 1;
+    int inRange = 0;
+    int64_t ts;
+    size_t len;
+    FILE *fp;
+    int indexed;
+
+    if((fp = fopen(path, "r")) == NULL)
+    {
+        fprintf(stderr, "magseek: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    indexed = (logIndexSeek(fp, path, begin) == 0);
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        len = strlen(line);
+        if(lineStart && (ts = logIndexParseTime(line)) >= 0)
+        {
+            read++;
+            if(ts >= end)
+            {
+                break;
+            }
+            inRange = (ts >= begin);
+        }
+        else if(lineStart)
+        {
+            inRange = 0;
+        }
+        if(inRange)
+        {
+            fputs(line, stdout);
+            printed += lineStart;
+        }
+        lineStart = (len > 0 && line[len - 1] == '\n');
+    }
+    fclose(fp);
+    if(verbose)
+    {
+        fprintf(stderr, "magseek: %s: %s, %lu lines read, %lu printed\n", path, indexed ? "indexed" : "no index", read, printed);
+    }
+    return 0;
+}
+
+//------------------------------------------
+// usage()
+//------------------------------------------
+static void usage(const char *prog)
+{
+    fprintf(stdout, "\n%s Version = %s\n", prog, MAGSEEK_VERSION);
+    fprintf(stdout, "\nUsage: %s [options] <log> [<log> ..]\n", prog);
+    fprintf(stdout, "\nParameters:\n\n");
+    fprintf(stdout, "   -b <time>              :  From, UTC.                            [ 2026-10-19, 2026-10-19T13:05:00 or epoch s ]\n");
+    fprintf(stdout, "   -e <time>              :  Until, UTC, not included.\n");
+    fprintf(stdout, "   -i                     :  Build or refresh the indexes instead.\n");
+    fprintf(stdout, "   -s <s>                 :  Index stride with -i.                 [ default 60 ]\n");
+    fprintf(stdout, "   -v                     :  Report lines read to stderr.\n");
+    fprintf(stdout, "   -h or -?               :  Display this help.\n\n");
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    logIndex li;
+    int64_t begin = INT64_MIN;
+    int64_t end = INT64_MAX;
+    int64_t t;
+    int stride = LOGIDX_DEFSTRIDE;
+    int build = 0;
+    int verbose = 0;
+    int failed = 0;
+    int c;
+    int i;
+
+    while((c = getopt(argc, argv, "?b:e:his:v")) != -1)
+    {
+        switch(c)
+        {
+            case 'b':
+            case 'e':
+                if((t = parseQueryTime(optarg)) < 0)
+                {
+                    fprintf(stderr, "magseek: bad time %s\n", optarg);
+                    return 1;
+                }
+                *((c == 'b') ? &begin : &end) = t;
+                break;
+            case 'i':
+                build = 1;
+                break;
+            case 's':
+                stride = atoi(optarg);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(stride < 1 || stride > LOGIDX_MAXSTRIDE || optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    for(i = optind; i < argc; i++)
+    {
+        if(!build)
+        {
+            failed |= printRange(argv[i], begin, end, verbose);
+            continue;
+        }
+        if(logIndexOpen(&li, argv[i], NULL, stride) != 0)
+        {
+            fprintf(stderr, "magseek: %s: %s\n", argv[i], strerror(errno));
+            failed = 1;
+            continue;
+        }
+        if(verbose)
+        {
+            fprintf(stderr, "magseek: %s: %lu entries\n", argv[i], li.entries);
+        }
+        logIndexClose(&li);
+    }
+    return failed;
+}
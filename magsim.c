@@ -0,0 +1,340 @@
+//=========================================================================
+// magsim.c
+//
+// Simulated runMag stations for trying magagg without hardware.
+//
+//      magsim -n 50 -u 127.0.0.1:5800          50 stations on --udp
+//      magsim -n 50 -t 127.0.0.1:6000          station i on --tcp port 6000+i
+//
+// Each station is its own netServer, so what goes on the wire is what
+// runMag sends.  Station i is named <prefix>NNN and stamps its samples
+// i * -c ms ahead of this host's clock.  The field is a slow sine on X
+// with a step per station, so merged lines can be told apart.
+//
+// Faults for the aggregator to find: -l drops a share of the samples
+// (the sequence number still moves on), -d sends a share of them twice,
+// and -R starts the first station's sequence again at 0 every so many
+// seconds, as runMag does when it restarts without --journal.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "netserve.h"
+
+#define MAGSIM_VERSION "0.1.2"
+
+#define MAGSIM_MAXSTATIONS      1000
+#define MAGSIM_DEFSTATIONS      4
+#define MAGSIM_MAXRATE          100
+#define MAGSIM_POLLNS           20000000LL  // longest sleep between netServePoll()s
+#define MAGSIM_GAIN             75.0        // counts/uT at cycle count 200
+
+//------------------------------------------
+// One simulated station
+//------------------------------------------
+typedef struct tag_simStation
+{
+    netServer       ns;
+    char            site[NETSERVE_SITELEN + 1];
+    char            tcpSpec[288];
+    uint64_t        seq;
+    unsigned long   sent;
+    unsigned long   dropped;
+    unsigned long   doubled;
+    unsigned long   restarts;
+} simStation;
+
+static volatile sig_atomic_t stopping = 0;
+
+//------------------------------------------
+// onSignal()
+//------------------------------------------
+static void onSignal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+//------------------------------------------
+// nowNs()
+//------------------------------------------
+static int64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//------------------------------------------
+// sleepUntil()
+//------------------------------------------
+static void sleepUntil(int64_t ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(ns / 1000000000LL);
+    ts.tv_nsec = (long)(ns % 1000000000LL);
+    while(clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL) == EINTR && !stopping)
+    {
+    }
+}
+
+//------------------------------------------
+// tcpPortSpec()
+// "[addr:]port" moved on by n ports.
+//------------------------------------------
+static int tcpPortSpec(char *out, size_t len, const char *base, int n)
+{
+    const char *colon = strrchr(base, ':');
+    const char *port = (colon != NULL) ? colon + 1 : base;
+    int hostLen = (colon != NULL) ? (int)(colon - base) : 0;
+    int p = atoi(port);
+
+    if(p <= 0 || p + n > 65535)
+    {
+        fprintf(stderr, "magsim: bad TCP port in %s\n", base);
+        return -1;
+    }
+    snprintf(out, len, "%.*s%s%i", hostLen, base, (colon != NULL) ? ":" : "", p + n);
+    return 0;
+}
+
+//------------------------------------------
+// makeRecord()
+//------------------------------------------
+static void makeRecord(magRecord *rec, int st, uint64_t seq, int64_t tsNs)
+{
+    double t = tsNs / 1e9;
+    int i;
+
+    memset(rec, 0, sizeof(magRecord));
+    rec->seq = seq;
+    rec->tsNs = tsNs;
+    rec->flags = MAGREC_F_RTEMP | MAGREC_F_LTEMP;
+    rec->xyz[0] = 20000.0 + 50.0 * sin(2.0 * M_PI * t / 600.0) + st;
+    rec->xyz[1] = 1500.0;
+    rec->xyz[2] = 50000.0;
+    for(i = 0; i < 3; i++)
+    {
+        rec->rXYZ[i] = (int32_t)lround(rec->xyz[i] * MAGSIM_GAIN / 1000.0);
+    }
+    rec->rcTemp = 24.5f;
+    rec->lcTemp = 21.0f;
+}
+
+//------------------------------------------
+// usage()
+//------------------------------------------
+static void usage(const char *prog)
+{
+    fprintf(stdout, "\n%s Version = %s\n", prog, MAGSIM_VERSION);
+    fprintf(stdout, "\nUsage: %s -u <host:port> | -t <[addr:]port> [options]\n", prog);
+    fprintf(stdout, "\nParameters:\n\n");
+    fprintf(stdout, "   -u <host:port>         :  Send each station's --udp batches here.\n");
+    fprintf(stdout, "   -t <[addr:]port>       :  Station i listens as --tcp on port + i.\n");
+    fprintf(stdout, "   -n <count>             :  Stations.                             [ default %i, at most %i ]\n", MAGSIM_DEFSTATIONS, MAGSIM_MAXSTATIONS);
+    fprintf(stdout, "   -r <Hz>                :  Samples per second per station.       [ default 1, at most %i ]\n", MAGSIM_MAXRATE);
+    fprintf(stdout, "   -s <s>                 :  Run this long, then stop.             [ default until killed ]\n");
+    fprintf(stdout, "   -p <prefix>            :  Site names are <prefix>NNN.           [ default SIM ]\n");
+    fprintf(stdout, "   -b <count>             :  Records per batch.                    [ default %i, at most %i ]\n", NETSERVE_DEFBATCH, NETSERVE_MAXBATCH);
+    fprintf(stdout, "   -c <ms>                :  Station i's clock is i * ms ahead.    [ default 0 ]\n");
+    fprintf(stdout, "   -l <percent>           :  Samples lost.                         [ default 0 ]\n");
+    fprintf(stdout, "   -d <percent>           :  Samples sent twice.                   [ default 0 ]\n");
+    fprintf(stdout, "   -R <s>                 :  First station restarts this often.    [ default never ]\n");
+    fprintf(stdout, "   -v                     :  Report what was sent at the end.\n");
+    fprintf(stdout, "   -h or -?               :  Display this help.\n\n");
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    simStation *stations;
+    simStation *s;
+    magRecord rec;
+    pList p;
+    struct sigaction sa;
+    const char *udpDest = NULL;
+    const char *tcpBase = NULL;
+    const char *prefix = "SIM";
+    unsigned int seed = (unsigned int)time(NULL);
+    int64_t periodNs;
+    int64_t startNs;
+    int64_t tickNs;
+    int64_t wakeNs;
+    int64_t now;
+    int64_t endNs = 0;
+    int64_t restartNs = 0;
+    int64_t nextRestart = 0;
+    double lossPct = 0.0;
+    double dupPct = 0.0;
+    int nStations = MAGSIM_DEFSTATIONS;
+    int rate = 1;
+    int seconds = 0;
+    int batch = NETSERVE_DEFBATCH;
+    int offsetMs = 0;
+    int verbose = 0;
+    int c;
+    int i;
+
+    while((c = getopt(argc, argv, "?b:c:d:hl:n:p:r:R:s:t:u:v")) != -1)
+    {
+        switch(c)
+        {
+            case 'b':
+                batch = atoi(optarg);
+                break;
+            case 'c':
+                offsetMs = atoi(optarg);
+                break;
+            case 'd':
+                dupPct = atof(optarg);
+                break;
+            case 'l':
+                lossPct = atof(optarg);
+                break;
+            case 'n':
+                nStations = atoi(optarg);
+                break;
+            case 'p':
+                prefix = optarg;
+                break;
+            case 'r':
+                rate = atoi(optarg);
+                break;
+            case 'R':
+                restartNs = (int64_t)atoi(optarg) * 1000000000LL;
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+            case 't':
+                tcpBase = optarg;
+                break;
+            case 'u':
+                udpDest = optarg;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if((udpDest == NULL) == (tcpBase == NULL) || nStations < 1 || nStations > MAGSIM_MAXSTATIONS ||
+       rate < 1 || rate > MAGSIM_MAXRATE || batch < 1 || batch > NETSERVE_MAXBATCH ||
+       lossPct < 0.0 || lossPct > 100.0 || dupPct < 0.0 || dupPct > 100.0 || restartNs < 0 || seconds < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if((stations = calloc(nStations, sizeof(simStation))) == NULL)
+    {
+        perror("magsim");
+        return 1;
+    }
+
+    // Each station gets the options runMag would have been started with.
+    memset(&p, 0, sizeof(p));
+    p.udpDest = (char *)udpDest;
+    p.udpTtl = NETSERVE_DEFTTL;
+    p.netBatch = batch;
+    p.netLingerMs = NETSERVE_DEFLINGER;
+    p.tcpQueueKB = NETSERVE_DEFQUEUE;
+    for(i = 0; i < nStations; i++)
+    {
+        s = &stations[i];
+        snprintf(s->site, sizeof(s->site), "%.12s%03u", prefix, (unsigned)i % 1000);
+        p.sitePrefix = s->site;
+        p.tcpListen = NULL;
+        if(tcpBase != NULL)
+        {
+            if(tcpPortSpec(s->tcpSpec, sizeof(s->tcpSpec), tcpBase, i) != 0)
+            {
+                return 1;
+            }
+            p.tcpListen = s->tcpSpec;
+        }
+        if(netServeOpen(&s->ns, &p) != 0)
+        {
+            fprintf(stderr, "magsim: station %s could not open its stream.\n", s->site);
+            return 1;
+        }
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // Samples fall on whole multiples of the period, like runMag's.
+    periodNs = 1000000000LL / rate;
+    startNs = nowNs();
+    tickNs = (startNs / periodNs + 1) * periodNs;
+    endNs = seconds ? startNs + (int64_t)seconds * 1000000000LL : 0;
+    nextRestart = restartNs ? startNs + restartNs : 0;
+    while(!stopping && (endNs == 0 || tickNs < endNs))
+    {
+        // Keep the TCP listeners and lingering batches serviced while
+        // waiting for the next sample.
+        while(!stopping && (now = nowNs()) < tickNs)
+        {
+            wakeNs = (tickNs - now > MAGSIM_POLLNS) ? now + MAGSIM_POLLNS : tickNs;
+            sleepUntil(wakeNs);
+            for(i = 0; i < nStations; i++)
+            {
+                netServePoll(&stations[i].ns);
+            }
+        }
+        if(nextRestart && tickNs >= nextRestart)
+        {
+            stations[0].seq = 0;
+            stations[0].restarts++;
+            nextRestart += restartNs;
+        }
+        for(i = 0; i < nStations; i++)
+        {
+            s = &stations[i];
+            makeRecord(&rec, i, s->seq++, tickNs + (int64_t)i * offsetMs * 1000000LL);
+            if(lossPct > 0.0 && rand_r(&seed) < lossPct / 100.0 * RAND_MAX)
+            {
+                s->dropped++;
+                continue;
+            }
+            netServePublish(&s->ns, &rec);
+            s->sent++;
+            if(dupPct > 0.0 && rand_r(&seed) < dupPct / 100.0 * RAND_MAX)
+            {
+                netServePublish(&s->ns, &rec);
+                s->doubled++;
+            }
+        }
+        tickNs += periodNs;
+    }
+
+    for(i = 0; i < nStations; i++)
+    {
+        s = &stations[i];
+        netServeClose(&s->ns);
+        if(verbose)
+        {
+            fprintf(stdout, "%s: sent %lu, lost %lu, sent twice %lu, restarts %lu\n",
+                    s->site, s->sent, s->dropped, s->doubled, s->restarts);
+        }
+    }
+    free(stations);
+    return 0;
+}
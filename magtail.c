@@ -0,0 +1,346 @@
+//=========================================================================
+// magtail.c
+//
+// tail(1) for the runMag shared memory ring (runMag --shm).
+//
+// Prints the last few samples and, with -f, keeps printing new ones as
+// runMag publishes them.  Reading the ring needs no system calls; while
+// caught up we sleep a fraction of a sample period between polls.
+//
+// With -t or -u it follows runMag's TCP or UDP stream (--tcp, --udp)
+// instead, and reports batches lost in transit.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include "shmring.h"
+#include "netserve.h"
+
+#define MAGTAIL_VERSION "0.1.2"
+
+//------------------------------------------
+// printRecord()
+//------------------------------------------
+static void printRecord(const magRecord *rec, int json)
+{
+    char utcStr[64] = "";
+    time_t secs = (time_t)(rec->tsNs / 1000000000LL);
+    int millis = (int)((rec->tsNs / 1000000LL) % 1000);
+    struct tm utcTime;
+
+    gmtime_r(&secs, &utcTime);
+    strftime(utcStr, sizeof(utcStr), "%Y-%m-%dT%H:%M:%S", &utcTime);
+    if(json)
+    {
+        fprintf(stdout, "{ \"seq\":%llu, \"ts\":\"%s.%03dZ\"", (unsigned long long)rec->seq, utcStr, millis);
+        if(rec->flags & MAGREC_F_RTEMP)
+        {
+            fprintf(stdout, ", \"rt\":%.2f", rec->rcTemp);
+        }
+        if(rec->flags & MAGREC_F_LTEMP)
+        {
+            fprintf(stdout, ", \"lt\":%.2f", rec->lcTemp);
+        }
+        fprintf(stdout, ", \"x\":%.3f, \"y\":%.3f, \"z\":%.3f, \"rx\":%d, \"ry\":%d, \"rz\":%d }\n",
+                rec->xyz[0], rec->xyz[1], rec->xyz[2], rec->rXYZ[0], rec->rXYZ[1], rec->rXYZ[2]);
+    }
+    else
+    {
+        fprintf(stdout, "%llu, %s.%03dZ", (unsigned long long)rec->seq, utcStr, millis);
+        if(rec->flags & MAGREC_F_RTEMP)
+        {
+            fprintf(stdout, ", %.2f", rec->rcTemp);
+        }
+        else
+        {
+            fprintf(stdout, ", \"\"");
+        }
+        if(rec->flags & MAGREC_F_LTEMP)
+        {
+            fprintf(stdout, ", %.2f", rec->lcTemp);
+        }
+        else
+        {
+            fprintf(stdout, ", \"\"");
+        }
+        fprintf(stdout, ", %.3f, %.3f, %.3f, %d, %d, %d\n",
+                rec->xyz[0], rec->xyz[1], rec->xyz[2], rec->rXYZ[0], rec->rXYZ[1], rec->rXYZ[2]);
+    }
+}
+
+//------------------------------------------
+// checkBatchSeq()
+//------------------------------------------
+static void checkBatchSeq(const char *prog, const netBatchHdr *hdr, uint64_t *next, int *started)
+{
+    if(*started && hdr->batchSeq != *next)
+    {
+        if(hdr->batchSeq > *next)
+        {
+            fprintf(stderr, "%s: %llu batches lost\n", prog, (unsigned long long)(hdr->batchSeq - *next));
+        }
+        else
+        {
+            fprintf(stderr, "%s: sender restarted\n", prog);
+        }
+    }
+    *started = 1;
+    *next = hdr->batchSeq + 1;
+}
+
+//------------------------------------------
+// readFull()
+//------------------------------------------
+static int readFull(int fd, uint8_t *buf, size_t len)
+{
+    ssize_t n;
+
+    while(len > 0)
+    {
+        if((n = read(fd, buf, len)) <= 0)
+        {
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// followTcp()
+//------------------------------------------
+static int followTcp(const char *prog, const char *spec, int json)
+{
+    struct sockaddr_storage ss;
+    socklen_t len;
+    uint8_t buf[NETSERVE_FRAMELEN];
+    magRecord recs[NETSERVE_MAXBATCH];
+    netBatchHdr hdr;
+    uint64_t next = 0;
+    uint32_t frameLen;
+    int started = 0;
+    int fd;
+    int n;
+    int i;
+
+    if(netParseAddr(spec, 0, SOCK_STREAM, &ss, &len) != 0)
+    {
+        return 1;
+    }
+    if((fd = socket(ss.ss_family, SOCK_STREAM, 0)) < 0 || connect(fd, (struct sockaddr *)&ss, len) != 0)
+    {
+        fprintf(stderr, "%s: cannot connect to %s: %s\n", prog, spec, strerror(errno));
+        return 1;
+    }
+    while(readFull(fd, buf, 4) == 0)
+    {
+        frameLen = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+        if(frameLen > sizeof(buf) || readFull(fd, buf, frameLen) != 0)
+        {
+            break;
+        }
+        if((n = netBatchDecode(buf, frameLen, &hdr, recs, NETSERVE_MAXBATCH)) < 0)
+        {
+            fprintf(stderr, "%s: bad batch from %s\n", prog, spec);
+            break;
+        }
+        checkBatchSeq(prog, &hdr, &next, &started);
+        for(i = 0; i < n; i++)
+        {
+            printRecord(&recs[i], json);
+        }
+        fflush(stdout);
+    }
+    close(fd);
+    fprintf(stderr, "%s: connection to %s closed\n", prog, spec);
+    return 0;
+}
+
+//------------------------------------------
+// followUdp()
+// Binds the port and, for a multicast group, joins it.
+//------------------------------------------
+static int followUdp(const char *prog, const char *spec, int json)
+{
+    struct sockaddr_storage ss;
+    socklen_t len;
+    uint8_t buf[NETSERVE_FRAMELEN];
+    magRecord recs[NETSERVE_MAXBATCH];
+    netBatchHdr hdr;
+    uint64_t next = 0;
+    int started = 0;
+    int on = 1;
+    ssize_t got;
+    int fd;
+    int n;
+    int i;
+
+    if(netParseAddr(spec, 1, SOCK_DGRAM, &ss, &len) != 0)
+    {
+        return 1;
+    }
+    if((fd = socket(ss.ss_family, SOCK_DGRAM, 0)) < 0)
+    {
+        perror("socket()");
+        return 1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if(bind(fd, (struct sockaddr *)&ss, len) != 0)
+    {
+        fprintf(stderr, "%s: cannot bind %s: %s\n", prog, spec, strerror(errno));
+        return 1;
+    }
+    if(ss.ss_family == AF_INET && IN_MULTICAST(ntohl(((struct sockaddr_in *)&ss)->sin_addr.s_addr)))
+    {
+        struct ip_mreq mreq;
+
+        mreq.imr_multiaddr = ((struct sockaddr_in *)&ss)->sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
+    else if(ss.ss_family == AF_INET6 && IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *)&ss)->sin6_addr))
+    {
+        struct ipv6_mreq mreq;
+
+        mreq.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&ss)->sin6_addr;
+        mreq.ipv6mr_interface = 0;
+        setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq));
+    }
+    while((got = recv(fd, buf, sizeof(buf), 0)) >= 0)
+    {
+        if((n = netBatchDecode(buf, got, &hdr, recs, NETSERVE_MAXBATCH)) < 0)
+        {
+            continue;
+        }
+        checkBatchSeq(prog, &hdr, &next, &started);
+        for(i = 0; i < n; i++)
+        {
+            printRecord(&recs[i], json);
+        }
+        fflush(stdout);
+    }
+    close(fd);
+    return 0;
+}
+
+//------------------------------------------
+// usage()
+//------------------------------------------
+static void usage(const char *prog)
+{
+    fprintf(stdout, "\n%s Version = %s\n", prog, MAGTAIL_VERSION);
+    fprintf(stdout, "\nParameters:\n\n");
+    fprintf(stdout, "   -f                     :  Follow: keep printing new samples.\n");
+    fprintf(stdout, "   -j                     :  Format output as JSON.\n");
+    fprintf(stdout, "   -n <count>             :  Start this many samples back.         [ default 10 ]\n");
+    fprintf(stdout, "   -s <name>              :  Shared memory ring name.              [ default %s ]\n", SHMRING_DEFNAME);
+    fprintf(stdout, "   -t <host:port>         :  Follow runMag --tcp instead.\n");
+    fprintf(stdout, "   -u <[addr:]port>       :  Follow runMag --udp instead.          [ addr may be a multicast group ]\n");
+    fprintf(stdout, "   -h or -?               :  Display this help.\n\n");
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    const char *name = SHMRING_DEFNAME;
+    const char *tcpSpec = NULL;
+    const char *udpSpec = NULL;
+    shmRingReader r;
+    magRecord rec;
+    uint64_t back = 10;
+    uint64_t lost = 0;
+    useconds_t idle;
+    double rate;
+    int follow = 0;
+    int json = 0;
+    int c;
+
+    while((c = getopt(argc, argv, "?fhjn:s:t:u:")) != -1)
+    {
+        switch(c)
+        {
+            case 'f':
+                follow = 1;
+                break;
+            case 'j':
+                json = 1;
+                break;
+            case 'n':
+                back = strtoull(optarg, NULL, 10);
+                break;
+            case 's':
+                name = optarg;
+                break;
+            case 't':
+                tcpSpec = optarg;
+                break;
+            case 'u':
+                udpSpec = optarg;
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(tcpSpec != NULL)
+    {
+        return followTcp(argv[0], tcpSpec, json);
+    }
+    if(udpSpec != NULL)
+    {
+        return followUdp(argv[0], udpSpec, json);
+    }
+    if(shmRingAttach(&r, name) != 0)
+    {
+        fprintf(stderr, "%s: cannot attach to ring %s: %s\n", argv[0], name, strerror(errno));
+        return 1;
+    }
+    rate = (r.hdr->sampleRate > 0.0) ? r.hdr->sampleRate : 1.0;
+    idle = (useconds_t)(250000.0 / rate);
+    if(idle < 1000)
+    {
+        idle = 1000;
+    }
+    else if(idle > 100000)
+    {
+        idle = 100000;
+    }
+    shmRingSeekTail(&r, back);
+    while(1)
+    {
+        while(shmRingRead(&r, &rec))
+        {
+            printRecord(&rec, json);
+        }
+        if(r.lost != lost)
+        {
+            fprintf(stderr, "%s: overrun, %llu samples lost\n", argv[0], (unsigned long long)(r.lost - lost));
+            lost = r.lost;
+        }
+        if(!follow)
+        {
+            break;
+        }
+        fflush(stdout);
+        usleep(idle);
+    }
+    shmRingDetach(&r);
+    return 0;
+}
@@ -13,8 +13,31 @@
 // Date:        May 12, 2020
 // License:     GPL 3.0
 //=========================================================================
+#include <stdarg.h>
+#include <sys/epoll.h>
 #include "cmdmgr.h"
 #include "main.h"
+#include "logroll.h"
+#include "mseed.h"
+#include "pipeout.h"
+#include "shmring.h"
+#include "netserve.h"
+#include "decimate.h"
+#include "magcal.h"
+#include "hampel.h"
+#include "psd.h"
+#include "dbdt.h"
+#include "capture.h"
+#include "resample.h"
+#include "tempcomp.h"
+#include "kindex.h"
+#include "sweep.h"
+#include "rollup.h"
+#include "logidx.h"
+#include "history.h"
+#include "journal.h"
+#include "evloop.h"
+#include "metrics.h"
 
 //------------------------------------------
 // Static variables
@@ -24,11 +47,24 @@ char outFilePath[MAXPATHBUFLEN] = "./logs/";
 char workFilePath[MAXPATHBUFLEN] = "";
 char rollOverTime[UTCBUFLEN] = "00:00";
 char sitePrefixString[SITEPREFIXLEN] = "SITEPREFIX";
-#if (USE_PIPES)
-char outputPipeName[MAXPATHBUFLEN] = "/home/web/wsroot/pipein.fifo";
-char inputPipeName[MAXPATHBUFLEN] = "/home/web/wsroot/pipeout.fifo";
-#endif
-static char  mSamples[9];
+char outputPipeName[MAXPATHBUFLEN] = PIPEOUT_DEFPATH;
+static uint8_t mSamples[MAGCAL_RAWLEN];
+static const int loopSignals[] = { SIGINT, SIGTERM, SIGHUP, SIGUSR1, 0 };
+static runMetrics met;
+
+//------------------------------------------
+// Event loop ids
+//------------------------------------------
+enum
+{
+    EV_TICK = EVLOOP_SIGNAL + 1,            // sample cadence
+    EV_XFER,                                // sensor deadline
+    EV_LINGER,                              // partial network batch due
+    EV_PIPE,
+    EV_CAPTURE,
+    EV_NETLISTEN,
+    EV_NETCLIENT,                           // .. + NETSERVE_MAXCLIENTS - 1
+};
 
 //------------------------------------------
 // readTemp()
@@ -36,12 +72,10 @@ static char  mSamples[9];
 int readTemp(pList *p, int devAddr)
 {
     int temp = -9999;
-    char data[2] = {0};
-    char reg[1] = {MCP9808_REG_AMBIENT_TEMP};
+    uint8_t data[2] = {0};
 
     i2c_setAddress(p->i2c_fd, devAddr);
-    write(p->i2c_fd, reg, 1);
-    if(read(p->i2c_fd, data, 2) != 2)
+    if(i2c_readbuf(p->i2c_fd, MCP9808_REG_AMBIENT_TEMP, data, 2) != 2)
     {
         fprintf(stderr, "Error : I/O error reading temp sensor at address: [0x%2X].\n", devAddr);
     }
@@ -75,17 +109,7 @@ int readMagCMM(pList *p, int devAddr, int32_t *XYZ)
     {
         perror("i2c transaction i2c_readbuf() failed.\n");
     }
-    XYZ[0] = ((signed char)mSamples[0]) * 256 * 256;
-    XYZ[0] |= mSamples[1] * 256;
-    XYZ[0] |= mSamples[2];
-
-    XYZ[1] = ((signed char)mSamples[3]) * 256 * 256;
-    XYZ[1] |= mSamples[4] * 256;
-    XYZ[1] |= mSamples[5];
-
-    XYZ[2] = ((signed char)mSamples[6]) * 256 * 256;
-    XYZ[2] |= mSamples[7] * 256;
-    XYZ[2] |= mSamples[8];
+    magDecode(mSamples, XYZ, 1);
 
     return bytes_read;
 }
@@ -116,354 +140,1410 @@ int readMagPOLL(pList *p, int devAddr, int32_t *XYZ)
     {
         perror("i2c transaction i2c_readbuf() failed.\n");
     }
-    XYZ[0] = ((signed char)mSamples[0]) * 256 * 256;
-    XYZ[0] |= mSamples[1] * 256;
-    XYZ[0] |= mSamples[2];
-
-    XYZ[1] = ((signed char)mSamples[3]) * 256 * 256;
-    XYZ[1] |= mSamples[4] * 256;
-    XYZ[1] |= mSamples[5];
-
-    XYZ[2] = ((signed char)mSamples[6]) * 256 * 256;
-    XYZ[2] |= mSamples[7] * 256;
-    XYZ[2] |= mSamples[8];
+    magDecode(mSamples, XYZ, 1);
 
     return bytes_read;
 }
 
 //------------------------------------------
-//  main()
+// despikeSample()
+// Runs the Hampel test on the raw counts, keeping the originals.
 //------------------------------------------
-int main(int argc, char** argv)
+static void despikeSample(hampelFilter *hf, magSample *smp)
 {
-    pList p;
-    char utcStr[UTCBUFLEN] = "";
-    //long runTime = 0;
-    int currentDay = 0;
-    struct tm *utcTime = getUTC();
-    int32_t rXYZ[3];
-    double xyz[3];
-    int temp = 0;
-    float lcTemp = 0.0;
-    float rcTemp = 0.0;
-    int rv = 0;
-    time_t sec_count;
-    time_t new_count;
-    FILE *outfp = stdout;
-#if (USE_PIPES)
-    int  fdPipeIn;
-    int  fdPipeOut;
-#endif
+    memcpy(smp->origXYZ, smp->rXYZ, sizeof(smp->rXYZ));
+    smp->haveOrig = TRUE;
+    smp->spikeMask = hampelPush(hf, smp->rXYZ);
+}
 
-    currentDay = utcTime->tm_mday;
+//------------------------------------------
+// readTemps()
+//------------------------------------------
+static void readTemps(pList *p, magSample *smp)
+{
+    if(p->remoteTempOnly)
+    {
+        smp->rcTemp = readTemp(p, p->remoteTempAddr) * 0.0625;
+    }
+    else if(p->localTempOnly)
+    {
+        smp->lcTemp = readTemp(p, p->localTempAddr) * 0.0625;
+    }
+    else
+    {
+        smp->rcTemp = readTemp(p, p->remoteTempAddr) * 0.0625;
+        smp->lcTemp = readTemp(p, p->localTempAddr) * 0.0625;
+    }
+}
 
-    if((rv = getCommandLine(argc, argv, &p)) != 0)
+//------------------------------------------
+// magXferStart()
+// Starts a reading and returns its deadline (CLOCK_MONOTONIC), when DRDY
+// should be up: the conversion time in POLL mode, or the post DRDY delay
+// if longer.  In CMM the sensor converts all along, so it is now.
+//------------------------------------------
+static int64_t magXferStart(pList *p, magXfer *x)
+{
+    int64_t wait = 0;
+
+    i2c_setAddress(p->i2c_fd, p->magnetometerAddr);
+    x->startNs = evClockNs(CLOCK_MONOTONIC);
+    x->busy = TRUE;
+    x->retried = FALSE;
+    if(p->samplingMode == POLL)
     {
-        return rv;
+        i2c_write(p->i2c_fd, RM3100_MAG_POLL, PMMODE_ALL);
+        wait = ((int64_t)p->DRDYdelay * 1000 > x->convNs) ? (int64_t)p->DRDYdelay * 1000 : x->convNs;
     }
-    // Open log file.
-    if(p.buildLogPath)
+    return x->startNs + wait;
+}
+
+//------------------------------------------
+// magXferCheck()
+// At the deadline: 1 with the counts in XYZ if DRDY is up, 0 to look
+// again at *retryNs, -1 if it never came.
+//------------------------------------------
+static int magXferCheck(pList *p, magXfer *x, int32_t *XYZ, int64_t *retryNs)
+{
+    int64_t now = evClockNs(CLOCK_MONOTONIC);
+
+    metricAdd(&met.drdyChecks, 1);
+    if((i2c_read(p->i2c_fd, RM3100I2C_STATUS) & RM3100I2C_READMASK) != RM3100I2C_READMASK)
     {
-        buildLogFilePath(&p);
-        if((outfp = fopen(p.outputFilePath, "a+"))!= NULL)
-        {
-            printf("\nLog File: %s\n", p.outputFilePath);
-        }
-        else
+        if(now - x->startNs > MAGXFER_TIMEOUTNS)
         {
-            perror("\nLog File: ");
+            x->busy = FALSE;
+            metricAdd(&met.drdyTimeouts, 1);
+            return -1;
         }
+        x->retried = TRUE;
+        *retryNs = now + MAGXFER_RETRYNS;
+        return 0;
     }
-    // if Verbose == TRUE
-    if(p.verboseFlag)
+    if(i2c_readbuf(p->i2c_fd, RM3100I2C_XYZ, (unsigned char*) &mSamples, sizeof(mSamples)) != sizeof(mSamples))
     {
-        // always stdout!
-        fprintf(stdout,"\nStartup UTC time: %s", asctime(utcTime));
+        perror("i2c transaction i2c_readbuf() failed.\n");
     }
-    // Open I2C bus (only one at a time for now)
-    openI2CBus(&p);
-    // Setup the magnetometer.
-    setup_mag(&p);
-    // Show initial (command line) parameters
-    if(p.showParameters)
+    magDecode(mSamples, XYZ, 1);
+    x->busy = FALSE;
+    metricAdd(&met.readings, 1);
+    metricTimeAdd(&met.drdyWait, now - x->startNs);
+    if(p->samplingMode == POLL)
     {
-        showSettings(&p);
+        // Creep down while DRDY is up at the first look; when it was not,
+        // take what it needed.
+        x->convNs = x->retried ? now - x->startNs : x->convNs - x->convNs / 32;
     }
-    if(p.readBackCCRegs)
+    return 1;
+}
+
+//------------------------------------------
+// decimReading()
+// Passes one reading at p->decimRatio Hz through despiking, the spectra,
+// the capture buffer and the raw log to the decimator.  Returns TRUE when
+// that completes the next output, which is left in smp timestamped at
+// the centre of the filter.  *spikes gathers the despiked axes between
+// outputs; the counts they replaced are only in the raw log.
+//------------------------------------------
+static int decimReading(pList *p, const magCal *cal, hampelFilter *hf, decimator *d, uint32_t *spikes, magSample *raw, magSample *smp, logRoll *rawRoll, FILE **rawfp, psdStage *psd, captureBuf *cap)
+{
+    char rawBuf[SAMPLEBUFLEN];
+    double counts[3];
+    int64_t ns;
+    int rawLen;
+
+    raw->haveComp = FALSE;
+    raw->rcTemp = smp->rcTemp;
+    raw->lcTemp = smp->lcTemp;
+    clock_gettime(CLOCK_REALTIME, &raw->ts);
+    if(hf != NULL)
     {
-        readCycleCountRegs(&p);
+        despikeSample(hf, raw);
+        *spikes |= raw->spikeMask;
     }
-    // Start CMM on X, Y, Z
-    if(p.samplingMode == CONTINUOUS)
+    if(*rawfp != NULL || psd != NULL || cap != NULL)
     {
-        startCMM(&p);
+        magCalApply(cal, raw->rXYZ, raw->xyz, 1);
+    }
+    if(psd != NULL)
+    {
+        psdPush(psd, raw->xyz, &raw->ts);
+    }
+    if(cap != NULL)
+    {
+        capturePush(cap, raw);
+    }
+    if(*rawfp != NULL)
+    {
+        raw->seq++;
+        *rawfp = logRollCheck(rawRoll, raw->ts.tv_sec);
+        rawLen = formatSample(p, raw, rawBuf, sizeof(rawBuf));
+        fwrite(rawBuf, 1, rawLen, *rawfp);
+    }
+    if(!decimatorPush(d, raw->rXYZ, counts))
+    {
+        return FALSE;
+    }
+    if(*rawfp != NULL)
+    {
+        fflush(*rawfp);
     }
+    smp->rXYZ[0] = (int32_t)lround(counts[0]);
+    smp->rXYZ[1] = (int32_t)lround(counts[1]);
+    smp->rXYZ[2] = (int32_t)lround(counts[2]);
+    smp->haveOrig = FALSE;
+    smp->spikeMask = *spikes;
+    *spikes = 0;
+    magCalApplyCounts(cal, counts, smp->xyz);
+    ns = (int64_t)raw->ts.tv_sec * 1000000000LL + raw->ts.tv_nsec - d->delayNs;
+    smp->ts.tv_sec = ns / 1000000000LL;
+    smp->ts.tv_nsec = ns % 1000000000LL;
+    return TRUE;
+}
+
+//------------------------------------------
+// watchNet()
+// Follows the server's descriptors after anything that may change them:
+// a client accepted or dropped, a queue filling or emptying, a batch
+// waiting out --net-linger.
+//------------------------------------------
+static void watchNet(evLoop *ev, netServer *ns, int lingerFd)
+{
+    netClient *c;
+    int i;
 
-    if(!(p.jsonFlag))
+    evLoopWatch(ev, EV_NETLISTEN, ns->listenFd, EPOLLIN);
+    for(i = 0; i < NETSERVE_MAXCLIENTS; i++)
     {
-        // DRL put meta data here
-        // DRL should be printed only at the top of the log file
-        // DMW respect -H switch (but not other rtemp, ltemp, etc. options yet.)
-        if(p.hideRaw)
-        {
-            fprintf(outfp, "\"time\", \"rtemp\", \"ltemp\", \"x\", \"y\", \"z\", \"total\"\n");
-        }
-        else
-        {
-            fprintf(outfp, "\"time\", \"rtemp\", \"ltemp\", \"x\", \"y\", \"z\", \"rx\", \"ry\", \"rz\", \"total\"\n");
-        }
+        c = &ns->client[i];
+        evLoopWatch(ev, EV_NETCLIENT + i, c->fd, EPOLLIN | EPOLLRDHUP | ((c->len > 0) ? EPOLLOUT : 0));
     }
+    evTimerSet(lingerFd, (ns->pending > 0) ? ns->firstNs + ns->lingerNs : 0, 0);
+}
 
-#if (USE_PIPES)
+//------------------------------------------
+// setGauges()
+// Copies the state of the outputs into met once the loop has served them.
+//------------------------------------------
+static void setGauges(evLoop *ev, const magXfer *x, const pipeOut *pipe, const netServer *ns, const journal *jnl)
+{
+    uint64_t queued = 0;
+    uint64_t clients = 0;
+    int i;
 
-    if(p.useOutputPipe = TRUE)
+    metricSet(&met.wakeups, ev->wakeups);
+    metricSet(&met.convNs, (uint64_t)x->convNs);
+    if(pipe != NULL)
+    {
+        metricSet(&met.pipeQueue, (uint64_t)pipe->count);
+        metricSet(&met.pipeDropped, pipe->dropped);
+    }
+    if(ns != NULL)
     {
-        // Notide that fdPipeOut and fdPipeIn are intentionally reversed.
-        if(!(fdPipeOut = open(p.pipeInPath, O_WRONLY | O_CREAT)))
+        for(i = 0; i < NETSERVE_MAXCLIENTS; i++)
         {
-            perror("Open PIPE Out failed: ");
-            fprintf(stderr, p.pipeInPath);
-            exit(1);
+            if(ns->client[i].fd >= 0)
+            {
+                clients++;
+                queued += ns->client[i].len;
+            }
         }
-        if(!(fdPipeIn = open(p.pipeOutPath, O_RDONLY | O_CREAT)))
+        metricSet(&met.netClients, clients);
+        metricSet(&met.netQueue, queued);
+        metricSet(&met.netEvicted, ns->evicted);
+    }
+    if(jnl != NULL)
+    {
+        metricSet(&met.journalErrors, jnl->errors);
+    }
+}
+
+//------------------------------------------
+// resampleSample()
+// Feeds one output sample to the resampler and logs the grid points it
+// completes, in the same format as the main log plus a flags column.
+//------------------------------------------
+static void resampleSample(pList *p, resampler *rs, const magSample *smp, logRoll *gridRoll, FILE **gridfp)
+{
+    double v[RESAMPLE_CHANNELS];
+    resamplePoint pt;
+    magSample gs = *smp;
+    char buf[SAMPLEBUFLEN];
+    int flags;
+    int len;
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        v[i] = smp->xyz[i];
+        v[3 + i] = smp->rXYZ[i];
+    }
+    resamplerPush(rs, (int64_t)smp->ts.tv_sec * 1000000000LL + smp->ts.tv_nsec, v);
+    while(resamplerNext(rs, &pt, &flags))
+    {
+        gs.ts.tv_sec = pt.ns / 1000000000LL;
+        gs.ts.tv_nsec = pt.ns % 1000000000LL;
+        for(i = 0; i < 3; i++)
         {
-            perror("Open PIPE In failed: ");
-            fprintf(stderr, p.pipeInPath);
-            exit(1);
+            gs.xyz[i] = pt.v[i];
+            gs.rXYZ[i] = (int32_t)lround(pt.v[3 + i]);
         }
+        gs.spikeMask = 0;
+        gs.haveComp = FALSE;
+        gs.onGrid = TRUE;
+        gs.gridFlags = flags;
+        *gridfp = logRollCheck(gridRoll, gs.ts.tv_sec);
+        len = formatSample(p, &gs, buf, sizeof(buf));
+        fwrite(buf, 1, len, *gridfp);
     }
+    fflush(*gridfp);
+}
 
-#endif //USE_PIPES
+//------------------------------------------
+// catf()
+// snprintf() onto the end of buf.
+//------------------------------------------
+static void catf(char *buf, int len, int *pos, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
 
-    // loop
-    while(1)
+    if(*pos >= len - 1)
+    {
+        return;
+    }
+    va_start(ap, fmt);
+    n = vsnprintf(buf + *pos, len - *pos, fmt, ap);
+    va_end(ap);
+    *pos += (n < len - *pos) ? n : (len - 1 - *pos);
+}
+
+//------------------------------------------
+// formatSample()
+// Encodes one sample as a CSV or JSON line.
+// Returns the length written to buf.
+//------------------------------------------
+int formatSample(pList *p, magSample *smp, char *buf, int len)
+{
+    char utcStr[UTCBUFLEN] = "";
+    struct tm utcTime;
+    long millis = (long)smp->ts.tv_sec * 1000 + smp->ts.tv_nsec / 1000000;
+    double x = smp->xyz[0]/1000;
+    double y = smp->xyz[1]/1000;
+    double z = smp->xyz[2]/1000;
+    int pos = 0;
+
+    buf[0] = '\0';
+    if(!p->tsMilliseconds)
+    {
+        gmtime_r(&smp->ts.tv_sec, &utcTime);
+        strftime(utcStr, UTCBUFLEN, "%d %b %Y %T", &utcTime);        // RFC 2822: "%a, %d %b %Y %T %z"      RFC 822: "%a, %d %b %y %T %z"
+    }
+    if(!(p->jsonFlag))
     {
-        //  Read temp sensor.
-        if(!p.magnetometerOnly)
+        if(p->tsMilliseconds)
         {
-            if(p.remoteTempOnly)
-            {
-                temp = readTemp(&p, p.remoteTempAddr);
-                rcTemp = temp * 0.0625;
-            }
-            else if(p.localTempOnly)
-            {
-                temp = readTemp(&p, p.localTempAddr);
-                lcTemp = temp * 0.0625;
-            }
-            else
-            {
-                temp = readTemp(&p, p.remoteTempAddr);
-                rcTemp = temp * 0.0625;
-                temp = readTemp(&p, p.localTempAddr);
-                lcTemp = temp * 0.0625;
-            }
+            catf(buf, len, &pos, "%ld ", millis);
         }
-        // Set magnetometer sampling mode.
-        if((!p.localTempOnly) || (!p.remoteTempOnly))
+        else
         {
-            if(p.samplingMode == POLL)                      // (p->samplingMode == POLL [default])
-            {
-                readMagPOLL(&p, p.magnetometerAddr, rXYZ);
-            }
-            else                                            // (p->samplingMode == CONTINUOUS)
-            {
-                readMagCMM(&p, p.magnetometerAddr, rXYZ);
-            }
-            xyz[0] = (((double)rXYZ[0] / p.NOSRegValue) / p.x_gain) * 1000;   // make microTeslas -> nanoTeslas
-            xyz[1] = (((double)rXYZ[1] / p.NOSRegValue) / p.y_gain) * 1000;   // make microTeslas -> nanoTeslas
-            xyz[2] = (((double)rXYZ[2] / p.NOSRegValue) / p.z_gain) * 1000;   // make microTeslas -> nanoTeslas
+            catf(buf, len, &pos, "\"%s\"", utcStr);
         }
-
-        // Output the results.
-        if(!(p.jsonFlag))
+        if(!p->magnetometerOnly)
         {
-            if(p.tsMilliseconds)
+            if(p->remoteTempOnly)
             {
-                fprintf(outfp, "%ld ", currentTimeMillis());
+                if(smp->rcTemp < -100.0)
+                {
+                    catf(buf, len, &pos, ", \"ERROR\"");
+                }
+                else
+                {
+                    catf(buf, len, &pos, ", %.2f", smp->rcTemp);
+                }
             }
-            else
+            else if(p->localTempOnly)
             {
-                utcTime = getUTC();
-                strftime(utcStr, UTCBUFLEN, "%d %b %Y %T", utcTime);
-                fprintf(outfp, "\"%s\"", utcStr);
+                if(smp->lcTemp < -100.0)
+                {
+                    catf(buf, len, &pos, ", \"ERROR\"");
+                }
+                else
+                {
+                    catf(buf, len, &pos, ", %.2f", smp->lcTemp);
+                }
             }
-            if(!p.magnetometerOnly)
+            else
             {
-                if(p.remoteTempOnly)
+                if(smp->rcTemp < -100.0)
                 {
-                    if(rcTemp < -100.0)
-                    {
-                        fprintf(outfp, ", \"ERROR\"");
-                    }
-                    else
-                    {
-                        fprintf(outfp, ", %.2f", rcTemp);
-                    }
+                    catf(buf, len, &pos, ", \"ERROR\"");
                 }
-                else if(p.localTempOnly)
+                else
                 {
-                    if(lcTemp < -100.0)
-                    {
-                        fprintf(outfp, ", \"ERROR\"");
-                    }
-                    else
-                    {
-                        fprintf(outfp, ", %.2f", lcTemp);
-                    }
+                    catf(buf, len, &pos, ", %.2f", smp->rcTemp);
+                }
+                if(smp->lcTemp < -100.0)
+                {
+                    catf(buf, len, &pos, ", \"ERROR\"");
                 }
                 else
                 {
-                    if(rcTemp < -100.0)
-                    {
-                        fprintf(outfp, ", \"ERROR\"");
-                    }
-                    else
-                    {
-                        fprintf(outfp, ", %.2f", rcTemp);
-                    }
-                    if(lcTemp < -100.0)
-                    {
-                        fprintf(outfp, ", \"ERROR\"");
-                    }
-                    else
-                    {
-                        fprintf(outfp, ", %.2f", lcTemp);
-                    }
+                    catf(buf, len, &pos, ", %.2f", smp->lcTemp);
                 }
             }
-            fprintf(outfp, ", %.4f", xyz[0]/1000);
-            fprintf(outfp, ", %.4f", xyz[1]/1000);
-            fprintf(outfp, ", %.4f", xyz[2]/1000);
-            if(!p.hideRaw)
-            {
-                fprintf(outfp, ", %i", rXYZ[0]/1000);
-                fprintf(outfp, ", %i", rXYZ[1]/1000);
-                fprintf(outfp, ", %i", rXYZ[2]/1000);
-            }
-            if(p.showTotal)
+        }
+        catf(buf, len, &pos, ", %.4f", x);
+        catf(buf, len, &pos, ", %.4f", y);
+        catf(buf, len, &pos, ", %.4f", z);
+        if(!p->hideRaw)
+        {
+            catf(buf, len, &pos, ", %i", smp->rXYZ[0]/1000);
+            catf(buf, len, &pos, ", %i", smp->rXYZ[1]/1000);
+            catf(buf, len, &pos, ", %i", smp->rXYZ[2]/1000);
+        }
+        if(p->showTotal)
+        {
+            catf(buf, len, &pos, ", %.4f", sqrt((x * x) + (y * y) + (z * z)));
+        }
+        if(p->despikeWindow)
+        {
+            catf(buf, len, &pos, ", %u", smp->spikeMask);
+            if(smp->spikeMask && smp->haveOrig && !p->despikeMark)
             {
-                double x = xyz[0]/1000;
-                double y = xyz[1]/1000;
-                double z = xyz[2]/1000;
-                fprintf(outfp, ", %.4f", sqrt((x * x) + (y * y) + (z * z)));
+                catf(buf, len, &pos, ", %i, %i, %i", smp->origXYZ[0]/1000, smp->origXYZ[1]/1000, smp->origXYZ[2]/1000);
             }
-            fprintf(outfp, "\n");
         }
-        else    // JSON output ------------------------------------------------
+        if(smp->onGrid)
+        {
+            catf(buf, len, &pos, ", %u", smp->gridFlags);
+        }
+        if(smp->haveComp)
+        {
+            catf(buf, len, &pos, ", %.4f, %.4f, %.4f", smp->compXYZ[0]/1000, smp->compXYZ[1]/1000, smp->compXYZ[2]/1000);
+        }
+        catf(buf, len, &pos, "\n");
+    }
+    else    // JSON output ------------------------------------------------
+    {
+        catf(buf, len, &pos, "{ ");
+        if(p->tsMilliseconds)
+        {
+            catf(buf, len, &pos, "\"ts\":\"%ld\"", millis);
+        }
+        else
+        {
+            catf(buf, len, &pos, "\"ts\":\"%s\"", utcStr);
+        }
+        if(!p->magnetometerOnly)
         {
-            fprintf(outfp, "{ ");
-            if(p.tsMilliseconds)
+            if(p->remoteTempOnly)
             {
-                fprintf(outfp, "\"ts\":\"%ld\"",  currentTimeMillis());
+                if(smp->rcTemp < -100.0)
+                {
+                    catf(buf, len, &pos, ", \"rt\":0.0");
+                }
+                else
+                {
+                    catf(buf, len, &pos, ", \"rt\":%.2f",  smp->rcTemp);
+                }
             }
-            else
+            else if(p->localTempOnly)
             {
-                utcTime = getUTC();
-                strftime(utcStr, UTCBUFLEN, "%d %b %Y %T", utcTime);        // RFC 2822: "%a, %d %b %Y %T %z"      RFC 822: "%a, %d %b %y %T %z"
-                fprintf(outfp, "\"ts\":\"%s\"", utcStr);
+                if(smp->lcTemp < -100.0)
+                {
+                    catf(buf, len, &pos, ", \"lt\":0.0");
+                }
+                else
+                {
+                    catf(buf, len, &pos, ", \"lt\":%.2f",  smp->lcTemp);
+                }
             }
-            if(!p.magnetometerOnly)
+            else
             {
-                if(p.remoteTempOnly)
+                if(smp->rcTemp < -100.0)
                 {
-                    if(rcTemp < -100.0)
-                    {
-                        fprintf(outfp, ", \"rt\":0.0");
-                    }
-                    else
-                    {
-                        fprintf(outfp, ", \"rt\":%.2f",  rcTemp);
-                    }
+                    catf(buf, len, &pos, ", \"rt\":0.0");
+                }
+                else
+                {
+                    catf(buf, len, &pos, ", \"rt\":%.2f",  smp->rcTemp);
                 }
-                else if(p.localTempOnly)
+                if(smp->lcTemp <-100.0)
                 {
-                    if(lcTemp < -100.0)
-                    {
-                        fprintf(outfp, ", \"lt\":0.0");
-                    }
-                    else
-                    {
-                        fprintf(outfp, ", \"lt\":%.2f",  lcTemp);
-                    }
+                    catf(buf, len, &pos, ", \"lt\":0.0");
                 }
                 else
                 {
-                    if(rcTemp < -100.0)
-                    {
-                        fprintf(outfp, ", \"rt\":0.0");
-                    }
-                    else
-                    {
-                        fprintf(outfp, ", \"rt\":%.2f",  rcTemp);
-                    }
-                    if(lcTemp <-100.0)
-                    {
-                        fprintf(outfp, ", \"lt\":0.0");
-                    }
-                    else
-                    {
-                        fprintf(outfp, ", \"lt\":%.2f",  lcTemp);
-                    }
+                    catf(buf, len, &pos, ", \"lt\":%.2f",  smp->lcTemp);
                 }
             }
-            fprintf(outfp, ", \"x\":%.4f", xyz[0]/1000);
-            fprintf(outfp, ", \"y\":%.4f", xyz[1]/1000);
-            fprintf(outfp, ", \"z\":%.4f", xyz[2]/1000);
-            if(!p.hideRaw)
-            {
-                fprintf(outfp, ", \"rx\":%i", rXYZ[0]/1000);
-                fprintf(outfp, ", \"ry\":%i", rXYZ[1]/1000);
-                fprintf(outfp, ", \"rz\":%i", rXYZ[2]/1000);
-            }
-            if(p.showTotal)
+        }
+        catf(buf, len, &pos, ", \"x\":%.4f", x);
+        catf(buf, len, &pos, ", \"y\":%.4f", y);
+        catf(buf, len, &pos, ", \"z\":%.4f", z);
+        if(!p->hideRaw)
+        {
+            catf(buf, len, &pos, ", \"rx\":%i", smp->rXYZ[0]/1000);
+            catf(buf, len, &pos, ", \"ry\":%i", smp->rXYZ[1]/1000);
+            catf(buf, len, &pos, ", \"rz\":%i", smp->rXYZ[2]/1000);
+        }
+        if(p->showTotal)
+        {
+            catf(buf, len, &pos, ", \"Tm\": %.4f",  sqrt((x * x) + (y * y) + (z * z)));
+        }
+        if(p->despikeWindow)
+        {
+            catf(buf, len, &pos, ", \"spk\":%u", smp->spikeMask);
+            if(smp->spikeMask && smp->haveOrig && !p->despikeMark)
             {
-                double x = xyz[0]/1000;
-                double y = xyz[1]/1000;
-                double z = xyz[2]/1000;
-                fprintf(outfp, ", \"Tm\": %.4f",  sqrt((x * x) + (y * y) + (z * z)));
+                // What was replaced, for auditing the filter.  Decimated
+                // output has none of its own: see the --raw-log lines.
+                catf(buf, len, &pos, ", \"orx\":%i, \"ory\":%i, \"orz\":%i", smp->origXYZ[0]/1000, smp->origXYZ[1]/1000, smp->origXYZ[2]/1000);
             }
-            fprintf(outfp, " }\n");
         }
-        fflush(outfp);
-        if(p.singleRead)
+        if(smp->onGrid)
         {
-            break;
+            catf(buf, len, &pos, ", \"gf\":%u", smp->gridFlags);
         }
-        // Per Bill Englkey
-        do
+        if(smp->haveComp)
         {
-            time(&new_count);
-            usleep(100000);
-        } while (new_count==sec_count);
-        sec_count = new_count;
+            catf(buf, len, &pos, ", \"cx\":%.4f, \"cy\":%.4f, \"cz\":%.4f", smp->compXYZ[0]/1000, smp->compXYZ[1]/1000, smp->compXYZ[2]/1000);
+        }
+        catf(buf, len, &pos, " }\n");
+    }
+    return pos;
+}
 
-        //printf("Seconds ctr=%ld\n",sec_count);
+//------------------------------------------
+// sampleToRecord()
+// Fills the fixed binary record used by the binary outputs.
+//------------------------------------------
+void sampleToRecord(pList *p, const magSample *smp, magRecord *rec)
+{
+    int i;
 
-        // wait p.outDelay (1000 ms default) for next poll.
-        // usleep(p.outDelay);
-        utcTime = getUTC();
-        if(p.buildLogPath)
+    rec->seq = smp->seq;
+    rec->tsNs = (int64_t)smp->ts.tv_sec * 1000000000LL + smp->ts.tv_nsec;
+    rec->flags = smp->spikeMask * MAGREC_F_SPIKEX;
+    for(i = 0; i < 3; i++)
+    {
+        rec->rXYZ[i] = smp->rXYZ[i];
+        rec->xyz[i] = smp->xyz[i];
+    }
+    rec->rcTemp = MAGREC_TEMP_INVALID;
+    rec->lcTemp = MAGREC_TEMP_INVALID;
+    if(!p->magnetometerOnly)
+    {
+        if(!p->localTempOnly && smp->rcTemp >= -100.0)
         {
-            if(utcTime->tm_mday != currentDay)
-            {
-                currentDay = utcTime->tm_mday;
-                // currentDay = utcTime->tm_min;
-                fclose(outfp);
-                buildLogFilePath(&p);
-                if((outfp = fopen(p.outputFilePath, "a+"))!= NULL)
-                {
-                    fprintf(stdout,"\nNew Log File: %s\n", p.outputFilePath);
-                }
-                else
-                {
-                    fprintf(stdout,"\nNew Log File: %s\n", p.outputFilePath);
-                    perror("\nLog File: ");
-                    exit(1);
-                }
-            }
+            rec->rcTemp = smp->rcTemp;
+            rec->flags |= MAGREC_F_RTEMP;
+        }
+        if(!p->remoteTempOnly && smp->lcTemp >= -100.0)
+        {
+            rec->lcTemp = smp->lcTemp;
+            rec->flags |= MAGREC_F_LTEMP;
         }
     }
+}
+
+//------------------------------------------
+// recordToSample()
+// The inverse of sampleToRecord(), for samples recovered from the journal.
+//------------------------------------------
+static void recordToSample(const magRecord *rec, magSample *smp)
+{
+    int i;
+
+    memset(smp, 0, sizeof(magSample));
+    smp->seq = rec->seq;
+    smp->ts.tv_sec = rec->tsNs / 1000000000LL;
+    smp->ts.tv_nsec = rec->tsNs % 1000000000LL;
+    for(i = 0; i < 3; i++)
+    {
+        smp->rXYZ[i] = rec->rXYZ[i];
+        smp->origXYZ[i] = rec->rXYZ[i];
+        smp->xyz[i] = rec->xyz[i];
+    }
+    smp->rcTemp = (rec->flags & MAGREC_F_RTEMP) ? rec->rcTemp : MAGREC_TEMP_INVALID;
+    smp->lcTemp = (rec->flags & MAGREC_F_LTEMP) ? rec->lcTemp : MAGREC_TEMP_INVALID;
+    smp->spikeMask = (rec->flags / MAGREC_F_SPIKEX) & 7;
+}
+
+//------------------------------------------
+// endPartialLine()
+// Terminates a line cut short by a crash so the next one starts clean.
+//------------------------------------------
+static void endPartialLine(FILE *fp)
+{
+    int c;
+
+    fflush(fp);
+    if(fseeko(fp, -1, SEEK_END) == 0)
+    {
+        c = fgetc(fp);
+        fseeko(fp, 0, SEEK_END);
+        if(c != '\n' && c != EOF)
+        {
+            fputc('\n', fp);
+        }
+    }
+}
+
+//------------------------------------------
+// recoverJournal()
+// Appends the journal records that are newer than the last line of the
+// log for their period.  Logs already compressed (-z) are left alone.
+//------------------------------------------
+static void recoverJournal(pList *p, journal *j, logRoll *lr, FILE *curfp)
+{
+    char path[MAXPATHBUFLEN];
+    char gzPath[MAXPATHBUFLEN + 4];
+    char openPath[MAXPATHBUFLEN] = "";
+    char buf[SAMPLEBUFLEN];
+    const magRecord *rec;
+    magSample s;
+    struct stat st;
+    FILE *fp = NULL;
+    int64_t tailMs = INT64_MIN;
+    int64_t key;
+    time_t sec;
+    unsigned long recovered = 0;
+    unsigned long skipped = 0;
+    uint32_t i;
+
+    fflush(curfp);
+    for(i = 0; i < j->nRecovered; i++)
+    {
+        rec = &j->recovered[i];
+        sec = (time_t)(rec->tsNs / 1000000000LL);
+        buildLogFilePathFor(p, sec - (sec % lr->period), LOGROLL_TEXTSUFFIX, path);
+        if(strcmp(path, openPath) != 0)
+        {
+            if(fp != NULL && fp != curfp)
+            {
+                fclose(fp);
+            }
+            strcpy(openPath, path);
+            snprintf(gzPath, sizeof(gzPath), "%s.gz", path);
+            tailMs = journalLogTailMs(path);
+            if(!strcmp(path, lr->curPath))
+            {
+                fp = curfp;
+            }
+            else if(stat(gzPath, &st) == 0 || (fp = fopen(path, "a+")) == NULL)
+            {
+                fp = NULL;
+            }
+            else if(fstat(fileno(fp), &st) == 0 && st.st_size == 0)
+            {
+                writeLogHeader(p, fp);
+            }
+            if(fp != NULL)
+            {
+                endPartialLine(fp);
+            }
+        }
+        // Compare at the resolution of the log's time stamps.
+        key = p->tsMilliseconds ? rec->tsNs / 1000000LL : rec->tsNs / 1000000000LL * 1000;
+        if(key <= tailMs)
+        {
+            continue;
+        }
+        if(fp == NULL)
+        {
+            skipped++;
+            continue;
+        }
+        recordToSample(rec, &s);
+        fwrite(buf, 1, formatSample(p, &s, buf, sizeof(buf)), fp);
+        recovered++;
+    }
+    if(fp != NULL && fp != curfp)
+    {
+        fclose(fp);
+    }
+    fflush(curfp);
+    if(recovered > 0 || skipped > 0)
+    {
+        fprintf(stdout, "\nJournal: %lu samples recovered into the log, %lu not (log compressed or unwritable)\n", recovered, skipped);
+    }
+}
+
+//------------------------------------------
+// formatGap()
+// The log line marking time not sampled between two samples, or nothing
+// if they are no further apart than a restart allows.
+//------------------------------------------
+static int formatGap(pList *p, int64_t fromNs, int64_t toNs, char *buf, int len)
+{
+    char t[2][UTCBUFLEN];
+    struct tm utcTime;
+    time_t sec;
+    int pos = 0;
+    int i;
+
+    buf[0] = '\0';
+    if(toNs - fromNs <= JOURNAL_GAPNS)
+    {
+        return 0;
+    }
+    for(i = 0; i < 2; i++)
+    {
+        sec = (time_t)((i ? toNs : fromNs) / 1000000000LL);
+        if(p->tsMilliseconds)
+        {
+            snprintf(t[i], UTCBUFLEN, "%lld", (long long)((i ? toNs : fromNs) / 1000000LL));
+        }
+        else
+        {
+            gmtime_r(&sec, &utcTime);
+            strftime(t[i], UTCBUFLEN, "\"%d %b %Y %T\"", &utcTime);
+        }
+    }
+    if(p->jsonFlag)
+    {
+        catf(buf, len, &pos, "{ \"gap\":{ \"from\":%s, \"to\":%s, \"s\":%.1f } }\n", t[0], t[1], (toNs - fromNs) / 1e9);
+    }
+    else
+    {
+        catf(buf, len, &pos, "# gap: not sampling from %s to %s (%.1f s)\n", t[0], t[1], (toNs - fromNs) / 1e9);
+    }
+    return pos;
+}
+
+//------------------------------------------
+//  main()
+//------------------------------------------
+int main(int argc, char** argv)
+{
+    pList p;
+    //long runTime = 0;
+    struct tm *utcTime = getUTC();
+    magSample smp;
+    magSample raw;
+    int rv = 0;
+    FILE *outfp = stdout;
+    logRoll logr;
+    mseedWriter mseed;
+    pipeOut pipe;
+    shmRingWriter shm;
+    netServer net;
+    int useNet = FALSE;
+    decimator dec;
+    uint32_t decimSpikes = 0;
+    logRoll rawRoll;
+    FILE *rawfp = NULL;
+    magCal cal;
+    hampelFilter *hf = NULL;
+    psdStage *psd = NULL;
+    dbdtDetector *dbdt = NULL;
+    captureBuf *cap = NULL;
+    resampler *rs = NULL;
+    tempComp *tc = NULL;
+    kIndex *ki = NULL;
+    rollup *ru = NULL;
+    logIndex *lidx = NULL;
+    history *hist = NULL;
+    metricsServer *ms = NULL;
+    journal *jnl = NULL;
+    int64_t gapFromNs = 0;
+    double outRate = 1.0;                   // output samples/s; decimation ends at 1 Hz too
+    logRoll gridRoll;
+    FILE *gridfp = NULL;
+    magRecord rec;
+    char outBuf[SAMPLEBUFLEN];
+    int outLen = 0;
+    int64_t outStartNs;
+    time_t lastSec = 0;
+    evLoop ev;
+    magXfer xfer;
+    int tickFd = -1;
+    int xferFd = -1;
+    int lingerFd = -1;
+    int useMag;
+    int stopping = FALSE;
+    int haveSample;
+    int checkNow;
+    int64_t periodNs;
+    int64_t deadline;
+    uint64_t ready;
+    uint64_t ticks;
+    int sig;
+
+    memset(&smp, 0, sizeof(smp));
+    if((rv = getCommandLine(argc, argv, &p)) != 0)
+    {
+        return rv;
+    }
+    // Batch fit of a temperature model from an old log; no hardware needed.
+    if(p.tempCompFit != NULL)
+    {
+        return (tempCompFit(&p) == 0) ? 0 : 1;
+    }
+    // Before any thread is started, so these signals only reach the loop.
+    if(evLoopOpen(&ev, loopSignals) != 0)
+    {
+        exit(1);
+    }
+    // Open log file.
+    if(p.buildLogPath)
+    {
+        if((outfp = logRollOpen(&logr, &p))!= NULL)
+        {
+            printf("\nLog File: %s\n", p.outputFilePath);
+        }
+        else
+        {
+            perror("\nLog File: ");
+            exit(1);
+        }
+    }
+    // Samples the last run journalled but did not get into its log.
+    if(p.journalPath != NULL)
+    {
+        if(!p.buildLogPath)
+        {
+            fprintf(stderr, "\n --journal needs log files (-k).\n\n");
+            exit(1);
+        }
+        if((jnl = malloc(sizeof(journal))) == NULL || journalOpen(jnl, &p) != 0)
+        {
+            exit(1);
+        }
+        recoverJournal(&p, jnl, &logr, outfp);
+        smp.seq = jnl->lastSeq;
+        gapFromNs = jnl->lastNs;
+    }
+    // Time index beside the log, brought up to date if the day file exists.
+    if(p.logIndexStride)
+    {
+        if(!p.buildLogPath)
+        {
+            fprintf(stderr, "\n --log-index needs log files (-k).\n\n");
+            exit(1);
+        }
+        if((lidx = malloc(sizeof(logIndex))) == NULL || logIndexOpen(lidx, logr.curPath, outfp, p.logIndexStride) != 0)
+        {
+            perror("\nLog index: ");
+            exit(1);
+        }
+    }
+    // Open miniSEED side file.
+    if(p.mseedRecLen)
+    {
+        if(mseedOpen(&mseed, &p, 1.0) != 0)
+        {
+            exit(1);
+        }
+    }
+    // if Verbose == TRUE
+    if(p.verboseFlag)
+    {
+        // always stdout!
+        fprintf(stdout,"\nStartup UTC time: %s", asctime(utcTime));
+    }
+    // Open I2C bus (only one at a time for now)
+    openI2CBus(&p);
+    // Setup the magnetometer.
+    setup_mag(&p);
+    // Parameter sweep instead of a run.
+    if(p.sweepCounts != NULL)
+    {
+        evLoopClose(&ev);
+        rv = runSweep(&p);
+        closeI2CBus(p.i2c_fd);
+        return rv;
+    }
+    // Scale factors from the cycle counts just set, plus any iron correction.
+    magCalInit(&cal, &p);
+    if(p.calFilePath != NULL && magCalLoad(&cal, p.calFilePath) != 0)
+    {
+        exit(1);
+    }
+    // Show initial (command line) parameters
+    if(p.showParameters)
+    {
+        showSettings(&p);
+    }
+    if(p.readBackCCRegs)
+    {
+        readCycleCountRegs(&p);
+    }
+    // Start CMM on X, Y, Z
+    if(p.samplingMode == CONTINUOUS)
+    {
+        startCMM(&p);
+    }
+
+    // Log files get their header from logRollOpen() when they are new.
+    if(!p.buildLogPath)
+    {
+        writeLogHeader(&p, outfp);
+    }
+
+    // Create the shared memory ring for local subscribers.
+    if(p.shmName != NULL)
+    {
+        if(shmRingCreate(&shm, p.shmName, p.shmSlots, 1.0) != 0)
+        {
+            exit(1);
+        }
+    }
+    // Start the TCP/UDP streaming server.
+    if(p.tcpListen != NULL || p.udpDest != NULL)
+    {
+        if(netServeOpen(&net, &p) != 0)
+        {
+            exit(1);
+        }
+        useNet = TRUE;
+    }
+    // Despiking runs on every raw reading, before any decimation.
+    if(p.despikeWindow)
+    {
+        if((hf = malloc(sizeof(hampelFilter))) == NULL)
+        {
+            perror("Despike filter");
+            exit(1);
+        }
+        hampelInit(hf, p.despikeWindow, p.despikeK, !p.despikeMark);
+    }
+    // Oversample and decimate.
+    if(p.decimRatio > 1)
+    {
+        if(decimatorInit(&dec, p.decimRatio, p.decimFilter, 1000000000LL / p.decimRatio) != 0)
+        {
+            exit(1);
+        }
+        if(p.rawLog)
+        {
+            if(!p.buildLogPath)
+            {
+                fprintf(stderr, "\n --raw-log needs log files (-k).\n\n");
+                exit(1);
+            }
+            if((rawfp = logRollOpenFile(&rawRoll, &p, DECIM_RAWSUFFIX)) == NULL)
+            {
+                perror("\nRaw log file: ");
+                exit(1);
+            }
+        }
+    }
+    // Spectra of what the magnetometer delivers: every oversampled reading when decimating.
+    if(p.psdLen)
+    {
+        if((psd = malloc(sizeof(psdStage))) == NULL || psdOpen(psd, &p, (p.decimRatio > 1) ? p.decimRatio : 1.0) != 0)
+        {
+            exit(1);
+        }
+    }
+    // dB/dt alerts on the output samples.
+    if(p.dbdtWindows != NULL)
+    {
+        if((dbdt = malloc(sizeof(dbdtDetector))) == NULL || dbdtOpen(dbdt, &p, outRate) != 0)
+        {
+            exit(1);
+        }
+    }
+    // Pre-trigger capture of the full-rate readings.
+    if(p.captureSeconds)
+    {
+        if(p.decimRatio <= 1 || !p.buildLogPath)
+        {
+            fprintf(stderr, "\n --capture needs --decimate and log files (-k).\n\n");
+            exit(1);
+        }
+        if((cap = malloc(sizeof(captureBuf))) == NULL || captureOpen(cap, &p, &cal) != 0)
+        {
+            exit(1);
+        }
+        printf("\nCapture buffer: %i s at %i Hz, %lu KB\n", cap->seconds, cap->rate, (unsigned long)(cap->bytes / 1024));
+    }
+    // Resample onto the UTC grid.
+    if(p.resamplePeriod > 0.0)
+    {
+        if(!p.buildLogPath)
+        {
+            fprintf(stderr, "\n --resample needs log files (-k).\n\n");
+            exit(1);
+        }
+        if((rs = malloc(sizeof(resampler))) == NULL)
+        {
+            perror("Resampler");
+            exit(1);
+        }
+        resamplerInit(rs, p.resamplePeriod, p.resampleMode);
+        if((gridfp = logRollOpenFile(&gridRoll, &p, RESAMPLE_SUFFIX)) == NULL)
+        {
+            perror("\nGrid log file: ");
+            exit(1);
+        }
+    }
+    // Temperature compensation model.
+    if(p.tempCompPath != NULL)
+    {
+        if((tc = malloc(sizeof(tempComp))) == NULL || tempCompInit(tc, &p) != 0)
+        {
+            exit(1);
+        }
+    }
+    // K and hourly range indices.
+    if(p.kIndexPath != NULL)
+    {
+        if((ki = malloc(sizeof(kIndex))) == NULL)
+        {
+            perror("K index");
+            exit(1);
+        }
+        kIndexInit(ki, &p);
+    }
+    // Minute, hour and day rollups.
+    if(p.rollup)
+    {
+        if(!p.buildLogPath)
+        {
+            fprintf(stderr, "\n --rollup needs log files (-k).\n\n");
+            exit(1);
+        }
+        if((ru = malloc(sizeof(rollup))) == NULL || rollupOpen(ru, &p) != 0)
+        {
+            exit(1);
+        }
+    }
+    // Recent samples in memory, served on a Unix socket.
+    if(p.historySock != NULL)
+    {
+        if((hist = malloc(sizeof(history))) == NULL || historyOpen(hist, &p, outRate) != 0)
+        {
+            exit(1);
+        }
+    }
+    // Counters for a scraper, served from their own thread.
+    metricSet(&met.startNs, (uint64_t)evClockNs(CLOCK_REALTIME));
+    if(p.metricsAddr != NULL)
+    {
+        if((ms = malloc(sizeof(metricsServer))) == NULL || metricsOpen(ms, &p, &met) != 0)
+        {
+            exit(1);
+        }
+    }
+    // Open output FIFO (never blocks; reader may come and go).
+    if(p.useOutputPipe)
+    {
+        if(pipeOutOpen(&pipe, &p) != 0)
+        {
+            exit(1);
+        }
+    }
+
+    // Everything below waits in one place.  The cadence is a timer: each
+    // UTC second, or p.decimRatio Hz on the monotonic clock when
+    // decimating.  A tick starts a reading; its deadline, when DRDY should
+    // be up, is a second timer, so the loop serves the outputs while the
+    // sensor converts.
+    useMag = (!p.localTempOnly) && (!p.remoteTempOnly);
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.convNs = (int64_t)(p.cc_x + p.cc_y + p.cc_z) * MAGXFER_NSPERCYCLE;
+    raw = smp;
+    if(p.decimRatio > 1)
+    {
+        periodNs = 1000000000LL / p.decimRatio;
+        tickFd = evTimerOpen(CLOCK_MONOTONIC);
+        deadline = evClockNs(CLOCK_MONOTONIC) + periodNs;
+    }
+    else
+    {
+        periodNs = 1000000000LL;
+        tickFd = evTimerOpen(CLOCK_REALTIME);
+        deadline = p.singleRead ? evClockNs(CLOCK_REALTIME) : (evClockNs(CLOCK_REALTIME) / periodNs + 1) * periodNs;
+    }
+    xferFd = evTimerOpen(CLOCK_MONOTONIC);
+    if(tickFd < 0 || xferFd < 0 || evTimerSet(tickFd, deadline, periodNs) != 0 ||
+       evLoopWatch(&ev, EV_TICK, tickFd, EPOLLIN) != 0 || evLoopWatch(&ev, EV_XFER, xferFd, EPOLLIN) != 0)
+    {
+        perror("Event loop");
+        exit(1);
+    }
+    if(useNet)
+    {
+        if((lingerFd = evTimerOpen(CLOCK_MONOTONIC)) < 0 || evLoopWatch(&ev, EV_LINGER, lingerFd, EPOLLIN) != 0)
+        {
+            exit(1);
+        }
+        watchNet(&ev, &net, lingerFd);
+    }
+    if(cap != NULL)
+    {
+        evLoopWatch(&ev, EV_CAPTURE, cap->ctlFd, EPOLLIN);
+    }
+
+    // loop
+    while(!stopping)
+    {
+        ready = evLoopWait(&ev, -1);
+        haveSample = FALSE;
+        checkNow = FALSE;
+        // SIGINT, SIGTERM and SIGHUP finish the pass and shut down cleanly.
+        if(ready & EVLOOP_BIT(EVLOOP_SIGNAL))
+        {
+            while((sig = evLoopSignal(&ev)) != 0)
+            {
+                if(sig != SIGUSR1)
+                {
+                    stopping = TRUE;
+                }
+                else if(cap != NULL)
+                {
+                    captureTrigger(cap, "signal");
+                }
+            }
+        }
+        if((ready & EVLOOP_BIT(EV_TICK)) && (ticks = evTimerRead(tickFd)) > 0)
+        {
+            // Missed ticks are not made up.
+            metricAdd(&met.lateTicks, ticks - 1);
+            if(xfer.busy)
+            {
+                metricAdd(&met.lateTicks, 1);
+            }
+            else if(!useMag)
+            {
+                readTemps(&p, &smp);
+                clock_gettime(CLOCK_REALTIME, &smp.ts);
+                haveSample = TRUE;
+            }
+            else
+            {
+                if(p.decimRatio <= 1 && !p.magnetometerOnly)
+                {
+                    readTemps(&p, &smp);
+                }
+                deadline = magXferStart(&p, &xfer);
+                if(deadline <= evClockNs(CLOCK_MONOTONIC))
+                {
+                    checkNow = TRUE;
+                }
+                else
+                {
+                    evTimerSet(xferFd, deadline, 0);
+                }
+            }
+        }
+        if(xfer.busy && (checkNow || ((ready & EVLOOP_BIT(EV_XFER)) && evTimerRead(xferFd) > 0)))
+        {
+            switch(magXferCheck(&p, &xfer, (p.decimRatio > 1) ? raw.rXYZ : smp.rXYZ, &deadline))
+            {
+                case 0:
+                    evTimerSet(xferFd, deadline, 0);
+                    break;
+                case 1:
+                    if(p.decimRatio > 1)
+                    {
+                        if((haveSample = decimReading(&p, &cal, hf, &dec, &decimSpikes, &raw, &smp, &rawRoll, &rawfp, psd, cap)) && !p.magnetometerOnly)
+                        {
+                            readTemps(&p, &smp);
+                        }
+                        break;
+                    }
+                    if(hf != NULL)
+                    {
+                        despikeSample(hf, &smp);
+                    }
+                    magCalApply(&cal, smp.rXYZ, smp.xyz, 1);                // counts -> calibrated nanoTeslas
+                    clock_gettime(CLOCK_REALTIME, &smp.ts);
+                    if(psd != NULL)
+                    {
+                        psdPush(psd, smp.xyz, &smp.ts);
+                    }
+                    haveSample = TRUE;
+                    break;
+                default:
+                    fprintf(stderr, "Error : no DRDY from the magnetometer in %lld ms, reading skipped.\n", MAGXFER_TIMEOUTNS / 1000000);
+                    break;
+            }
+        }
+        if(haveSample)
+        {
+            if(tc != NULL)
+            {
+                tempCompApply(tc, &smp);
+            }
+            smp.seq++;
+            if(p.mseedRecLen)
+            {
+                mseedPush(&mseed, &smp);
+            }
+            if(p.shmName != NULL || useNet || jnl != NULL)
+            {
+                sampleToRecord(&p, &smp, &rec);
+            }
+            // Journal first: from here on a crash cannot lose the sample.
+            if(jnl != NULL)
+            {
+                journalWrite(jnl, &rec);
+            }
+            if(p.shmName != NULL)
+            {
+                shmRingPublish(&shm, &rec);
+            }
+            if(useNet)
+            {
+                netServePublish(&net, &rec);
+            }
+
+            // Switch log files first if this sample starts a new period.
+            if(p.buildLogPath)
+            {
+                outfp = logRollCheck(&logr, smp.ts.tv_sec);
+                if(lidx != NULL && strcmp(lidx->logPath, logr.curPath) != 0)
+                {
+                    logIndexClose(lidx);
+                    if(logIndexOpen(lidx, logr.curPath, outfp, p.logIndexStride) != 0)
+                    {
+                        perror("\nLog index: ");
+                    }
+                }
+            }
+            // First sample after a restart: mark the time nothing was sampled.
+            if(gapFromNs != 0)
+            {
+                if((outLen = formatGap(&p, gapFromNs, (int64_t)smp.ts.tv_sec * 1000000000LL + smp.ts.tv_nsec, outBuf, sizeof(outBuf))) > 0)
+                {
+                    fwrite(outBuf, 1, outLen, outfp);
+                    if(lidx != NULL)
+                    {
+                        logIndexAdd(lidx, (int64_t)smp.ts.tv_sec * 1000 + smp.ts.tv_nsec / 1000000, outLen);
+                    }
+                }
+                gapFromNs = 0;
+            }
+            // Output the results.
+            outStartNs = evClockNs(CLOCK_MONOTONIC);
+            outLen = formatSample(&p, &smp, outBuf, sizeof(outBuf));
+            if(fwrite(outBuf, 1, outLen, outfp) != (size_t)outLen || fflush(outfp) != 0)
+            {
+                metricAdd(&met.logErrors, 1);
+            }
+            metricTimeAdd(&met.output, evClockNs(CLOCK_MONOTONIC) - outStartNs);
+            metricAdd(&met.logBytes, outLen);
+            metricAdd(&met.samples, 1);
+            metricSet(&met.lastSampleNs, (uint64_t)smp.ts.tv_sec * 1000000000ULL + smp.ts.tv_nsec);
+            if(lastSec != 0 && smp.ts.tv_sec > lastSec + 1)
+            {
+                metricAdd(&met.missedSeconds, smp.ts.tv_sec - lastSec - 1);
+            }
+            lastSec = smp.ts.tv_sec;
+            if(lidx != NULL)
+            {
+                logIndexAdd(lidx, (int64_t)smp.ts.tv_sec * 1000 + smp.ts.tv_nsec / 1000000, outLen);
+            }
+            if(p.useOutputPipe)
+            {
+                pipeOutPublish(&pipe, outBuf, outLen);
+            }
+            // After the log write, so detection never delays it.
+            if(dbdt != NULL && dbdtPush(dbdt, &smp) && cap != NULL)
+            {
+                captureTrigger(cap, "dbdt");
+            }
+            if(ki != NULL)
+            {
+                kIndexPush(ki, &smp);
+            }
+            if(ru != NULL)
+            {
+                rollupPush(ru, &smp);
+            }
+            if(hist != NULL)
+            {
+                historyPush(hist, &smp);
+            }
+            if(rs != NULL)
+            {
+                resampleSample(&p, rs, &smp, &gridRoll, &gridfp);
+            }
+            if(p.singleRead)
+            {
+                stopping = TRUE;
+            }
+        }
+        // Outputs that backed up, only when they can take more.
+        if(useNet && (haveSample || (ready & (EVLOOP_BIT(EV_LINGER) | EVLOOP_BIT(EV_NETLISTEN) | (((1ULL << NETSERVE_MAXCLIENTS) - 1) << EV_NETCLIENT)))))
+        {
+            evTimerRead(lingerFd);
+            netServePoll(&net);
+            watchNet(&ev, &net, lingerFd);
+        }
+        if(p.useOutputPipe && (haveSample || (ready & EVLOOP_BIT(EV_PIPE))))
+        {
+            pipeOutDrain(&pipe);
+            evLoopWatch(&ev, EV_PIPE, pipe.fd, (pipe.count > 0) ? EPOLLOUT : 0);
+        }
+        if(ready & EVLOOP_BIT(EV_CAPTURE))
+        {
+            capturePoll(cap);
+        }
+        setGauges(&ev, &xfer, p.useOutputPipe ? &pipe : NULL, useNet ? &net : NULL, jnl);
+    }
+    if(p.useOutputPipe)
+    {
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nOutput pipe: %lu sent, %lu dropped, %lu connects\n", pipe.sent, pipe.dropped, pipe.connects);
+        }
+        pipeOutClose(&pipe);
+    }
+    if(useNet)
+    {
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nNet server: %lu batches, %lu clients accepted, %lu evicted, %lu UDP errors\n", net.batches, net.accepted, net.evicted, net.udpErrors);
+        }
+        netServeClose(&net);
+    }
+    if(p.shmName != NULL)
+    {
+        // Leave the segment so readers can drain it; the next run takes it over.
+        shmRingDestroy(&shm, FALSE);
+    }
+    if(hist != NULL)
+    {
+        historyClose(hist);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nHistory: %lu queries, %lu bad, %lu samples out of order\n", hist->queries, hist->errors, hist->dropped);
+        }
+        free(hist);
+    }
+    if(ms != NULL)
+    {
+        metricsClose(ms);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nMetrics: %lu scrapes, %lu bad requests\n", ms->scrapes, ms->errors);
+        }
+        free(ms);
+    }
+    if(ru != NULL)
+    {
+        rollupClose(ru);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nRollups: %lu records, %lu write errors\n", ru->records, ru->errors);
+        }
+        free(ru);
+    }
+    if(ki != NULL)
+    {
+        kIndexClose(ki);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nK index: %lu updates, %lu write errors\n", ki->writes, ki->writeErrors);
+        }
+        free(ki);
+    }
+    if(tc != NULL)
+    {
+        tempCompSave(tc);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nTemperature model: %lu updates, b = %.4f, %.4f, %.4f nT/degC\n", tc->updates, tc->axis[0].b, tc->axis[1].b, tc->axis[2].b);
+        }
+        free(tc);
+    }
+    if(rs != NULL)
+    {
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nResample: %lu grid points, %lu flagged, %lu skipped\n", rs->points, rs->flagged, rs->skipped);
+        }
+        logRollClose(&gridRoll);
+        free(rs);
+    }
+    if(cap != NULL)
+    {
+        captureClose(cap);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nCapture: %lu dumps, %lu truncated, %lu triggers ignored, %lu KB buffer\n", __atomic_load_n(&cap->dumps, __ATOMIC_RELAXED), __atomic_load_n(&cap->truncated, __ATOMIC_RELAXED), cap->ignored, (unsigned long)(cap->bytes / 1024));
+        }
+        free(cap);
+    }
+    if(dbdt != NULL)
+    {
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\ndB/dt: %lu alerts, %lu dropped, max latency %.1f ms\n", dbdt->alerts, dbdt->dropped, dbdt->maxLatencyMs);
+        }
+        dbdtClose(dbdt);
+        free(dbdt);
+    }
+    if(psd != NULL)
+    {
+        psdClose(psd);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nPSD: %lu frames, %lu overruns, %lu gaps\n", psd->frames, psd->overruns, psd->gaps);
+        }
+        free(psd);
+    }
+    if(hf != NULL)
+    {
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nDespike: %lu X, %lu Y, %lu Z spikes\n", hf->spikes[0], hf->spikes[1], hf->spikes[2]);
+        }
+        free(hf);
+    }
+    if(p.decimRatio > 1)
+    {
+        if(rawfp != NULL)
+        {
+            logRollClose(&rawRoll);
+        }
+        decimatorFree(&dec);
+    }
+    if(p.mseedRecLen)
+    {
+        mseedClose(&mseed);
+    }
+    if(jnl != NULL)
+    {
+        journalClose(jnl);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nJournal: %lu samples, %lu sync errors\n", jnl->written, jnl->errors);
+        }
+        free(jnl);
+    }
+    if(lidx != NULL)
+    {
+        logIndexClose(lidx);
+        if(p.verboseFlag)
+        {
+            fprintf(stdout, "\nLog index: %lu entries, %lu write errors\n", lidx->entries, lidx->errors);
+        }
+        free(lidx);
+    }
+    if(p.buildLogPath)
+    {
+        logRollClose(&logr);
+    }
+    if(p.verboseFlag)
+    {
+        fprintf(stdout, "\nEvent loop: %lu wakeups, %llu readings, %llu late ticks, %llu DRDY checks, %llu timeouts, conversion %.2f ms\n",
+                ev.wakeups, (unsigned long long)met.readings, (unsigned long long)met.lateTicks, (unsigned long long)met.drdyChecks,
+                (unsigned long long)met.drdyTimeouts, xfer.convNs / 1e6);
+    }
+    close(tickFd);
+    close(xferFd);
+    if(lingerFd >= 0)
+    {
+        close(lingerFd);
+    }
+    evLoopClose(&ev);
     closeI2CBus(p.i2c_fd);
     return 0;
 }
@@ -28,17 +28,17 @@
 #include "device_defs.h"
 #include "i2c.h"
 #include "MCP9808.h"
+#include "magrec.h"
 
 #define _DEBUG 0
 
-#define USE_PIPES   FALSE
-
 #define RUNMAG_VERSION "0.1.2"
 #define UTCBUFLEN 64
 #define MAXPATHBUFLEN 1025
 #define JSONBUFLEN 1025
 #define JSONBUFTOKENCOUNT 1024
 #define SITEPREFIXLEN 32
+#define SAMPLEBUFLEN 512
 
 //------------------------------------------
 // Parameter List struct
@@ -95,13 +95,100 @@ typedef struct tag_pList
     char *outputFilePath;
     char *sitePrefix;
     char *logOutputTime;
+    int  logRollSeconds;
+    int  compressLogs;
     int  logOutput;
     char *Version;
     int  useOutputPipe;
-    char *pipeInPath;
     char *pipeOutPath;
+    int  pipePolicy;
+    int  pipeQueueLen;
+    char *shmName;
+    int  shmSlots;
+    char *tcpListen;
+    char *udpDest;
+    int  udpTtl;
+    int  netBatch;
+    int  netLingerMs;
+    int  tcpQueueKB;
+    int  decimRatio;
+    int  decimFilter;
+    int  rawLog;
+    char *calFilePath;
+    int  despikeWindow;
+    double despikeK;
+    int  despikeMark;
+    int  psdLen;
+    int  psdAvg;
+    char *psdOut;
+    int  psdBinary;
+    char *dbdtWindows;
+    double dbdtOnset;
+    double dbdtRelease;
+    char *dbdtOut;
+    int  captureSeconds;
+    double captureLevel;
+    char *captureCtl;
+    double resamplePeriod;
+    int  resampleMode;
+    char *tempCompPath;
+    double tempCompLambda;
+    int  tempCompFreeze;
+    char *tempCompFit;
+    char *kIndexPath;
+    double kIndexK9;
+    char *sweepCounts;
+    char *sweepNos;
+    int  sweepSecs;
+    double sweepRate;
+    int  rollup;
+    int  logIndexStride;
+    char *historySock;
+    int  historyHours;
+    char *journalPath;
+    int  journalSlots;
+    int  journalSync;
+    char *metricsAddr;
+    int  mseedRecLen;
+    char *mseedNetwork;
+    char *mseedLocation;
 } pList;
 
+//------------------------------------------
+// One acquired sample
+//------------------------------------------
+typedef struct tag_magSample
+{
+    uint64_t seq;               // sample sequence number
+    struct timespec ts;         // acquisition time (UTC)
+    int32_t rXYZ[3];            // raw counts
+    double  xyz[3];             // field, nT
+    float   rcTemp;
+    float   lcTemp;
+    uint32_t spikeMask;         // Hampel spikes: 1 = X, 2 = Y, 4 = Z
+    int32_t origXYZ[3];         // raw counts before despiking
+    int     haveOrig;           // origXYZ is set (not for decimated output)
+    int     onGrid;             // interpolated onto the resampling grid
+    uint32_t gridFlags;         // RESAMPLE_F_* for grid samples
+    int     haveComp;           // compXYZ is set
+    double  compXYZ[3];         // temperature compensated field, nT
+} magSample;
+
+//-------------------------------------------
+// One magnetometer reading in progress
+//-------------------------------------------
+#define MAGXFER_NSPERCYCLE      11300       // conversion per cycle count, per axis
+#define MAGXFER_RETRYNS         250000      // DRDY low at the deadline: look again after
+#define MAGXFER_TIMEOUTNS       1000000000LL
+
+typedef struct tag_magXfer
+{
+    int     busy;               // started, DRDY not seen yet
+    int64_t startNs;            // CLOCK_MONOTONIC when started
+    int64_t convNs;             // expected start to DRDY, learnt as it goes
+    int     retried;            // this reading needed more than one look
+} magXfer;
+
 //-------------------------------------------
 // Device paths for different platforms
 //-------------------------------------------
@@ -181,6 +268,8 @@ struct busDev
 int readTemp(pList *p, int devAddr);
 int readMagCMM(pList *p, int devAddr, int32_t *XYZ);
 int readMagPOLL(pList *p, int devAddr, int32_t *XYZ);
+int formatSample(pList *p, magSample *smp, char *buf, int len);
+void sampleToRecord(pList *p, const magSample *smp, magRecord *rec);
 int main(int argc, char** argv);
 
 #endif //SWX3100MAIN_h
@@ -0,0 +1,243 @@
+//=========================================================================
+// metrics.c
+//
+// Health and performance counters for the runMag utility.
+// See metrics.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <stdarg.h>
+#include <string.h>
+#include <sys/socket.h>
+#include "metrics.h"
+#include "i2c.h"
+
+//------------------------------------------
+// Reply body
+//------------------------------------------
+typedef struct tag_metricsBody
+{
+    int         len;
+    char        buf[METRICS_BODYLEN];
+} metricsBody;
+
+//------------------------------------------
+// load()
+//------------------------------------------
+static uint64_t load(const uint64_t *v)
+{
+    return __atomic_load_n(v, __ATOMIC_RELAXED);
+}
+
+//------------------------------------------
+// add()
+//------------------------------------------
+static void add(metricsBody *b, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if(b->len >= METRICS_BODYLEN - 1)
+    {
+        return;
+    }
+    va_start(ap, fmt);
+    n = vsnprintf(b->buf + b->len, METRICS_BODYLEN - b->len, fmt, ap);
+    va_end(ap);
+    b->len = (n < METRICS_BODYLEN - b->len) ? b->len + n : METRICS_BODYLEN - 1;
+}
+
+//------------------------------------------
+// metric()
+// One unlabelled count with its HELP and TYPE lines.
+//------------------------------------------
+static void metric(metricsBody *b, const char *name, const char *type, const char *help, uint64_t v)
+{
+    add(b, "# HELP runmag_%s %s\n# TYPE runmag_%s %s\nrunmag_%s %llu\n", name, help, name, type, name, (unsigned long long)v);
+}
+
+//------------------------------------------
+// seconds()
+// One unlabelled gauge in seconds.
+//------------------------------------------
+static void seconds(metricsBody *b, const char *name, const char *help, double v)
+{
+    add(b, "# HELP runmag_%s %s\n# TYPE runmag_%s gauge\nrunmag_%s %.9f\n", name, help, name, name, v);
+}
+
+//------------------------------------------
+// timeMetric()
+// A summary in seconds, and its largest value as a gauge.
+//------------------------------------------
+static void timeMetric(metricsBody *b, const char *name, const char *help, const metricTime *t)
+{
+    add(b, "# HELP runmag_%s_seconds %s\n# TYPE runmag_%s_seconds summary\n", name, help, name);
+    add(b, "runmag_%s_seconds_sum %.9f\nrunmag_%s_seconds_count %llu\n", name, load(&t->sumNs) / 1e9, name, (unsigned long long)load(&t->count));
+    add(b, "# HELP runmag_%s_max_seconds Largest of runmag_%s_seconds.\n# TYPE runmag_%s_max_seconds gauge\n", name, name, name);
+    add(b, "runmag_%s_max_seconds %.9f\n", name, load(&t->maxNs) / 1e9);
+}
+
+//------------------------------------------
+// deviceName()
+//------------------------------------------
+static const char *deviceName(const pList *p, int addr)
+{
+    if(addr == p->magnetometerAddr)
+    {
+        return "magnetometer";
+    }
+    if(addr == p->remoteTempAddr)
+    {
+        return "remote_temp";
+    }
+    if(addr == p->localTempAddr)
+    {
+        return "local_temp";
+    }
+    return "other";
+}
+
+//------------------------------------------
+// i2cMetrics()
+// Every device address that has seen a transfer.
+//------------------------------------------
+static void i2cMetrics(metricsBody *b, const pList *p)
+{
+    const i2cStats *s = i2c_getStats();
+    int i;
+
+    add(b, "# HELP runmag_i2c_transfers_total I2C transfers per device.\n# TYPE runmag_i2c_transfers_total counter\n");
+    for(i = 0; i < I2C_MAXADDR; i++)
+    {
+        if(load(&s[i].xfers) > 0)
+        {
+            add(b, "runmag_i2c_transfers_total{device=\"%s\",addr=\"0x%02X\"} %llu\n", deviceName(p, i), i, (unsigned long long)load(&s[i].xfers));
+        }
+    }
+    add(b, "# HELP runmag_i2c_errors_total Failed I2C transfers per device.\n# TYPE runmag_i2c_errors_total counter\n");
+    for(i = 0; i < I2C_MAXADDR; i++)
+    {
+        if(load(&s[i].xfers) > 0)
+        {
+            add(b, "runmag_i2c_errors_total{device=\"%s\",addr=\"0x%02X\"} %llu\n", deviceName(p, i), i, (unsigned long long)load(&s[i].errors));
+        }
+    }
+}
+
+//------------------------------------------
+// format()
+//------------------------------------------
+static void format(metricsServer *ms, metricsBody *b)
+{
+    const runMetrics *m = ms->m;
+    struct timespec ts;
+    double now;
+    double last;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    now = ts.tv_sec + ts.tv_nsec / 1e9;
+    last = load(&m->lastSampleNs) / 1e9;
+    b->len = 0;
+    seconds(b, "start_time_seconds", "When runMag started, epoch seconds.", load(&m->startNs) / 1e9);
+    metric(b, "samples_total", "counter", "Output samples.", load(&m->samples));
+    seconds(b, "last_sample_age_seconds", "Time since the last output sample, -1 before the first.", (last > 0.0) ? now - last : -1.0);
+    metric(b, "missed_seconds_total", "counter", "UTC seconds without an output sample.", load(&m->missedSeconds));
+    metric(b, "late_ticks_total", "counter", "Sample ticks missed or found the last reading unfinished.", load(&m->lateTicks));
+    metric(b, "readings_total", "counter", "Magnetometer readings.", load(&m->readings));
+    metric(b, "drdy_checks_total", "counter", "DRDY status register reads.", load(&m->drdyChecks));
+    metric(b, "drdy_timeouts_total", "counter", "Readings dropped for want of DRDY.", load(&m->drdyTimeouts));
+    seconds(b, "drdy_expected_seconds", "Expected time from starting a reading to DRDY.", load(&m->convNs) / 1e9);
+    timeMetric(b, "drdy_wait", "Time from starting a reading to DRDY.", &m->drdyWait);
+    timeMetric(b, "output", "Time to format, log and flush a sample.", &m->output);
+    metric(b, "log_bytes_total", "counter", "Bytes written to the log.", load(&m->logBytes));
+    metric(b, "log_errors_total", "counter", "Short or failed log writes.", load(&m->logErrors));
+    metric(b, "loop_wakeups_total", "counter", "Event loop wakeups.", load(&m->wakeups));
+    metric(b, "pipe_queue_records", "gauge", "Records waiting for the FIFO reader.", load(&m->pipeQueue));
+    metric(b, "pipe_dropped_total", "counter", "Records the FIFO queue dropped.", load(&m->pipeDropped));
+    metric(b, "net_clients", "gauge", "Connected TCP clients.", load(&m->netClients));
+    metric(b, "net_queue_bytes", "gauge", "Bytes waiting for TCP clients.", load(&m->netQueue));
+    metric(b, "net_evicted_total", "counter", "TCP clients dropped for a full queue.", load(&m->netEvicted));
+    metric(b, "journal_errors_total", "counter", "Journal msync() failures.", load(&m->journalErrors));
+    i2cMetrics(b, ms->p);
+}
+
+//------------------------------------------
+// metricsServe()
+// One HTTP/1.0 request per connection: GET /metrics (or /).
+//------------------------------------------
+static void metricsServe(void *ctx, int fd)
+{
+    metricsServer *ms = (metricsServer *)ctx;
+    metricsBody *b = ms->body;
+    char req[METRICS_REQLEN];
+    char hdr[160];
+    ssize_t n;
+    int len;
+    int ok;
+
+    for(len = 0; len < METRICS_REQLEN - 1; len += n)
+    {
+        req[len] = '\0';
+        if(strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL ||
+           (n = recv(fd, req + len, METRICS_REQLEN - 1 - len, 0)) <= 0)
+        {
+            break;
+        }
+    }
+    req[len] = '\0';
+    ok = !strncmp(req, "GET /metrics", 12) || !strncmp(req, "GET / ", 6);
+    if(ok)
+    {
+        format(ms, b);
+        snprintf(hdr, sizeof(hdr), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %i\r\n\r\n", b->len);
+    }
+    else
+    {
+        snprintf(hdr, sizeof(hdr), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        ms->errors++;
+    }
+    if(reqSendAll(fd, hdr, strlen(hdr)) == 0 && ok)
+    {
+        reqSendAll(fd, b->buf, b->len);
+    }
+    ms->scrapes++;
+}
+
+//------------------------------------------
+// metricsOpen()
+// A spec with a '/' is a Unix socket path, otherwise [addr:]port.
+//------------------------------------------
+int metricsOpen(metricsServer *ms, pList *p, const runMetrics *m)
+{
+    memset(ms, 0, sizeof(metricsServer));
+    ms->p = p;
+    ms->m = m;
+    ms->srv.listenFd = -1;
+    if((ms->body = malloc(sizeof(metricsBody))) == NULL)
+    {
+        perror("Metrics: reply buffer");
+        return -1;
+    }
+    if(reqServeOpen(&ms->srv, "Metrics", p->metricsAddr, strchr(p->metricsAddr, '/') != NULL, metricsServe, ms) != 0)
+    {
+        metricsClose(ms);
+        return -1;
+    }
+    if(p->verboseFlag)
+    {
+        fprintf(stdout, "Metrics: serving on %s\n", p->metricsAddr);
+    }
+    return 0;
+}
+
+//------------------------------------------
+// metricsClose()
+//------------------------------------------
+void metricsClose(metricsServer *ms)
+{
+    reqServeClose(&ms->srv);
+    free(ms->body);
+    ms->body = NULL;
+}
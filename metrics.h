@@ -0,0 +1,119 @@
+//=========================================================================
+// metrics.h
+//
+// Health and performance counters for the runMag utility, served in the
+// Prometheus text format.
+//
+// The sampling thread is the only writer of runMetrics.  It updates each
+// field with a relaxed atomic load and store, no lock and no read-modify-
+// write, so keeping the counters costs a few instructions per sample.
+// With --metrics the request server thread (reqserve.c) serves them over
+// HTTP at low priority:
+//
+//      --metrics 127.0.0.1:9310        curl http://127.0.0.1:9310/metrics
+//      --metrics /run/runmag.prom      curl --unix-socket /run/runmag.prom http://x/metrics
+//
+// A scrape loads each field on its own, so a set such as a time's sum
+// and count may be one sample apart; it never blocks or slows the loop.
+// I2C transfers and errors per device come from i2c.c.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100METRICS_h
+#define SWX3100METRICS_h
+
+#include <stdint.h>
+#include "main.h"
+#include "reqserve.h"
+
+#define METRICS_REQLEN          1024
+#define METRICS_BODYLEN         16384
+
+//------------------------------------------
+// Time spent in one step
+//------------------------------------------
+typedef struct tag_metricTime
+{
+    uint64_t    count;
+    uint64_t    sumNs;
+    uint64_t    maxNs;
+} metricTime;
+
+//------------------------------------------
+// Counters, one writer
+//------------------------------------------
+typedef struct tag_runMetrics
+{
+    uint64_t    startNs;                    // CLOCK_REALTIME
+    uint64_t    lastSampleNs;
+    uint64_t    samples;                    // output samples
+    uint64_t    readings;                   // magnetometer readings
+    uint64_t    drdyChecks;                 // status register reads
+    uint64_t    drdyTimeouts;
+    uint64_t    lateTicks;                  // ticks missed, or that found a reading unfinished
+    uint64_t    missedSeconds;              // UTC seconds without an output sample
+    uint64_t    logBytes;
+    uint64_t    logErrors;
+    uint64_t    wakeups;
+    uint64_t    convNs;                     // expected conversion time
+    metricTime  drdyWait;                   // reading started to DRDY seen
+    metricTime  output;                     // sample formatted, logged and flushed
+    uint64_t    pipeQueue;                  // records waiting for the FIFO
+    uint64_t    pipeDropped;
+    uint64_t    netClients;
+    uint64_t    netQueue;                   // bytes waiting for TCP clients
+    uint64_t    netEvicted;
+    uint64_t    journalErrors;
+} runMetrics;
+
+//------------------------------------------
+// Server state
+//------------------------------------------
+typedef struct tag_metricsServer
+{
+    pList              *p;
+    const runMetrics   *m;
+    reqServer           srv;
+    struct tag_metricsBody *body;           // the server thread's reply buffer
+    unsigned long       scrapes;
+    unsigned long       errors;
+} metricsServer;
+
+//------------------------------------------
+// metricAdd()
+//------------------------------------------
+static inline void metricAdd(uint64_t *c, uint64_t n)
+{
+    __atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+//------------------------------------------
+// metricSet()
+//------------------------------------------
+static inline void metricSet(uint64_t *g, uint64_t v)
+{
+    __atomic_store_n(g, v, __ATOMIC_RELAXED);
+}
+
+//------------------------------------------
+// metricTimeAdd()
+//------------------------------------------
+static inline void metricTimeAdd(metricTime *t, int64_t ns)
+{
+    metricAdd(&t->count, 1);
+    metricAdd(&t->sumNs, (uint64_t)ns);
+    if((uint64_t)ns > __atomic_load_n(&t->maxNs, __ATOMIC_RELAXED))
+    {
+        metricSet(&t->maxNs, (uint64_t)ns);
+    }
+}
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int metricsOpen(metricsServer *ms, pList *p, const runMetrics *m);
+void metricsClose(metricsServer *ms);
+
+#endif // SWX3100METRICS_h
@@ -0,0 +1,413 @@
+//=========================================================================
+// mseed.c
+//
+// miniSEED (SEED 2.4 data-only) writer with Steim2 compression for the
+// runMag utility.
+//
+// Each axis is its own channel of raw counts.  Samples are differenced
+// and packed into Steim2 words as soon as enough are pending to choose
+// the densest packing; a record is written out as soon as its frames
+// are full, so files grow record by record while sampling.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <string.h>
+#include "main.h"
+#include "cmdmgr.h"
+#include "mseed.h"
+
+extern char sitePrefixString[SITEPREFIXLEN];
+
+//------------------------------------------
+// Steim2 word layouts, densest first.
+//------------------------------------------
+static const struct
+{
+    int count;      // differences per word
+    int bits;       // bits per difference
+    int ck;         // 2-bit control code
+    int dnib;       // 2-bit decode nibble (in the word itself)
+} steim2Packs[] =
+{
+    { 7,  4, 3, 2 },
+    { 6,  5, 3, 1 },
+    { 5,  6, 3, 0 },
+    { 4,  8, 1, 0 },
+    { 3, 10, 2, 3 },
+    { 2, 15, 2, 2 },
+    { 1, 30, 2, 1 },
+};
+
+//------------------------------------------
+// Big-endian helpers
+//------------------------------------------
+static void putU16(uint8_t *b, uint16_t v)
+{
+    b[0] = (uint8_t)(v >> 8);
+    b[1] = (uint8_t)v;
+}
+
+static void putU32(uint8_t *b, uint32_t v)
+{
+    b[0] = (uint8_t)(v >> 24);
+    b[1] = (uint8_t)(v >> 16);
+    b[2] = (uint8_t)(v >> 8);
+    b[3] = (uint8_t)v;
+}
+
+static uint32_t getU32(const uint8_t *b)
+{
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+//------------------------------------------
+// bandCode()
+// SEED band code for a sample rate.
+//------------------------------------------
+static char bandCode(double rate)
+{
+    if(rate >= 80.0)
+    {
+        return 'H';
+    }
+    if(rate >= 10.0)
+    {
+        return 'B';
+    }
+    if(rate > 1.0)
+    {
+        return 'M';
+    }
+    if(rate >= 0.5)
+    {
+        return 'L';
+    }
+    if(rate >= 0.05)
+    {
+        return 'V';
+    }
+    return 'U';
+}
+
+//------------------------------------------
+// rateFactors()
+// SEED sample rate factor and multiplier.
+//------------------------------------------
+static void rateFactors(double rate, int16_t *factor, int16_t *mult)
+{
+    double period = 1.0 / rate;
+
+    if(rate >= 1.0 && rate == (int)rate && rate <= 32767)
+    {
+        *factor = (int16_t)rate;
+        *mult = 1;
+    }
+    else if(rate < 1.0 && period == (int)period && period <= 32767)
+    {
+        *factor = (int16_t)(-period);
+        *mult = 1;
+    }
+    else
+    {
+        // rate = factor / 10000
+        *factor = (int16_t)(rate * 10000.0 + 0.5);
+        *mult = -10000;
+    }
+}
+
+//------------------------------------------
+// fitsBits()
+//------------------------------------------
+static int fitsBits(const int32_t *d, int n, int bits)
+{
+    int32_t lo = -(1 << (bits - 1));
+    int32_t hi = (1 << (bits - 1)) - 1;
+    int i;
+
+    for(i = 0; i < n; i++)
+    {
+        if(d[i] < lo || d[i] > hi)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+//------------------------------------------
+// writeRecord()
+// Fills in the header of a full (or final) record and writes it.
+//------------------------------------------
+static void writeRecord(mseedWriter *w, mseedStream *s)
+{
+    uint8_t *h = s->rec;
+    char seqStr[8];
+    int64_t us = s->startNs / 1000;
+    int64_t ticks = (us + 50) / 100;           // 0.0001 s, rounded
+    int usOffset = (int)(us - ticks * 100);     // -50 .. 49
+    time_t secs = (time_t)(ticks / 10000);
+    struct tm t;
+    int16_t factor;
+    int16_t mult;
+
+    gmtime_r(&secs, &t);
+    rateFactors(w->rate, &factor, &mult);
+
+    w->seq = (w->seq % 999999) + 1;
+    snprintf(seqStr, sizeof(seqStr), "%06u", w->seq);
+    memcpy(h, seqStr, 6);
+    h[6] = 'D';
+    h[7] = ' ';
+    memset(h + 8, ' ', 12);
+    memcpy(h + 8,  w->sta,  strlen(w->sta));
+    memcpy(h + 13, w->loc,  strlen(w->loc));
+    memcpy(h + 15, s->chan, 3);
+    memcpy(h + 18, w->net,  strlen(w->net));
+    putU16(h + 20, (uint16_t)(t.tm_year + 1900));
+    putU16(h + 22, (uint16_t)(t.tm_yday + 1));
+    h[24] = (uint8_t)t.tm_hour;
+    h[25] = (uint8_t)t.tm_min;
+    h[26] = (uint8_t)t.tm_sec;
+    h[27] = 0;
+    putU16(h + 28, (uint16_t)(ticks % 10000));
+    putU16(h + 30, (uint16_t)s->nSamples);
+    putU16(h + 32, (uint16_t)factor);
+    putU16(h + 34, (uint16_t)mult);
+    h[36] = 0;                                  // activity flags
+    h[37] = 0;                                  // I/O and clock flags
+    h[38] = 0;                                  // data quality flags
+    h[39] = 2;                                  // blockettes that follow
+    putU32(h + 40, 0);                          // time correction
+    putU16(h + 44, MSEED_HDRLEN);               // beginning of data
+    putU16(h + 46, 48);                         // first blockette
+
+    // Blockette 1000: data only SEED
+    putU16(h + 48, 1000);
+    putU16(h + 50, 56);
+    h[52] = MSEED_ENC_STEIM2;
+    h[53] = 1;                                  // big-endian
+    h[54] = (w->recLen == MSEED_MAXRECLEN) ? 12 : 9;
+    h[55] = 0;
+
+    // Blockette 1001: data extension (microseconds, frame count)
+    putU16(h + 56, 1001);
+    putU16(h + 58, 0);
+    h[60] = 0;                                  // timing quality unknown
+    h[61] = (uint8_t)(int8_t)usOffset;
+    h[62] = 0;
+    h[63] = (uint8_t)(s->frame + (s->word > 0 ? 1 : 0));
+
+    // Reverse integration constant.
+    putU32(h + MSEED_HDRLEN + 8, (uint32_t)s->last);
+
+    if(w->fp != NULL)
+    {
+        fwrite(s->rec, 1, w->recLen, w->fp);
+        fflush(w->fp);
+    }
+    memset(s->rec, 0, w->recLen);
+    s->frame = 0;
+    s->word = 0;
+    s->nSamples = 0;
+}
+
+//------------------------------------------
+// packWord()
+// Packs the leading pending differences into one Steim2 word.
+//------------------------------------------
+static void packWord(mseedWriter *w, mseedStream *s)
+{
+    int i;
+    int j;
+    int n = 0;
+    uint32_t word = 0;
+    uint32_t mask;
+    uint8_t *frame;
+    uint32_t ctl;
+
+    for(i = 0; i < (int)(sizeof(steim2Packs) / sizeof(steim2Packs[0])); i++)
+    {
+        if(steim2Packs[i].count <= s->nPending && fitsBits(s->pDiff, steim2Packs[i].count, steim2Packs[i].bits))
+        {
+            break;
+        }
+    }
+    if(i == (int)(sizeof(steim2Packs) / sizeof(steim2Packs[0])))
+    {
+        // Difference too large for 30 bits: cannot happen with 24-bit counts.
+        i--;
+    }
+    n = steim2Packs[i].count;
+    mask = (1u << steim2Packs[i].bits) - 1;
+    if(steim2Packs[i].ck != 1)
+    {
+        word = (uint32_t)steim2Packs[i].dnib << 30;
+    }
+    for(j = 0; j < n; j++)
+    {
+        word |= ((uint32_t)s->pDiff[j] & mask) << (steim2Packs[i].bits * (n - 1 - j));
+    }
+
+    // New record: first sample becomes the forward integration constant.
+    if(s->nSamples == 0)
+    {
+        s->startNs = s->pNs[0];
+        s->word = 3;
+        putU32(s->rec + MSEED_HDRLEN + 4, (uint32_t)s->pVal[0]);
+    }
+    else if(s->word == 0)
+    {
+        s->word = 1;
+    }
+    frame = s->rec + MSEED_HDRLEN + s->frame * MSEED_FRAMELEN;
+    putU32(frame + s->word * 4, word);
+    ctl = getU32(frame) | ((uint32_t)steim2Packs[i].ck << (2 * (15 - s->word)));
+    putU32(frame, ctl);
+
+    s->nSamples += n;
+    s->last = s->pVal[n - 1];
+    s->nPending -= n;
+    memmove(s->pVal,  s->pVal + n,  s->nPending * sizeof(s->pVal[0]));
+    memmove(s->pDiff, s->pDiff + n, s->nPending * sizeof(s->pDiff[0]));
+    memmove(s->pNs,   s->pNs + n,   s->nPending * sizeof(s->pNs[0]));
+
+    if(++s->word == MSEED_FRAMELEN / 4)
+    {
+        s->word = 0;
+        if(++s->frame == w->nFrames)
+        {
+            writeRecord(w, s);
+        }
+    }
+}
+
+//------------------------------------------
+// flushStream()
+// Packs everything pending and writes a partial record.
+//------------------------------------------
+static void flushStream(mseedWriter *w, mseedStream *s)
+{
+    while(s->nPending > 0)
+    {
+        packWord(w, s);
+    }
+    if(s->nSamples > 0)
+    {
+        writeRecord(w, s);
+    }
+}
+
+//------------------------------------------
+// mseedOpen()
+//------------------------------------------
+int mseedOpen(mseedWriter *w, pList *p, double rate)
+{
+    const char *site = (p->sitePrefix != NULL) ? p->sitePrefix : sitePrefixString;
+    const char *net = (p->mseedNetwork != NULL) ? p->mseedNetwork : MSEED_DEFNETWORK;
+    const char *loc = (p->mseedLocation != NULL) ? p->mseedLocation : MSEED_DEFLOCATION;
+    int i;
+
+    memset(w, 0, sizeof(mseedWriter));
+    w->p = p;
+    w->recLen = (p->mseedRecLen == MSEED_MAXRECLEN) ? MSEED_MAXRECLEN : MSEED_MINRECLEN;
+    w->nFrames = (w->recLen / MSEED_FRAMELEN) - 1;
+    w->rate = rate;
+    w->periodNs = (int64_t)(1e9 / rate);
+    for(i = 0; i < 5 && site[i] != '\0'; i++)
+    {
+        w->sta[i] = (char)toupper((unsigned char)site[i]);
+    }
+    for(i = 0; i < 2 && net[i] != '\0'; i++)
+    {
+        w->net[i] = (char)toupper((unsigned char)net[i]);
+    }
+    for(i = 0; i < 2 && loc[i] != '\0'; i++)
+    {
+        w->loc[i] = (char)toupper((unsigned char)loc[i]);
+    }
+    for(i = 0; i < 3; i++)
+    {
+        w->axis[i].chan[0] = bandCode(rate);
+        w->axis[i].chan[1] = 'F';                   // magnetometer
+        w->axis[i].chan[2] = "XYZ"[i];
+    }
+    if((w->fp = logRollOpenFile(&w->roll, p, MSEED_SUFFIX)) == NULL)
+    {
+        perror("miniSEED file");
+        return -1;
+    }
+    if(p->verboseFlag)
+    {
+        fprintf(stdout, "\nminiSEED File: %s  (%s.%s.%s.%cF?, %i byte records)\n",
+                w->roll.curPath, w->net, w->sta, w->loc, w->axis[0].chan[0], w->recLen);
+    }
+    return 0;
+}
+
+//------------------------------------------
+// mseedPush()
+// Adds one sample to each axis channel.
+//------------------------------------------
+void mseedPush(mseedWriter *w, const magSample *smp)
+{
+    int64_t ns = (int64_t)smp->ts.tv_sec * 1000000000LL + smp->ts.tv_nsec;
+    int64_t jitter;
+    mseedStream *s;
+    int i;
+
+    if(smp->ts.tv_sec >= w->roll.boundary)
+    {
+        mseedFlush(w);
+        w->fp = logRollSwap(&w->roll, smp->ts.tv_sec);
+    }
+    for(i = 0; i < 3; i++)
+    {
+        s = &w->axis[i];
+        if(s->havePrev)
+        {
+            // A gap (or clock step) starts a new record.
+            jitter = ns - s->nextNs;
+            if(jitter > w->periodNs / 2 || jitter < -(w->periodNs / 2))
+            {
+                flushStream(w, s);
+            }
+        }
+        s->pVal[s->nPending]  = smp->rXYZ[i];
+        s->pDiff[s->nPending] = s->havePrev ? smp->rXYZ[i] - s->prev : 0;
+        s->pNs[s->nPending]   = ns;
+        s->nPending++;
+        s->prev = smp->rXYZ[i];
+        s->havePrev = TRUE;
+        s->nextNs = ns + w->periodNs;
+        if(s->nPending == MSEED_PENDING)
+        {
+            packWord(w, s);
+        }
+    }
+}
+
+//------------------------------------------
+// mseedFlush()
+// Writes partial records for all channels.
+//------------------------------------------
+void mseedFlush(mseedWriter *w)
+{
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        flushStream(w, &w->axis[i]);
+    }
+}
+
+//------------------------------------------
+// mseedClose()
+//------------------------------------------
+void mseedClose(mseedWriter *w)
+{
+    mseedFlush(w);
+    logRollClose(&w->roll);
+    w->fp = NULL;
+}
@@ -0,0 +1,77 @@
+//=========================================================================
+// mseed.h
+//
+// miniSEED (SEED 2.4 data-only) writer with Steim2 compression for the
+// runMag utility.  One channel per magnetometer axis, raw counts.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100MSEED_h
+#define SWX3100MSEED_h
+
+#include "main.h"
+#include "logroll.h"
+
+#define MSEED_SUFFIX            "runmag.mseed"
+#define MSEED_HDRLEN            64          // fixed header + blockettes 1000 and 1001
+#define MSEED_FRAMELEN          64
+#define MSEED_MINRECLEN         512
+#define MSEED_MAXRECLEN         4096
+#define MSEED_PENDING           7           // most differences a Steim2 word can hold
+#define MSEED_DEFNETWORK        "XX"
+#define MSEED_DEFLOCATION       ""
+#define MSEED_ENC_STEIM2        11
+
+//------------------------------------------
+// Per-channel Steim2 stream
+//------------------------------------------
+typedef struct tag_mseedStream
+{
+    char        chan[4];
+    uint8_t     rec[MSEED_MAXRECLEN];
+    int         frame;                      // current data frame
+    int         word;                       // next word within the frame
+    int         nSamples;                   // samples packed into the current record
+    int64_t     startNs;                    // time of the first sample in the record
+    int32_t     last;                       // last sample packed
+    int32_t     prev;                       // last sample received
+    int         havePrev;
+    int64_t     nextNs;                     // expected time of the next sample
+
+    // Samples received but not yet packed into a word
+    int32_t     pVal[MSEED_PENDING];
+    int32_t     pDiff[MSEED_PENDING];
+    int64_t     pNs[MSEED_PENDING];
+    int         nPending;
+} mseedStream;
+
+//------------------------------------------
+// miniSEED writer
+//------------------------------------------
+typedef struct tag_mseedWriter
+{
+    pList       *p;
+    logRoll      roll;
+    FILE        *fp;
+    int          recLen;
+    int          nFrames;                   // data frames per record
+    double       rate;                      // samples per second
+    int64_t      periodNs;
+    uint32_t     seq;
+    char         net[3];
+    char         sta[6];
+    char         loc[3];
+    mseedStream  axis[3];
+} mseedWriter;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int mseedOpen(mseedWriter *w, pList *p, double rate);
+void mseedPush(mseedWriter *w, const magSample *smp);
+void mseedFlush(mseedWriter *w);
+void mseedClose(mseedWriter *w);
+
+#endif // SWX3100MSEED_h
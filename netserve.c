@@ -0,0 +1,544 @@
+//=========================================================================
+// netserve.c
+//
+// Batched binary TCP/UDP sample streaming for the runMag utility.
+//
+// Like the FIFO publisher, nothing here may stall the sampling loop: all
+// sockets are non-blocking and are serviced from the loop itself.  Each
+// TCP client has its own queue of whole frames; a client that lets its
+// queue fill up is disconnected rather than allowed to hold back the rest.
+// UDP batches go to one unicast or multicast destination and carry a
+// batch sequence number so receivers can count what they lost.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#define _GNU_SOURCE                 // accept4()
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "netserve.h"
+
+//------------------------------------------
+// Little endian field access
+//------------------------------------------
+static inline void put16(uint8_t *b, uint16_t v)
+{
+    b[0] = v;
+    b[1] = v >> 8;
+}
+
+static inline void put32(uint8_t *b, uint32_t v)
+{
+    put16(b, v);
+    put16(b + 2, v >> 16);
+}
+
+static inline void put64(uint8_t *b, uint64_t v)
+{
+    put32(b, (uint32_t)v);
+    put32(b + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint16_t get16(const uint8_t *b)
+{
+    return b[0] | (b[1] << 8);
+}
+
+static inline uint32_t get32(const uint8_t *b)
+{
+    return get16(b) | ((uint32_t)get16(b + 2) << 16);
+}
+
+static inline uint64_t get64(const uint8_t *b)
+{
+    return get32(b) | ((uint64_t)get32(b + 4) << 32);
+}
+
+//------------------------------------------
+// monoNs()
+//------------------------------------------
+static int64_t monoNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//------------------------------------------
+// encodeRecord()
+//------------------------------------------
+static void encodeRecord(uint8_t *b, const magRecord *rec)
+{
+    uint64_t u64;
+    uint32_t u32;
+    int i;
+
+    put64(b, rec->seq);
+    put64(b + 8, (uint64_t)rec->tsNs);
+    for(i = 0; i < 3; i++)
+    {
+        put32(b + 16 + 4 * i, (uint32_t)rec->rXYZ[i]);
+    }
+    put32(b + 28, rec->flags);
+    for(i = 0; i < 3; i++)
+    {
+        memcpy(&u64, &rec->xyz[i], sizeof(u64));
+        put64(b + 32 + 8 * i, u64);
+    }
+    memcpy(&u32, &rec->rcTemp, sizeof(u32));
+    put32(b + 56, u32);
+    memcpy(&u32, &rec->lcTemp, sizeof(u32));
+    put32(b + 60, u32);
+}
+
+//------------------------------------------
+// decodeRecord()
+//------------------------------------------
+static void decodeRecord(const uint8_t *b, magRecord *rec)
+{
+    uint64_t u64;
+    uint32_t u32;
+    int i;
+
+    rec->seq = get64(b);
+    rec->tsNs = (int64_t)get64(b + 8);
+    for(i = 0; i < 3; i++)
+    {
+        rec->rXYZ[i] = (int32_t)get32(b + 16 + 4 * i);
+    }
+    rec->flags = get32(b + 28);
+    for(i = 0; i < 3; i++)
+    {
+        u64 = get64(b + 32 + 8 * i);
+        memcpy(&rec->xyz[i], &u64, sizeof(u64));
+    }
+    u32 = get32(b + 56);
+    memcpy(&rec->rcTemp, &u32, sizeof(u32));
+    u32 = get32(b + 60);
+    memcpy(&rec->lcTemp, &u32, sizeof(u32));
+}
+
+//------------------------------------------
+// netBatchDecode()
+// Decodes one batch (without the TCP length prefix).
+// Returns the number of records, or -1 if it is not a valid batch.
+//------------------------------------------
+int netBatchDecode(const uint8_t *buf, size_t len, netBatchHdr *hdr, magRecord *recs, int maxRecs)
+{
+    int i;
+
+    if(len < NETSERVE_HDRLEN)
+    {
+        return -1;
+    }
+    hdr->magic = get32(buf);
+    hdr->version = get16(buf + 4);
+    hdr->count = get16(buf + 6);
+    hdr->batchSeq = get64(buf + 8);
+    memcpy(hdr->site, buf + 16, NETSERVE_SITELEN);
+    hdr->site[NETSERVE_SITELEN] = '\0';
+    if(hdr->magic != NETSERVE_MAGIC || hdr->version != NETSERVE_VERSION ||
+       hdr->count > maxRecs || len != NETSERVE_HDRLEN + (size_t)hdr->count * NETSERVE_RECLEN)
+    {
+        return -1;
+    }
+    for(i = 0; i < hdr->count; i++)
+    {
+        decodeRecord(buf + NETSERVE_HDRLEN + i * NETSERVE_RECLEN, &recs[i]);
+    }
+    return hdr->count;
+}
+
+//------------------------------------------
+// netParseAddr()
+// Accepts "port", "host:port" or "[v6addr]:port".  A bare port means
+// any address when passive, loopback otherwise.
+//------------------------------------------
+int netParseAddr(const char *spec, int passive, int sockType, struct sockaddr_storage *ss, socklen_t *len)
+{
+    char host[256] = "";
+    const char *port = spec;
+    const char *colon = strrchr(spec, ':');
+    struct addrinfo hints;
+    struct addrinfo *ai = NULL;
+    size_t n;
+    int rv;
+
+    if(colon != NULL)
+    {
+        n = colon - spec;
+        if(n > 0 && spec[0] == '[' && spec[n - 1] == ']')
+        {
+            spec++;
+            n -= 2;
+        }
+        if(n >= sizeof(host))
+        {
+            return -1;
+        }
+        memcpy(host, spec, n);
+        host[n] = '\0';
+        port = colon + 1;
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = sockType;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    hints.ai_family = (host[0] == '\0') ? AF_INET : AF_UNSPEC;
+    if((rv = getaddrinfo(host[0] ? host : NULL, port, &hints, &ai)) != 0)
+    {
+        fprintf(stderr, "Net: %s: %s\n", spec, gai_strerror(rv));
+        return -1;
+    }
+    memcpy(ss, ai->ai_addr, ai->ai_addrlen);
+    *len = ai->ai_addrlen;
+    freeaddrinfo(ai);
+    return 0;
+}
+
+//------------------------------------------
+// isMulticast()
+//------------------------------------------
+static int isMulticast(const struct sockaddr_storage *ss)
+{
+    if(ss->ss_family == AF_INET)
+    {
+        return IN_MULTICAST(ntohl(((const struct sockaddr_in *)ss)->sin_addr.s_addr));
+    }
+    if(ss->ss_family == AF_INET6)
+    {
+        return IN6_IS_ADDR_MULTICAST(&((const struct sockaddr_in6 *)ss)->sin6_addr);
+    }
+    return 0;
+}
+
+//------------------------------------------
+// openListener()
+//------------------------------------------
+static int openListener(const char *spec)
+{
+    struct sockaddr_storage ss;
+    socklen_t len;
+    int on = 1;
+    int fd;
+
+    if(netParseAddr(spec, 1, SOCK_STREAM, &ss, &len) != 0)
+    {
+        return -1;
+    }
+    if((fd = socket(ss.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        perror("Net server: socket()");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if(bind(fd, (struct sockaddr *)&ss, len) != 0 || listen(fd, NETSERVE_MAXCLIENTS) != 0)
+    {
+        perror("Net server: bind()/listen()");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//------------------------------------------
+// openUdp()
+//------------------------------------------
+static int openUdp(netServer *ns, const char *spec, int ttl)
+{
+    int fd;
+
+    if(netParseAddr(spec, 0, SOCK_DGRAM, &ns->udpAddr, &ns->udpAddrLen) != 0)
+    {
+        return -1;
+    }
+    if((fd = socket(ns->udpAddr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        perror("Net server: UDP socket()");
+        return -1;
+    }
+    if(isMulticast(&ns->udpAddr))
+    {
+        if(ns->udpAddr.ss_family == AF_INET)
+        {
+            unsigned char t = (unsigned char)ttl;
+            setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &t, sizeof(t));
+        }
+        else
+        {
+            setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl));
+        }
+    }
+    return fd;
+}
+
+//------------------------------------------
+// netServeOpen()
+//------------------------------------------
+int netServeOpen(netServer *ns, pList *p)
+{
+    int i;
+
+    memset(ns, 0, sizeof(netServer));
+    ns->listenFd = -1;
+    ns->udpFd = -1;
+    ns->batchLen = p->netBatch;
+    ns->lingerNs = (int64_t)p->netLingerMs * 1000000LL;
+    ns->queueLen = (size_t)p->tcpQueueKB * 1024;
+    snprintf(ns->site, sizeof(ns->site), "%s", (p->sitePrefix != NULL) ? p->sitePrefix : "");
+    for(i = 0; i < NETSERVE_MAXCLIENTS; i++)
+    {
+        ns->client[i].fd = -1;
+    }
+    if(p->tcpListen != NULL && (ns->listenFd = openListener(p->tcpListen)) < 0)
+    {
+        return -1;
+    }
+    if(p->udpDest != NULL && (ns->udpFd = openUdp(ns, p->udpDest, p->udpTtl)) < 0)
+    {
+        netServeClose(ns);
+        return -1;
+    }
+    // A client going away must not kill us.
+    signal(SIGPIPE, SIG_IGN);
+    return 0;
+}
+
+//------------------------------------------
+// dropClient()
+//------------------------------------------
+static void dropClient(netClient *c)
+{
+    close(c->fd);
+    c->fd = -1;
+    free(c->queue);
+    c->queue = NULL;
+    c->head = 0;
+    c->len = 0;
+}
+
+//------------------------------------------
+// acceptClients()
+//------------------------------------------
+static void acceptClients(netServer *ns)
+{
+    struct sockaddr_storage ss;
+    socklen_t len;
+    char host[48];
+    char port[8];
+    netClient *c;
+    int on = 1;
+    int fd;
+    int i;
+
+    while(1)
+    {
+        len = sizeof(ss);
+        if((fd = accept4(ns->listenFd, (struct sockaddr *)&ss, &len, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0)
+        {
+            return;
+        }
+        for(i = 0, c = NULL; i < NETSERVE_MAXCLIENTS && c == NULL; i++)
+        {
+            if(ns->client[i].fd < 0)
+            {
+                c = &ns->client[i];
+            }
+        }
+        if(c == NULL || (c->queue = malloc(ns->queueLen)) == NULL)
+        {
+            close(fd);
+            continue;
+        }
+        // Frames are already batched; don't let Nagle hold them back.
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        if(getnameinfo((struct sockaddr *)&ss, len, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+        {
+            strcpy(host, "?");
+            strcpy(port, "?");
+        }
+        snprintf(c->addr, sizeof(c->addr), "%s:%s", host, port);
+        c->fd = fd;
+        c->head = 0;
+        c->len = 0;
+        ns->accepted++;
+    }
+}
+
+//------------------------------------------
+// sendClient()
+// Writes as much of the client's queue as the socket will take.
+// Returns -1 if the client has gone.
+//------------------------------------------
+static int sendClient(netClient *c)
+{
+    ssize_t n;
+
+    while(c->len > 0)
+    {
+        if((n = send(c->fd, c->queue + c->head, c->len, MSG_DONTWAIT | MSG_NOSIGNAL)) < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            {
+                return 0;
+            }
+            return -1;
+        }
+        c->head += n;
+        c->len -= n;
+    }
+    c->head = 0;
+    return 0;
+}
+
+//------------------------------------------
+// clientGone()
+// Clients have nothing to say; a read of 0 means they hung up.
+//------------------------------------------
+static int clientGone(netClient *c)
+{
+    char junk[256];
+    ssize_t n;
+
+    while((n = recv(c->fd, junk, sizeof(junk), MSG_DONTWAIT)) > 0)
+    {
+    }
+    return (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR));
+}
+
+//------------------------------------------
+// flushBatch()
+// Sends the pending batch over UDP and queues it for every TCP client.
+//------------------------------------------
+static void flushBatch(netServer *ns)
+{
+    size_t frameLen = 4 + NETSERVE_HDRLEN + (size_t)ns->pending * NETSERVE_RECLEN;
+    netClient *c;
+    int i;
+
+    if(ns->pending == 0)
+    {
+        return;
+    }
+    put32(ns->frame, (uint32_t)(frameLen - 4));
+    put32(ns->frame + 4, NETSERVE_MAGIC);
+    put16(ns->frame + 8, NETSERVE_VERSION);
+    put16(ns->frame + 10, (uint16_t)ns->pending);
+    put64(ns->frame + 12, ns->batchSeq++);
+    memcpy(ns->frame + 20, ns->site, NETSERVE_SITELEN);
+    ns->pending = 0;
+    ns->batches++;
+
+    if(ns->udpFd >= 0)
+    {
+        if(sendto(ns->udpFd, ns->frame + 4, frameLen - 4, MSG_DONTWAIT, (struct sockaddr *)&ns->udpAddr, ns->udpAddrLen) < 0)
+        {
+            ns->udpErrors++;
+        }
+    }
+    for(i = 0; i < NETSERVE_MAXCLIENTS; i++)
+    {
+        c = &ns->client[i];
+        if(c->fd < 0)
+        {
+            continue;
+        }
+        if(c->head + c->len + frameLen > ns->queueLen)
+        {
+            memmove(c->queue, c->queue + c->head, c->len);
+            c->head = 0;
+        }
+        if(c->len + frameLen > ns->queueLen)
+        {
+            fprintf(stderr, "Net server: evicting slow client %s\n", c->addr);
+            dropClient(c);
+            ns->evicted++;
+            continue;
+        }
+        memcpy(c->queue + c->head + c->len, ns->frame, frameLen);
+        c->len += frameLen;
+        if(sendClient(c) != 0)
+        {
+            dropClient(c);
+        }
+    }
+}
+
+//------------------------------------------
+// netServePublish()
+// Adds one record to the current batch; sends it when it is full.
+//------------------------------------------
+void netServePublish(netServer *ns, const magRecord *rec)
+{
+    if(ns->pending == 0)
+    {
+        ns->firstNs = monoNs();
+    }
+    encodeRecord(ns->frame + 4 + NETSERVE_HDRLEN + ns->pending * NETSERVE_RECLEN, rec);
+    ns->pending++;
+    if(ns->pending >= ns->batchLen || monoNs() - ns->firstNs >= ns->lingerNs)
+    {
+        flushBatch(ns);
+    }
+}
+
+//------------------------------------------
+// netServePoll()
+// Accepts new clients, retires dead ones, drains queues and sends a
+// partial batch that has waited long enough.  Call it often.
+//------------------------------------------
+void netServePoll(netServer *ns)
+{
+    netClient *c;
+    int i;
+
+    if(ns->listenFd >= 0)
+    {
+        acceptClients(ns);
+    }
+    for(i = 0; i < NETSERVE_MAXCLIENTS; i++)
+    {
+        c = &ns->client[i];
+        if(c->fd >= 0 && (clientGone(c) || sendClient(c) != 0))
+        {
+            dropClient(c);
+        }
+    }
+    if(ns->pending > 0 && monoNs() - ns->firstNs >= ns->lingerNs)
+    {
+        flushBatch(ns);
+    }
+}
+
+//------------------------------------------
+// netServeClose()
+//------------------------------------------
+void netServeClose(netServer *ns)
+{
+    int i;
+
+    flushBatch(ns);
+    for(i = 0; i < NETSERVE_MAXCLIENTS; i++)
+    {
+        if(ns->client[i].fd >= 0)
+        {
+            sendClient(&ns->client[i]);
+            dropClient(&ns->client[i]);
+        }
+    }
+    if(ns->listenFd >= 0)
+    {
+        close(ns->listenFd);
+        ns->listenFd = -1;
+    }
+    if(ns->udpFd >= 0)
+    {
+        close(ns->udpFd);
+        ns->udpFd = -1;
+    }
+}
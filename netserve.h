@@ -0,0 +1,104 @@
+//=========================================================================
+// netserve.h
+//
+// Batched binary TCP/UDP sample streaming for the runMag utility.
+//
+// Samples are sent in batches of magRecords.  Everything on the wire is
+// little endian:
+//
+//      TCP:  uint32 length of what follows, then a batch
+//      UDP:  one batch per datagram
+//
+//      batch header (32 bytes)
+//          uint32  magic           NETSERVE_MAGIC
+//          uint16  version
+//          uint16  count           records that follow
+//          uint64  batchSeq        +1 per batch; a gap means batches were lost
+//          char    site[16]        site prefix, NUL padded
+//      count * 64 byte records laid out as magRecord (magrec.h)
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100NETSERVE_h
+#define SWX3100NETSERVE_h
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include "main.h"
+#include "magrec.h"
+
+#define NETSERVE_MAGIC          0x424E4D52  // "RMNB"
+#define NETSERVE_VERSION        1
+#define NETSERVE_HDRLEN         32
+#define NETSERVE_RECLEN         64
+#define NETSERVE_SITELEN        16
+#define NETSERVE_MAXBATCH       22          // 32 + 22 * 64 = 1440 bytes, one 1500 byte MTU
+#define NETSERVE_DEFBATCH       1
+#define NETSERVE_DEFLINGER      1000        // ms a partial batch may wait
+#define NETSERVE_MAXCLIENTS     8
+#define NETSERVE_DEFQUEUE       64          // KB queued per TCP client
+#define NETSERVE_MAXQUEUE       4096
+#define NETSERVE_DEFTTL         1
+#define NETSERVE_FRAMELEN       (4 + NETSERVE_HDRLEN + NETSERVE_MAXBATCH * NETSERVE_RECLEN)
+
+//------------------------------------------
+// Decoded batch header
+//------------------------------------------
+typedef struct tag_netBatchHdr
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    count;
+    uint64_t    batchSeq;
+    char        site[NETSERVE_SITELEN + 1];
+} netBatchHdr;
+
+//------------------------------------------
+// One TCP subscriber
+//------------------------------------------
+typedef struct tag_netClient
+{
+    int             fd;                     // -1 when free
+    char            addr[64];
+    uint8_t        *queue;                  // whole frames waiting to be sent
+    size_t          head;
+    size_t          len;
+} netClient;
+
+//------------------------------------------
+// Server state
+//------------------------------------------
+typedef struct tag_netServer
+{
+    int             listenFd;
+    int             udpFd;
+    struct sockaddr_storage udpAddr;
+    socklen_t       udpAddrLen;
+    int             batchLen;
+    int64_t         lingerNs;
+    size_t          queueLen;
+    char            site[NETSERVE_SITELEN + 1];
+    uint8_t         frame[NETSERVE_FRAMELEN];
+    int             pending;                // records in frame
+    int64_t         firstNs;                // CLOCK_MONOTONIC when the first one was added
+    uint64_t        batchSeq;
+    netClient       client[NETSERVE_MAXCLIENTS];
+    unsigned long   batches;
+    unsigned long   accepted;
+    unsigned long   evicted;
+    unsigned long   udpErrors;
+} netServer;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int netParseAddr(const char *spec, int passive, int sockType, struct sockaddr_storage *ss, socklen_t *len);
+int netServeOpen(netServer *ns, pList *p);
+void netServePublish(netServer *ns, const magRecord *rec);
+void netServePoll(netServer *ns);
+void netServeClose(netServer *ns);
+int netBatchDecode(const uint8_t *buf, size_t len, netBatchHdr *hdr, magRecord *recs, int maxRecs);
+
+#endif // SWX3100NETSERVE_h
@@ -0,0 +1,285 @@
+//=========================================================================
+// pipeout.c
+//
+// Non-blocking FIFO publisher for the runMag utility.
+//
+// Encoded records are queued in a fixed ring and written to the FIFO with
+// O_NONBLOCK, at most PIPE_BUF bytes per write so each write is atomic.
+// A missing or stalled reader never blocks the sampling loop: the open is
+// retried once a second, and when the ring is full the configured policy
+// decides which records to give up.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "main.h"
+#include "pipeout.h"
+
+#define PIPEOUT_MAXIOV  16
+
+//------------------------------------------
+// parsePipePolicy()
+//------------------------------------------
+int parsePipePolicy(const char *spec)
+{
+    if(!strcasecmp(spec, "oldest"))
+    {
+        return ePIPE_DROP_OLDEST;
+    }
+    if(!strcasecmp(spec, "newest"))
+    {
+        return ePIPE_DROP_NEWEST;
+    }
+    if(!strcasecmp(spec, "decimate"))
+    {
+        return ePIPE_DECIMATE;
+    }
+    return -1;
+}
+
+//------------------------------------------
+// pipePolicyName()
+//------------------------------------------
+const char *pipePolicyName(int policy)
+{
+    switch(policy)
+    {
+        case ePIPE_DROP_NEWEST:
+            return "drop newest";
+        case ePIPE_DECIMATE:
+            return "decimate";
+        default:
+            return "drop oldest";
+    }
+}
+
+//------------------------------------------
+// slotAt()
+//------------------------------------------
+static inline int slotAt(pipeOut *po, int i)
+{
+    return (po->head + i) % po->capacity;
+}
+
+//------------------------------------------
+// decimateQueue()
+// Keeps every other queued record, so the backlog still spans the same
+// time at half the resolution.
+//------------------------------------------
+static void decimateQueue(pipeOut *po)
+{
+    int i;
+    int kept = 1;
+    int from;
+    int to;
+
+    // The head record may be partly written; keep it and thin the rest.
+    for(i = 2; i < po->count; i += 2)
+    {
+        from = slotAt(po, i);
+        to = slotAt(po, kept);
+        memcpy(po->slots + to * PIPEOUT_RECLEN, po->slots + from * PIPEOUT_RECLEN, po->len[from]);
+        po->len[to] = po->len[from];
+        kept++;
+    }
+    po->dropped += po->count - kept;
+    po->count = kept;
+}
+
+//------------------------------------------
+// connectPipe()
+//------------------------------------------
+static void connectPipe(pipeOut *po)
+{
+    time_t now = time(NULL);
+
+    if(now == po->lastTry)
+    {
+        return;
+    }
+    po->lastTry = now;
+    // ENXIO just means nobody is reading yet.
+    if((po->fd = open(po->path, O_WRONLY | O_NONBLOCK | O_CLOEXEC)) >= 0)
+    {
+        po->connects++;
+        // Don't hand a new reader half a record.
+        po->headOff = 0;
+    }
+}
+
+//------------------------------------------
+// pipeOutOpen()
+//------------------------------------------
+int pipeOutOpen(pipeOut *po, pList *p)
+{
+    struct stat st;
+
+    memset(po, 0, sizeof(pipeOut));
+    po->fd = -1;
+    po->path = p->pipeOutPath;
+    po->policy = p->pipePolicy;
+    po->capacity = (p->pipeQueueLen < PIPEOUT_MINQUEUE) ? PIPEOUT_MINQUEUE : p->pipeQueueLen;
+    if(stat(po->path, &st) != 0)
+    {
+        if(mkfifo(po->path, 0666) != 0)
+        {
+            perror("Output pipe: mkfifo()");
+            return -1;
+        }
+    }
+    else if(!S_ISFIFO(st.st_mode))
+    {
+        fprintf(stderr, "Output pipe: %s is not a FIFO.\n", po->path);
+        return -1;
+    }
+    po->len = calloc(po->capacity, sizeof(uint16_t));
+    po->slots = malloc((size_t)po->capacity * PIPEOUT_RECLEN);
+    if(po->len == NULL || po->slots == NULL)
+    {
+        perror("Output pipe: queue");
+        return -1;
+    }
+    // A reader going away must not kill us.
+    signal(SIGPIPE, SIG_IGN);
+    connectPipe(po);
+    return 0;
+}
+
+//------------------------------------------
+// pipeOutPublish()
+// Queues one encoded record and writes whatever the reader will take.
+//------------------------------------------
+void pipeOutPublish(pipeOut *po, const char *rec, int n)
+{
+    int slot;
+
+    if(n > PIPEOUT_RECLEN)
+    {
+        n = PIPEOUT_RECLEN;
+    }
+    if(po->count == po->capacity)
+    {
+        switch(po->policy)
+        {
+            case ePIPE_DROP_NEWEST:
+                po->dropped++;
+                pipeOutDrain(po);
+                return;
+            case ePIPE_DECIMATE:
+                decimateQueue(po);
+                break;
+            default:
+                // The head record may already be partly on the wire; it is
+                // finished first and the oldest whole record goes instead.
+                if(po->headOff > 0)
+                {
+                    slot = slotAt(po, 1);
+                    memcpy(po->slots + slot * PIPEOUT_RECLEN, po->slots + po->head * PIPEOUT_RECLEN, po->len[po->head]);
+                    po->len[slot] = po->len[po->head];
+                }
+                po->head = (po->head + 1) % po->capacity;
+                po->count--;
+                po->dropped++;
+                break;
+        }
+    }
+    slot = slotAt(po, po->count);
+    memcpy(po->slots + slot * PIPEOUT_RECLEN, rec, n);
+    po->len[slot] = (uint16_t)n;
+    po->count++;
+    pipeOutDrain(po);
+}
+
+//------------------------------------------
+// pipeOutDrain()
+// Writes queued records until the FIFO is full or the queue is empty.
+//------------------------------------------
+void pipeOutDrain(pipeOut *po)
+{
+    struct iovec iov[PIPEOUT_MAXIOV];
+    int nIov;
+    int bytes;
+    int slot;
+    int off;
+    ssize_t n;
+
+    if(po->fd < 0)
+    {
+        connectPipe(po);
+        if(po->fd < 0)
+        {
+            return;
+        }
+    }
+    while(po->count > 0)
+    {
+        nIov = 0;
+        bytes = 0;
+        off = po->headOff;
+        while(nIov < PIPEOUT_MAXIOV && nIov < po->count)
+        {
+            slot = slotAt(po, nIov);
+            if(nIov > 0 && bytes + po->len[slot] > PIPE_BUF)
+            {
+                break;
+            }
+            iov[nIov].iov_base = po->slots + slot * PIPEOUT_RECLEN + off;
+            iov[nIov].iov_len = po->len[slot] - off;
+            bytes += iov[nIov].iov_len;
+            off = 0;
+            nIov++;
+        }
+        if((n = writev(po->fd, iov, nIov)) < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+            {
+                return;
+            }
+            // EPIPE: reader went away.  Reopen later, keep the queue.
+            close(po->fd);
+            po->fd = -1;
+            po->headOff = 0;
+            return;
+        }
+        // Retire whole records written; remember a partial one.
+        while(n > 0 && po->count > 0)
+        {
+            int left = po->len[po->head] - po->headOff;
+            if(n >= left)
+            {
+                n -= left;
+                po->headOff = 0;
+                po->head = (po->head + 1) % po->capacity;
+                po->count--;
+                po->sent++;
+            }
+            else
+            {
+                po->headOff += n;
+                n = 0;
+            }
+        }
+    }
+}
+
+//------------------------------------------
+// pipeOutClose()
+//------------------------------------------
+void pipeOutClose(pipeOut *po)
+{
+    if(po->fd >= 0)
+    {
+        pipeOutDrain(po);
+        close(po->fd);
+        po->fd = -1;
+    }
+    free(po->len);
+    free(po->slots);
+    po->len = NULL;
+    po->slots = NULL;
+}
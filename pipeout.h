@@ -0,0 +1,61 @@
+//=========================================================================
+// pipeout.h
+//
+// Non-blocking FIFO publisher for the runMag utility.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100PIPEOUT_h
+#define SWX3100PIPEOUT_h
+
+#include "main.h"
+
+#define PIPEOUT_DEFPATH         "/home/web/wsroot/pipein.fifo"
+#define PIPEOUT_DEFQUEUE        64
+#define PIPEOUT_MINQUEUE        2           // room for a partly written head and one more
+#define PIPEOUT_MAXQUEUE        65536
+#define PIPEOUT_RECLEN          SAMPLEBUFLEN
+
+//-------------------------------------------
+// What to do when the queue is full
+//-------------------------------------------
+typedef enum
+{
+    ePIPE_DROP_OLDEST = 0,
+    ePIPE_DROP_NEWEST,
+    ePIPE_DECIMATE,
+} pipePolicy;
+
+//------------------------------------------
+// FIFO publisher state
+//------------------------------------------
+typedef struct tag_pipeOut
+{
+    const char     *path;
+    int             fd;
+    int             policy;
+    int             capacity;
+    int             head;
+    int             count;
+    int             headOff;                // bytes of the head record already written
+    uint16_t       *len;
+    char           *slots;                  // capacity * PIPEOUT_RECLEN
+    time_t          lastTry;
+    unsigned long   sent;
+    unsigned long   dropped;
+    unsigned long   connects;
+} pipeOut;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int parsePipePolicy(const char *spec);
+const char *pipePolicyName(int policy);
+int pipeOutOpen(pipeOut *po, pList *p);
+void pipeOutPublish(pipeOut *po, const char *rec, int n);
+void pipeOutDrain(pipeOut *po);
+void pipeOutClose(pipeOut *po);
+
+#endif // SWX3100PIPEOUT_h
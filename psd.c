@@ -0,0 +1,433 @@
+//=========================================================================
+// psd.c
+//
+// Streaming power spectral density (Welch's method) for the runMag utility.
+// See psd.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "psd.h"
+#include "netserve.h"
+
+//------------------------------------------
+// Little endian field access
+//------------------------------------------
+static inline void put16(uint8_t *b, uint16_t v)
+{
+    b[0] = v;
+    b[1] = v >> 8;
+}
+
+static inline void put32(uint8_t *b, uint32_t v)
+{
+    put16(b, v);
+    put16(b + 2, v >> 16);
+}
+
+static inline void put64(uint8_t *b, uint64_t v)
+{
+    put32(b, (uint32_t)v);
+    put32(b + 4, (uint32_t)(v >> 32));
+}
+
+//------------------------------------------
+// binDensity()
+// Density of bin k in one axis lane.
+//------------------------------------------
+static inline double binDensity(const psdStage *ps, int k, int axis)
+{
+    double s = ps->scale / ps->segs;
+
+    if(k > 0 && k < ps->nfft / 2)
+    {
+        s *= 2.0;                               // one-sided
+    }
+    return ps->acc[k][axis] * s;
+}
+
+//------------------------------------------
+// catJson()
+//------------------------------------------
+static size_t catJson(const psdStage *ps, char *buf, size_t cap, int64_t t1Ns)
+{
+    static const char axisName[3] = { 'x', 'y', 'z' };
+    struct tm utc;
+    time_t secs = ps->t0Ns / 1000000000LL;
+    char utcStr[32];
+    size_t pos;
+    int axis;
+    int k;
+
+    gmtime_r(&secs, &utc);
+    strftime(utcStr, sizeof(utcStr), "%Y-%m-%dT%H:%M:%S", &utc);
+    pos = snprintf(buf, cap, "{\"ts\":\"%s.%03iZ\",\"dur\":%.3f,\"fs\":%.6g,\"nfft\":%i,\"segs\":%i,\"df\":%.6g",
+                   utcStr, (int)(ps->t0Ns % 1000000000LL / 1000000), (t1Ns - ps->t0Ns) / 1e9,
+                   ps->fs, ps->nfft, ps->segs, ps->fs / ps->nfft);
+    for(axis = 0; axis < 3 && pos < cap; axis++)
+    {
+        pos += snprintf(buf + pos, cap - pos, ",\"%c\":[", axisName[axis]);
+        for(k = 0; k < ps->nbins && pos < cap; k++)
+        {
+            pos += snprintf(buf + pos, cap - pos, k ? ",%.4e" : "%.4e", binDensity(ps, k, axis));
+        }
+        if(pos < cap)
+        {
+            pos += snprintf(buf + pos, cap - pos, "]");
+        }
+    }
+    if(pos < cap)
+    {
+        pos += snprintf(buf + pos, cap - pos, "}\n");
+    }
+    return (pos < cap) ? pos : cap - 1;
+}
+
+//------------------------------------------
+// catBinary()
+//------------------------------------------
+static size_t catBinary(const psdStage *ps, uint8_t *b, int64_t t1Ns)
+{
+    uint64_t u64;
+    float f;
+    int axis;
+    int k;
+
+    memset(b, 0, PSD_HDRLEN);
+    put32(b, PSD_MAGIC);
+    put16(b + 4, PSD_VERSION);
+    put16(b + 6, PSD_HDRLEN);
+    put32(b + 8, ps->nfft);
+    put32(b + 12, ps->nbins);
+    put32(b + 16, ps->segs);
+    memcpy(&u64, &ps->fs, sizeof(u64));
+    put64(b + 24, u64);
+    put64(b + 32, (uint64_t)ps->t0Ns);
+    put64(b + 40, (uint64_t)t1Ns);
+    memcpy(b + 48, ps->site, PSD_SITELEN);
+    b += PSD_HDRLEN;
+    for(axis = 0; axis < 3; axis++)
+    {
+        for(k = 0; k < ps->nbins; k++, b += 4)
+        {
+            f = (float)binDensity(ps, k, axis);
+            memcpy(&u64, &f, sizeof(f));
+            put32(b, (uint32_t)u64);
+        }
+    }
+    return PSD_HDRLEN + 12 * (size_t)ps->nbins;
+}
+
+//------------------------------------------
+// emitFrame()
+//------------------------------------------
+static void emitFrame(psdStage *ps, int64_t t1Ns)
+{
+    size_t len;
+
+    if(ps->binary)
+    {
+        len = catBinary(ps, ps->frame, t1Ns);
+    }
+    else
+    {
+        len = catJson(ps, (char *)ps->frame, ps->frameCap, t1Ns);
+    }
+    if(ps->udpFd >= 0)
+    {
+        sendto(ps->udpFd, ps->frame, len, MSG_DONTWAIT, (struct sockaddr *)&ps->dest, ps->destLen);
+    }
+    else
+    {
+        if(ps->useRoll)
+        {
+            ps->fp = logRollCheck(&ps->roll, time(NULL));
+        }
+        fwrite(ps->frame, 1, len, ps->fp);
+        fflush(ps->fp);
+    }
+    ps->frames++;
+}
+
+//------------------------------------------
+// doSegment()
+// Transforms the segment at segStart and adds it to the frame.
+//------------------------------------------
+static void doSegment(psdStage *ps)
+{
+    uint64_t mask = ps->ringLen - 1;
+    v4df sum = { 0.0, 0.0, 0.0, 0.0 };
+    v4df mean;
+    uint64_t written;
+    int64_t firstNs;
+    int64_t lastNs;
+    int i;
+
+    for(i = 0; i < ps->nfft; i++)
+    {
+        ps->re[i] = ps->ring[(ps->segStart + i) & mask];
+        sum += ps->re[i];
+    }
+    firstNs = ps->ringNs[ps->segStart & mask];
+    lastNs = ps->ringNs[(ps->segStart + ps->nfft - 1) & mask];
+    written = __atomic_load_n(&ps->written, __ATOMIC_ACQUIRE);
+    if(written >= ps->segStart + ps->ringLen)
+    {
+        // The sampling loop lapped us while copying; start a fresh frame
+        // at the next hop boundary.
+        ps->overruns++;
+        ps->segs = 0;
+        ps->segStart += ((written - ps->segStart) / ps->hop + 1) * ps->hop;
+        return;
+    }
+    mean = sum / (double)ps->nfft;
+    for(i = 0; i < ps->nfft; i++)
+    {
+        ps->re[i] = (ps->re[i] - mean) * ps->window[i];
+        ps->im[i] = (v4df){ 0.0, 0.0, 0.0, 0.0 };
+    }
+    fftRun(&ps->plan, ps->re, ps->im);
+    if(ps->segs == 0)
+    {
+        memset(ps->acc, 0, ps->nbins * sizeof(v4df));
+        ps->t0Ns = firstNs;
+    }
+    for(i = 0; i < ps->nbins; i++)
+    {
+        ps->acc[i] += ps->re[i] * ps->re[i] + ps->im[i] * ps->im[i];
+    }
+    ps->segStart += ps->hop;
+    if(++ps->segs == ps->avg)
+    {
+        emitFrame(ps, lastNs);
+        ps->segs = 0;
+    }
+}
+
+//------------------------------------------
+// psdWorker()
+//------------------------------------------
+static void *psdWorker(void *arg)
+{
+    psdStage *ps = (psdStage *)arg;
+    uint64_t written;
+    uint64_t resetAt;
+
+#ifdef SYS_gettid
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), PSD_NICE);
+#endif
+    pthread_mutex_lock(&ps->lock);
+    while(1)
+    {
+        resetAt = __atomic_load_n(&ps->resetAt, __ATOMIC_ACQUIRE);
+        if(resetAt > ps->segStart)
+        {
+            ps->gaps++;
+            ps->segStart = resetAt;
+            ps->segs = 0;
+        }
+        written = __atomic_load_n(&ps->written, __ATOMIC_ACQUIRE);
+        if(written >= ps->segStart + ps->nfft)
+        {
+            pthread_mutex_unlock(&ps->lock);
+            doSegment(ps);
+            pthread_mutex_lock(&ps->lock);
+            continue;
+        }
+        if(ps->stop)
+        {
+            break;
+        }
+        pthread_cond_wait(&ps->wake, &ps->lock);
+    }
+    pthread_mutex_unlock(&ps->lock);
+    return NULL;
+}
+
+//------------------------------------------
+// openOutput()
+// UDP for "udp:host:port", else a file; by default a rolled side file.
+//------------------------------------------
+static int openOutput(psdStage *ps, pList *p)
+{
+    ps->udpFd = -1;
+    if(p->psdOut != NULL && !strncmp(p->psdOut, "udp:", 4))
+    {
+        if(netParseAddr(p->psdOut + 4, 0, SOCK_DGRAM, &ps->dest, &ps->destLen) != 0)
+        {
+            return -1;
+        }
+        if((ps->udpFd = socket(ps->dest.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+        {
+            perror("PSD: socket()");
+            return -1;
+        }
+        ps->binary = TRUE;
+        if(PSD_HDRLEN + 12 * ps->nbins > PSD_UDPMAX)
+        {
+            fprintf(stderr, "PSD: %i point frames do not fit in a UDP datagram.\n", ps->nfft);
+            return -1;
+        }
+        return 0;
+    }
+    if(p->psdOut != NULL)
+    {
+        if((ps->fp = fopen(p->psdOut, "a")) == NULL)
+        {
+            perror("PSD output file");
+            return -1;
+        }
+        return 0;
+    }
+    if(!p->buildLogPath)
+    {
+        fprintf(stderr, "\n --psd needs log files (-k) or --psd-out.\n\n");
+        return -1;
+    }
+    if((ps->fp = logRollOpenFile(&ps->roll, p, ps->binary ? PSD_BINSUFFIX : PSD_JSONSUFFIX)) == NULL)
+    {
+        perror("PSD side file");
+        return -1;
+    }
+    ps->useRoll = TRUE;
+    return 0;
+}
+
+//------------------------------------------
+// psdOpen()
+// fs is the rate psdPush() will be called at.
+//------------------------------------------
+int psdOpen(psdStage *ps, pList *p, double fs)
+{
+    double w2 = 0.0;
+    int i;
+
+    memset(ps, 0, sizeof(psdStage));
+    ps->nfft = p->psdLen;
+    ps->nbins = ps->nfft / 2 + 1;
+    ps->hop = ps->nfft / 2;
+    ps->avg = p->psdAvg;
+    ps->fs = fs;
+    ps->binary = p->psdBinary;
+    ps->ringLen = 2 * ps->nfft;
+    ps->gapNs = (int64_t)(1.5e9 / fs);
+    snprintf(ps->site, sizeof(ps->site), "%s", (p->sitePrefix != NULL) ? p->sitePrefix : "");
+    if(openOutput(ps, p) != 0)
+    {
+        psdClose(ps);
+        return -1;
+    }
+    ps->frameCap = ps->binary ? PSD_HDRLEN + 12 * (size_t)ps->nbins : 256 + 3 * 12 * (size_t)ps->nbins;
+    if(fftInit(&ps->plan, ps->nfft) != 0 ||
+       posix_memalign((void **)&ps->ring, 64, ps->ringLen * sizeof(v4df)) != 0 ||
+       posix_memalign((void **)&ps->re, 64, ps->nfft * sizeof(v4df)) != 0 ||
+       posix_memalign((void **)&ps->im, 64, ps->nfft * sizeof(v4df)) != 0 ||
+       posix_memalign((void **)&ps->acc, 64, ps->nbins * sizeof(v4df)) != 0 ||
+       (ps->ringNs = malloc(ps->ringLen * sizeof(int64_t))) == NULL ||
+       (ps->window = malloc(ps->nfft * sizeof(double))) == NULL ||
+       (ps->frame = malloc(ps->frameCap)) == NULL)
+    {
+        perror("PSD");
+        psdClose(ps);
+        return -1;
+    }
+    for(i = 0; i < ps->nfft; i++)
+    {
+        // Periodic Hann: half-overlapped windows sum to a constant.
+        ps->window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / ps->nfft);
+        w2 += ps->window[i] * ps->window[i];
+    }
+    ps->scale = 1.0 / (fs * w2);
+    pthread_mutex_init(&ps->lock, NULL);
+    pthread_cond_init(&ps->wake, NULL);
+    if(pthread_create(&ps->worker, NULL, psdWorker, ps) != 0)
+    {
+        perror("PSD: pthread_create()");
+        psdClose(ps);
+        return -1;
+    }
+    ps->running = TRUE;
+    return 0;
+}
+
+//------------------------------------------
+// psdPush()
+// Called from the sampling loop with one calibrated sample.
+//------------------------------------------
+void psdPush(psdStage *ps, const double xyz[3], const struct timespec *ts)
+{
+    uint64_t n = ps->written;
+    uint64_t since;
+    int64_t ns = (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+    int pos = n & (ps->ringLen - 1);
+
+    if(n > 0 && (ns - ps->lastNs > ps->gapNs || ns <= ps->lastNs))
+    {
+        __atomic_store_n(&ps->resetAt, n, __ATOMIC_RELEASE);
+    }
+    ps->lastNs = ns;
+    ps->ring[pos] = (v4df){ xyz[0], xyz[1], xyz[2], 0.0 };
+    ps->ringNs[pos] = ns;
+    __atomic_store_n(&ps->written, n + 1, __ATOMIC_RELEASE);
+    since = n + 1 - ps->resetAt;
+    if(since >= (uint64_t)ps->nfft && (since - ps->nfft) % ps->hop == 0)
+    {
+        pthread_mutex_lock(&ps->lock);
+        pthread_cond_signal(&ps->wake);
+        pthread_mutex_unlock(&ps->lock);
+    }
+}
+
+//------------------------------------------
+// psdClose()
+//------------------------------------------
+void psdClose(psdStage *ps)
+{
+    if(ps->running)
+    {
+        pthread_mutex_lock(&ps->lock);
+        ps->stop = TRUE;
+        pthread_cond_signal(&ps->wake);
+        pthread_mutex_unlock(&ps->lock);
+        pthread_join(ps->worker, NULL);
+        pthread_mutex_destroy(&ps->lock);
+        pthread_cond_destroy(&ps->wake);
+        ps->running = FALSE;
+    }
+    if(ps->useRoll)
+    {
+        logRollClose(&ps->roll);
+        ps->useRoll = FALSE;
+    }
+    else if(ps->fp != NULL)
+    {
+        fclose(ps->fp);
+    }
+    ps->fp = NULL;
+    if(ps->udpFd >= 0)
+    {
+        close(ps->udpFd);
+        ps->udpFd = -1;
+    }
+    fftFree(&ps->plan);
+    free(ps->ring);
+    free(ps->ringNs);
+    free(ps->re);
+    free(ps->im);
+    free(ps->acc);
+    free(ps->window);
+    free(ps->frame);
+    ps->ring = NULL;
+    ps->ringNs = NULL;
+    ps->re = NULL;
+    ps->im = NULL;
+    ps->acc = NULL;
+    ps->window = NULL;
+    ps->frame = NULL;
+}
@@ -0,0 +1,124 @@
+//=========================================================================
+// psd.h
+//
+// Streaming power spectral density (Welch's method) for the runMag utility.
+//
+// Calibrated samples (nT) are copied into a ring by the sampling loop;
+// a worker thread takes segments of <nfft> samples overlapping by half,
+// removes the mean, applies a periodic Hann window, transforms all three
+// axes in one pass (fft.h) and averages <avg> periodograms into a frame
+// of one-sided densities in nT^2/Hz, bins 0 to nfft/2, df = fs / nfft.
+// The sampling loop only copies a sample and, once per hop, signals the
+// worker; if the worker falls a whole ring behind, the frame in progress
+// is dropped and counted.  A gap in the sample times also restarts the
+// frame, so every frame covers contiguous data.
+//
+// JSON frames are one line each:
+//
+//      {"ts":"<UTC start>","dur":<s>,"fs":<Hz>,"nfft":<n>,"segs":<avg>,
+//       "df":<Hz>,"x":[...],"y":[...],"z":[...]}
+//
+// Binary frames are a 64 byte little-endian header
+//
+//      uint32  magic           PSD_MAGIC
+//      uint16  version         PSD_VERSION
+//      uint16  hdrLen          64
+//      uint32  nfft
+//      uint32  nbins           nfft / 2 + 1
+//      uint32  segs
+//      uint32  reserved
+//      double  fs              Hz
+//      int64   t0Ns            first sample, ns since the epoch
+//      int64   t1Ns            last sample
+//      char    site[16]
+//
+// followed by float32 X[nbins], Y[nbins], Z[nbins].  UDP datagrams carry
+// one binary frame each.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100PSD_h
+#define SWX3100PSD_h
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include "main.h"
+#include "fft.h"
+#include "logroll.h"
+
+#define PSD_MINLEN              16
+#define PSD_MAXLEN              FFT_MAXLEN
+#define PSD_DEFAVG              8
+#define PSD_MAXAVG              1000
+#define PSD_MAGIC               0x46445350  // "PSDF"
+#define PSD_VERSION             1
+#define PSD_HDRLEN              64
+#define PSD_SITELEN             16
+#define PSD_UDPMAX              65507
+#define PSD_NICE                10          // worker priority: below sampling, above compression
+#define PSD_JSONSUFFIX          "runmag-psd.json"
+#define PSD_BINSUFFIX           "runmag-psd.bin"
+
+//------------------------------------------
+// PSD stage
+//------------------------------------------
+typedef struct tag_psdStage
+{
+    int             nfft;
+    int             nbins;
+    int             hop;
+    int             avg;
+    double          fs;
+    int             binary;
+
+    // Written by the sampling loop.
+    int             ringLen;                // 2 * nfft
+    v4df           *ring;
+    int64_t        *ringNs;
+    uint64_t        written;                // samples pushed (atomic)
+    uint64_t        resetAt;                // first sample after a gap (atomic)
+    int64_t         lastNs;
+    int64_t         gapNs;
+
+    // Owned by the worker.
+    fftPlan         plan;
+    double         *window;
+    double          scale;                  // 1 / (fs * sum(w^2))
+    v4df           *re;
+    v4df           *im;
+    v4df           *acc;
+    uint64_t        segStart;
+    int             segs;
+    int64_t         t0Ns;
+    uint8_t        *frame;
+    size_t          frameCap;
+    unsigned long   frames;
+    unsigned long   overruns;
+    unsigned long   gaps;
+
+    // Output
+    char            site[PSD_SITELEN + 1];
+    FILE           *fp;
+    logRoll         roll;
+    int             useRoll;
+    int             udpFd;
+    struct sockaddr_storage dest;
+    socklen_t       destLen;
+
+    int             stop;
+    int             running;
+    pthread_t       worker;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+} psdStage;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int psdOpen(psdStage *ps, pList *p, double fs);
+void psdPush(psdStage *ps, const double xyz[3], const struct timespec *ts);
+void psdClose(psdStage *ps);
+
+#endif // SWX3100PSD_h
@@ -0,0 +1,155 @@
+//=========================================================================
+// reqserve.c
+//
+// Small local request server for the runMag utility.
+// See reqserve.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#define _GNU_SOURCE                 // accept4()
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include "reqserve.h"
+#include "netserve.h"
+
+//------------------------------------------
+// reqWorker()
+// Serves one request per connection.
+//------------------------------------------
+static void *reqWorker(void *arg)
+{
+    reqServer *rs = (reqServer *)arg;
+    struct timeval tv = { REQSERVE_IOTIMEOUT, 0 };
+    struct pollfd pfd;
+    int fd;
+
+#ifdef SYS_gettid
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), REQSERVE_NICE);
+#endif
+    pfd.fd = rs->listenFd;
+    pfd.events = POLLIN;
+    while(!rs->stop)
+    {
+        if(poll(&pfd, 1, REQSERVE_POLLMS) <= 0 || (fd = accept4(rs->listenFd, NULL, NULL, SOCK_CLOEXEC)) < 0)
+        {
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        rs->handler(rs->ctx, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+//------------------------------------------
+// reqServeOpen()
+// spec is a Unix socket path when isPath, otherwise [addr:]port.
+//------------------------------------------
+int reqServeOpen(reqServer *rs, const char *name, const char *spec, int isPath, reqHandler handler, void *ctx)
+{
+    struct sockaddr_storage ss;
+    struct sockaddr_un *sun = (struct sockaddr_un *)&ss;
+    socklen_t len;
+    int on = 1;
+
+    memset(rs, 0, sizeof(reqServer));
+    rs->name = name;
+    rs->listenFd = -1;
+    rs->handler = handler;
+    rs->ctx = ctx;
+    memset(&ss, 0, sizeof(ss));
+    if(isPath)
+    {
+        if(strlen(spec) >= sizeof(sun->sun_path))
+        {
+            fprintf(stderr, "%s socket path too long: %s\n", name, spec);
+            return -1;
+        }
+        sun->sun_family = AF_UNIX;
+        strcpy(sun->sun_path, spec);
+        len = sizeof(struct sockaddr_un);
+        rs->path = spec;
+        unlink(rs->path);
+    }
+    else if(netParseAddr(spec, 1, SOCK_STREAM, &ss, &len) != 0)
+    {
+        return -1;
+    }
+    if((rs->listenFd = socket(ss.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        fprintf(stderr, "%s socket: %s\n", name, strerror(errno));
+        return -1;
+    }
+    if(rs->path == NULL)
+    {
+        setsockopt(rs->listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if(bind(rs->listenFd, (struct sockaddr *)&ss, len) != 0 || listen(rs->listenFd, 8) != 0)
+    {
+        fprintf(stderr, "%s socket: %s\n", name, strerror(errno));
+        reqServeClose(rs);
+        return -1;
+    }
+    if(pthread_create(&rs->worker, NULL, reqWorker, rs) != 0)
+    {
+        fprintf(stderr, "%s: pthread_create() failed\n", name);
+        reqServeClose(rs);
+        return -1;
+    }
+    rs->running = TRUE;
+    return 0;
+}
+
+//------------------------------------------
+// reqServeClose()
+//------------------------------------------
+void reqServeClose(reqServer *rs)
+{
+    if(rs->running)
+    {
+        rs->stop = TRUE;
+        pthread_join(rs->worker, NULL);
+        rs->running = FALSE;
+    }
+    if(rs->listenFd >= 0)
+    {
+        close(rs->listenFd);
+        if(rs->path != NULL)
+        {
+            unlink(rs->path);
+        }
+        rs->listenFd = -1;
+    }
+}
+
+//------------------------------------------
+// reqSendAll()
+// Returns 0 once all len bytes are sent, -1 if the client went away.
+//------------------------------------------
+int reqSendAll(int fd, const char *buf, int len)
+{
+    ssize_t n;
+    int off = 0;
+
+    while(off < len)
+    {
+        if((n = send(fd, buf + off, len - off, MSG_NOSIGNAL)) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        off += n;
+    }
+    return 0;
+}
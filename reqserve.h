@@ -0,0 +1,50 @@
+//=========================================================================
+// reqserve.h
+//
+// Small local request server for the runMag utility's query sockets.
+//
+// A worker thread at low priority accepts one connection at a time on a
+// Unix stream socket or a TCP [addr:]port, sets read and write timeouts
+// so a stalled client cannot hold it, and hands the connection to the
+// owner's handler, which reads the request and sends the reply.  The
+// connection is closed when the handler returns.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100REQSERVE_h
+#define SWX3100REQSERVE_h
+
+#include <pthread.h>
+#include "main.h"
+
+#define REQSERVE_NICE           10
+#define REQSERVE_POLLMS         250         // how often the worker looks at stop
+#define REQSERVE_IOTIMEOUT      2           // s a client may stall a read or write
+
+typedef void (*reqHandler)(void *ctx, int fd);
+
+//------------------------------------------
+// Server state
+//------------------------------------------
+typedef struct tag_reqServer
+{
+    const char     *name;                   // for messages
+    const char     *path;                   // Unix socket, else NULL
+    int             listenFd;
+    reqHandler      handler;
+    void           *ctx;
+    pthread_t       worker;
+    int             running;
+    volatile int    stop;
+} reqServer;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int reqServeOpen(reqServer *rs, const char *name, const char *spec, int isPath, reqHandler handler, void *ctx);
+void reqServeClose(reqServer *rs);
+int reqSendAll(int fd, const char *buf, int len);
+
+#endif // SWX3100REQSERVE_h
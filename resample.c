@@ -0,0 +1,332 @@
+//=========================================================================
+// resample.c
+//
+// Resampling onto an exact UTC grid for the runMag utility.
+// See resample.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <string.h>
+#include "resample.h"
+
+#define P(r, i)     (&(r)->hist[(i) & (RESAMPLE_HISTORY - 1)])
+
+//------------------------------------------
+// parseResampleMode()
+//------------------------------------------
+int parseResampleMode(const char *spec)
+{
+    if(!strcmp(spec, "linear"))
+    {
+        return eRESAMPLE_LINEAR;
+    }
+    if(!strcmp(spec, "cubic"))
+    {
+        return eRESAMPLE_CUBIC;
+    }
+    if(!strcmp(spec, "sinc"))
+    {
+        return eRESAMPLE_SINC;
+    }
+    return -1;
+}
+
+//------------------------------------------
+// resampleModeName()
+//------------------------------------------
+const char *resampleModeName(int mode)
+{
+    switch(mode)
+    {
+        case eRESAMPLE_CUBIC:
+            return "cubic";
+        case eRESAMPLE_SINC:
+            return "sinc";
+        default:
+            return "linear";
+    }
+}
+
+//------------------------------------------
+// gridCeil()
+// First grid time at or after ns.
+//------------------------------------------
+static int64_t gridCeil(const resampler *r, int64_t ns)
+{
+    int64_t k = ns / r->periodNs;
+
+    if(k * r->periodNs < ns)
+    {
+        k++;
+    }
+    return k * r->periodNs;
+}
+
+//------------------------------------------
+// resamplerInit()
+//------------------------------------------
+void resamplerInit(resampler *r, double period, int mode)
+{
+    memset(r, 0, sizeof(resampler));
+    r->mode = mode;
+    r->periodNs = (int64_t)llround(period * 1e9);
+}
+
+//------------------------------------------
+// resamplerPush()
+// Samples must arrive in time order; a repeated or earlier time stamp
+// (clock step) is dropped.
+//------------------------------------------
+void resamplerPush(resampler *r, int64_t ns, const double v[RESAMPLE_CHANNELS])
+{
+    resamplePoint *pt;
+    double dt;
+
+    if(r->count > 0)
+    {
+        dt = (double)(ns - P(r, r->count - 1)->ns);
+        if(dt <= 0.0)
+        {
+            r->skipped++;
+            return;
+        }
+        if(r->count == 1)
+        {
+            r->spacingNs = dt;
+        }
+        else if(dt > 0.5 * r->spacingNs && dt < 2.0 * r->spacingNs)
+        {
+            r->spacingNs += (dt - r->spacingNs) / 16.0;
+        }
+    }
+    else
+    {
+        r->nextNs = gridCeil(r, ns);
+    }
+    pt = P(r, r->count);
+    pt->ns = ns;
+    memcpy(pt->v, v, sizeof(pt->v));
+    r->count++;
+}
+
+//------------------------------------------
+// lanczos()
+//------------------------------------------
+static double lanczos(double x)
+{
+    double px;
+
+    if(x == 0.0)
+    {
+        return 1.0;
+    }
+    if(fabs(x) >= RESAMPLE_LANCZOS)
+    {
+        return 0.0;
+    }
+    px = M_PI * x;
+    return RESAMPLE_LANCZOS * sin(px) * sin(px / RESAMPLE_LANCZOS) / (px * px);
+}
+
+//------------------------------------------
+// interpLinear()
+//------------------------------------------
+static void interpLinear(const resampler *r, uint64_t i, int64_t t, double *v)
+{
+    const resamplePoint *a = P(r, i);
+    const resamplePoint *b = P(r, i + 1);
+    double f = (double)(t - a->ns) / (double)(b->ns - a->ns);
+    int c;
+
+    for(c = 0; c < RESAMPLE_CHANNELS; c++)
+    {
+        v[c] = a->v[c] + (b->v[c] - a->v[c]) * f;
+    }
+}
+
+//------------------------------------------
+// interpCubic()
+// Lagrange through samples i - 1 .. i + 2.
+//------------------------------------------
+static void interpCubic(const resampler *r, uint64_t i, int64_t t, double *v)
+{
+    double x[4];
+    double w[4];
+    int j;
+    int k;
+    int c;
+
+    for(j = 0; j < 4; j++)
+    {
+        x[j] = (P(r, i - 1 + j)->ns - t) / 1e9;
+    }
+    for(j = 0; j < 4; j++)
+    {
+        w[j] = 1.0;
+        for(k = 0; k < 4; k++)
+        {
+            if(k != j)
+            {
+                w[j] *= -x[k] / (x[j] - x[k]);
+            }
+        }
+    }
+    for(c = 0; c < RESAMPLE_CHANNELS; c++)
+    {
+        v[c] = 0.0;
+        for(j = 0; j < 4; j++)
+        {
+            v[c] += w[j] * P(r, i - 1 + j)->v[c];
+        }
+    }
+}
+
+//------------------------------------------
+// interpSinc()
+// Over samples i - half + 1 .. i + half, by index.
+//------------------------------------------
+static void interpSinc(const resampler *r, uint64_t i, int64_t t, int half, double stretch, double *v)
+{
+    const resamplePoint *a = P(r, i);
+    double u = (double)(t - a->ns) / (double)(P(r, i + 1)->ns - a->ns);
+    double sum = 0.0;
+    double w;
+    int j;
+    int c;
+
+    for(c = 0; c < RESAMPLE_CHANNELS; c++)
+    {
+        v[c] = 0.0;
+    }
+    for(j = -half + 1; j <= half; j++)
+    {
+        w = lanczos((j - u) / stretch);
+        sum += w;
+        for(c = 0; c < RESAMPLE_CHANNELS; c++)
+        {
+            v[c] += w * P(r, i + j)->v[c];
+        }
+    }
+    for(c = 0; c < RESAMPLE_CHANNELS; c++)
+    {
+        v[c] /= sum;
+    }
+}
+
+//------------------------------------------
+// hasGap()
+// Any step over the gap limit between samples lo .. hi.
+//------------------------------------------
+static int hasGap(const resampler *r, uint64_t lo, uint64_t hi, double limit)
+{
+    uint64_t j;
+
+    for(j = lo; j < hi; j++)
+    {
+        if(P(r, j + 1)->ns - P(r, j)->ns > limit)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// resamplerNext()
+// Produces the next grid point if its samples are in; call until it
+// returns 0 after each push.
+//------------------------------------------
+int resamplerNext(resampler *r, resamplePoint *out, int *flags)
+{
+    uint64_t newest;
+    uint64_t oldest;
+    uint64_t i;
+    double limit = RESAMPLE_GAPFACTOR * r->spacingNs;
+    double stretch = 1.0;
+    int64_t t;
+    int half = 1;
+
+    if(r->count < 2)
+    {
+        return 0;
+    }
+    newest = r->count - 1;
+    oldest = (r->count > RESAMPLE_HISTORY) ? r->count - RESAMPLE_HISTORY : 0;
+    while(1)
+    {
+        t = r->nextNs;
+        if(t >= P(r, newest)->ns)
+        {
+            return 0;
+        }
+        if(t < P(r, oldest)->ns)
+        {
+            r->nextNs = gridCeil(r, P(r, oldest)->ns);
+            continue;
+        }
+        for(i = newest - 1; P(r, i)->ns > t; i--)
+        {
+        }
+        if(P(r, i + 1)->ns - P(r, i)->ns > limit &&
+           (P(r, i + 1)->ns - t) / r->periodNs > RESAMPLE_MAXFILL)
+        {
+            r->skipped += (P(r, i + 1)->ns - t) / r->periodNs;
+            r->nextNs = gridCeil(r, P(r, i + 1)->ns);
+            continue;
+        }
+        break;
+    }
+    if(r->mode == eRESAMPLE_CUBIC)
+    {
+        half = 2;
+    }
+    else if(r->mode == eRESAMPLE_SINC)
+    {
+        stretch = (r->periodNs > r->spacingNs) ? r->periodNs / r->spacingNs : 1.0;
+        half = (int)ceil(RESAMPLE_LANCZOS * stretch);
+        if(half > RESAMPLE_MAXHALF)
+        {
+            half = RESAMPLE_MAXHALF;
+            stretch = (double)half / RESAMPLE_LANCZOS;
+        }
+    }
+    *flags = 0;
+    if(P(r, i + 1)->ns - P(r, i)->ns > limit)
+    {
+        *flags = RESAMPLE_F_GAP;
+        interpLinear(r, i, t, out->v);
+    }
+    else if(i + half > newest)
+    {
+        // Wait for the rest of the kernel.
+        return 0;
+    }
+    else if(r->mode == eRESAMPLE_LINEAR)
+    {
+        interpLinear(r, i, t, out->v);
+    }
+    else if(i < oldest + half - 1 || hasGap(r, i - half + 1, i + half, limit))
+    {
+        *flags = RESAMPLE_F_REDUCED;
+        interpLinear(r, i, t, out->v);
+    }
+    else if(r->mode == eRESAMPLE_CUBIC)
+    {
+        interpCubic(r, i, t, out->v);
+    }
+    else
+    {
+        interpSinc(r, i, t, half, stretch, out->v);
+    }
+    out->ns = t;
+    r->nextNs += r->periodNs;
+    r->points++;
+    if(*flags)
+    {
+        r->flagged++;
+    }
+    return 1;
+}
@@ -0,0 +1,93 @@
+//=========================================================================
+// resample.h
+//
+// Resampling onto an exact UTC grid for the runMag utility.
+//
+// Samples arrive with their acquisition time stamps, at any rate and
+// with jitter; values are produced at t = k * period since the epoch.
+// Methods:
+//
+//      linear  between the two samples around t.
+//      cubic   Lagrange through the four samples around t, at their
+//              actual times.
+//      sinc    Lanczos windowed sinc (a = 4) over the sample index; when
+//              the grid is coarser than the input the kernel is widened
+//              so it also low-pass filters to the grid Nyquist frequency.
+//
+// The input spacing is tracked as a running average; a step more than
+// 1.5 times that is a gap.  A grid point whose kernel would reach across
+// a gap falls back to linear (RESAMPLE_F_REDUCED), and a point inside a
+// gap is linear across it and flagged RESAMPLE_F_GAP.  Gaps longer than
+// RESAMPLE_MAXFILL grid points are skipped rather than filled.
+//
+// A point is produced once the samples its kernel needs have arrived, so
+// latency is one sample for linear, two for cubic and up to
+// RESAMPLE_MAXHALF for sinc.  Memory is the fixed history below.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100RESAMPLE_h
+#define SWX3100RESAMPLE_h
+
+#include <stdint.h>
+
+#define RESAMPLE_CHANNELS       6           // X, Y, Z (nT) and raw X, Y, Z counts
+#define RESAMPLE_HISTORY        512         // power of 2
+#define RESAMPLE_LANCZOS        4
+#define RESAMPLE_MAXHALF        (RESAMPLE_HISTORY / 2 - 4)
+#define RESAMPLE_GAPFACTOR      1.5
+#define RESAMPLE_MAXFILL        3600
+#define RESAMPLE_MINPERIOD      0.01        // seconds
+#define RESAMPLE_MAXPERIOD      3600.0
+#define RESAMPLE_SUFFIX         "runmag-grid.log"
+
+#define RESAMPLE_F_GAP          0x1
+#define RESAMPLE_F_REDUCED      0x2
+
+//-------------------------------------------
+// Interpolation methods
+//-------------------------------------------
+typedef enum
+{
+    eRESAMPLE_LINEAR = 0,
+    eRESAMPLE_CUBIC,
+    eRESAMPLE_SINC,
+} resampleMode;
+
+//------------------------------------------
+// One input sample
+//------------------------------------------
+typedef struct tag_resamplePoint
+{
+    int64_t     ns;
+    double      v[RESAMPLE_CHANNELS];
+} resamplePoint;
+
+//------------------------------------------
+// Resampler state
+//------------------------------------------
+typedef struct tag_resampler
+{
+    int             mode;
+    int64_t         periodNs;
+    int64_t         nextNs;                 // next grid point to produce
+    double          spacingNs;              // running input spacing
+    resamplePoint   hist[RESAMPLE_HISTORY];
+    uint64_t        count;
+    unsigned long   points;
+    unsigned long   flagged;
+    unsigned long   skipped;
+} resampler;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int parseResampleMode(const char *spec);
+const char *resampleModeName(int mode);
+void resamplerInit(resampler *r, double period, int mode);
+void resamplerPush(resampler *r, int64_t ns, const double v[RESAMPLE_CHANNELS]);
+int resamplerNext(resampler *r, resamplePoint *out, int *flags);
+
+#endif // SWX3100RESAMPLE_h
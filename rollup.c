@@ -0,0 +1,158 @@
+//=========================================================================
+// rollup.c
+//
+// Minute, hour and day rollups for the runMag utility.
+// See rollup.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <string.h>
+#include "cmdmgr.h"
+#include "rollup.h"
+
+//------------------------------------------
+// rollupOpen()
+//------------------------------------------
+int rollupOpen(rollup *ru, pList *p)
+{
+    static const char *suffix[ROLLUP_LEVELS - 1] = { ROLLUP_HOURSUFFIX, ROLLUP_DAYSUFFIX };
+    static const int seconds[ROLLUP_LEVELS] = { 60, 3600, 86400 };
+    char path[MAXPATHBUFLEN];
+    int i;
+
+    memset(ru, 0, sizeof(rollup));
+    for(i = 0; i < ROLLUP_LEVELS; i++)
+    {
+        ru->lv[i].seconds = seconds[i];
+        ru->lv[i].key = -1;
+    }
+    if((ru->lv[0].fp = logRollOpenFile(&ru->minRoll, p, ROLLUP_MINSUFFIX)) == NULL)
+    {
+        perror("Rollup file");
+        return -1;
+    }
+    for(i = 1; i < ROLLUP_LEVELS; i++)
+    {
+        buildSiteFilePath(p, suffix[i - 1], path);
+        if((ru->lv[i].fp = fopen(path, "ab")) == NULL)
+        {
+            perror("Rollup file");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------
+// closeInterval()
+//------------------------------------------
+static void closeInterval(rollup *ru, rollLevel *lv)
+{
+    rollRecord rec;
+    rollStat *st;
+    int c;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.start = lv->key * lv->seconds;
+    rec.seconds = lv->seconds;
+    rec.count = lv->count;
+    for(c = 0; c < ROLLUP_CHANNELS; c++)
+    {
+        st = &lv->ch[c];
+        rec.min[c] = (float)st->min;
+        rec.max[c] = (float)st->max;
+        rec.mean[c] = (float)st->mean;
+        rec.sd[c] = (lv->count > 1) ? (float)sqrt(st->m2 / (lv->count - 1)) : 0.0f;
+    }
+    if(lv == &ru->lv[0])
+    {
+        // Into the minute file of the period the interval started in.
+        lv->fp = logRollCheck(&ru->minRoll, (time_t)rec.start);
+    }
+    if(fwrite(&rec, sizeof(rec), 1, lv->fp) != 1 || fflush(lv->fp) != 0)
+    {
+        ru->errors++;
+    }
+    else
+    {
+        ru->records++;
+    }
+    lv->count = 0;
+}
+
+//------------------------------------------
+// rollupPush()
+// Constant work per sample: one Welford step per channel and resolution.
+//------------------------------------------
+void rollupPush(rollup *ru, const magSample *smp)
+{
+    rollLevel *lv;
+    rollStat *st;
+    double v[ROLLUP_CHANNELS];
+    double d;
+    int64_t key;
+    int i;
+    int c;
+
+    v[0] = smp->xyz[0];
+    v[1] = smp->xyz[1];
+    v[2] = smp->xyz[2];
+    v[3] = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for(i = 0; i < ROLLUP_LEVELS; i++)
+    {
+        lv = &ru->lv[i];
+        key = smp->ts.tv_sec / lv->seconds;
+        if(key != lv->key)
+        {
+            if(lv->count > 0)
+            {
+                closeInterval(ru, lv);
+            }
+            lv->key = key;
+        }
+        lv->count++;
+        for(c = 0; c < ROLLUP_CHANNELS; c++)
+        {
+            st = &lv->ch[c];
+            if(lv->count == 1)
+            {
+                st->mean = st->min = st->max = v[c];
+                st->m2 = 0.0;
+                continue;
+            }
+            d = v[c] - st->mean;
+            st->mean += d / lv->count;
+            st->m2 += d * (v[c] - st->mean);
+            st->min = (v[c] < st->min) ? v[c] : st->min;
+            st->max = (v[c] > st->max) ? v[c] : st->max;
+        }
+    }
+}
+
+//------------------------------------------
+// rollupClose()
+// Writes the open intervals too.
+//------------------------------------------
+void rollupClose(rollup *ru)
+{
+    int i;
+
+    for(i = 0; i < ROLLUP_LEVELS; i++)
+    {
+        if(ru->lv[i].count > 0)
+        {
+            closeInterval(ru, &ru->lv[i]);
+        }
+    }
+    logRollClose(&ru->minRoll);
+    for(i = 1; i < ROLLUP_LEVELS; i++)
+    {
+        if(ru->lv[i].fp != NULL)
+        {
+            fclose(ru->lv[i].fp);
+        }
+    }
+}
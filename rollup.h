@@ -0,0 +1,75 @@
+//=========================================================================
+// rollup.h
+//
+// Minute, hour and day rollups for the runMag utility.
+//
+// Each output sample updates, per resolution, a running count, min, max,
+// mean and variance (Welford) of X, Y, Z and the total field.  When the
+// sample time leaves a UTC interval its rollRecord (magrec.h) is appended
+// to the file for that resolution:
+//
+//      <site>-<date>-runmag-1m.roll        rolled with the log
+//      <site>-runmag-1h.roll               one file for the station
+//      <site>-runmag-1d.roll
+//
+// Open intervals are written at exit as well, so a restart may leave two
+// rows for an interval; readers combine them by count.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100ROLLUP_h
+#define SWX3100ROLLUP_h
+
+#include "main.h"
+#include "logroll.h"
+
+#define ROLLUP_LEVELS           3
+#define ROLLUP_CHANNELS         4           // X, Y, Z, F
+#define ROLLUP_MINSUFFIX        "runmag-1m.roll"
+#define ROLLUP_HOURSUFFIX       "runmag-1h.roll"
+#define ROLLUP_DAYSUFFIX        "runmag-1d.roll"
+
+//------------------------------------------
+// Running statistics for one channel
+//------------------------------------------
+typedef struct tag_rollStat
+{
+    double      mean;
+    double      m2;
+    double      min;
+    double      max;
+} rollStat;
+
+//------------------------------------------
+// One resolution
+//------------------------------------------
+typedef struct tag_rollLevel
+{
+    int         seconds;
+    int64_t     key;                        // interval number, start / seconds
+    uint32_t    count;
+    rollStat    ch[ROLLUP_CHANNELS];
+    FILE       *fp;
+} rollLevel;
+
+//------------------------------------------
+// Rollup state
+//------------------------------------------
+typedef struct tag_rollup
+{
+    rollLevel       lv[ROLLUP_LEVELS];
+    logRoll         minRoll;
+    unsigned long   records;
+    unsigned long   errors;
+} rollup;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int rollupOpen(rollup *ru, pList *p);
+void rollupPush(rollup *ru, const magSample *smp);
+void rollupClose(rollup *ru);
+
+#endif // SWX3100ROLLUP_h
@@ -248,15 +248,15 @@ void setCycleCountRegs(pList *p)
     i2c_write(p->i2c_fd, RM3100I2C_CCY_1, (p->cc_y >> 8));
     i2c_write(p->i2c_fd, RM3100I2C_CCY_0, (p->cc_y & 0xff));
     p->y_gain = getCCGainEquiv(p->cc_y);
-    i2c_write(p->i2c_fd, RM3100I2C_CCZ_1, (p->cc_y >> 8));
-    i2c_write(p->i2c_fd, RM3100I2C_CCZ_0, (p->cc_y & 0xff));
+    i2c_write(p->i2c_fd, RM3100I2C_CCZ_1, (p->cc_z >> 8));
+    i2c_write(p->i2c_fd, RM3100I2C_CCZ_0, (p->cc_z & 0xff));
     p->z_gain = getCCGainEquiv(p->cc_z);
     // Write NOSRegValue to  register 0A
     i2c_write(p->i2c_fd, RM3100I2C_NOS,   (uint8_t)(p->NOSRegValue));
     if(p->verboseFlag)
     {
         fprintf(stderr, "\nIn setCycleCountRegs():: Setting NOS register to value: %2X\n", p->NOSRegValue);
-        fprintf(stderr, "CycleCounts  - X: %u, Y: %u, Z: %u.\n", p->cc_x, p->cc_y, p->cc_x);
+        fprintf(stderr, "CycleCounts  - X: %u, Y: %u, Z: %u.\n", p->cc_x, p->cc_y, p->cc_z);
         fprintf(stderr, "Gains        - X: %u, Y: %u, Z: %u.\n", p->x_gain, p->y_gain, p->z_gain);
         fprintf(stderr, "NOS Register - %2X.\n", p->NOSRegValue);
     }
@@ -32,4 +32,14 @@ void setTMRCReg(pList *p);
 void setCycleCountRegs(pList *p);
 void readCycleCountRegs(pList *p);
 
+//------------------------------------------
+// getCCGainExact()
+//   getCCGainEquiv() without the truncation; used for scaling samples.
+//   Inline so magcal.o links without the I2C code (magproc).
+//------------------------------------------
+static inline double getCCGainExact(unsigned short CCVal)
+{
+    return 0.3671 * CCVal + 1.5;
+}
+
 #endif // SWX3100RUNMag_h
\ No newline at end of file
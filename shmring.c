@@ -0,0 +1,283 @@
+//=========================================================================
+// shmring.c
+//
+// POSIX shared memory sample ring for local subscribers of runMag.
+// See shmring.h for the locking protocol.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmring.h"
+
+//------------------------------------------
+// shmRingCreate()
+// Creates (or takes over) the segment and starts a new generation.
+//------------------------------------------
+int shmRingCreate(shmRingWriter *w, const char *name, uint32_t slots, double sampleRate)
+{
+    struct timespec now;
+    struct stat st;
+    int fd;
+
+    memset(w, 0, sizeof(shmRingWriter));
+    if(slots == 0 || (slots & (slots - 1)) != 0 || slots > SHMRING_MAXSLOTS)
+    {
+        fprintf(stderr, "shmring: slot count must be a power of two <= %i.\n", SHMRING_MAXSLOTS);
+        return -1;
+    }
+    snprintf(w->name, sizeof(w->name), "%s%s", (name[0] == '/') ? "" : "/", name);
+    w->mapLen = sizeof(shmRingHdr) + (size_t)slots * sizeof(shmSlot);
+    if((fd = shm_open(w->name, O_CREAT | O_RDWR, 0644)) < 0)
+    {
+        perror("shmring: shm_open()");
+        return -1;
+    }
+    // Never shrink: a reader still mapping the old size would fault.
+    if(fstat(fd, &st) == 0 && (size_t)st.st_size > w->mapLen)
+    {
+        w->mapLen = st.st_size;
+    }
+    if(ftruncate(fd, w->mapLen) != 0)
+    {
+        perror("shmring: ftruncate()");
+        close(fd);
+        return -1;
+    }
+    w->hdr = mmap(NULL, w->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(w->hdr == MAP_FAILED)
+    {
+        perror("shmring: mmap()");
+        w->hdr = NULL;
+        return -1;
+    }
+    w->slot = (shmSlot *)(w->hdr + 1);
+
+    // Invalidate the header while the slots are reset so readers resync.
+    __atomic_store_n(&w->hdr->magic, 0, __ATOMIC_RELEASE);
+    memset(w->slot, 0, (size_t)slots * sizeof(shmSlot));
+    clock_gettime(CLOCK_REALTIME, &now);
+    w->hdr->version = SHMRING_VERSION;
+    w->hdr->slots = slots;
+    w->hdr->recSize = sizeof(magRecord);
+    w->hdr->sampleRate = sampleRate;
+    w->hdr->head = 0;
+    __atomic_store_n(&w->hdr->generation, (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec, __ATOMIC_RELEASE);
+    __atomic_store_n(&w->hdr->magic, SHMRING_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+//------------------------------------------
+// shmRingPublish()
+//------------------------------------------
+void shmRingPublish(shmRingWriter *w, const magRecord *rec)
+{
+    uint64_t n = w->next++;
+    shmSlot *s = &w->slot[n & (w->hdr->slots - 1)];
+
+    __atomic_store_n(&s->lock, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&s->rec, rec, sizeof(magRecord));
+    __atomic_store_n(&s->lock, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&w->hdr->head, n + 1, __ATOMIC_RELEASE);
+}
+
+//------------------------------------------
+// shmRingDestroy()
+//------------------------------------------
+void shmRingDestroy(shmRingWriter *w, int unlinkSeg)
+{
+    if(w->hdr != NULL)
+    {
+        munmap(w->hdr, w->mapLen);
+        w->hdr = NULL;
+    }
+    if(unlinkSeg)
+    {
+        shm_unlink(w->name);
+    }
+}
+
+//------------------------------------------
+// shmRingAttach()
+// Maps the segment read-only.  The reader starts at the newest record.
+//------------------------------------------
+int shmRingAttach(shmRingReader *r, const char *name)
+{
+    char shmName[64];
+    struct stat st;
+    void *map;
+    int fd;
+
+    memset(r, 0, sizeof(shmRingReader));
+    snprintf(shmName, sizeof(shmName), "%s%s", (name[0] == '/') ? "" : "/", name);
+    if((fd = shm_open(shmName, O_RDONLY, 0)) < 0)
+    {
+        return -1;
+    }
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shmRingHdr))
+    {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        return -1;
+    }
+    r->hdr = map;
+    r->mapLen = st.st_size;
+    if(__atomic_load_n(&r->hdr->magic, __ATOMIC_ACQUIRE) != SHMRING_MAGIC ||
+       r->hdr->recSize != sizeof(magRecord) ||
+       sizeof(shmRingHdr) + (size_t)r->hdr->slots * sizeof(shmSlot) > r->mapLen)
+    {
+        shmRingDetach(r);
+        errno = EPROTO;
+        return -1;
+    }
+    r->slot = (const shmSlot *)(r->hdr + 1);
+    r->generation = __atomic_load_n(&r->hdr->generation, __ATOMIC_ACQUIRE);
+    r->pos = __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+//------------------------------------------
+// checkGeneration()
+// A restarted writer resets head; read the new generation from its start.
+//------------------------------------------
+static int checkGeneration(shmRingReader *r)
+{
+    uint64_t gen = __atomic_load_n(&r->hdr->generation, __ATOMIC_ACQUIRE);
+
+    if(__atomic_load_n(&r->hdr->magic, __ATOMIC_ACQUIRE) != SHMRING_MAGIC)
+    {
+        return 0;
+    }
+    if(sizeof(shmRingHdr) + (size_t)r->hdr->slots * sizeof(shmSlot) > r->mapLen)
+    {
+        // Writer came back with a bigger ring; caller must re-attach.
+        return 0;
+    }
+    if(gen != r->generation)
+    {
+        r->generation = gen;
+        r->pos = 0;
+        r->restarts++;
+    }
+    return 1;
+}
+
+//------------------------------------------
+// shmRingSeekTail()
+// Positions the reader 'back' records before the newest one.
+//------------------------------------------
+void shmRingSeekTail(shmRingReader *r, uint64_t back)
+{
+    uint64_t head;
+
+    checkGeneration(r);
+    head = __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+    if(back > r->hdr->slots)
+    {
+        back = r->hdr->slots;
+    }
+    r->pos = (head > back) ? head - back : 0;
+}
+
+//------------------------------------------
+// shmRingAvailable()
+//------------------------------------------
+uint64_t shmRingAvailable(shmRingReader *r)
+{
+    uint64_t head = __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+
+    return (head > r->pos) ? head - r->pos : 0;
+}
+
+//------------------------------------------
+// shmRingRead()
+// Copies the next record.  Returns 1 if one was read, 0 if the reader
+// is caught up.  Records the writer lapped us on are counted in 'lost'.
+//------------------------------------------
+int shmRingRead(shmRingReader *r, magRecord *rec)
+{
+    const shmSlot *s;
+    uint64_t head;
+    uint64_t want;
+    uint64_t lock1;
+    uint64_t lock2;
+    uint32_t slots;
+
+    if(!checkGeneration(r))
+    {
+        return 0;
+    }
+    slots = r->hdr->slots;
+    while(1)
+    {
+        head = __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+        if(r->pos >= head)
+        {
+            if(r->pos > head)
+            {
+                // Only possible mid-restart, before the new generation is posted.
+                r->pos = head;
+            }
+            return 0;
+        }
+        if(head - r->pos > slots)
+        {
+            r->lost += head - slots - r->pos;
+            r->pos = head - slots;
+        }
+        s = &r->slot[r->pos & (slots - 1)];
+        want = 2 * r->pos + 2;
+        lock1 = __atomic_load_n(&s->lock, __ATOMIC_ACQUIRE);
+        if(lock1 != want)
+        {
+            if(lock1 > want)
+            {
+                // Overwritten by a newer lap; skip ahead.
+                r->lost++;
+                r->pos++;
+                continue;
+            }
+            return 0;
+        }
+        memcpy(rec, &s->rec, sizeof(magRecord));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        lock2 = __atomic_load_n(&s->lock, __ATOMIC_RELAXED);
+        if(lock2 != lock1)
+        {
+            r->lost++;
+            r->pos++;
+            continue;
+        }
+        r->pos++;
+        return 1;
+    }
+}
+
+//------------------------------------------
+// shmRingDetach()
+//------------------------------------------
+void shmRingDetach(shmRingReader *r)
+{
+    if(r->hdr != NULL)
+    {
+        munmap((void *)r->hdr, r->mapLen);
+        r->hdr = NULL;
+        r->slot = NULL;
+    }
+}
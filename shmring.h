@@ -0,0 +1,92 @@
+//=========================================================================
+// shmring.h
+//
+// POSIX shared memory sample ring for local subscribers of runMag.
+//
+// One writer (runMag) publishes magRecords into a power-of-two ring of
+// slots.  Each slot carries a sequence lock: the writer sets it to
+// 2n+1 while record n is being stored and to 2n+2 when it is complete.
+// Readers map the segment read-only, keep their own position and copy
+// a record out only if the slot's lock is the same before and after the
+// copy.  Nothing is shared between readers and no system calls are made
+// after the segment is mapped.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100SHMRING_h
+#define SWX3100SHMRING_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "magrec.h"
+
+#define SHMRING_DEFNAME         "/runmag"
+#define SHMRING_DEFSLOTS        4096
+#define SHMRING_MAXSLOTS        (1 << 20)
+#define SHMRING_MAGIC           0x524D5348  // "RMSH"
+#define SHMRING_VERSION         1
+
+//------------------------------------------
+// Shared layout
+//------------------------------------------
+typedef struct tag_shmSlot
+{
+    uint64_t    lock;                       // 2n+1 writing record n, 2n+2 record n complete
+    uint64_t    pad[7];                     // keep records on their own cache lines
+    magRecord   rec;
+} shmSlot;
+
+typedef struct tag_shmRingHdr
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    slots;                      // power of two
+    uint32_t    recSize;
+    uint64_t    generation;                 // changes every time a writer (re)creates the ring
+    uint64_t    head;                       // records published so far
+    double      sampleRate;                 // nominal samples per second
+    uint64_t    pad[3];
+} shmRingHdr;
+
+//------------------------------------------
+// Writer
+//------------------------------------------
+typedef struct tag_shmRingWriter
+{
+    char        name[64];
+    shmRingHdr *hdr;
+    shmSlot    *slot;
+    size_t      mapLen;
+    uint64_t    next;
+} shmRingWriter;
+
+//------------------------------------------
+// Reader
+//------------------------------------------
+typedef struct tag_shmRingReader
+{
+    const shmRingHdr *hdr;
+    const shmSlot    *slot;
+    size_t            mapLen;
+    uint64_t          generation;
+    uint64_t          pos;                  // next record wanted
+    uint64_t          lost;                 // records overwritten before we got them
+    uint64_t          restarts;             // writer restarts seen
+} shmRingReader;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int shmRingCreate(shmRingWriter *w, const char *name, uint32_t slots, double sampleRate);
+void shmRingPublish(shmRingWriter *w, const magRecord *rec);
+void shmRingDestroy(shmRingWriter *w, int unlinkSeg);
+
+int shmRingAttach(shmRingReader *r, const char *name);
+void shmRingSeekTail(shmRingReader *r, uint64_t back);
+uint64_t shmRingAvailable(shmRingReader *r);
+int shmRingRead(shmRingReader *r, magRecord *rec);
+void shmRingDetach(shmRingReader *r);
+
+#endif // SWX3100SHMRING_h
@@ -0,0 +1,324 @@
+//=========================================================================
+// sweep.c
+//
+// Cycle count / NOS sweep for the runMag utility.
+// See sweep.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <string.h>
+#include "runMag.h"
+#include "magcal.h"
+#include "sweep.h"
+
+//------------------------------------------
+// Per axis accumulators for one setting
+//------------------------------------------
+typedef struct tag_sweepAxis
+{
+    double      y0;
+    double      sy;
+    double      syy;
+    double      sty;
+    double      binSum;
+    double      lastMean;
+    double      d2;
+    long        adevTerms;
+} sweepAxis;
+
+//------------------------------------------
+// parseSweepList()
+// Comma separated integers in lo .. hi; returns the count or -1.
+//------------------------------------------
+int parseSweepList(const char *spec, int *vals, int lo, int hi)
+{
+    const char *s = spec;
+    char *end;
+    long v;
+    int n = 0;
+
+    while(*s != '\0')
+    {
+        v = strtol(s, &end, 10);
+        if(end == s || v < lo || v > hi || n == SWEEP_MAXVALUES || (*end != ',' && *end != '\0'))
+        {
+            return -1;
+        }
+        vals[n++] = (int)v;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return (n > 0) ? n : -1;
+}
+
+//------------------------------------------
+// nsSince()
+//------------------------------------------
+static int64_t nsSince(const struct timespec *a, const struct timespec *b)
+{
+    return (int64_t)(b->tv_sec - a->tv_sec) * 1000000000LL + (b->tv_nsec - a->tv_nsec);
+}
+
+//------------------------------------------
+// sweepRead()
+// One polled reading, like readMagPOLL() but timed.  Returns -1 if DRDY
+// never comes.
+//------------------------------------------
+static int sweepRead(pList *p, int32_t *XYZ, int64_t *convNs, int64_t *busNs)
+{
+    uint8_t bytes[MAGCAL_RAWLEN];
+    struct timespec t0;
+    struct timespec t1;
+    struct timespec t2;
+    struct timespec t3;
+    struct timespec s0;
+    int64_t statusNs = 0;
+    int ready;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    i2c_write(p->i2c_fd, RM3100_MAG_POLL, PMMODE_ALL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if(p->DRDYdelay)
+    {
+        usleep(p->DRDYdelay);
+    }
+    // Each status read is bus time; the waits between them are not.
+    do
+    {
+        clock_gettime(CLOCK_MONOTONIC, &s0);
+        ready = (i2c_read(p->i2c_fd, RM3100I2C_STATUS) & RM3100I2C_READMASK) == RM3100I2C_READMASK;
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        statusNs += nsSince(&s0, &t2);
+        if(!ready && nsSince(&t1, &t2) > 1000000000LL)
+        {
+            return -1;
+        }
+    } while(!ready);
+    i2c_readbuf(p->i2c_fd, RM3100I2C_XYZ, bytes, MAGCAL_RAWLEN);
+    clock_gettime(CLOCK_MONOTONIC, &t3);
+    magDecode(bytes, XYZ, 1);
+    *convNs += nsSince(&t1, &t2);
+    *busNs += nsSince(&t0, &t1) + statusNs + nsSince(&t2, &t3);
+    return 0;
+}
+
+//------------------------------------------
+// measure()
+// Samples one setting for secs seconds.
+//------------------------------------------
+static int measure(pList *p, int secs, sweepResult *r)
+{
+    sweepAxis ax[3];
+    magCal cal;
+    struct timespec start;
+    struct timespec now;
+    struct timespec cpu0;
+    struct timespec cpu1;
+    int64_t convNs = 0;
+    int64_t busNs = 0;
+    int64_t elapsed = 0;
+    int32_t raw[3];
+    double xyz[3];
+    double st = 0.0;
+    double stt = 0.0;
+    double t;
+    double y;
+    double stY;
+    double ss;
+    long bin = 0;
+    long binN = 0;
+    long n = 0;
+    long lastBin = -2;
+    int c;
+
+    p->cc_x = p->cc_y = p->cc_z = r->cc;
+    p->NOSRegValue = r->nos;
+    setCycleCountRegs(p);
+    magCalInit(&cal, p);
+    usleep(SWEEP_SETTLEMS * 1000);
+    // The first readings after a change are discarded.
+    for(c = 0; c < 2; c++)
+    {
+        if(sweepRead(p, raw, &convNs, &busNs) != 0)
+        {
+            return -1;
+        }
+    }
+    convNs = busNs = 0;
+    memset(ax, 0, sizeof(ax));
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(elapsed < (int64_t)secs * 1000000000LL)
+    {
+        if(sweepRead(p, raw, &convNs, &busNs) != 0)
+        {
+            return -1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = nsSince(&start, &now);
+        t = elapsed / 1e9;
+        magCalApply(&cal, raw, xyz, 1);
+        if((long)t != bin)
+        {
+            // Bin complete; differences only between adjacent bins.
+            for(c = 0; c < 3 && binN > 0; c++)
+            {
+                y = ax[c].binSum / binN;
+                if(lastBin == bin - 1)
+                {
+                    ax[c].d2 += (y - ax[c].lastMean) * (y - ax[c].lastMean);
+                    ax[c].adevTerms++;
+                }
+                ax[c].lastMean = y;
+                ax[c].binSum = 0.0;
+            }
+            lastBin = (binN > 0) ? bin : lastBin;
+            bin = (long)t;
+            binN = 0;
+        }
+        for(c = 0; c < 3; c++)
+        {
+            if(n == 0)
+            {
+                ax[c].y0 = xyz[c];
+            }
+            y = xyz[c] - ax[c].y0;
+            ax[c].sy += y;
+            ax[c].syy += y * y;
+            ax[c].sty += t * y;
+            ax[c].binSum += xyz[c];
+        }
+        st += t;
+        stt += t * t;
+        binN++;
+        n++;
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu1);
+    r->samples = n;
+    r->rate = n / (elapsed / 1e9);
+    r->convMs = convNs / 1e6 / n;
+    r->busMs = busNs / 1e6 / n;
+    r->cpuMs = nsSince(&cpu0, &cpu1) / 1e6 / n;
+    r->adevRms = 0.0;
+    for(c = 0; c < 3; c++)
+    {
+        // Residual about the least squares line.
+        stY = ax[c].sty - st * ax[c].sy / n;
+        ss = ax[c].syy - ax[c].sy * ax[c].sy / n;
+        if(stt - st * st / n > 0.0)
+        {
+            ss -= stY * stY / (stt - st * st / n);
+        }
+        r->sd[c] = (n > 2 && ss > 0.0) ? sqrt(ss / (n - 2)) : 0.0;
+        r->adev[c] = ax[c].adevTerms ? sqrt(ax[c].d2 / (2.0 * ax[c].adevTerms)) : 0.0;
+        r->adevRms += r->adev[c] * r->adev[c];
+    }
+    r->adevRms = sqrt(r->adevRms / 3.0);
+    return 0;
+}
+
+//------------------------------------------
+// markPareto()
+// Among settings reaching the target rate, those no other beats on
+// adev, cpu and rate.
+//------------------------------------------
+static void markPareto(sweepResult *r, int n, double target)
+{
+    int i;
+    int j;
+
+    for(i = 0; i < n; i++)
+    {
+        r[i].pareto = (r[i].samples > 0 && r[i].rate >= target);
+        for(j = 0; j < n && r[i].pareto; j++)
+        {
+            if(j == i || r[j].samples == 0 || r[j].rate < target)
+            {
+                continue;
+            }
+            if(r[j].adevRms <= r[i].adevRms && r[j].cpuMs <= r[i].cpuMs && r[j].rate >= r[i].rate &&
+               (r[j].adevRms < r[i].adevRms || r[j].cpuMs < r[i].cpuMs || r[j].rate > r[i].rate))
+            {
+                r[i].pareto = FALSE;
+            }
+        }
+    }
+}
+
+//------------------------------------------
+// runSweep()
+//------------------------------------------
+int runSweep(pList *p)
+{
+    sweepResult res[SWEEP_MAXVALUES * SWEEP_MAXVALUES];
+    sweepResult *r;
+    sweepResult *best = NULL;
+    int counts[SWEEP_MAXVALUES];
+    int nosVals[SWEEP_MAXVALUES];
+    int ccSave[3] = { p->cc_x, p->cc_y, p->cc_z };
+    int nosSave = p->NOSRegValue;
+    int nCounts;
+    int nNos = 1;
+    int n = 0;
+    int i;
+    int j;
+
+    nCounts = parseSweepList(p->sweepCounts, counts, 1, CC_800);
+    nosVals[0] = p->NOSRegValue;
+    if(p->sweepNos != NULL)
+    {
+        nNos = parseSweepList(p->sweepNos, nosVals, 1, 255);
+    }
+    fprintf(stdout, "\nSweeping %i settings, %i s each, polled back to back.\n\n", nCounts * nNos, p->sweepSecs);
+    fprintf(stdout, "    CC  NOS   rate Hz  conv ms   bus ms   cpu ms  |   sd X    sd Y    sd Z  |  adev X  adev Y  adev Z  (nT)\n");
+    for(i = 0; i < nCounts; i++)
+    {
+        for(j = 0; j < nNos; j++)
+        {
+            r = &res[n++];
+            memset(r, 0, sizeof(sweepResult));
+            r->cc = counts[i];
+            r->nos = nosVals[j];
+            if(measure(p, p->sweepSecs, r) != 0)
+            {
+                fprintf(stdout, "   %3i  %3i   no DRDY\n", r->cc, r->nos);
+                r->samples = 0;
+                continue;
+            }
+            fprintf(stdout, "   %3i  %3i  %8.2f %8.3f %8.3f %8.3f  | %7.3f %7.3f %7.3f | %7.3f %7.3f %7.3f\n",
+                    r->cc, r->nos, r->rate, r->convMs, r->busMs, r->cpuMs,
+                    r->sd[0], r->sd[1], r->sd[2], r->adev[0], r->adev[1], r->adev[2]);
+            fflush(stdout);
+        }
+    }
+    // Back to the settings we started with.
+    p->cc_x = ccSave[0];
+    p->cc_y = ccSave[1];
+    p->cc_z = ccSave[2];
+    p->NOSRegValue = nosSave;
+    setCycleCountRegs(p);
+
+    markPareto(res, n, p->sweepRate);
+    fprintf(stdout, "\nPareto set for >= %g Hz (adev, cpu, rate):\n", p->sweepRate);
+    for(i = 0; i < n; i++)
+    {
+        if(!res[i].pareto)
+        {
+            continue;
+        }
+        fprintf(stdout, "    -c %-4i -A %-4i  %8.2f Hz  adev %.3f nT rms  cpu %.3f ms\n", res[i].cc, res[i].nos, res[i].rate, res[i].adevRms, res[i].cpuMs);
+        if(best == NULL || res[i].adevRms < best->adevRms)
+        {
+            best = &res[i];
+        }
+    }
+    if(best == NULL)
+    {
+        fprintf(stdout, "    none: no setting reached %g Hz.\n\n", p->sweepRate);
+        return 1;
+    }
+    fprintf(stdout, "\nRecommended: -c %i -A %i\n\n", best->cc, best->nos);
+    return 0;
+}
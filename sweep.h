@@ -0,0 +1,61 @@
+//=========================================================================
+// sweep.h
+//
+// Cycle count / NOS sweep for the runMag utility.
+//
+// For each cycle count and NOS value in the grid the RM3100 is polled
+// back to back for --sweep-secs and the setting is rated on:
+//
+//      rate        samples per second achieved
+//      conv        ms from the poll command to DRDY (the conversion)
+//      bus         ms per sample on the bus: poll write, the status
+//                  reads until DRDY, and the result read
+//      cpu         ms of process CPU per sample
+//      sd          nT per axis, about a straight line fit
+//      adev        nT per axis, Allan deviation of 1 s means
+//
+// The table marks the settings that reach --sweep-rate and that no other
+// such setting beats on adev, cpu and rate together (the Pareto set),
+// and recommends the quietest of those.  The original settings are
+// written back at the end.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100SWEEP_h
+#define SWX3100SWEEP_h
+
+#include "main.h"
+
+#define SWEEP_MAXVALUES         16
+#define SWEEP_DEFSECS           10
+#define SWEEP_MINSECS           3
+#define SWEEP_MAXSECS           3600
+#define SWEEP_SETTLEMS          100
+
+//------------------------------------------
+// Result for one setting
+//------------------------------------------
+typedef struct tag_sweepResult
+{
+    int         cc;
+    int         nos;
+    long        samples;
+    double      rate;                       // Hz
+    double      convMs;
+    double      busMs;
+    double      cpuMs;
+    double      sd[3];                      // nT
+    double      adev[3];                    // nT at 1 s; 0 if under 2 s of data
+    double      adevRms;
+    int         pareto;
+} sweepResult;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int parseSweepList(const char *spec, int *vals, int lo, int hi);
+int runSweep(pList *p);
+
+#endif // SWX3100SWEEP_h
@@ -0,0 +1,373 @@
+//=========================================================================
+// tempcomp.c
+//
+// Online temperature compensation for the runMag utility.
+// See tempcomp.h.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <string.h>
+#include "tempcomp.h"
+
+static const char axisName[3] = { 'x', 'y', 'z' };
+
+//------------------------------------------
+// loadModel()
+// Returns 1 if loaded, 0 if there is no file yet, -1 on error.
+//------------------------------------------
+static int loadModel(tempComp *tc)
+{
+    tempCompAxis *ax;
+    char line[256];
+    char key[16];
+    int lineNo = 0;
+    int got = 0;
+    int i;
+    FILE *fp;
+
+    if((fp = fopen(tc->path, "r")) == NULL)
+    {
+        return 0;
+    }
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        lineNo++;
+        if(sscanf(line, "%15s", key) != 1 || key[0] == '#')
+        {
+            continue;
+        }
+        if(!strcmp(key, "tref") && sscanf(line, "%*s %lf", &tc->tref) == 1)
+        {
+            got |= 8;
+            continue;
+        }
+        for(i = 0; i < 3; i++)
+        {
+            ax = &tc->axis[i];
+            if(key[0] == axisName[i] && key[1] == '\0' &&
+               sscanf(line, "%*s %lf %lf %lf %lf %lf", &ax->a, &ax->b, &ax->P[0][0], &ax->P[0][1], &ax->P[1][1]) == 5)
+            {
+                ax->P[1][0] = ax->P[0][1];
+                got |= 1 << i;
+                break;
+            }
+        }
+        if(i == 3)
+        {
+            fprintf(stderr, "Temperature model %s line %i: expected 'tref' or 'x', 'y', 'z' with 5 values.\n", tc->path, lineNo);
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    if(got != 15)
+    {
+        fprintf(stderr, "Temperature model %s: needs tref, x, y and z lines.\n", tc->path);
+        return -1;
+    }
+    return 1;
+}
+
+//------------------------------------------
+// writeModel()
+// Written to a temporary file and renamed, so a crash never leaves half a model.
+//------------------------------------------
+static int writeModel(const char *path, double tref, const tempCompAxis *axis)
+{
+    char tmp[MAXPATHBUFLEN];
+    int i;
+    FILE *fp;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if((fp = fopen(tmp, "w")) == NULL)
+    {
+        perror("Temperature model");
+        return -1;
+    }
+    fprintf(fp, "# runMag temperature compensation model: B = a + b * (T - tref)\n");
+    fprintf(fp, "#   axis  a (nT)  b (nT/degC)  P00  P01  P11\n");
+    fprintf(fp, "tref %.4f\n", tref);
+    for(i = 0; i < 3; i++)
+    {
+        fprintf(fp, "%c %.6f %.9g %.9g %.9g %.9g\n", axisName[i], axis[i].a, axis[i].b, axis[i].P[0][0], axis[i].P[0][1], axis[i].P[1][1]);
+    }
+    if(fclose(fp) != 0 || rename(tmp, path) != 0)
+    {
+        perror("Temperature model");
+        return -1;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// tempCompInit()
+//------------------------------------------
+int tempCompInit(tempComp *tc, pList *p)
+{
+    int rv;
+    int i;
+
+    if(p->magnetometerOnly || p->localTempOnly)
+    {
+        fprintf(stderr, "\n --tempcomp needs the remote temperature sensor.\n\n");
+        return -1;
+    }
+    memset(tc, 0, sizeof(tempComp));
+    tc->path = p->tempCompPath;
+    tc->lambda = p->tempCompLambda;
+    tc->freeze = p->tempCompFreeze;
+    tc->tref = TEMPCOMP_DEFTREF;
+    for(i = 0; i < 3; i++)
+    {
+        tc->axis[i].P[0][0] = TEMPCOMP_P0_OFFSET;
+        tc->axis[i].P[1][1] = TEMPCOMP_P0_COEF;
+    }
+    if((rv = loadModel(tc)) < 0)
+    {
+        return -1;
+    }
+    tc->seeded = (rv == 1);
+    if(!tc->seeded && tc->freeze)
+    {
+        fprintf(stderr, "\n --tempcomp-freeze needs an existing model in %s.\n\n", tc->path);
+        return -1;
+    }
+    tc->nextSave = time(NULL) + TEMPCOMP_SAVESECS;
+    return 0;
+}
+
+//------------------------------------------
+// rlsUpdate()
+// One step of 2 parameter RLS with regressor (1, dT).
+//------------------------------------------
+static void rlsUpdate(tempCompAxis *ax, double y, double dT, double lambda)
+{
+    double Pp0 = ax->P[0][0] + ax->P[0][1] * dT;
+    double Pp1 = ax->P[1][0] + ax->P[1][1] * dT;
+    double den = lambda + Pp0 + dT * Pp1;
+    double k0 = Pp0 / den;
+    double k1 = Pp1 / den;
+    double e = y - ax->a - ax->b * dT;
+    double scale = 1.0;
+
+    ax->a += k0 * e;
+    ax->b += k1 * e;
+    // P = (P - k phi' P) / lambda; phi' P is (Pp0, Pp1) by symmetry.
+    ax->P[0][0] -= k0 * Pp0;
+    ax->P[0][1] -= k0 * Pp1;
+    ax->P[1][1] -= k1 * Pp1;
+    ax->P[1][0] = ax->P[0][1];
+    if(ax->P[0][0] + ax->P[1][1] < TEMPCOMP_PMAX)
+    {
+        scale = 1.0 / lambda;
+    }
+    ax->P[0][0] *= scale;
+    ax->P[0][1] *= scale;
+    ax->P[1][0] *= scale;
+    ax->P[1][1] *= scale;
+}
+
+//------------------------------------------
+// tempCompApply()
+// Fills smp->compXYZ and updates the model; constant work per sample.
+//------------------------------------------
+void tempCompApply(tempComp *tc, magSample *smp)
+{
+    int valid = smp->rcTemp >= -100.0;
+    double dT;
+    int i;
+
+    smp->haveComp = TRUE;
+    if(valid)
+    {
+        tc->lastTemp = smp->rcTemp;
+        tc->haveTemp = TRUE;
+    }
+    if(!tc->haveTemp)
+    {
+        memcpy(smp->compXYZ, smp->xyz, sizeof(smp->compXYZ));
+        return;
+    }
+    if(!tc->seeded)
+    {
+        // First reading: reference temperature and offsets from here.
+        tc->tref = tc->lastTemp;
+        for(i = 0; i < 3; i++)
+        {
+            tc->axis[i].a = smp->xyz[i];
+        }
+        tc->seeded = TRUE;
+    }
+    dT = tc->lastTemp - tc->tref;
+    for(i = 0; i < 3; i++)
+    {
+        if(valid && !tc->freeze)
+        {
+            rlsUpdate(&tc->axis[i], smp->xyz[i], dT, tc->lambda);
+        }
+        smp->compXYZ[i] = smp->xyz[i] - tc->axis[i].b * dT;
+    }
+    if(valid && !tc->freeze)
+    {
+        tc->updates++;
+        if(smp->ts.tv_sec >= tc->nextSave)
+        {
+            tempCompSave(tc);
+            tc->nextSave = smp->ts.tv_sec + TEMPCOMP_SAVESECS;
+        }
+    }
+}
+
+//------------------------------------------
+// tempCompSave()
+//------------------------------------------
+int tempCompSave(tempComp *tc)
+{
+    if(tc->freeze || !tc->seeded)
+    {
+        return 0;
+    }
+    return writeModel(tc->path, tc->tref, tc->axis);
+}
+
+//------------------------------------------
+// parseLogLine()
+// Remote temperature and field (nT) from one runMag CSV or JSON line.
+//------------------------------------------
+static int parseLogLine(pList *p, const char *line, double *temp, double xyz[3])
+{
+    static const char *keys[3] = { "\"x\":", "\"y\":", "\"z\":" };
+    const char *s;
+    double v[3];
+    int nTemps;
+    int i;
+
+    if(line[0] == '{')
+    {
+        if((s = strstr(line, "\"rt\":")) == NULL || sscanf(s + 5, "%lf", temp) != 1)
+        {
+            return -1;
+        }
+        for(i = 0; i < 3; i++)
+        {
+            if((s = strstr(line, keys[i])) == NULL || sscanf(s + 4, "%lf", &xyz[i]) != 1)
+            {
+                return -1;
+            }
+            xyz[i] *= 1000.0;
+        }
+        return 0;
+    }
+    if(line[0] != '"' && (line[0] < '0' || line[0] > '9'))
+    {
+        return -1;
+    }
+    // Time stamp, then rt [, lt], then x, y, z in uT.
+    nTemps = p->remoteTempOnly ? 1 : 2;
+    if((s = strchr(line, ',')) == NULL || sscanf(s + 1, "%lf", temp) != 1)
+    {
+        return -1;
+    }
+    for(i = 0; i < nTemps; i++)
+    {
+        if((s = strchr(s + 1, ',')) == NULL)
+        {
+            return -1;
+        }
+    }
+    if(sscanf(s + 1, "%lf , %lf , %lf", &v[0], &v[1], &v[2]) != 3)
+    {
+        return -1;
+    }
+    for(i = 0; i < 3; i++)
+    {
+        xyz[i] = v[i] * 1000.0;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// tempCompFit()
+// Batch least squares over a log; writes the model file.
+//------------------------------------------
+int tempCompFit(pList *p)
+{
+    tempCompAxis axis[3];
+    double sT = 0.0;
+    double sTT = 0.0;
+    double sY[3] = { 0.0, 0.0, 0.0 };
+    double sYY[3] = { 0.0, 0.0, 0.0 };
+    double sTY[3] = { 0.0, 0.0, 0.0 };
+    double y0[3] = { 0.0, 0.0, 0.0 };
+    double t0 = 0.0;
+    double xyz[3];
+    double temp;
+    double dT;
+    double dY;
+    double mT;
+    double sxx;
+    double resid;
+    char line[SAMPLEBUFLEN];
+    long n = 0;
+    int i;
+    FILE *fp;
+
+    if(p->tempCompPath == NULL || p->magnetometerOnly || p->localTempOnly)
+    {
+        fprintf(stderr, "\n --tempcomp-fit needs --tempcomp <file> and the remote temperature column.\n\n");
+        return -1;
+    }
+    if((fp = fopen(p->tempCompFit, "r")) == NULL)
+    {
+        perror("Temperature fit log");
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        if(parseLogLine(p, line, &temp, xyz) != 0 || temp < -100.0)
+        {
+            continue;
+        }
+        if(n == 0)
+        {
+            // Shift by the first values so the sums keep their precision.
+            t0 = temp;
+            memcpy(y0, xyz, sizeof(y0));
+        }
+        dT = temp - t0;
+        sT += dT;
+        sTT += dT * dT;
+        for(i = 0; i < 3; i++)
+        {
+            dY = xyz[i] - y0[i];
+            sY[i] += dY;
+            sYY[i] += dY * dY;
+            sTY[i] += dT * dY;
+        }
+        n++;
+    }
+    fclose(fp);
+    mT = (n > 0) ? sT / n : 0.0;
+    sxx = sTT - n * mT * mT;
+    if(n < 3 || sxx <= 0.0)
+    {
+        fprintf(stderr, "Temperature fit: %li usable lines in %s and no temperature change; nothing to fit.\n", n, p->tempCompFit);
+        return -1;
+    }
+    memset(axis, 0, sizeof(axis));
+    for(i = 0; i < 3; i++)
+    {
+        axis[i].b = (sTY[i] - n * mT * (sY[i] / n)) / sxx;
+        axis[i].a = y0[i] + sY[i] / n;
+        axis[i].P[0][0] = 1.0 / n;
+        axis[i].P[1][1] = 1.0 / sxx;
+        resid = (sYY[i] - sY[i] * sY[i] / n - axis[i].b * axis[i].b * sxx) / (n - 2);
+        fprintf(stdout, "  %c: b = %9.4f nT/degC (+/- %.4f), a = %.3f nT\n", axisName[i] - 32, axis[i].b,
+                sqrt((resid > 0.0 ? resid : 0.0) / sxx), axis[i].a);
+    }
+    fprintf(stdout, "  %li samples, tref = %.3f degC, range %.3f degC rms\n", n, t0 + mT, sqrt(sxx / n));
+    return writeModel(p->tempCompPath, t0 + mT, axis);
+}
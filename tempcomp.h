@@ -0,0 +1,77 @@
+//=========================================================================
+// tempcomp.h
+//
+// Online temperature compensation for the runMag utility.
+//
+// Each axis is modelled against the remote (sensor side) MCP9808 as
+//
+//      B = a + b * (T - Tref)                      nT
+//
+// and the compensated field is B - b * (T - Tref).  a and b are updated
+// every sample by recursive least squares with a forgetting factor, a
+// fixed 2 x 2 update per axis; the covariance is not allowed to grow
+// without bound while the temperature is steady.  The model persists in
+// a small text file, rewritten every TEMPCOMP_SAVESECS and at exit:
+//
+//      # comment
+//      tref    <degC>
+//      x       <a> <b> <P00> <P01> <P11>
+//      y       ...
+//      z       ...
+//
+// --tempcomp-fit seeds the file with an ordinary least squares fit over
+// an existing runMag log (CSV or JSON, written with the same temperature
+// options as this run).
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100TEMPCOMP_h
+#define SWX3100TEMPCOMP_h
+
+#include "main.h"
+
+#define TEMPCOMP_DEFLAMBDA      0.99999     // ~1 day memory at 1 Hz
+#define TEMPCOMP_SAVESECS       600
+#define TEMPCOMP_PMAX           1.0e8       // covariance trace ceiling (anti wind-up)
+#define TEMPCOMP_P0_OFFSET      1.0e6       // initial variances: nT^2
+#define TEMPCOMP_P0_COEF        1.0e2       //                    (nT/degC)^2
+#define TEMPCOMP_DEFTREF        25.0
+
+//------------------------------------------
+// One axis
+//------------------------------------------
+typedef struct tag_tempCompAxis
+{
+    double      a;
+    double      b;                          // nT per degC
+    double      P[2][2];
+} tempCompAxis;
+
+//------------------------------------------
+// Compensation state
+//------------------------------------------
+typedef struct tag_tempComp
+{
+    const char     *path;
+    double          lambda;
+    int             freeze;
+    double          tref;
+    int             seeded;                 // a has been set
+    tempCompAxis    axis[3];
+    double          lastTemp;
+    int             haveTemp;
+    time_t          nextSave;
+    unsigned long   updates;
+} tempComp;
+
+//------------------------------------------
+// Prototypes
+//------------------------------------------
+int tempCompInit(tempComp *tc, pList *p);
+void tempCompApply(tempComp *tc, magSample *smp);
+int tempCompSave(tempComp *tc);
+int tempCompFit(pList *p);
+
+#endif // SWX3100TEMPCOMP_h
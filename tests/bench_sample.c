@@ -0,0 +1,192 @@
+//=========================================================================
+// bench_sample.c
+//
+// Time per reading of the per-sample stages of runMag, to compare
+// builds and boards:
+//
+//      magDecode() and magCalApply(), in the batches the loop uses
+//      hampelPush() with a 7 reading window
+//      decimatorPush() for each filter at 50x
+//      fftRun() of a 1024 point PSD segment, per point
+//
+// "make bench" builds it against the release objects and runs it.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "magcal.h"
+#include "hampel.h"
+#include "decimate.h"
+#include "fft.h"
+
+#define BATCH           64
+#define READINGS        2000000
+#define NFFT            1024
+#define FFTRUNS         2000
+
+static volatile double sink;
+
+//------------------------------------------
+// nowNs()
+//------------------------------------------
+static int64_t nowNs(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+//------------------------------------------
+// report()
+//------------------------------------------
+static void report(const char *what, int64_t ns, long n)
+{
+    fprintf(stdout, "   %-28s %8.1f ns\n", what, (double)ns / n);
+}
+
+//------------------------------------------
+// benchCal()
+//------------------------------------------
+static void benchCal(void)
+{
+    static uint8_t bytes[9 * BATCH];
+    static int32_t raw[3 * BATCH];
+    static double xyz[3 * BATCH];
+    magCal cal;
+    int64_t t;
+    int i;
+
+    for(i = 0; i < (int)sizeof(bytes); i++)
+    {
+        bytes[i] = (uint8_t)(i * 37 + 11);
+    }
+    magCalInitUnit(&cal);
+    t = nowNs();
+    for(i = 0; i < READINGS / BATCH; i++)
+    {
+        bytes[0] = (uint8_t)i;
+        magDecode(bytes, raw, BATCH);
+    }
+    report("magDecode()", nowNs() - t, READINGS);
+    t = nowNs();
+    for(i = 0; i < READINGS / BATCH; i++)
+    {
+        raw[0] = i;
+        magCalApply(&cal, raw, xyz, BATCH);
+    }
+    report("magCalApply()", nowNs() - t, READINGS);
+    sink = xyz[0];
+}
+
+//------------------------------------------
+// benchHampel()
+//------------------------------------------
+static void benchHampel(void)
+{
+    static hampelFilter h;
+    int32_t xyz[3];
+    uint32_t s = 1;
+    int64_t t;
+    int i;
+
+    hampelInit(&h, 7, HAMPEL_DEFK, 1);
+    t = nowNs();
+    for(i = 0; i < READINGS; i++)
+    {
+        s = s * 1664525u + 1013904223u;
+        xyz[0] = 200000 + (int32_t)(s >> 24);
+        xyz[1] = -5000 + (int32_t)((s >> 16) & 0xff);
+        xyz[2] = (int32_t)((s >> 8) & 0xff);
+        hampelPush(&h, xyz);
+    }
+    report("hampelPush(), window 7", nowNs() - t, READINGS);
+}
+
+//------------------------------------------
+// benchDecimate()
+//------------------------------------------
+static void benchDecimate(void)
+{
+    char what[64];
+    decimator d;
+    double out[3];
+    int32_t xyz[3] = { 200000, -5000, 30000 };
+    int64_t t;
+    int f;
+    int i;
+
+    for(f = 0; f < 3; f++)
+    {
+        if(decimatorInit(&d, 50, f, 20000000LL) != 0)
+        {
+            continue;
+        }
+        t = nowNs();
+        for(i = 0; i < READINGS; i++)
+        {
+            xyz[0] += (i & 7) - 3;
+            decimatorPush(&d, xyz, out);
+        }
+        snprintf(what, sizeof(what), "decimatorPush(), %s 50x", decimFilterName(f));
+        report(what, nowNs() - t, READINGS);
+        sink = out[0];
+        decimatorFree(&d);
+    }
+}
+
+//------------------------------------------
+// benchFft()
+//------------------------------------------
+static void benchFft(void)
+{
+    fftPlan plan;
+    v4df *re;
+    v4df *im;
+    int64_t t;
+    int i;
+    int k;
+
+    if(fftInit(&plan, NFFT) != 0 ||
+       posix_memalign((void **)&re, 64, NFFT * sizeof(v4df)) != 0 ||
+       posix_memalign((void **)&im, 64, NFFT * sizeof(v4df)) != 0)
+    {
+        fprintf(stderr, "bench_sample: out of memory\n");
+        return;
+    }
+    t = nowNs();
+    for(k = 0; k < FFTRUNS; k++)
+    {
+        for(i = 0; i < NFFT; i++)
+        {
+            re[i] = (v4df){ i & 15, k & 7, i ^ k, 0.0 };
+            im[i] = (v4df){ 0.0, 0.0, 0.0, 0.0 };
+        }
+        fftRun(&plan, re, im);
+    }
+    report("fftRun(), 1024 points", nowNs() - t, (long)FFTRUNS * NFFT);
+    sink = re[1][0];
+    free(re);
+    free(im);
+    fftFree(&plan);
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    fprintf(stdout, "Time per reading (X, Y and Z):\n");
+    benchCal();
+    benchHampel();
+    benchDecimate();
+    benchFft();
+    return 0;
+}
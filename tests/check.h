@@ -0,0 +1,38 @@
+//=========================================================================
+// check.h
+//
+// Minimal assertions for the smoke checks run by "make check".  Each
+// check is a small program that exits non-zero when anything failed.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#ifndef SWX3100CHECK_h
+#define SWX3100CHECK_h
+
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+#define CHECK(cond)                                                             \
+    do                                                                          \
+    {                                                                           \
+        if(!(cond))                                                             \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            checkFailures++;                                                    \
+        }                                                                       \
+    } while(0)
+
+//------------------------------------------
+// checkDone()
+// Reports and gives main()'s exit status.
+//------------------------------------------
+static inline int checkDone(const char *name)
+{
+    fprintf(stdout, "%s: %s\n", name, checkFailures ? "FAILED" : "ok");
+    return checkFailures ? 1 : 0;
+}
+
+#endif // SWX3100CHECK_h
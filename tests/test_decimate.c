@@ -0,0 +1,135 @@
+//=========================================================================
+// test_decimate.c
+//
+// Checks each decimation filter at several ratios:
+//
+//      a constant comes out unchanged, one output per <ratio> inputs
+//      an impulse, moved through every input phase, adds up to the
+//      filter's full response: unit gain, centred on the reported delay
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <stdlib.h>
+#include "decimate.h"
+#include "check.h"
+
+#define IMPULSE         1000000
+
+//------------------------------------------
+// settleLen()
+// Inputs before the filter's outputs depend on nothing it started with.
+//------------------------------------------
+static int settleLen(const decimator *d)
+{
+    return (d->firLen + d->cicOrder + 2) * d->ratio;
+}
+
+//------------------------------------------
+// checkConstant()
+//------------------------------------------
+static void checkConstant(int filter, int ratio)
+{
+    const int32_t c[3] = { 1000, -2000, 8388607 };
+    decimator d;
+    double out[3];
+    int outputs = 0;
+    int n;
+    int i;
+    int k;
+
+    CHECK(decimatorInit(&d, ratio, filter, 0) == 0);
+    n = settleLen(&d);
+    for(i = 0; i < n + 10 * ratio; i++)
+    {
+        if(decimatorPush(&d, c, out))
+        {
+            if(i >= n)
+            {
+                outputs++;
+            }
+            for(k = 0; k < 3 && i >= n; k++)
+            {
+                CHECK(fabs(out[k] - c[k]) < 1e-6 * fabs((double)c[k]));
+            }
+        }
+    }
+    CHECK(outputs == 10);
+    decimatorFree(&d);
+}
+
+//------------------------------------------
+// checkImpulse()
+//------------------------------------------
+static void checkImpulse(int filter, int ratio)
+{
+    const int32_t zero[3] = { 0, 0, 0 };
+    const int32_t one[3] = { IMPULSE, -IMPULSE, 0 };
+    decimator d;
+    double out[3];
+    double gain[2] = { 0.0, 0.0 };
+    double moment = 0.0;
+    double t;
+    int64_t periodNs = 100000000LL / ratio;
+    int at;
+    int n;
+    int s;
+    int i;
+
+    for(s = 0; s < ratio; s++)
+    {
+        CHECK(decimatorInit(&d, ratio, filter, periodNs) == 0);
+        CHECK(d.delayNs == (int64_t)(d.delay * periodNs));
+        n = settleLen(&d);
+        at = n + s;
+        for(i = 0; i < at + n + ratio; i++)
+        {
+            if(decimatorPush(&d, (i == at) ? one : zero, out))
+            {
+                // The output made by input i is stamped delay inputs back.
+                t = i - d.delay - at;
+                gain[0] += out[0] / IMPULSE;
+                gain[1] -= out[1] / IMPULSE;
+                moment += t * out[0] / IMPULSE;
+                CHECK(out[2] == 0.0);
+            }
+        }
+        decimatorFree(&d);
+    }
+    CHECK(fabs(gain[0] - 1.0) < 1e-9);
+    CHECK(fabs(gain[1] - 1.0) < 1e-9);
+    CHECK(fabs(moment) < 1e-6 * ratio);
+    if(fabs(moment) >= 1e-6 * ratio)
+    {
+        fprintf(stderr, "%s ratio %i: response centred %.3f inputs from the delay\n",
+                decimFilterName(filter), ratio, moment);
+    }
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    static const int ratios[] = { 2, 8, 10, 50, 120, DECIM_MAXRATIO };
+    static const char *names[] = { "gauss", "cic", "boxcar" };
+    int f;
+    int r;
+
+    (void)argc;
+    (void)argv;
+    for(f = 0; f < 3; f++)
+    {
+        CHECK(parseDecimFilter(names[f]) == f);
+        CHECK(parseDecimFilter(decimFilterName(f)) == f);
+        for(r = 0; r < (int)(sizeof(ratios) / sizeof(ratios[0])); r++)
+        {
+            checkConstant(f, ratios[r]);
+            checkImpulse(f, ratios[r]);
+        }
+    }
+    CHECK(parseDecimFilter("median") == -1);
+    return checkDone("test_decimate");
+}
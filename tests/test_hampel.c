@@ -0,0 +1,162 @@
+//=========================================================================
+// test_hampel.c
+//
+// Runs the skip list Hampel filter beside a brute force one that sorts
+// the window for every sample, over noisy counts with repeated values
+// and spikes, for several windows and thresholds.  The spike masks, the
+// replaced values and the spike counts must agree exactly.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <stdlib.h>
+#include <string.h>
+#include "hampel.h"
+#include "check.h"
+
+#define NSAMPLES        4000
+
+//------------------------------------------
+// nextRand()
+//------------------------------------------
+static uint32_t nextRand(uint32_t *s)
+{
+    *s = *s * 1664525u + 1013904223u;
+    return *s >> 8;
+}
+
+//------------------------------------------
+// byValue()
+//------------------------------------------
+static int byValue(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+//------------------------------------------
+// refPush()
+// One axis of the filter, the slow way.  hist holds the last window
+// raw values, oldest first.
+//------------------------------------------
+static int refPush(int64_t *hist, int *count, int window, double k, int32_t *x)
+{
+    int64_t sorted[HAMPEL_MAXWINDOW];
+    int64_t med;
+    int64_t mad;
+    int64_t dev;
+    int c = (window - 1) / 2;
+    int i;
+
+    if(*count == window)
+    {
+        memmove(hist, hist + 1, (window - 1) * sizeof(hist[0]));
+        (*count)--;
+    }
+    hist[(*count)++] = *x;
+    if(*count < window)
+    {
+        return 0;
+    }
+    memcpy(sorted, hist, window * sizeof(sorted[0]));
+    qsort(sorted, window, sizeof(sorted[0]), byValue);
+    med = sorted[c];
+    for(i = 0; i < window; i++)
+    {
+        sorted[i] = (hist[i] > med) ? hist[i] - med : med - hist[i];
+    }
+    qsort(sorted, window, sizeof(sorted[0]), byValue);
+    mad = (sorted[c] < 1) ? 1 : sorted[c];
+    dev = (*x > med) ? *x - med : med - *x;
+    if(dev > k * HAMPEL_MADSCALE * mad)
+    {
+        *x = (int32_t)med;
+        return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------
+// runOnce()
+//------------------------------------------
+static void runOnce(int window, double k, int replace, uint32_t seed)
+{
+    static hampelFilter h;
+    int64_t hist[3][HAMPEL_MAXWINDOW];
+    int count[3] = { 0, 0, 0 };
+    unsigned long spikes[3] = { 0, 0, 0 };
+    int32_t level[3] = { 20000, -5000, 0 };
+    int32_t xyz[3];
+    int32_t ref[3];
+    int mask;
+    int refMask;
+    int i;
+    int a;
+
+    hampelInit(&h, window, k, replace);
+    for(i = 0; i < NSAMPLES; i++)
+    {
+        for(a = 0; a < 3; a++)
+        {
+            // A slow walk with a little noise; Z is coarse so values repeat.
+            level[a] += (int32_t)(nextRand(&seed) % 5) - 2;
+            xyz[a] = level[a] + (int32_t)(nextRand(&seed) % 7) - 3;
+            if(a == 2)
+            {
+                xyz[a] = (xyz[a] / 8) * 8;
+            }
+            if(nextRand(&seed) % 50 == 0)
+            {
+                xyz[a] += ((nextRand(&seed) & 1) ? 1 : -1) * (int32_t)(10 + nextRand(&seed) % 100000);
+            }
+        }
+        memcpy(ref, xyz, sizeof(ref));
+        refMask = 0;
+        for(a = 0; a < 3; a++)
+        {
+            if(refPush(hist[a], &count[a], window, k, &ref[a]))
+            {
+                refMask |= 1 << a;
+                spikes[a]++;
+            }
+            if(!replace)
+            {
+                ref[a] = xyz[a];
+            }
+        }
+        mask = hampelPush(&h, xyz);
+        CHECK(mask == refMask);
+        CHECK(memcmp(xyz, ref, sizeof(ref)) == 0);
+        if(mask != refMask)
+        {
+            fprintf(stderr, "window %i, k %.1f, sample %i: mask %i, expected %i\n", window, k, i, mask, refMask);
+            return;
+        }
+    }
+    for(a = 0; a < 3; a++)
+    {
+        CHECK(h.spikes[a] == spikes[a]);
+        CHECK(spikes[a] > 0);
+    }
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    static const int windows[] = { HAMPEL_MINWINDOW, 5, 7, 31, 101, HAMPEL_MAXWINDOW };
+    int i;
+
+    (void)argc;
+    (void)argv;
+    for(i = 0; i < (int)(sizeof(windows) / sizeof(windows[0])); i++)
+    {
+        runOnce(windows[i], HAMPEL_DEFK, 1, 12345u + i);
+        runOnce(windows[i], 2.0, 0, 777u + i);
+    }
+    return checkDone("test_hampel");
+}
@@ -0,0 +1,252 @@
+//=========================================================================
+// test_logidx.c
+//
+// Builds a day log with a gap in it and its index the way runMag does,
+// then checks:
+//
+//      line times parse, CSV, JSON and -M milliseconds
+//      logIndexSeek() for times across the log lands on a line start
+//      within one stride of the first line at or after the time
+//      an index left behind its log, or ahead of a truncated one, is
+//      brought back to what indexing the log from scratch gives
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "logidx.h"
+#include "check.h"
+
+#define STRIDE          60
+#define START           1792368000LL            // 19 Oct 2026 00:00:00 UTC
+#define NLINES          7200
+#define GAPFROM         3000                    // lines [GAPFROM, GAPTO) are missing
+#define GAPTO           4300
+#define MAXLINES        NLINES
+
+static char logPath[LOGIDX_PATHLEN - 16];
+static int64_t lineTs[MAXLINES];
+static long lineOff[MAXLINES];
+static int nLines = 0;
+
+//------------------------------------------
+// formatLine()
+//------------------------------------------
+static int formatLine(char *buf, size_t len, int64_t secs, int i)
+{
+    time_t t = (time_t)secs;
+    char utcStr[64];
+    struct tm utcTime;
+
+    gmtime_r(&t, &utcTime);
+    strftime(utcStr, sizeof(utcStr), "%d %b %Y %T", &utcTime);
+    return snprintf(buf, len, "\"%s\", 24.50, 21.00, %.4f, 1.5000, 50.0000\n", utcStr, 20.0 + i * 0.0001);
+}
+
+//------------------------------------------
+// writeLog()
+// Lines [from, to) of the day, appended to the log; indexed when li is
+// not NULL.
+//------------------------------------------
+static void writeLog(logIndex *li, FILE *fp, int from, int to)
+{
+    char line[128];
+    int len;
+    int i;
+
+    for(i = from; i < to; i++)
+    {
+        if(i >= GAPFROM && i < GAPTO)
+        {
+            continue;
+        }
+        len = formatLine(line, sizeof(line), START + i, i);
+        lineOff[nLines] = ftell(fp);
+        lineTs[nLines++] = (START + i) * 1000;
+        fwrite(line, 1, len, fp);
+        fflush(fp);
+        if(li != NULL)
+        {
+            logIndexAdd(li, (START + i) * 1000, len);
+        }
+    }
+}
+
+//------------------------------------------
+// readIndex()
+// The index file, malloc()ed; *len is its size.
+//------------------------------------------
+static uint8_t *readIndex(long *len)
+{
+    char path[LOGIDX_PATHLEN + sizeof(LOGIDX_SUFFIX)];
+    uint8_t *buf;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s%s", logPath, LOGIDX_SUFFIX);
+    if((fp = fopen(path, "rb")) == NULL)
+    {
+        *len = 0;
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    if((buf = malloc(*len + 1)) != NULL && fread(buf, 1, *len, fp) != (size_t)*len)
+    {
+        *len = -1;
+    }
+    fclose(fp);
+    return buf;
+}
+
+//------------------------------------------
+// freshIndex()
+// The index built from nothing for the log as it stands.
+//------------------------------------------
+static uint8_t *freshIndex(long *len)
+{
+    char path[LOGIDX_PATHLEN + sizeof(LOGIDX_SUFFIX)];
+    logIndex li;
+
+    snprintf(path, sizeof(path), "%s%s", logPath, LOGIDX_SUFFIX);
+    unlink(path);
+    CHECK(logIndexOpen(&li, logPath, NULL, STRIDE) == 0);
+    logIndexClose(&li);
+    return readIndex(len);
+}
+
+//------------------------------------------
+// checkParse()
+//------------------------------------------
+static void checkParse(void)
+{
+    const int64_t t = (START + 3 * 3600 + 59 * 60) * 1000;
+
+    CHECK(logIndexParseTime("\"19 Oct 2026 03:59:00\", 24.50, 21.00, 20.0226\n") == t);
+    CHECK(logIndexParseTime("{ \"ts\":\"19 Oct 2026 03:59:00\", \"rt\":24.50 }\n") == t);
+    CHECK(logIndexParseTime("1792382340123, 24.50, 21.00\n") == t + 123);
+    CHECK(logIndexParseTime("{ \"ts\":1792382340123, \"rt\":24.50 }\n") == t + 123);
+    CHECK(logIndexParseTime("\"time\", \"rtemp\", \"ltemp\", \"x\", \"y\", \"z\"\n") == -1);
+    CHECK(logIndexParseTime("# gap: not sampling\n") == -1);
+}
+
+//------------------------------------------
+// checkSeeks()
+//------------------------------------------
+static void checkSeeks(void)
+{
+    char line[LOGIDX_LINELEN];
+    int64_t target;
+    int64_t ts;
+    long pos;
+    FILE *fp;
+    int want;
+    int at;
+
+    fp = fopen(logPath, "r");
+    CHECK(fp != NULL);
+    if(fp == NULL)
+    {
+        return;
+    }
+    for(target = (START - 100) * 1000; target <= (START + NLINES + 100) * 1000; target += 7321)
+    {
+        CHECK(logIndexSeek(fp, logPath, target) == 0);
+        pos = ftell(fp);
+
+        // It has to be the top, or the start of a line at or before the
+        // answer...
+        for(want = 0; want < nLines && lineTs[want] < target; want++)
+        {
+        }
+        for(at = 0; at < nLines && lineOff[at] < pos; at++)
+        {
+        }
+        CHECK(pos == 0 || at == nLines || lineOff[at] == pos);
+        CHECK(at <= want);
+
+        // ... and everything read before it in the same stride.
+        if(at < want)
+        {
+            CHECK(lineTs[at] / 1000 / STRIDE == lineTs[want - 1] / 1000 / STRIDE);
+        }
+        if(pos > 0 && at < nLines && fgets(line, sizeof(line), fp) != NULL)
+        {
+            ts = logIndexParseTime(line);
+            CHECK(ts == lineTs[at]);
+        }
+    }
+    fclose(fp);
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    char dir[] = "/tmp/test_logidx.XXXXXX";
+    char path[LOGIDX_PATHLEN + sizeof(LOGIDX_SUFFIX)];
+    uint8_t *have;
+    uint8_t *want;
+    long haveLen;
+    long wantLen;
+    logIndex li;
+    FILE *fp;
+
+    (void)argc;
+    (void)argv;
+    checkParse();
+    if(mkdtemp(dir) == NULL)
+    {
+        perror("test_logidx");
+        return 1;
+    }
+    snprintf(logPath, sizeof(logPath), "%s/test-20261019-runmag.log", dir);
+    snprintf(path, sizeof(path), "%s%s", logPath, LOGIDX_SUFFIX);
+
+    // The header line is not indexed; the lines are, as they are written.
+    fp = fopen(logPath, "w");
+    fputs("\"time\", \"rtemp\", \"ltemp\", \"x\", \"y\", \"z\"\n", fp);
+    CHECK(logIndexOpen(&li, logPath, fp, STRIDE) == 0);
+    writeLog(&li, fp, 0, NLINES / 2);
+    CHECK(li.errors == 0);
+
+    // runMag stops; the log goes on without the index.
+    logIndexClose(&li);
+    writeLog(NULL, fp, NLINES / 2, NLINES);
+    fclose(fp);
+
+    // Reopening catches up to what a fresh index holds.
+    CHECK(logIndexOpen(&li, logPath, NULL, STRIDE) == 0);
+    logIndexClose(&li);
+    have = readIndex(&haveLen);
+    want = freshIndex(&wantLen);
+    CHECK(haveLen > (long)sizeof(logIndexHdr) && haveLen == wantLen && memcmp(have, want, wantLen) == 0);
+    free(have);
+    free(want);
+    checkSeeks();
+
+    // A log cut short leaves index entries past its end; they go.
+    CHECK(truncate(logPath, lineOff[nLines - 500] + 10) == 0);
+    CHECK(logIndexOpen(&li, logPath, NULL, STRIDE) == 0);
+    logIndexClose(&li);
+    have = readIndex(&haveLen);
+    want = freshIndex(&wantLen);
+    CHECK(haveLen == wantLen && memcmp(have, want, wantLen) == 0);
+    free(have);
+    free(want);
+
+    // Without an index a seek starts from the top.
+    unlink(path);
+    fp = fopen(logPath, "r");
+    CHECK(logIndexSeek(fp, logPath, (START + 100) * 1000) == -1 && ftell(fp) == 0);
+    fclose(fp);
+
+    unlink(logPath);
+    rmdir(dir);
+    return checkDone("test_logidx");
+}
@@ -0,0 +1,286 @@
+//=========================================================================
+// test_magcol.c
+//
+// Round trip through the magcol archive.  A log of known samples, with
+// missing temperatures, a gap and several UTC hours, is packed into
+// small blocks by ./magcol and queried back:
+//
+//      one row per second gives every sample back exactly
+//      one row for everything matches the statistics worked out here,
+//      so the per block statistics in the index are right
+//      a time range, groups and a sample filter count what they should
+//
+// Run from the top of the tree, after magcol is built.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "check.h"
+
+#define MAGCOL          "./magcol"
+#define START           1792376400LL            // 19 Oct 2026 02:20:00 UTC
+#define NSAMPLES        9000
+#define GAPFROM         5000                    // samples [GAPFROM, GAPTO) are missing
+#define GAPTO           5600
+#define MISSING         INT32_MIN
+#define NCOLS           5                       // x, y, z (0.1 nT), rt, lt (0.01 C)
+
+static int64_t when[NSAMPLES];                  // s
+static int32_t val[NSAMPLES][NCOLS];
+static int nSamples = 0;
+
+//------------------------------------------
+// makeSamples()
+//------------------------------------------
+static void makeSamples(void)
+{
+    int i;
+
+    for(i = 0; i < NSAMPLES; i++)
+    {
+        if(i >= GAPFROM && i < GAPTO)
+        {
+            continue;
+        }
+        when[nSamples] = START + i;
+        val[nSamples][0] = 200000 + (i * 37) % 2001 - 1000;
+        val[nSamples][1] = 15000 + (int32_t)lround(300.0 * sin(i / 500.0));
+        val[nSamples][2] = -5 + (i % 11) - (i / 1000) * 7;
+        val[nSamples][3] = (i % 97 == 0) ? MISSING : 2450 + i % 50;
+        val[nSamples][4] = (i % 89 == 0) ? MISSING : -1200 + i % 7;
+        nSamples++;
+    }
+}
+
+//------------------------------------------
+// writeLog()
+// CSV as runMag writes it: time, rt, lt, then X, Y, Z in uT.
+//------------------------------------------
+static int writeLog(const char *path)
+{
+    char utcStr[64];
+    struct tm utcTime;
+    time_t t;
+    FILE *fp;
+    int i;
+    int c;
+
+    if((fp = fopen(path, "w")) == NULL)
+    {
+        return -1;
+    }
+    fprintf(fp, "\"time\", \"rtemp\", \"ltemp\", \"x\", \"y\", \"z\"\n");
+    for(i = 0; i < nSamples; i++)
+    {
+        t = (time_t)when[i];
+        gmtime_r(&t, &utcTime);
+        strftime(utcStr, sizeof(utcStr), "%d %b %Y %T", &utcTime);
+        fprintf(fp, "\"%s\"", utcStr);
+        for(c = 3; c < 5; c++)
+        {
+            if(val[i][c] == MISSING)
+            {
+                fprintf(fp, ", \"ERROR\"");
+            }
+            else
+            {
+                fprintf(fp, ", %.2f", val[i][c] / 100.0);
+            }
+        }
+        fprintf(fp, ", %.4f, %.4f, %.4f\n", val[i][0] / 10000.0, val[i][1] / 10000.0, val[i][2] / 10000.0);
+    }
+    return fclose(fp);
+}
+
+//------------------------------------------
+// unitScale()
+//------------------------------------------
+static double unitScale(int c)
+{
+    return (c < 3) ? 10.0 : 100.0;
+}
+
+//------------------------------------------
+// checkRow()
+// A row "time, n, min, max, mean, .." against samples [from, to) that
+// pass keep[] (all when keep is NULL).
+//------------------------------------------
+static void checkRow(const char *row, int64_t start, int from, int to, const char *keep)
+{
+    char utcStr[32];
+    struct tm utcTime;
+    time_t t = (time_t)start;
+    const char *s = row;
+    double min;
+    double max;
+    double sum;
+    double got[3];
+    long n = 0;
+    long cn;
+    int i;
+    int c;
+    int k;
+
+    gmtime_r(&t, &utcTime);
+    strftime(utcStr, sizeof(utcStr), "%Y-%m-%dT%H:%M:%SZ", &utcTime);
+    CHECK(strncmp(s, utcStr, strlen(utcStr)) == 0);
+    for(i = from; i < to; i++)
+    {
+        n += (keep == NULL || keep[i]);
+    }
+    s = strchr(s, ',');
+    CHECK(s != NULL && strtol(s + 1, NULL, 10) == n);
+    for(c = 0; c < NCOLS && s != NULL; c++)
+    {
+        min = INFINITY;
+        max = -INFINITY;
+        sum = 0.0;
+        cn = 0;
+        for(i = from; i < to; i++)
+        {
+            if((keep == NULL || keep[i]) && val[i][c] != MISSING)
+            {
+                min = (val[i][c] < min) ? val[i][c] : min;
+                max = (val[i][c] > max) ? val[i][c] : max;
+                sum += val[i][c];
+                cn++;
+            }
+        }
+        for(k = 0; k < 3 && s != NULL; k++)
+        {
+            s = strchr(s + 1, ',');
+            got[k] = (s != NULL) ? strtod(s + 1, NULL) : NAN;
+            if(cn == 0)
+            {
+                CHECK(s != NULL && strncmp(s, ", \"\"", 4) == 0);
+            }
+        }
+        if(cn > 0)
+        {
+            CHECK(got[0] == min / unitScale(c));
+            CHECK(got[1] == max / unitScale(c));
+            CHECK(fabs(got[2] - sum / cn / unitScale(c)) < ((c < 3) ? 0.006 : 0.0006));
+        }
+    }
+}
+
+//------------------------------------------
+// query()
+// Runs magcol and returns its rows, at most max, without the heading.
+//------------------------------------------
+static int query(const char *args, const char *arch, char rows[][256], int max)
+{
+    char cmd[512];
+    char line[256];
+    FILE *fp;
+    int n = 0;
+
+    snprintf(cmd, sizeof(cmd), "%s %s %s", MAGCOL, args, arch);
+    if((fp = popen(cmd, "r")) == NULL)
+    {
+        return -1;
+    }
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        if(line[0] == '#')
+        {
+            continue;
+        }
+        if(n < max)
+        {
+            memcpy(rows[n], line, sizeof(line));
+        }
+        n++;
+    }
+    CHECK(pclose(fp) == 0);
+    return n;
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    static char rows[NSAMPLES + 1][256];
+    static char keep[NSAMPLES];
+    char dir[] = "/tmp/test_magcol.XXXXXX";
+    char log[64];
+    char arch[64];
+    char cmd[256];
+    char args[128];
+    int64_t begin;
+    int64_t end;
+    int64_t g;
+    int from;
+    int to;
+    int n;
+    int i;
+
+    (void)argc;
+    (void)argv;
+    if(access(MAGCOL, X_OK) != 0 || mkdtemp(dir) == NULL)
+    {
+        perror("test_magcol");
+        return 1;
+    }
+    snprintf(log, sizeof(log), "%s/test.log", dir);
+    snprintf(arch, sizeof(arch), "%s/test.mcol", dir);
+    makeSamples();
+    CHECK(writeLog(log) == 0);
+    snprintf(cmd, sizeof(cmd), "%s -o %s -B 100 %s", MAGCOL, arch, log);
+    CHECK(system(cmd) == 0);
+
+    // Every sample back.
+    n = query("-g 1 -c x,y,z,rt,lt", arch, rows, NSAMPLES + 1);
+    CHECK(n == nSamples);
+    for(i = 0; i < n && i < nSamples; i++)
+    {
+        checkRow(rows[i], when[i], i, i + 1, NULL);
+    }
+
+    // Everything in one row.
+    n = query("-c x,y,z,rt,lt", arch, rows, 1);
+    CHECK(n == 1);
+    checkRow(rows[0], when[0], 0, nSamples, NULL);
+
+    // Ten minute groups over part of the day, Z above -30 only.
+    begin = START + 1234;
+    end = START + 7777;
+    snprintf(args, sizeof(args), "-b %lld -e %lld -g 600 -s 'z>-3.0' -c x,y,z,rt,lt", (long long)begin, (long long)end);
+    for(i = 0; i < nSamples; i++)
+    {
+        keep[i] = (when[i] >= begin && when[i] < end && val[i][2] > -30);
+    }
+    n = query(args, arch, rows, NSAMPLES);
+    CHECK(n > 2);
+    for(from = 0, i = 0; i < n; i++)
+    {
+        while(from < nSamples && !keep[from])
+        {
+            from++;
+        }
+        CHECK(from < nSamples);
+        if(from == nSamples)
+        {
+            break;
+        }
+        g = when[from] / 600;
+        for(to = from; to < nSamples && when[to] / 600 == g; to++)
+        {
+        }
+        checkRow(rows[i], g * 600, from, to, keep);
+        from = to;
+    }
+
+    unlink(arch);
+    unlink(log);
+    rmdir(dir);
+    return checkDone("test_magcol");
+}
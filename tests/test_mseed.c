@@ -0,0 +1,241 @@
+//=========================================================================
+// test_mseed.c
+//
+// Round trip of the miniSEED writer: counts covering every Steim2 word
+// layout go in, the records are decoded again and must give back the
+// same counts, channel by channel, with consistent headers.
+//
+// The writer's log rollover is stubbed so the records land in a
+// temporary file.
+//
+// Author:      David Witten, KD0EAG
+// Date:        October 19, 2026
+// License:     GPL 3.0
+//=========================================================================
+#include <stdlib.h>
+#include <string.h>
+#include "mseed.h"
+#include "check.h"
+
+#define NSAMPLES        3000
+#define GAPAT           1700            // a missing sample here starts new records
+
+char sitePrefixString[SITEPREFIXLEN] = "TEST";
+
+static FILE *outfp = NULL;
+
+//------------------------------------------
+// Log rollover stubs
+//------------------------------------------
+FILE *logRollOpenFile(logRoll *lr, pList *p, const char *suffix)
+{
+    (void)p;
+    memset(lr, 0, sizeof(logRoll));
+    lr->suffix = suffix;
+    lr->boundary = (time_t)0x7fffffff;
+    lr->curfp = outfp = tmpfile();
+    return lr->curfp;
+}
+
+FILE *logRollSwap(logRoll *lr, time_t now)
+{
+    (void)now;
+    return lr->curfp;
+}
+
+void logRollClose(logRoll *lr)
+{
+    lr->curfp = NULL;
+}
+
+//------------------------------------------
+// Big-endian readers
+//------------------------------------------
+static uint16_t getU16(const uint8_t *b)
+{
+    return (uint16_t)((b[0] << 8) | b[1]);
+}
+
+static uint32_t getU32(const uint8_t *b)
+{
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+//------------------------------------------
+// signExtend()
+//------------------------------------------
+static int32_t signExtend(uint32_t v, int bits)
+{
+    uint32_t m = 1u << (bits - 1);
+
+    v &= (bits == 32) ? 0xffffffffu : ((1u << bits) - 1);
+    return (int32_t)((v ^ m) - m);
+}
+
+//------------------------------------------
+// decodeRecord()
+// Appends the record's samples to out[]; returns how many, -1 if the
+// record does not hold together.
+//------------------------------------------
+static int decodeRecord(const uint8_t *rec, int recLen, int32_t *out, int room)
+{
+    int nSamples = getU16(rec + 30);
+    int nFrames = rec[63];
+    int32_t x0 = (int32_t)getU32(rec + MSEED_HDRLEN + 4);
+    int32_t xn = (int32_t)getU32(rec + MSEED_HDRLEN + 8);
+    int32_t d[7];
+    int n = 0;
+    int f;
+    int w;
+    int k;
+    int cnt;
+    int bits;
+    uint32_t ctl;
+    uint32_t word;
+
+    if(nSamples > room || nFrames > (recLen - MSEED_HDRLEN) / MSEED_FRAMELEN)
+    {
+        return -1;
+    }
+    for(f = 0; f < nFrames; f++)
+    {
+        const uint8_t *frame = rec + MSEED_HDRLEN + f * MSEED_FRAMELEN;
+
+        ctl = getU32(frame);
+        for(w = (f == 0) ? 3 : 1; w < MSEED_FRAMELEN / 4; w++)
+        {
+            word = getU32(frame + w * 4);
+            cnt = 0;
+            bits = 0;
+            switch((ctl >> (2 * (15 - w))) & 3)
+            {
+                case 0:
+                    continue;
+                case 1:
+                    cnt = 4;
+                    bits = 8;
+                    break;
+                case 2:
+                    cnt = (word >> 30) == 1 ? 1 : (word >> 30) == 2 ? 2 : 3;
+                    bits = (cnt == 1) ? 30 : (cnt == 2) ? 15 : 10;
+                    break;
+                case 3:
+                    cnt = (word >> 30) == 0 ? 5 : (word >> 30) == 1 ? 6 : 7;
+                    bits = (cnt == 5) ? 6 : (cnt == 6) ? 5 : 4;
+                    break;
+            }
+            for(k = 0; k < cnt; k++)
+            {
+                d[k] = signExtend(word >> (bits * (cnt - 1 - k)), bits);
+            }
+            for(k = 0; k < cnt && n < nSamples; k++)
+            {
+                // The first difference of a record is not used: x0 is.
+                out[n] = (n == 0) ? x0 : out[n - 1] + d[k];
+                n++;
+            }
+        }
+    }
+    if(n != nSamples || out[n - 1] != xn)
+    {
+        return -1;
+    }
+    return n;
+}
+
+//------------------------------------------
+// countsFor()
+// Differences from a few counts to +-2^23 so every word layout is used.
+//------------------------------------------
+static int32_t countsFor(int axis, int i)
+{
+    static const int32_t steps[] = { 3, 12, 25, 100, 400, 12000, 3000000 };
+    int32_t step = steps[(i / 150) % 7];
+    int32_t v = ((i * 7919 + axis * 104729) % (2 * step + 1)) - step;
+
+    return (axis == 2) ? -v : v + axis * 1000;
+}
+
+//------------------------------------------
+// runOnce()
+//------------------------------------------
+static void runOnce(int recLen)
+{
+    static int32_t got[3][NSAMPLES];
+    uint8_t rec[MSEED_MAXRECLEN];
+    mseedWriter w;
+    magSample smp;
+    pList p;
+    int have[3] = { 0, 0, 0 };
+    int64_t ns;
+    int axis;
+    int i;
+    int n;
+
+    memset(&p, 0, sizeof(p));
+    p.mseedRecLen = recLen;
+    CHECK(mseedOpen(&w, &p, 10.0) == 0);
+    memset(&smp, 0, sizeof(smp));
+    for(i = 0; i < NSAMPLES; i++)
+    {
+        ns = 1792368000000000000LL + (int64_t)(i + (i >= GAPAT)) * 100000000LL;
+        smp.ts.tv_sec = ns / 1000000000LL;
+        smp.ts.tv_nsec = ns % 1000000000LL;
+        for(axis = 0; axis < 3; axis++)
+        {
+            smp.rXYZ[axis] = countsFor(axis, i);
+        }
+        mseedPush(&w, &smp);
+    }
+    mseedClose(&w);
+
+    rewind(outfp);
+    while(fread(rec, 1, recLen, outfp) == (size_t)recLen)
+    {
+        CHECK(rec[6] == 'D');
+        CHECK(memcmp(rec + 8, "TEST", 4) == 0);
+        CHECK(rec[15] == 'B' && rec[16] == 'F');
+        CHECK(getU16(rec + 48) == 1000 && rec[52] == MSEED_ENC_STEIM2);
+        CHECK((1 << rec[54]) == recLen);
+        axis = rec[17] - 'X';
+        CHECK(axis >= 0 && axis < 3);
+        if(axis < 0 || axis > 2)
+        {
+            break;
+        }
+        n = decodeRecord(rec, recLen, got[axis] + have[axis], NSAMPLES - have[axis]);
+        CHECK(n > 0);
+        if(n <= 0)
+        {
+            break;
+        }
+        have[axis] += n;
+    }
+    fclose(outfp);
+    for(axis = 0; axis < 3; axis++)
+    {
+        CHECK(have[axis] == NSAMPLES);
+        for(i = 0; i < have[axis]; i++)
+        {
+            if(got[axis][i] != countsFor(axis, i))
+            {
+                fprintf(stderr, "record length %i, axis %i, sample %i: %i != %i\n",
+                        recLen, axis, i, got[axis][i], countsFor(axis, i));
+                CHECK(got[axis][i] == countsFor(axis, i));
+                break;
+            }
+        }
+    }
+}
+
+//------------------------------------------
+// main()
+//------------------------------------------
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    runOnce(MSEED_MINRECLEN);
+    runOnce(MSEED_MAXRECLEN);
+    return checkDone("test_mseed");
+}